@@ -0,0 +1,123 @@
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "batch_means.h"
+#include "error_handling.h"
+
+using std::vector;
+
+BatchMeans::BatchMeans(int size, int batches) : target(batches), samples(0), length(1),
+    filled(0), full(0), moments(size), current(size, 0.0), sums(2*batches*size, 0.0) {
+  if (batches < 2) throw SimError("batch means need at least 2 batches");
+}
+
+/* Add one sample of each series. Returns whether a batch was completed,
+ * which is when the standard errors change */
+bool
+BatchMeans::post(const double *x) {
+  int n = size();
+  for (int i=0; i < n; i++) {
+    moments.post(i, x[i]);
+    current[i] += x[i];
+  }
+  samples++;
+  if (++filled < length) return false;
+
+  /* the batch is full */
+  std::copy(current.begin(), current.end(), sums.begin() + full*n);
+  std::fill(current.begin(), current.end(), 0.0);
+  filled = 0;
+  if (++full == 2*target) {
+    for (int j=0; j < target; j++) {
+      for (int i=0; i < n; i++) sums[j*n + i] = sums[2*j*n + i] + sums[(2*j+1)*n + i];
+    }
+    full = target;
+    length *= 2;
+  }
+  return true;
+}
+
+/* the standard error of series i's mean, NaN until there are two batches */
+double
+BatchMeans::se(int i) const {
+  if (full < 2) return NAN;
+  int n = size();
+  double mu = 0.0, m2 = 0.0;
+  for (int j=0; j < full; j++) {
+    double d = sums[j*n + i] / length - mu;
+    mu += d / (j+1);
+    m2 += d * (sums[j*n + i] / length - mu);
+  }
+  return sqrt(m2 / (full-1) / full);
+}
+
+/* the effective sample size of series i, all of its samples if its batch
+ * means don't vary */
+double
+BatchMeans::ess(int i) const {
+  double e = se(i);
+  if (isnan(e)) return NAN;
+  if (e == 0.0) return samples;
+  return moments.variance(i) / (e*e);
+}
+
+/* the lag 1 autocorrelation of series i's batch means, 0 if they don't vary */
+double
+BatchMeans::lag1(int i) const {
+  if (full < 2) return NAN;
+  int n = size();
+  double mu = 0.0;
+  for (int j=0; j < full; j++) mu += sums[j*n + i];
+  mu /= full;
+  double c0 = 0.0, c1 = 0.0;
+  for (int j=0; j < full; j++) {
+    double d = sums[j*n + i] - mu;
+    c0 += d*d;
+    if (j > 0) c1 += d * (sums[(j-1)*n + i] - mu);
+  }
+  return c0 > 0 ? c1 / c0 : 0.0;
+}
+
+/* flatten onto the end of v: size, target, samples, length, filled, full,
+ * then the moments, the current batch and the full batches */
+void
+BatchMeans::save(vector<double> &v) const {
+  v.push_back(size());
+  v.push_back(target);
+  v.push_back(samples);
+  v.push_back(length);
+  v.push_back(filled);
+  v.push_back(full);
+  v.insert(v.end(), moments.n.begin(), moments.n.end());
+  v.insert(v.end(), moments.mu.begin(), moments.mu.end());
+  v.insert(v.end(), moments.m2.begin(), moments.m2.end());
+  v.insert(v.end(), current.begin(), current.end());
+  v.insert(v.end(), sums.begin(), sums.begin() + full*size());
+}
+
+/* read back batch means saved at p, returning where they end. They must
+ * have the same size and number of batches */
+const double*
+BatchMeans::restore(const double *p, const double *end) {
+  int n = size();
+  if (end - p < 6) throw SimError("truncated batch means");
+  if ((int)p[0] != n || (int)p[1] != target) throw SimError("batch means don't match");
+  samples = (long)p[2];
+  length = (long)p[3];
+  filled = (long)p[4];
+  full = (int)p[5];
+  p += 6;
+  if (full < 0 || full >= 2*target || end - p < (long)(4 + full)*n)
+    throw SimError("truncated batch means");
+  moments.n.assign(p, p+n);
+  moments.mu.assign(p+n, p+2*n);
+  moments.m2.assign(p+2*n, p+3*n);
+  current.assign(p+3*n, p+4*n);
+  p += 4*n;
+  std::copy(p, p + full*n, sums.begin());
+  return p + full*n;
+}
+
+/* END */
@@ -0,0 +1,54 @@
+#ifndef __BATCH_MEANS_H__
+#define __BATCH_MEANS_H__
+
+#include <vector>
+
+#include "moments.h"
+
+/* Standard errors of the means of a set of autocorrelated series, sampled
+ * together, by batch means. The samples are cut into batches of
+ * consecutive samples, and once the batches are longer than the series'
+ * autocorrelation their means are nearly independent, so the standard error
+ * is the standard deviation of the batch means over the square root of the
+ * number of batches. When 2*batches batches have filled, neighbouring pairs
+ * are merged, halving their number and doubling their length, so there are
+ * always between batches and 2*batches of them, and the memory used stays
+ * the same, however long the run.
+ *
+ * The effective sample size is the variance of the samples over the
+ * squared standard error: the number of independent samples that would
+ * have given the mean as precisely. Whether the batches are long enough
+ * can be judged by the lag 1 autocorrelation of their means. */
+class BatchMeans {
+public:
+  BatchMeans(int size, int batches = 32);
+  ~BatchMeans() { }
+
+  bool post(const double *x);
+  bool post(double x) { return post(&x); }
+
+  int size(void) const { return current.size(); }
+  long count(void) const { return samples; }
+  int batches(void) const { return full; }
+  long batch_length(void) const { return length; }
+  double mean(int i) const { return moments.mean(i); }
+  double se(int i) const;
+  double ess(int i) const;
+  double lag1(int i) const;
+  double batch_mean(int j, int i) const { return sums[j*size() + i] / length; }
+
+  void save(std::vector<double> &v) const;
+  const double* restore(const double *p, const double *end);
+
+private:
+  int target;                   /* batches kept, at least */
+  long samples;                 /* samples of each series */
+  long length;                  /* samples in each batch */
+  long filled;                  /* samples in the batch being filled */
+  int full;                     /* full batches */
+  Moments moments;              /* each series' mean and variance */
+  std::vector<double> current;  /* sums of the batch being filled */
+  std::vector<double> sums;     /* sums of the full batches, batch j of series i at j*size()+i */
+};
+
+#endif /* __BATCH_MEANS_H__ */
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+
+#include "branch.h"
+#include "error_handling.h"
+#include "sim_rand.h"
+#include "genome.h"
+#include "output.h"
+
+using std::cout;
+using std::endl;
+using std::vector;
+using std::string;
+
+/* fork one child per branch */
+int fork_branches(Args &ar) {
+  vector<FILE*> outputs;
+  vector<pid_t> pids;
+
+  /* anything still buffered would otherwise be printed by every child, and
+   * the writer thread must be stopped, as threads don't survive fork() */
+  out.finish();
+  cout.flush();
+  fflush(stdout);
+
+  for (int k=0; k < ar.branches; k++) {
+    FILE *tmp = tmpfile();
+    if (tmp == NULL) throw SimError("failed to create temporary file for branch output");
+    pid_t pid = fork();
+    if (pid < 0) throw SimError(0, "failed to fork branch %d", k);
+    if (pid == 0) {
+      /* the child writes its output to its own temporary file */
+      if (dup2(fileno(tmp), STDOUT_FILENO) < 0)
+        throw SimError(0, "failed to redirect output of branch %d", k);
+      for (int j=0; j < (int)outputs.size(); j++) fclose(outputs[j]);
+      return k;
+    }
+    outputs.push_back(tmp);
+    pids.push_back(pid);
+  }
+
+  /* wait for the children in order, passing on each one's output */
+  int failed = 0;
+  char buf[65536];
+  for (int k=0; k < ar.branches; k++) {
+    int status;
+    if (waitpid(pids[k], &status, 0) < 0)
+      throw SimError(0, "failed to wait for branch %d", k);
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128+WTERMSIG(status);
+    if (code != 0) failed++;
+
+    cout << "branch: " << k << endl;
+    rewind(outputs[k]);
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), outputs[k])) > 0)
+      cout.write(buf, n);
+    cout << "end branch: " << k << " status: " << code << endl;
+    fclose(outputs[k]);
+  }
+  if (failed > 0) throw SimError(0, "%d branch(es) failed", failed);
+  return -1;
+}
+
+/* Each branch gets its own seed, derived from the run's seed and the branch
+ * number, and optionally its own mutation rate and opts/times schedule */
+void setup_branch(Args &ar, int k) {
+  unsigned int seed = derive_seed(ar.rand_seed, k+1);
+  srand48(seed);
+  if (ar.crn) use_role_streams(seed);
+  if (ar.branch_mu.size() > 0) {
+    ar.mu = ar.branch_mu[k];
+    Genome::new_mu(ar.mu);
+  }
+  if (ar.branch_opts.size() > 0) {
+    ar.opts.resize(ar.branch_opts[k].size());
+    ar.opts = ar.branch_opts[k];
+    ar.times.resize(ar.branch_times[k].size());
+    ar.times = ar.branch_times[k];
+    Genome::new_optimum(ar.opts[0]);
+  }
+
+  /* each branch writes its own trajectory and genotype files, and
+   * publishes to its own segment */
+  if (!ar.trajectory_file.empty()) {
+    std::stringstream path;
+    path << ar.trajectory_file << "." << k;
+    ar.trajectory_file = path.str();
+  }
+  if (!ar.publish_name.empty()) {
+    std::stringstream name;
+    name << ar.publish_name << "." << k;
+    ar.publish_name = name.str();
+  }
+  if (!ar.export_genotypes_file.empty()) {
+    std::stringstream path;
+    path << ar.export_genotypes_file << "." << k;
+    ar.export_genotypes_file = path.str();
+  }
+
+  string tmp;
+  out << "branch_params: branch=" << k << " seed=" << seed << " mu=" << ar.mu;
+  out << " " << print_r_vector(ar.opts, "opts", tmp);
+  out << " " << print_r_vector(ar.times, "times", tmp) << '\n';
+}
+
+/* END */
@@ -0,0 +1,23 @@
+#ifndef __BRANCH_H__
+#define __BRANCH_H__
+
+#include "command_line.h"
+
+/* Branching lets many replicates share a single burnin. Once the burnin is
+ * over, the process fork()s one child per branch. The children start with
+ * the burned-in Population, Site and Genome state of the parent, shared
+ * copy-on-write by the operating system, so nothing needs to be copied or
+ * serialized. Each child reseeds the random number generator, applies its
+ * branch's mutation rate and opts/times schedule, and continues on its own,
+ * writing to a temporary file. The parent waits for all the children and
+ * then prints each one's output in turn, between "branch: <k>" and
+ * "end branch: <k>" lines. */
+
+/* In each child, returns the branch number. In the parent, returns -1 once
+ * all the children's output has been collected */
+int fork_branches(Args &ar);
+
+/* reseed and apply branch k's parameters, called in the child */
+void setup_branch(Args &ar, int k);
+
+#endif /* __BRANCH_H__ */
@@ -0,0 +1,86 @@
+#include <vector>
+
+#include "burnin.h"
+#include "error_handling.h"
+
+using std::vector;
+
+/* the fewest batches the rule is applied to */
+#define MIN_BATCHES 100
+
+BurninDetector::BurninDetector(int size, long shortest, int batches) : means(size, batches), 
+    shortest(shortest), previous(size, 0.0), settled_at(-1), from(-1) {
+}
+
+/* Add one generation's samples. Returns true once the series have all
+ * settled, and stayed settled, which is only checked when a batch has
+ * been completed */
+bool
+BurninDetector::post(const double *x) {
+  previous.assign(x, x + means.size());
+  if (from >= 0) return true;
+  if (!means.post(x) || means.batches() < MIN_BATCHES || means.count() < shortest) return false;
+  int latest = 0;
+  for (int i=0; i < means.size(); i++) {
+    int d = truncation(i);
+    if (2*d >= means.batches()) {
+      settled_at = -1;
+      return false;
+    }
+    if (d > latest) latest = d;
+  }
+  /* the series must stay settled until the run is twice as long as when
+   * they first seemed to be, so a slow trend has time to show */
+  if (settled_at < 0) settled_at = means.count();
+  if (means.count() < 2*settled_at) return false;
+  from = latest * means.batch_length();
+  return true;
+}
+
+/* The MSER truncation point of series i, in batches: the d up to half
+ * the batches with the least variance of the batches after it over their
+ * number. If that's the halfway point itself, the series hasn't settled.
+ * The tails are accumulated from the end, with Welford's updates */
+int
+BurninDetector::truncation(int i) const {
+  int n = means.batches();
+  double mu = 0.0, m2 = 0.0, best = 0.0;
+  int best_d = n;
+  for (int d=n-1; d >= 0; d--) {
+    int k = n-d;
+    double y = means.batch_mean(d, i);
+    double delta = y - mu;
+    mu += delta / k;
+    m2 += delta * (y - mu);
+    double mser = m2 / ((double)k * k);
+    if (2*d <= n && (best_d == n || mser <= best)) {
+      best = mser;
+      best_d = d;
+    }
+  }
+  return best_d;
+}
+
+/* flatten onto the end of v: the batch means, then the last samples, when
+ * the series first settled and the generation stationary from */
+void
+BurninDetector::save(vector<double> &v) const {
+  means.save(v);
+  v.insert(v.end(), previous.begin(), previous.end());
+  v.push_back(settled_at);
+  v.push_back(from);
+}
+
+/* read back a detector saved at p, returning where it ends */
+const double*
+BurninDetector::restore(const double *p, const double *end) {
+  p = means.restore(p, end);
+  int n = means.size();
+  if (end - p < n+2) throw SimError("truncated burnin detector");
+  previous.assign(p, p+n);
+  settled_at = (long)p[n];
+  from = (long)p[n+1];
+  return p + n+2;
+}
+
+/* END */
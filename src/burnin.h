@@ -0,0 +1,45 @@
+#ifndef __BURNIN_H__
+#define __BURNIN_H__
+
+#include <vector>
+
+#include "batch_means.h"
+
+/* Detects the end of the burnin, from a set of series sampled each burnin
+ * generation, by MSER (White's marginal standard error rule). For each
+ * truncation point d of a series' batch means Y_0 ... Y_n-1, MSER is the
+ * variance of Y_d ... Y_n-1 over (n-d), and it's smallest where cutting
+ * off more would take away settled batches, not an initial transient. A
+ * series has settled once the best d is in the first half of its batches,
+ * so there's at least as long a stationary stretch after it. The burnin is
+ * over once all the series have settled, and stayed settled while the run
+ * doubled in length, and they're taken to have been stationary from the
+ * latest of their truncation points.
+ *
+ * The batch means are kept by BatchMeans, so however long the burnin runs
+ * there are no more than 2*batches of them. The rule isn't applied until
+ * there have been at least shortest samples, since on a short stretch a
+ * slow trend can't be told from noise. */
+class BurninDetector {
+public:
+  BurninDetector(int size, long shortest, int batches = 512);
+  ~BurninDetector() { }
+
+  bool post(const double *x);
+  double last(int i) const { return previous[i]; }
+  long count(void) const { return means.count(); }
+  long stationary_from(void) const { return from; }
+  int truncation(int i) const;
+
+  void save(std::vector<double> &v) const;
+  const double* restore(const double *p, const double *end);
+
+private:
+  BatchMeans means;
+  long shortest;                  /* samples before the rule is applied */
+  std::vector<double> previous;   /* the last samples posted */
+  long settled_at;                /* samples when they last started to look settled, or -1 */
+  long from;                      /* generation stationary from, -1 until detected */
+};
+
+#endif /* __BURNIN_H__ */
@@ -0,0 +1,416 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "checkpoint.h"
+#include "error_handling.h"
+#include "genome.h"
+#include "site.h"
+#include "sim_rand.h"
+#include "moments.h"
+
+using std::string;
+using std::vector;
+using std::map;
+using std::queue;
+using std::pair;
+
+#define CHECKPOINT_VERSION 2
+
+volatile sig_atomic_t checkpoint_requested = 0;
+
+static void request_checkpoint(int sig) {
+  checkpoint_requested = (sig == SIGTERM) ? CHECKPOINT_STOP : CHECKPOINT_CONTINUE;
+}
+
+/* checkpoint on SIGUSR1 and carry on, or checkpoint on SIGTERM and stop */
+void
+Checkpoint::install_signal_handlers(void) {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = request_checkpoint;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+}
+
+/* the scalar state, stored as the "state" section */
+struct CheckpointState {
+  uint32_t version;
+  int32_t popsize, model, ploidy, num_loci;
+  int32_t generation, epoch, parent_pop, burnin;
+  int32_t mutation_count;
+  uint32_t next_unique_id;
+  int32_t delta_generations;
+  double mu, s, env;
+  double baseline, optimum;
+  double max_fitness[2];
+  uint16_t rand48[4];                    /* the fourth is padding */
+  int32_t crn, nroles;
+  uint64_t role_state[num_rand_roles];
+};
+
+/* one site of one population view, stored in the "sitesN" sections */
+struct SiteRecord {
+  double effect;
+  int32_t count;
+  int32_t generation_created;
+  uint32_t id;
+  int32_t reusable;
+};
+
+/* Writes sections to the checkpoint file */
+class SectionWriter {
+public:
+  SectionWriter(FILE *f, const string &p) : out(f), path(p) { }
+  void put(const char *tag, const void *data, uint64_t n) {
+    char t[8];
+    memset(t, 0, 8);
+    memcpy(t, tag, strnlen(tag, 8));
+    static const char zeros[8] = { 0 };
+    size_t pad = (8 - n % 8) % 8;
+    if (fwrite(t, 8, 1, out) != 1 || fwrite(&n, 8, 1, out) != 1 ||
+        (n > 0 && fwrite(data, n, 1, out) != 1) || (pad > 0 && fwrite(zeros, pad, 1, out) != 1))
+      throw SimError(0, "failed to write checkpoint %s", path.c_str());
+  }
+  template<class T> void put(const char *tag, const vector<T> &v) {
+    put(tag, v.empty() ? NULL : &v[0], v.size()*sizeof(T));
+  }
+private:
+  FILE *out;
+  string path;
+};
+
+/* A checkpoint file, mapped into memory, with its sections found */
+class SectionReader {
+public:
+  SectionReader(const string &p) : path(p) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw SimError(0, "cannot open checkpoint %s", path.c_str());
+    struct stat st;
+    if (fstat(fd, &st) != 0) throw SimError(0, "cannot stat checkpoint %s", path.c_str());
+    size = st.st_size;
+    base = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) throw SimError(0, "cannot map checkpoint %s", path.c_str());
+    madvise((void *)base, size, MADV_SEQUENTIAL);
+
+    size_t pos = 0;
+    while (pos + 16 <= size) {
+      string tag(base + pos, strnlen(base + pos, 8));
+      uint64_t n;
+      memcpy(&n, base + pos + 8, 8);
+      if (pos + 16 + n > size) throw SimError(0, "truncated checkpoint %s", path.c_str());
+      sections[tag] = std::make_pair(base + pos + 16, (size_t)n);
+      pos += 16 + n + (8 - n % 8) % 8;
+    }
+  }
+  ~SectionReader() { munmap((void *)base, size); }
+
+  /* get a section, checking it holds whole elements of type T */
+  template<class T> const T* get(const string &tag, size_t &count, bool required = true) {
+    map<string,std::pair<const char*,size_t> >::iterator it = sections.find(tag);
+    if (it == sections.end()) {
+      if (required) throw SimError(0, "checkpoint %s has no %s section", path.c_str(), tag.c_str());
+      count = 0;
+      return NULL;
+    }
+    if (it->second.second % sizeof(T) != 0)
+      throw SimError(0, "bad %s section in checkpoint %s", tag.c_str(), path.c_str());
+    count = it->second.second / sizeof(T);
+    return (const T *)it->second.first;
+  }
+
+private:
+  string path;
+  const char *base;
+  size_t size;
+  map<string,std::pair<const char*,size_t> > sections;
+};
+
+/* the name of a per-view section */
+static string view_tag(const char *name, int v) {
+  char t[16];
+  snprintf(t, sizeof(t), "%s%d", name, v);
+  return string(t);
+}
+
+/* write a set of Moments, if it exists */
+void
+Checkpoint::put_moments(SectionWriter &w, const char *name, const Moments *m) {
+  if (m == NULL) return;
+  w.put(view_tag(name, 0).c_str(), m->n);
+  w.put(view_tag(name, 1).c_str(), m->mu);
+  w.put(view_tag(name, 2).c_str(), m->m2);
+}
+
+/* read a set of Moments back in, if it exists */
+void
+Checkpoint::get_moments(SectionReader &r, const char *name, Moments *m) {
+  if (m == NULL) return;
+  size_t n, k, j;
+  const double *counts = r.get<double>(view_tag(name, 0), n);
+  const double *means = r.get<double>(view_tag(name, 1), k);
+  const double *m2 = r.get<double>(view_tag(name, 2), j);
+  if (n != m->n.size() || k != m->mu.size() || j != m->m2.size())
+    throw SimError(0, "checkpoint's %s statistic doesn't match", name);
+  m->n.assign(counts, counts+n);
+  m->mu.assign(means, means+k);
+  m->m2.assign(m2, m2+j);
+}
+
+/* Write a checkpoint. The file is written beside the final one and renamed
+ * into place once complete */
+void
+Checkpoint::write(const string &path, const Args &ar, Population *pops, const LoopState &loop) {
+  string tmp = path + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (f == NULL) throw SimError(0, "failed to open checkpoint %s", tmp.c_str());
+  SectionWriter w(f, tmp);
+
+  CheckpointState st;
+  memset(&st, 0, sizeof(st));
+  st.version = CHECKPOINT_VERSION;
+  st.popsize = Population::popsize;
+  st.model = Population::sites_model;
+  st.ploidy = Site::ploidy_level;
+  st.num_loci = Population::num_loci;
+  st.generation = Population::generation;
+  st.epoch = loop.epoch;
+  st.parent_pop = loop.parent_pop;
+  st.burnin = ar.burnin;
+  st.mutation_count = Genome::mutation_count;
+  st.next_unique_id = Site::next_unique_id;
+  st.delta_generations = Population::delta_generations;
+  st.mu = Genome::mu;
+  st.s = ar.s;
+  st.env = Genome::environmental_noise;
+  st.baseline = Genome::baseline;
+  st.optimum = Genome::optimum;
+  st.max_fitness[0] = pops[0].max_fitness;
+  st.max_fitness[1] = pops[1].max_fitness;
+  /* seed48() returns the current state, but also sets it, so set it back */
+  unsigned short state[3] = { 0, 0, 0 };
+  unsigned short *current = seed48(state);
+  memcpy(st.rand48, current, sizeof(state));
+  memcpy(state, st.rand48, sizeof(state));
+  seed48(state);
+  st.crn = role_streams != NULL;
+  st.nroles = num_rand_roles;
+  for (int r=0; st.crn && r < num_rand_roles; r++) st.role_state[r] = role_streams[r].x;
+  w.put("state", &st, sizeof(st));
+
+  /* the two population views */
+  int N = Population::popsize;
+  for (int v=0; v < 2; v++) {
+    Population &p = pops[v];
+    vector<SiteRecord> records(p.sites.size());
+    vector<char> genotypes(p.sites.size() * N);
+    for (size_t loc=0; loc < p.sites.size(); loc++) {
+      Site &site = p.sites[loc];
+      records[loc].effect = site.effect;
+      records[loc].count = site.derived_alleles_count;
+      records[loc].generation_created = site.generation_created;
+      records[loc].id = site.id;
+      records[loc].reusable = site.reusable;
+      if (N > 0) site.store->read_column(loc, &genotypes[loc*N]);
+    }
+    w.put(view_tag("sites", v).c_str(), records);
+    w.put(view_tag("geno", v).c_str(), genotypes);
+
+    vector<double> fitness(N), phenotype(N);
+    vector<uint32_t> offsets(N+1, 0);
+    vector<uint32_t> mutants;
+    for (int i=0; i < N; i++) {
+      Genome *g = p.genomes[i];
+      fitness[i] = g->fitness;
+      phenotype[i] = g->phenotype;
+      mutants.insert(mutants.end(), g->mutant_sites.begin(), g->mutant_sites.end());
+      offsets[i+1] = mutants.size();
+    }
+    w.put(view_tag("fit", v).c_str(), fitness);
+    w.put(view_tag("pheno", v).c_str(), phenotype);
+    w.put(view_tag("moff", v).c_str(), offsets);
+    w.put(view_tag("muts", v).c_str(), mutants);
+  }
+
+  /* the lost site queue, in order */
+  vector<int32_t> lost;
+  queue<int> q(Population::lost);
+  while (!q.empty()) { lost.push_back(q.front()); q.pop(); }
+  w.put("lost", lost);
+
+  /* accumulated statistics */
+  vector<double> fix_effects;
+  vector<int32_t> fix_counts;
+  for (map<double,int>::iterator it = Population::fixations.begin(); it != Population::fixations.end(); it++) {
+    fix_effects.push_back(it->first);
+    fix_counts.push_back(it->second);
+  }
+  w.put("fixeff", fix_effects);
+  w.put("fixcnt", fix_counts);
+  if (!Population::visits.empty()) Population::flush_visits();
+  w.put("visits", Population::visits);
+  w.put("dcounts", Population::delta_counts);
+  w.put("dids", Population::delta_ids);
+  put_moments(w, "dpm", Population::delta_p_moments);
+  put_moments(w, "pvm", Population::phenotype_var_mean);
+
+  /* the quantile sketches, each key (kind and effect) with its sketch */
+  vector<double> sketch_keys, sketch_state;
+  for (map<pair<int,double>, QuantileSketch>::iterator it = Population::sketches.begin();
+      it != Population::sketches.end(); it++) {
+    sketch_keys.push_back(it->first.first);
+    sketch_keys.push_back(it->first.second);
+    it->second.save(sketch_state);
+  }
+  w.put("qkeys", sketch_keys);
+  w.put("qsketch", sketch_state);
+
+  /* the convergence targets' batch means */
+  vector<double> target_state;
+  for (size_t t=0; t < Population::target_means.size(); t++)
+    Population::target_means[t]->save(target_state);
+  w.put("targets", target_state);
+
+  /* and an adaptive burnin's detector */
+  vector<double> burnin_state;
+  if (Population::burnin_detector != NULL) Population::burnin_detector->save(burnin_state);
+  w.put("burnin", burnin_state);
+
+  if (fclose(f) != 0) throw SimError(0, "failed to write checkpoint %s", tmp.c_str());
+  if (rename(tmp.c_str(), path.c_str()) != 0)
+    throw SimError(0, "failed to rename checkpoint %s", tmp.c_str());
+}
+
+/* Restore a checkpoint into freshly initialized populations, which must
+ * have been set up with the same arguments as the checkpointed run */
+void
+Checkpoint::read(const string &path, Args &ar, Population *pops, LoopState &loop) {
+  SectionReader r(path);
+  size_t n;
+  const CheckpointState *stp = r.get<CheckpointState>("state", n);
+  if (n != 1) throw SimError(0, "bad state in checkpoint %s", path.c_str());
+  const CheckpointState &st = *stp;
+  if (st.version != CHECKPOINT_VERSION)
+    throw SimError(0, "unsupported checkpoint version %u", st.version);
+  if (st.popsize != Population::popsize || st.model != (int)Population::sites_model ||
+      st.ploidy != (int)Site::ploidy_level || st.mu != Genome::mu || st.s != ar.s ||
+      st.env != Genome::environmental_noise)
+    throw SimError(0, "checkpoint %s was written with different parameters", path.c_str());
+  if (st.epoch >= (int)ar.times.size())
+    throw SimError(0, "checkpoint %s is past the last epoch", path.c_str());
+  if ((st.crn != 0) != (role_streams != NULL) || st.nroles != num_rand_roles)
+    throw SimError("checkpoint and run must both, or neither, use --crn");
+  if (Population::num_loci != 0)
+    throw SimError("can only resume into empty populations");
+
+  Population::num_loci = st.num_loci;
+  Population::generation = st.generation;
+  Population::delta_generations = st.delta_generations;
+  loop.epoch = st.epoch;
+  loop.parent_pop = st.parent_pop;
+  ar.burnin = st.burnin;
+  Genome::mutation_count = st.mutation_count;
+  Genome::baseline = st.baseline;
+  Genome::new_optimum(st.optimum);
+  Site::next_unique_id = st.next_unique_id;
+  unsigned short state[3];
+  memcpy(state, st.rand48, sizeof(state));
+  seed48(state);
+  for (int k=0; st.crn && k < num_rand_roles; k++) role_streams[k].x = st.role_state[k];
+
+  int N = Population::popsize;
+  for (int v=0; v < 2; v++) {
+    Population &p = pops[v];
+    size_t nsites, ngeno;
+    const SiteRecord *records = r.get<SiteRecord>(view_tag("sites", v), nsites);
+    const char *genotypes = r.get<char>(view_tag("geno", v), ngeno);
+    if (nsites != (size_t)st.num_loci || ngeno != nsites*N)
+      throw SimError(0, "bad sites in checkpoint %s", path.c_str());
+    p.sites.clear();
+    p.sites.reserve(nsites);
+    p.reserve_sites(nsites);
+    for (size_t loc=0; loc < nsites; loc++) {
+      p.sites.push_back(Site(p.store, loc, records[loc].effect, records[loc].id, records[loc].generation_created));
+      Site &site = p.sites.back();
+      site.derived_alleles_count = records[loc].count;
+      site.reusable = records[loc].reusable != 0;
+      if (N > 0) p.store->write_column(loc, genotypes + loc*N);
+    }
+
+    size_t nfit, npheno, noff, nmuts;
+    const double *fitness = r.get<double>(view_tag("fit", v), nfit);
+    const double *phenotype = r.get<double>(view_tag("pheno", v), npheno);
+    const uint32_t *offsets = r.get<uint32_t>(view_tag("moff", v), noff);
+    const uint32_t *mutants = r.get<uint32_t>(view_tag("muts", v), nmuts, false);
+    if (nfit != (size_t)N || npheno != (size_t)N || noff != (size_t)N+1 || offsets[N] != nmuts)
+      throw SimError(0, "bad genomes in checkpoint %s", path.c_str());
+    for (int i=0; i < N; i++) {
+      Genome *g = p.genomes[i];
+      g->fitness = fitness[i];
+      g->phenotype = phenotype[i];
+      g->mutant_sites.assign(mutants + offsets[i], mutants + offsets[i+1]);
+    }
+    p.max_fitness = st.max_fitness[v];
+  }
+
+  /* every site's count has been replaced, so statistics kept from the
+   * changes look at all of them again */
+  Population::visits_changes.reset();
+  Population::frequency_changes.reset();
+
+  size_t k;
+  const int32_t *lost = r.get<int32_t>("lost", n, false);
+  while (!Population::lost.empty()) Population::lost.pop();
+  for (size_t i=0; i < n; i++) Population::lost.push(lost[i]);
+
+  const double *fix_effects = r.get<double>("fixeff", n, false);
+  const int32_t *fix_counts = r.get<int32_t>("fixcnt", k, false);
+  if (n != k) throw SimError(0, "bad fixations in checkpoint %s", path.c_str());
+  Population::fixations.clear();
+  for (size_t i=0; i < n; i++) Population::fixations[fix_effects[i]] = fix_counts[i];
+
+  const int32_t *visits = r.get<int32_t>("visits", n, false);
+  if (n != Population::visits.size())
+    throw SimError("checkpoint's visits statistic doesn't match");
+  Population::visits.assign(visits, visits+n);
+  const int32_t *dcounts = r.get<int32_t>("dcounts", n, false);
+  const uint32_t *dids = r.get<uint32_t>("dids", k, false);
+  Population::delta_counts.assign(dcounts, dcounts+n);
+  Population::delta_ids.assign(dids, dids+k);
+  get_moments(r, "dpm", Population::delta_p_moments);
+  get_moments(r, "pvm", Population::phenotype_var_mean);
+
+  const double *sketch_keys = r.get<double>("qkeys", n, false);
+  const double *sketch_state = r.get<double>("qsketch", k, false);
+  const double *p = sketch_state, *end = sketch_state + k;
+  Population::sketches.clear();
+  for (size_t i=0; i+1 < n; i += 2) {
+    pair<int,double> key((int)sketch_keys[i], sketch_keys[i+1]);
+    p = Population::sketches[key].restore(p, end);
+  }
+
+  const double *target_state = r.get<double>("targets", k, false);
+  p = target_state;
+  end = target_state + k;
+  for (size_t t=0; t < Population::target_means.size(); t++)
+    p = Population::target_means[t]->restore(p, end);
+
+  const double *burnin_state = r.get<double>("burnin", k, false);
+  if (Population::burnin_detector != NULL)
+    Population::burnin_detector->restore(burnin_state, burnin_state + k);
+}
+
+/* END */
@@ -0,0 +1,56 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <signal.h>
+#include <string>
+
+#include "command_line.h"
+#include "population.h"
+
+/* A checkpoint holds everything needed to carry on a run exactly as if it
+ * had never stopped: both population views (sites with their genotypes, and
+ * genomes with their mutant site lists, fitnesses and maximum fitness), the
+ * lost site queue, the Genome and Site class variables, the accumulated
+ * statistics, the position in the main loop and the state of the random
+ * number generators.
+ *
+ * The file is a sequence of sections, each an 8 character tag, a 64-bit
+ * length and the data, padded to a multiple of 8 bytes. The data are raw
+ * arrays in the byte order of the machine, so a checkpoint is mmap()ed and
+ * the arrays copied straight from the mapping on resume. A checkpoint is
+ * written to a temporary file that is renamed into place, so an existing
+ * checkpoint is never left half-written.
+ *
+ * Checkpoints are written every --checkpoint-every generations, and at the
+ * end of the current generation on SIGUSR1 (after which the run carries
+ * on) or SIGTERM (after which it exits with status 2). The run is then
+ * continued with the same arguments plus --resume=<checkpoint>, writing its
+ * output from the following generation on. */
+
+/* Set by the signal handlers: 0 if no checkpoint has been asked for,
+ * CHECKPOINT_CONTINUE on SIGUSR1, CHECKPOINT_STOP on SIGTERM */
+#define CHECKPOINT_CONTINUE 1
+#define CHECKPOINT_STOP 2
+extern volatile sig_atomic_t checkpoint_requested;
+
+/* the position of the main loop in quant */
+struct LoopState {
+  int epoch;
+  int parent_pop;
+};
+
+class SectionWriter;
+class SectionReader;
+
+class Checkpoint {
+public:
+  static void install_signal_handlers(void);
+  static void write(const std::string &path, const Args &ar, Population *pops, const LoopState &loop);
+  static void read(const std::string &path, Args &ar, Population *pops, LoopState &loop);
+
+private:
+  static void put_moments(SectionWriter &w, const char *name, const Moments *m);
+  static void get_moments(SectionReader &r, const char *name, Moments *m);
+};
+
+#endif /* __CHECKPOINT_H__ */
@@ -2,6 +2,7 @@
 #include "error_handling.h"
 #include "common.h"
 #include "statistic.h"
+#include "sim_rand.h"
 
 #include <getopt.h>
 #include <iostream>
@@ -11,6 +12,7 @@
 #include <map>
 #include <valarray>
 #include <stdlib.h>
+#include <string.h>
 
 /* identifiers for arguments, below 255 is for ascii characters */
 #define RAND_SEED     300
@@ -26,6 +28,36 @@
 #define STATOFF       310
 #define STATALLOFF    311
 #define HAPLOID       312
+#define LOCKSTEP      313
+#define DEMES         314
+#define MIGRATION     315
+#define DEME_OPTS     316
+#define BRANCHES      317
+#define BRANCH_MU     318
+#define BRANCH_OPTS   319
+#define BRANCH_TIMES  320
+#define CRN           321
+#define TRAJECTORY    322
+#define GZIP_OUTPUT   323
+#define KEYFRAME      324
+#define INDEX         325
+#define INDEX_EVERY   326
+#define CHECKPOINT    327
+#define CHECKPOINT_EVERY 328
+#define RESUME        329
+#define GENOTYPES     330
+#define EXPORT_GENOTYPES 331
+#define PUBLISH       332
+#define PUBLISH_EVERY 333
+#define GENOTYPE_MEMORY 334
+#define GENOTYPE_DIR  335
+#define CACHE         336
+#define STAT_EVERY    337
+#define QUANTILE_PROBS 338
+#define QUANTILE_EVERY 339
+#define TARGET_SE     340
+#define ENGINE        341
+#define THREADS       342
 
 using std::cerr;
 using std::cin;
@@ -36,18 +68,15 @@ using std::vector;
 using std::valarray;
 using std::map;
 
-void strsplit(const string &s, vector<string> &res, char sep);
-void valdouble_from_string(const string &s, valarray<double> &x);
-void valdouble_from_string(const char *s, valarray<double> &x);
-void valint_from_string(const string &s, valarray<int> &x);
-void valint_from_string(const char *s, valarray<int> &x);
-
 /* a map to make converting from model string to constant easier */
 static map<string,Model> model_lookup;
 string model_reverse_lookup[] = { string("unspecified"), string("infinite"), string("finite") };
 
 static map<string,freq_input> freq_lookup;
-string freq_reverse_lookup[2] = { string("file"), string("even") };
+string freq_reverse_lookup[3] = { string("file"), string("even"), string("stationary") };
+
+static map<string,engine_type> engine_lookup;
+string engine_reverse_lookup[2] = { string("individual"), string("frequency") };
 
 
 /* set default options */
@@ -57,10 +86,14 @@ Args::Args(int argc, char *argv[]) {
   model_lookup[string("finite")] = finite_sites;
   freq_lookup[string("file")] = freqfile;
   freq_lookup[string("even")] = freqeven;
+  freq_lookup[string("stationary")] = freqstationary;
+  engine_lookup[string("individual")] = engine_individual;
+  engine_lookup[string("frequency")] = engine_frequency;
 
   /* defaults */
   popsize = 5000;
   burnin = popsize;
+  auto_burnin = false;
   mu = 0.0001;
   s = 0.01;
   env = 0.0;
@@ -68,6 +101,21 @@ Args::Args(int argc, char *argv[]) {
   sites_model = unspecified;
   freqin = freqfile;
   ploidy_level = diploid;
+  lanes = 0;
+  engine = engine_individual;
+  threads = 0;
+  crn = false;
+  gzip_output = false;
+  keyframe_every = 1000;
+  double default_probs[] = { 0.001, 0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999 };
+  quantile_probs = valarray<double>(default_probs, 10);
+  quantile_every = 0;
+  index_every = 1000;
+  checkpoint_every = 0;
+  publish_every = 1;
+  genotype_memory = 0;
+  demes = 0;
+  branches = 0;
 
   /* process all the arguments from argv[] */
   int c;
@@ -123,6 +171,36 @@ Args::Args(int argc, char *argv[]) {
       {"disable-stat", required_argument, 0, STATOFF},
       {"disable-all-stats", no_argument, NULL, STATALLOFF},
       {"haploid", no_argument, NULL, HAPLOID},
+      {"crn", no_argument, NULL, CRN},
+      {"trajectory", required_argument, 0, TRAJECTORY},
+      {"gzip-output", no_argument, NULL, GZIP_OUTPUT},
+      {"keyframe-every", required_argument, 0, KEYFRAME},
+      {"index", required_argument, 0, INDEX},
+      {"index-every", required_argument, 0, INDEX_EVERY},
+      {"checkpoint", required_argument, 0, CHECKPOINT},
+      {"checkpoint-every", required_argument, 0, CHECKPOINT_EVERY},
+      {"resume", required_argument, 0, RESUME},
+      {"genotypes", required_argument, 0, GENOTYPES},
+      {"export-genotypes", required_argument, 0, EXPORT_GENOTYPES},
+      {"publish", required_argument, 0, PUBLISH},
+      {"publish-every", required_argument, 0, PUBLISH_EVERY},
+      {"genotype-memory", required_argument, 0, GENOTYPE_MEMORY},
+      {"genotype-dir", required_argument, 0, GENOTYPE_DIR},
+      {"cache", required_argument, 0, CACHE},
+      {"stat-every", required_argument, 0, STAT_EVERY},
+      {"quantile-probs", required_argument, 0, QUANTILE_PROBS},
+      {"quantile-every", required_argument, 0, QUANTILE_EVERY},
+      {"target-se", required_argument, 0, TARGET_SE},
+      {"lockstep", required_argument, 0, LOCKSTEP},
+      {"engine", required_argument, 0, ENGINE},
+      {"threads", required_argument, 0, THREADS},
+      {"demes", required_argument, 0, DEMES},
+      {"migration", required_argument, 0, MIGRATION},
+      {"deme-opts", required_argument, 0, DEME_OPTS},
+      {"branches", required_argument, 0, BRANCHES},
+      {"branch-mu", required_argument, 0, BRANCH_MU},
+      {"branch-opts", required_argument, 0, BRANCH_OPTS},
+      {"branch-times", required_argument, 0, BRANCH_TIMES},
       {0, 0, 0, 0}
     };
     /* getopt_long stores the option index here. */
@@ -198,6 +276,20 @@ Args::Args(int argc, char *argv[]) {
       case BURNIN:
         if (!has_option(optarg))
           throw SimUsageError("must specify number of burnin steps");
+        /* auto, or auto:<max>, ends the burnin once it's settled */
+        if (strncmp(optarg, "auto", 4) == 0) {
+          auto_burnin = true;
+          burnin = 0;
+          if (optarg[4] == ':') {
+            burnin = strtoul(optarg + 5, &end, 10);
+            if (optarg + 5 == end || *end != '\0' || burnin < 1)
+              throw SimUsageError("auto burnin needs a positive maximum, as auto:<gens>");
+          } else if (optarg[4] != '\0') {
+            throw SimUsageError("burnin must be a number of generations, auto or auto:<gens>");
+          }
+          break;
+        }
+        auto_burnin = false;
         burnin = strtoul(optarg, &end, 10);
         if (optarg == end) 
           throw SimUsageError("non-numeric number of burnin steps");
@@ -262,10 +354,248 @@ Args::Args(int argc, char *argv[]) {
         Statistic::deactivate_all();
         break;
 
+      case STAT_EVERY: {
+        if (!has_option(optarg))
+          throw SimUsageError("must specify statistic and generations, as <stat>:<gens>");
+        string spec(optarg);
+        size_t colon = spec.rfind(':');
+        if (colon == string::npos)
+          throw SimUsageError("stat-every must be given as <stat>:<gens>");
+        const char *gens = optarg + colon + 1;
+        int every = strtoul(gens, &end, 10);
+        if (gens == end || *end != '\0' || every < 1)
+          throw SimUsageError("stat-every needs a positive number of generations");
+        Statistic::set_every(spec.substr(0, colon).c_str(), every);
+        stat_every.push_back(spec);
+        break;
+      }
+
       case HAPLOID:
         ploidy_level = haploid;
         break;
 
+      case CRN:
+        crn = true;
+        break;
+
+      case QUANTILE_PROBS:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify quantile probabilities");
+        valdouble_from_string(optarg, quantile_probs);
+        if (quantile_probs.size() == 0 || quantile_probs.min() < 0 || quantile_probs.max() > 1)
+          throw SimUsageError("quantile probabilities must be between 0 and 1");
+        break;
+
+      case QUANTILE_EVERY:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify generations between quantiles");
+        quantile_every = strtoul(optarg, &end, 10);
+        if (optarg == end || quantile_every < 0) 
+          throw SimUsageError("quantile-every must be a non-negative integer");
+        break;
+
+      case TARGET_SE: {
+        if (!has_option(optarg))
+          throw SimUsageError("must specify statistic and standard error, as <stat>:<se>");
+        string spec(optarg);
+        size_t colon = spec.rfind(':');
+        if (colon == string::npos)
+          throw SimUsageError("target-se must be given as <stat>:<se>");
+        const char *se = optarg + colon + 1;
+        double target = strtod(se, &end);
+        if (se == end || *end != '\0' || !(target > 0))
+          throw SimUsageError("target-se needs a positive standard error");
+        target_stats.push_back(spec.substr(0, colon));
+        target_ses.push_back(target);
+        Statistic::activate("convergence");
+        break;
+      }
+
+      case KEYFRAME:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify generations between keyframes");
+        keyframe_every = strtoul(optarg, &end, 10);
+        if (optarg == end || keyframe_every < 1) 
+          throw SimUsageError("keyframe-every must be a positive integer");
+        break;
+
+      case INDEX:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify index file");
+        index_file = string(optarg);
+        break;
+
+      case INDEX_EVERY:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify generations per indexed block");
+        index_every = strtoul(optarg, &end, 10);
+        if (optarg == end || index_every < 1) 
+          throw SimUsageError("index-every must be a positive integer");
+        break;
+
+      case CHECKPOINT:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify checkpoint file");
+        checkpoint_file = string(optarg);
+        break;
+
+      case CHECKPOINT_EVERY:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify generations between checkpoints");
+        checkpoint_every = strtoul(optarg, &end, 10);
+        if (optarg == end || checkpoint_every < 1) 
+          throw SimUsageError("checkpoint-every must be a positive integer");
+        break;
+
+      case RESUME:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify checkpoint to resume from");
+        resume_file = string(optarg);
+        break;
+
+      case GZIP_OUTPUT:
+        gzip_output = true;
+        break;
+
+      case GENOTYPES:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify genotype file");
+        genotypes_file = string(optarg);
+        break;
+
+      case EXPORT_GENOTYPES:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify genotype file to export to");
+        export_genotypes_file = string(optarg);
+        break;
+
+      case PUBLISH:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify shared memory name to publish to");
+        publish_name = string(optarg);
+        if (publish_name.find('/', 1) != string::npos)
+          throw SimUsageError("shared memory names can't contain '/'");
+        break;
+
+      case PUBLISH_EVERY:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify generations between published snapshots");
+        publish_every = strtoul(optarg, &end, 10);
+        if (optarg == end || publish_every < 1) 
+          throw SimUsageError("publish-every must be a positive integer");
+        break;
+
+      case GENOTYPE_MEMORY:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify genotype memory budget");
+        genotype_memory = strtod(optarg, &end);
+        if (optarg == end || genotype_memory <= 0) 
+          throw SimUsageError("genotype-memory must be a positive number of megabytes");
+        break;
+
+      case GENOTYPE_DIR:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify directory for genotype files");
+        genotype_dir = string(optarg);
+        break;
+
+      case CACHE:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify cache directory");
+        cache_dir = string(optarg);
+        break;
+
+      case TRAJECTORY:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify trajectory file");
+        trajectory_file = string(optarg);
+        break;
+
+      case LOCKSTEP:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify number of lockstep replicates");
+        lanes = strtoul(optarg, &end, 10);
+        if (optarg == end) 
+          throw SimUsageError("non-numeric number of lockstep replicates");
+        if (lanes != 8 && lanes != 16)
+          throw SimUsageError("lockstep replicates must be 8 or 16");
+        break;
+
+      case ENGINE:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify engine");
+        if (engine_lookup.count(string(optarg)) == 0)
+          throw SimUsageError("invalid engine");
+        engine = engine_lookup[string(optarg)];
+        break;
+
+      case THREADS:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify number of threads");
+        threads = strtoul(optarg, &end, 10);
+        if (optarg == end || *end != '\0' || threads < 1)
+          throw SimUsageError("threads must be a positive integer");
+        break;
+
+      case DEMES:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify number of demes");
+        demes = strtoul(optarg, &end, 10);
+        if (optarg == end) 
+          throw SimUsageError("non-numeric number of demes");
+        break;
+
+      case MIGRATION:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify migration rate(s)");
+        valdouble_from_string(optarg, migration);
+        break;
+
+      case DEME_OPTS:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify per-deme optima");
+        fix_negatives(optarg);
+        valdouble_from_string(optarg, deme_opts);
+        break;
+
+      case BRANCHES:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify number of branches");
+        branches = strtoul(optarg, &end, 10);
+        if (optarg == end) 
+          throw SimUsageError("non-numeric number of branches");
+        break;
+
+      case BRANCH_MU:
+        if (!has_option(optarg))
+          throw SimUsageError("must specify branch mutation rates");
+        valdouble_from_string(optarg, branch_mu);
+        break;
+
+      case BRANCH_OPTS: {
+        if (!has_option(optarg))
+          throw SimUsageError("must specify branch optima");
+        fix_negatives(optarg);
+        /* each branch's vector is separated by ':' */
+        vector<string> pieces;
+        strsplit(string(optarg), pieces, ':');
+        branch_opts.resize(pieces.size());
+        for (int i=0; i < (int)pieces.size(); i++)
+          valdouble_from_string(pieces[i], branch_opts[i]);
+        break;
+      }
+
+      case BRANCH_TIMES: {
+        if (!has_option(optarg))
+          throw SimUsageError("must specify branch times");
+        vector<string> pieces;
+        strsplit(string(optarg), pieces, ':');
+        branch_times.resize(pieces.size());
+        for (int i=0; i < (int)pieces.size(); i++)
+          valint_from_string(pieces[i], branch_times[i]);
+        break;
+      }
+
       default:
         char o[10];
         snprintf(o, 10, "%d", c);
@@ -307,6 +637,11 @@ Args::Args(int argc, char *argv[]) {
       if (effect_probabilities.size() != effect_sizes.size()) {
         throw SimUsageError("effect sizes and effect probabilities must be same length");
       }
+      if (!genotypes_file.empty()) {
+        if (loci_counts.size() > 0)
+          throw SimUsageError("the genotype file replaces the loci count");
+        break;
+      }
       if (loci_counts.size() != 1)
         throw SimUsageError("infinite sites model takes exactly 1 loci count");
       if (loci_counts.min() < 0)
@@ -315,6 +650,11 @@ Args::Args(int argc, char *argv[]) {
     case finite_sites:
       if (ploidy_level == haploid) 
         throw SimUsageError("haploid not implemented for finite sites model");
+      if (!genotypes_file.empty()) {
+        if (loci_counts.size() > 0)
+          throw SimUsageError("the genotype file replaces the loci counts");
+        break;
+      }
       if (loci_counts.size() == 0) throw SimUsageError("must specify loci count(s)");
       if (loci_counts.size() != effect_sizes.size()) 
         throw SimUsageError("loci and effects must be same length");
@@ -324,10 +664,131 @@ Args::Args(int argc, char *argv[]) {
     default:
         throw SimUsageError("invalid sites model");
   }
-  nloci = (int)loci_counts.sum();
+  nloci = loci_counts.size() > 0 ? (int)loci_counts.sum() : 0;
+
+  /* an adaptive burnin runs for at most 20N generations, unless told otherwise */
+  if (auto_burnin && burnin == 0) burnin = 20 * popsize;
+  if (auto_burnin && (lanes > 0 || demes > 0))
+    throw SimUsageError("auto burnin can't be combined with lockstep replicates or demes");
+
+  if (lanes > 0 && sites_model != finite_sites)
+    throw SimUsageError("lockstep replicates are only implemented for the finite sites model");
+  if (lanes > 0 && (Statistic::is_activated(STAT_FREQUENCY_DELTAS) ||
+      Statistic::is_activated(STAT_FIXATIONS) || Statistic::is_activated(STAT_PMOMENTS)))
+    throw SimUsageError("lockstep replicates don't collect frequency-deltas, fixations or pmoments");
+
+  /* check the branching configuration */
+  if (branches > 0) {
+    if (lanes > 0 || demes > 0)
+      throw SimUsageError("branches can't be combined with lockstep replicates or demes");
+    if (branch_mu.size() > 0 && branch_mu.size() != (size_t)branches)
+      throw SimUsageError("branch-mu must have one mutation rate per branch");
+    if (branch_opts.size() != branch_times.size())
+      throw SimUsageError("branch-opts and branch-times must be given together");
+    if (branch_opts.size() > 0 && branch_opts.size() != (size_t)branches)
+      throw SimUsageError("branch-opts must have one schedule per branch");
+    for (int i=0; i < (int)branch_opts.size(); i++) {
+      if (branch_opts[i].size() != branch_times[i].size())
+        throw SimUsageError("each branch's opts and times must be same length");
+    }
+  } else if (branch_mu.size() > 0 || branch_opts.size() > 0 || branch_times.size() > 0) {
+    throw SimUsageError("branch-mu, branch-opts and branch-times require branches");
+  }
+
+  /* check the island model configuration */
+  if (demes > 0) {
+    if (sites_model != finite_sites)
+      throw SimUsageError("the island model is only implemented for the finite sites model");
+    if (lanes > 0)
+      throw SimUsageError("lockstep replicates and demes can't be combined");
+    if (demes < 2)
+      throw SimUsageError("the island model needs at least 2 demes");
+    if (migration.size() != 1 && migration.size() != (size_t)(demes*demes))
+      throw SimUsageError("migration must be a single rate or a demes x demes matrix");
+    if (migration.min() < 0 || migration.max() > 1)
+      throw SimUsageError("migration rates must be between 0 and 1");
+    if (deme_opts.size() > 0 && deme_opts.size() != (size_t)demes)
+      throw SimUsageError("deme-opts must have one optimum per deme");
+    /* sojourn has nothing to report, as no site is lost or fixed in the finite
+     * sites model, but these would be dropped */
+    if (Statistic::is_activated(STAT_FREQUENCY_DELTAS) || Statistic::is_activated(STAT_FIXATIONS) ||
+        Statistic::is_activated(STAT_PMOMENTS))
+      throw SimUsageError("demes don't collect frequency-deltas, fixations or pmoments");
+  } else if (migration.size() > 0 || deme_opts.size() > 0) {
+    throw SimUsageError("migration and deme-opts require demes");
+  }
+
+  if ((!genotypes_file.empty() || !export_genotypes_file.empty()) && (lanes > 0 || demes > 0))
+    throw SimUsageError("genotype files can't be combined with lockstep replicates or demes");
+  if (freqin == freqstationary) {
+    if (lanes > 0 || demes > 0)
+      throw SimUsageError("stationary frequencies can't be combined with lockstep replicates or demes");
+    if (!genotypes_file.empty())
+      throw SimUsageError("stationary frequencies can't be combined with a genotype file");
+    if (sites_model == infinite_sites && nloci > 0)
+      throw SimUsageError("stationary frequencies replace the loci count (use --loci=0)");
+    if (!(s > 0) || mu <= 0)
+      throw SimUsageError("stationary frequencies need s > 0 and mu > 0");
+  }
+  if ((genotype_memory > 0 || !genotype_dir.empty()) && (lanes > 0 || demes > 0))
+    throw SimUsageError("genotype-memory can't be combined with lockstep replicates or demes");
+  if (!publish_name.empty() && (lanes > 0 || demes > 0))
+    throw SimUsageError("publish can't be combined with lockstep replicates or demes");
+  if (!trajectory_file.empty() && (lanes > 0 || demes > 0))
+    throw SimUsageError("trajectory can't be combined with lockstep replicates or demes");
+  if (gzip_output && (lanes > 0 || demes > 0 || branches > 0))
+    throw SimUsageError("gzip-output can't be combined with lockstep replicates, demes or branches");
+  if (!index_file.empty() && (lanes > 0 || demes > 0 || branches > 0))
+    throw SimUsageError("index can't be combined with lockstep replicates, demes or branches");
+  if ((!checkpoint_file.empty() || !resume_file.empty()) && (lanes > 0 || demes > 0 || branches > 0))
+    throw SimUsageError("checkpoints can't be combined with lockstep replicates, demes or branches");
+  if (checkpoint_every > 0 && checkpoint_file.empty())
+    throw SimUsageError("checkpoint-every requires a checkpoint file");
+  if (crn && (lanes > 0 || demes > 0))
+    throw SimUsageError("crn can't be combined with lockstep replicates or demes");
+  if (Statistic::is_activated(STAT_QUANTILES) && (lanes > 0 || demes > 0))
+    throw SimUsageError("the quantiles statistic can't be combined with lockstep replicates or demes");
+  if (!stat_every.empty() && (lanes > 0 || demes > 0))
+    throw SimUsageError("stat-every can't be combined with lockstep replicates or demes");
+  if (!target_stats.empty() && (lanes > 0 || demes > 0))
+    throw SimUsageError("target-se can't be combined with lockstep replicates or demes");
+  if (!cache_dir.empty()) {
+    if (lanes > 0 || demes > 0 || branches > 0)
+      throw SimUsageError("cache can't be combined with lockstep replicates, demes or branches");
+    /* a cached run gives back only what was written to stdout */
+    if (!index_file.empty() || !trajectory_file.empty() || !export_genotypes_file.empty() ||
+        !publish_name.empty() || !checkpoint_file.empty() || !resume_file.empty())
+      throw SimUsageError("cache can't be combined with index, trajectory, export-genotypes, publish or checkpoints");
+    /* a run that stopped early can't be extended */
+    if (!target_stats.empty())
+      throw SimUsageError("cache can't be combined with target-se");
+    if (nloci > 0 && freqin == freqfile)
+      throw SimUsageError("cache can't be used with frequencies read from stdin");
+  }
+
+  /* the frequency engine keeps no individuals, so the options for their
+   * genotypes, and the statistics that need them, don't apply */
+  if (engine == engine_frequency) {
+    if (lanes > 0 || demes > 0 || branches > 0)
+      throw SimUsageError("the frequency engine can't be combined with lockstep replicates, demes or branches");
+    if (!genotypes_file.empty() || !export_genotypes_file.empty() || genotype_memory > 0 || !genotype_dir.empty())
+      throw SimUsageError("the frequency engine has no genotypes to read, write or store");
+    if (!trajectory_file.empty() || !publish_name.empty() || !cache_dir.empty())
+      throw SimUsageError("the frequency engine can't be combined with trajectory, publish or cache");
+    if (!checkpoint_file.empty() || !resume_file.empty())
+      throw SimUsageError("the frequency engine can't be combined with checkpoints");
+    if (auto_burnin || !target_stats.empty() || crn)
+      throw SimUsageError("the frequency engine can't be combined with auto burnin, target-se or crn");
+    if (Statistic::is_activated(STAT_FREQUENCY_DELTAS) || Statistic::is_activated(STAT_PMOMENTS) ||
+        Statistic::is_activated(STAT_QUANTILES))
+      throw SimUsageError("the frequency engine doesn't collect frequency-deltas, pmoments or quantiles");
+  } else if (threads > 0) {
+    throw SimUsageError("threads is for the frequency engine");
+  }
 
   /* initialize the random number generator */
   srand48(rand_seed);
+  if (crn) use_role_streams(rand_seed);
   return;
 }
 
@@ -360,12 +821,46 @@ ostream& operator<<(ostream &s, const Args &a) {
     << " model=\"" << model_reverse_lookup[a.sites_model] << "\""
     << " freqs=\"" << freq_reverse_lookup[a.freqin] << "\""
     << " burnin=" << a.burnin;
+  if (a.auto_burnin)
+    s << " burnin_auto=TRUE";
 
   if (a.ploidy_level == haploid) {
     s << " ploidy=haploid";
   } else {
     s << " ploidy=diploid";
   }
+  if (a.lanes > 0)
+    s << " lockstep=" << a.lanes;
+  if (a.engine != engine_individual)
+    s << " engine=\"" << engine_reverse_lookup[a.engine] << "\"";
+  if (a.crn)
+    s << " crn=TRUE";
+  if (a.gzip_output)
+    s << " gzip_output=TRUE";
+  if (!a.index_file.empty())
+    s << " index=\"" << a.index_file << "\" index_every=" << a.index_every;
+  if (!a.checkpoint_file.empty())
+    s << " checkpoint=\"" << a.checkpoint_file << "\" checkpoint_every=" << a.checkpoint_every;
+  if (!a.resume_file.empty())
+    s << " resume=\"" << a.resume_file << "\"";
+  if (!a.genotypes_file.empty())
+    s << " genotypes=\"" << a.genotypes_file << "\"";
+  if (!a.export_genotypes_file.empty())
+    s << " export_genotypes=\"" << a.export_genotypes_file << "\"";
+  if (a.genotype_memory > 0)
+    s << " genotype_memory=" << a.genotype_memory;
+  if (!a.publish_name.empty())
+    s << " publish=\"" << a.publish_name << "\" publish_every=" << a.publish_every;
+  for (size_t i=0; i < a.stat_every.size(); i++)
+    s << " stat_every=\"" << a.stat_every[i] << "\"";
+  for (size_t i=0; i < a.target_stats.size(); i++)
+    s << " target_se=\"" << a.target_stats[i] << ":" << a.target_ses[i] << "\"";
+  if (!a.trajectory_file.empty())
+    s << " trajectory=\"" << a.trajectory_file << "\"";
+  if (a.demes > 0)
+    s << " demes=" << a.demes;
+  if (a.branches > 0)
+    s << " branches=" << a.branches;
   string tmp;
   s << " " << print_r_vector(a.effect_sizes, "effects", tmp);
   s << " " << print_r_vector(a.opts, "opts", tmp);
@@ -373,6 +868,13 @@ ostream& operator<<(ostream &s, const Args &a) {
   s << " " << print_r_vector(a.loci_counts, "loci", tmp);
   if (a.sites_model == infinite_sites)
     s << " " << print_r_vector(a.effect_probabilities, "eprobs", tmp);
+  if (a.branch_mu.size() > 0)
+    s << " " << print_r_vector(a.branch_mu, "branch_mu", tmp);
+  if (a.demes > 0) {
+    s << " " << print_r_vector(a.migration, "migration", tmp);
+    if (a.deme_opts.size() > 0)
+      s << " " << print_r_vector(a.deme_opts, "deme_opts", tmp);
+  }
   return s;
 }
 
@@ -3,11 +3,16 @@
 
 #include <iostream>
 #include <valarray>
+#include <string>
+#include <vector>
 
 #include "common.h"
 
 /* methods for setting up initial frequencies */
-enum freq_input {freqfile, freqeven};
+enum freq_input {freqfile, freqeven, freqstationary};
+
+/* the simulation engines: individuals, or only the sites' allele frequencies */
+enum engine_type {engine_individual, engine_frequency};
 
 class Args {
 public:
@@ -16,11 +21,13 @@ public:
    ~Args() { }
    friend std::ostream& operator<<(std::ostream &s, const Args &a);
   double get_initial_frequency(void);
+  bool stationary_freqs(void) const { return freqin == freqstationary; }
    
    /* command line parameters */
   int popsize;
   unsigned int rand_seed;
   int burnin;                                 /* generations of burnin */
+  bool auto_burnin;                           /* end it once settled, burnin at most */
   double mu;                                  /* mutation rate */
   double s;                                   /* Barton s parameter */
   double env;                                 /* environmental phenotypic variance */
@@ -30,6 +37,41 @@ public:
   std::valarray<int> times;                   /* times (in generations) when the epochs end */
   std::string cmd;
   enum ploidy ploidy_level;
+  int lanes;                                  /* replicates run in lockstep, 0 if not */
+  engine_type engine;                         /* individual-based, or frequency approximation */
+  int threads;                                /* threads of the frequency engine, 0 for one per core */
+  bool crn;                                   /* separate random streams for each role */
+  std::string trajectory_file;                /* binary trajectory output, if not empty */
+  bool gzip_output;                           /* compress stdout */
+  std::string index_file;                     /* index of output blocks, if not empty */
+  int index_every;                            /* generations per indexed block */
+  int keyframe_every;                         /* generations between frequency-deltas keyframes */
+  std::valarray<double> quantile_probs;       /* quantiles printed by the quantiles statistic */
+  int quantile_every;                         /* generations between them, 0 if only at the end */
+  std::string checkpoint_file;                /* where checkpoints are written, if not empty */
+  int checkpoint_every;                       /* generations between checkpoints, 0 if only on signals */
+  std::string resume_file;                    /* checkpoint to carry on from, if not empty */
+  std::string genotypes_file;                 /* initial genotypes, if not empty */
+  std::string export_genotypes_file;          /* where the final genotypes go, if not empty */
+  std::string publish_name;                  /* shared memory segment for snapshots, if not empty */
+  int publish_every;                          /* generations between published snapshots */
+  double genotype_memory;                     /* MB of genotypes kept in memory, 0 if no limit */
+  std::string genotype_dir;                   /* where genotypes go beyond that */
+  std::string cache_dir;                      /* cache of finished runs, if not empty */
+  std::vector<std::string> stat_every;        /* <stat>:<gens> cadences, as given */
+  std::vector<std::string> target_stats;      /* statistics to run until converged, */
+  std::vector<double> target_ses;             /* and the standard errors they're to reach */
+
+  /* for branching after the burnin */
+  int branches;                               /* number of branches, 0 if not branching */
+  std::valarray<double> branch_mu;            /* per-branch mutation rates */
+  std::vector<std::valarray<double> > branch_opts;  /* per-branch optima */
+  std::vector<std::valarray<int> > branch_times;    /* per-branch epoch ends */
+
+  /* for the island model */
+  int demes;                                  /* number of demes, 0 if panmictic */
+  std::valarray<double> migration;            /* one rate, or a demes x demes matrix */
+  std::valarray<double> deme_opts;            /* per-deme offsets to the optimum */
   
 
   /* for fixed number of loci model */
@@ -48,4 +90,11 @@ private:
   freq_input freqin;                          /* way of setting up initial frequencies */
 };
 
+/* helpers for parsing comma-separated lists, also used by the sweep driver */
+void strsplit(const std::string &s, std::vector<std::string> &res, char sep);
+void valdouble_from_string(const std::string &s, std::valarray<double> &x);
+void valdouble_from_string(const char *s, std::valarray<double> &x);
+void valint_from_string(const std::string &s, std::valarray<int> &x);
+void valint_from_string(const char *s, std::valarray<int> &x);
+
 #endif /* __COMMAND_LINE_H */
@@ -0,0 +1,75 @@
+/*
+ *  embed.c
+ *
+ *  Runs many short replicates of a finite sites simulation in one process,
+ *  through quant's library interface (quant_api.h), and prints, for each
+ *  seed, the final phenotype moments and the mean number of segregating
+ *  loci over the generations after the burnin.
+ *
+ *  usage: embed [replicates]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "quant_api.h"
+
+struct segregating {
+  int popsize;
+  long total;
+  int looks;
+};
+
+/* count the loci that are neither lost nor fixed */
+static void count_segregating(const quant_sim *sim, void *user) {
+  struct segregating *seg = (struct segregating *)user;
+  quant_span counts = quant_site_counts(sim);
+  size_t i;
+  for (i=0; i < counts.size; i++) {
+    int c = quant_span_int(counts, i);
+    if (c > 0 && c < 2*seg->popsize) seg->total++;
+  }
+  seg->looks++;
+}
+
+int
+main(int argc, char **argv) {
+  int reps = argc > 1 ? atoi(argv[1]) : 10;
+  double effects[] = { 1.0, 3.0 };
+  int loci[] = { 40, 10 };
+  int rep;
+
+  for (rep=0; rep < reps; rep++) {
+    quant_params p;
+    quant_default_params(&p);
+    p.popsize = 200;
+    p.burnin = 200;
+    p.seed = rep+1;
+    p.model = QUANT_FINITE_SITES;
+    p.neffects = 2;
+    p.effects = effects;
+    p.loci = loci;
+    p.optimum = 1.0;
+
+    quant_sim *sim = quant_create(&p);
+    if (sim == NULL) {
+      fprintf(stderr, "embed: %s\n", quant_last_error());
+      return 1;
+    }
+    struct segregating seg = { p.popsize, 0, 0 };
+    quant_add_callback(sim, count_segregating, &seg, 10);
+    if (quant_step(sim, p.burnin + 1000) != 0) {
+      fprintf(stderr, "embed: %s\n", quant_last_error());
+      return 1;
+    }
+
+    double mean, variance;
+    quant_phenotype_moments(sim, &mean, &variance);
+    printf("seed: %u gen: %d pheno: %g %g segregating: %g\n", p.seed, quant_generation(sim),
+      mean, variance, seg.looks > 0 ? (double)seg.total / seg.looks : 0.0);
+    quant_destroy(sim);
+  }
+  return 0;
+}
+
+/* END */
@@ -0,0 +1,361 @@
+#include <math.h>
+#include <vector>
+#include <map>
+#include <thread>
+#include <algorithm>
+
+#include "frequency_engine.h"
+#include "error_handling.h"
+#include "statistic.h"
+#include "stationary.h"
+#include "output.h"
+
+using std::vector;
+using std::map;
+using std::thread;
+
+/* sites per chunk, each chunk with its own random stream */
+#define FREQUENCY_CHUNK 4096
+
+/* the threads asked for, or one per core */
+static int thread_count(const Args &ar) {
+  if (ar.threads > 0) return ar.threads;
+  int n = (int)thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
+
+/* set up the engine from the command line arguments */
+FrequencyEngine::FrequencyEngine(Args &a) : ar(a), nthreads(thread_count(a)),
+    barrier(thread_count(a)) {
+  popsize = ar.popsize;
+  copies = (int)ar.ploidy_level * popsize;
+  generation = 0;
+  burnin = ar.burnin;
+  sig = 2.0/ar.s;
+  env = ar.env;
+  optimum = ar.opts[0];
+  baseline = 0;
+  next_id = 0;
+  finished = false;
+  u = ar.sites_model == finite_sites && ar.nloci > 0 ? ar.mu / ar.nloci : 0.0;
+  rng.reseed(ar.rand_seed, 0);
+
+  phenotype_mean = phenotype_variance = 0;
+  phenotype_var_sum = 0;
+  phenotype_var_count = 0;
+  mutation_count = 0;
+  if (Statistic::is_activated(STAT_VISITS)) visits.assign(copies-1, 0);
+}
+
+FrequencyEngine::~FrequencyEngine() { }
+
+/* Add a site of the given effect and derived allele count. Chunk k's stream
+ * is stream k+1 of the seed, stream 0 being rng's */
+void FrequencyEngine::add_site(double effect, int count) {
+  effects.push_back(effect);
+  counts.push_back(count);
+  ids.push_back(next_id++);
+  born.push_back(generation);
+  next_p.push_back(0.0);
+  int chunks = ((int)counts.size() + FREQUENCY_CHUNK - 1) / FREQUENCY_CHUNK;
+  while ((int)streams.size() < chunks)
+    streams.push_back(RandStream(ar.rand_seed, streams.size() + 1));
+}
+
+/* an effect size, with a random sign, as GenomeInfiniteSites::sample_effect_size()
+ * draws them */
+double FrequencyEngine::sample_effect_size(void) {
+  double max = ar.effect_probabilities.max();
+  double sign = rng.uniform() < 0.5 ? -1.0 : 1.0;
+  while (1) {
+    int r = (int)(rng.uniform() * ar.effect_sizes.size());
+    if (rng.uniform()*max < ar.effect_probabilities[r])
+      return ar.effect_sizes[r] * sign;
+  }
+}
+
+/* The sites and their counts to start from: the finite sites loci, or the
+ * infinite sites model's initial sites, at the frequencies given, rounded to
+ * genotypes as Population::setup_initial_genotypes() gets them, or drawn
+ * from the stationary distribution */
+void FrequencyEngine::setup_initial_frequencies(void) {
+  if (ar.sites_model == finite_sites) {
+    for (int i=0; i < (int)ar.loci_counts.size(); i++) {
+      for (int j=0; j < ar.loci_counts[i]; j++) {
+        add_site(ar.effect_sizes[i], 0);
+        baseline -= ar.effect_sizes[i];
+      }
+    }
+  }
+
+  if (ar.stationary_freqs()) {
+    Stationary st(popsize, ar.ploidy_level, ar.mu, 1.0/ar.s);
+    vector<int> initial;
+    vector<double> site_effects;
+    double v;
+    if (ar.sites_model == infinite_sites) {
+      st.sample_sites(ar.effect_sizes, ar.effect_probabilities, site_effects, initial, v);
+      for (int k=0; k < (int)initial.size(); k++) add_site(site_effects[k], initial[k]);
+    } else {
+      st.sample_loci(ar.effect_sizes, ar.loci_counts, initial, v);
+      for (int k=0; k < (int)initial.size(); k++) counts[k] = initial[k];
+    }
+    if (Statistic::is_activated(STAT_BURNIN))
+      out << "stationary sites: " << initial.size() << " variance: " << v << '\n';
+    return;
+  }
+
+  if (ar.nloci == 0) return;
+  if (ar.ploidy_level == haploid)
+    throw SimError("haploid version doesn't support frequencies on stdin");
+  double f;
+  int loc = 0;
+  while (1) {
+    f = ar.get_initial_frequency();
+    if (f < 0 || loc == ar.nloci) break;
+    int count = (int)round(2.0*f*(1.0-f)*popsize) + 2*(int)round(f*f*popsize);
+    if (count > copies) throw SimError(0, "invalid initial frequency %f", f);
+    if (ar.sites_model == finite_sites) counts[loc] = count;
+    else add_site(sample_effect_size(), count);
+    loc++;
+  }
+  if (!(f < 0 && loc == ar.nloci))
+    throw SimError(0, "incorrect number of frequencies. Expecting %d.", ar.nloci);
+}
+
+/* The phenotype mean and variance, from the counts, with each site in
+ * Hardy-Weinberg and linkage equilibrium, and the environmental noise's mean
+ * env/2 and variance env^2/12 */
+void FrequencyEngine::compute_phenotype_moments(void) {
+  double mean = 0, var = 0;
+  int n = (int)counts.size();
+  const double *a = n > 0 ? &effects[0] : NULL;
+  const int *c = n > 0 ? &counts[0] : NULL;
+  for (int i=0; i < n; i++) {
+    double p = (double)c[i] / copies;
+    mean += a[i]*c[i];
+    var += a[i]*a[i]*p*(1.0-p);
+  }
+  phenotype_mean = baseline + mean/popsize + 0.5*env;
+  phenotype_variance = (int)ar.ploidy_level * var + env*env/12.0;
+}
+
+/* Draw the next counts of the chunks this thread is given: every nthreads'th
+ * chunk, starting from its own */
+void FrequencyEngine::draw_chunks(int t) {
+  int n = (int)counts.size();
+  for (int chunk=t; chunk*FREQUENCY_CHUNK < n; chunk += nthreads) {
+    int first = chunk*FREQUENCY_CHUNK;
+    int m = std::min(FREQUENCY_CHUNK, n - first);
+    const double *a = &effects[first];
+    const int *c = &counts[first];
+    double *p = &next_p[first];
+    for (int i=0; i < m; i++) {
+      double q = (double)c[i] / copies;
+      double x = q + q*(1.0-q)*(a[i]*a[i]*(1.0-2.0*q)*curvature + a[i]*slope);
+      x = x < 0.0 ? 0.0 : (x > 1.0 ? 1.0 : x);
+      p[i] = x*(1.0-u) + (1.0-x)*u;
+    }
+    streams[chunk].binomials(copies, p, &counts[first], m);
+  }
+}
+
+/* the other threads wait for each generation's counts to be drawn, until
+ * the run is finished */
+void FrequencyEngine::worker(int t) {
+  while (1) {
+    barrier.wait();
+    if (finished) return;
+    draw_chunks(t);
+    barrier.wait();
+  }
+}
+
+/* Drop the sites that have been lost or fixed (infinite sites), keeping the
+ * rest in order, with the bookkeeping of Population::purge_lost() */
+void FrequencyEngine::absorb(void) {
+  int kept = 0;
+  for (int i=0; i < (int)counts.size(); i++) {
+    int c = counts[i];
+    if (c > 0 && c < copies) {
+      effects[kept] = effects[i];
+      counts[kept] = c;
+      ids[kept] = ids[i];
+      born[kept] = born[i];
+      kept++;
+      continue;
+    }
+    bool fixed = c == copies;
+    if (fixed) {
+      baseline += (int)ar.ploidy_level * effects[i];
+      fixations[effects[i]]++;
+    }
+    if (Statistic::is_activated(STAT_SOJOURN))
+      out << "gen: " << generation << " absorption " << (fixed ? "fixation" : "loss")
+        << " site: " << ids[i] << " sojourn: " << generation-born[i]
+        << " effect: " << effects[i] << '\n';
+  }
+  effects.resize(kept);
+  counts.resize(kept);
+  ids.resize(kept);
+  born.resize(kept);
+  next_p.resize(kept);
+}
+
+/* the new sites of the infinite sites model, each a single copy */
+void FrequencyEngine::mutate(void) {
+  int m = rng.poisson(copies * ar.mu);
+  for (int k=0; k < m; k++) {
+    add_site(sample_effect_size(), 1);
+    if (Statistic::is_activated(STAT_MUTATION))
+      out << "gen: " << generation << " site: id: " << ids.back()
+        << " effect: " << effects.back() << '\n';
+  }
+  mutation_count += m;
+}
+
+/* Advance one generation, with the burnin bookkeeping of
+ * Population::next_generation() */
+void FrequencyEngine::next_generation(void) {
+  double S = sig + 2.0*phenotype_variance, d = phenotype_mean - optimum;
+  curvature = (2.0*d*d/S - 1.0) / S;
+  slope = -2.0*d / S;
+
+  if (nthreads > 1) {
+    barrier.wait();
+    draw_chunks(0);
+    barrier.wait();
+  } else {
+    draw_chunks(0);
+  }
+
+  if (ar.sites_model == infinite_sites) {
+    absorb();
+    mutate();
+  }
+
+  if (burnin == 0 && generation == 0 && Statistic::is_activated(STAT_BURNIN))
+    out << "end burnin\n";
+  if (burnin <= 0) {
+    generation++;
+    if (generation == 0) {
+      if (Statistic::is_activated(STAT_BURNIN) && ar.sites_model == infinite_sites)
+        out << "burnin mutations: " << mutation_count << '\n';
+      mutation_count = 0;
+    }
+  } else {
+    burnin--;
+  }
+}
+
+/* is statistic h collected this generation */
+bool FrequencyEngine::due(int h) const {
+  return Statistic::is_activated(h) && generation % Statistic::every(h) == 0;
+}
+
+/* the frequencies of the sites that haven't fixed */
+void FrequencyEngine::stat_frequency_summary(void) {
+  out << "gen: " << generation << " freqs:";
+  for (int i=0; i < (int)counts.size(); i++) {
+    if (counts[i] < copies)
+      out << " " << ids[i] << ":" << (double)counts[i] / copies;
+  }
+  out << '\n';
+}
+
+void FrequencyEngine::stat_fixations(void) {
+  out << "gen: " << generation << " fixations:";
+  for (map<double,int>::iterator i=fixations.begin(); i != fixations.end(); i++)
+    out << " " << i->first << "," << i->second;
+  out << '\n';
+}
+
+/* the sites of each effect size, counted as Population::count_segregating()
+ * counts them */
+void FrequencyEngine::stat_segsites(void) {
+  map<double,int> segregating;
+  for (int i=0; i < (int)effects.size(); i++) segregating[effects[i]]++;
+  out << "gen: " << generation << " segsites:";
+  for (map<double,int>::iterator i=segregating.begin(); i != segregating.end(); i++)
+    out << " " << i->first << "," << i->second;
+  out << '\n';
+}
+
+void FrequencyEngine::stat_phenotype_summary(void) {
+  out << "gen: " << generation << " pheno: " << phenotype_mean << " " << phenotype_variance << '\n';
+}
+
+void FrequencyEngine::stat_print_visits(void) {
+  out << "visits:";
+  for (int i=0; i < (int)visits.size(); i++) out << " " << visits[i];
+  out << '\n';
+}
+
+void FrequencyEngine::stat_print_phenotype_var_mean(void) {
+  out << "gen: " << generation << " phenotype_var_mean: "
+    << phenotype_var_sum / phenotype_var_count << '\n';
+}
+
+/* each generation's statistics, in the order of their handles */
+void FrequencyEngine::stat_generation(void) {
+  if (due(STAT_FREQUENCIES)) stat_frequency_summary();
+  if (due(STAT_VISITS)) {
+    for (int i=0; i < (int)counts.size(); i++) {
+      int c = counts[i];
+      if (c > 0 && c < copies) visits[c-1]++;
+    }
+  }
+  if (due(STAT_FIXATIONS)) stat_fixations();
+  if (due(STAT_SEGSITES)) stat_segsites();
+  if (due(STAT_PHENOTYPE)) stat_phenotype_summary();
+  if (due(STAT_PHENOTYPE_VAR_MEAN)) {
+    phenotype_var_sum += phenotype_variance;
+    phenotype_var_count++;
+  }
+}
+
+/* and the final ones, as Statistic::final() prints them */
+void FrequencyEngine::stat_final(void) {
+  if (Statistic::is_activated(STAT_FREQUENCIES)) stat_frequency_summary();
+  if (Statistic::is_activated(STAT_PHENOTYPE)) stat_phenotype_summary();
+  if (Statistic::is_activated(STAT_SEGSITES)) stat_segsites();
+  if (Statistic::is_activated(STAT_VISITS)) stat_print_visits();
+  if (Statistic::is_activated(STAT_PHENOTYPE_VAR_MEAN)) {
+    phenotype_var_sum += phenotype_variance;
+    phenotype_var_count++;
+    stat_print_phenotype_var_mean();
+  }
+  if (Statistic::is_activated(STAT_MUTATION) && ar.sites_model == infinite_sites)
+    out << "mutations: " << mutation_count << '\n';
+}
+
+/* Run all the epochs, with the bookkeeping of the main loop in quant.cpp */
+void FrequencyEngine::run(void) {
+  setup_initial_frequencies();
+  vector<thread> threads;
+  for (int t=1; t < nthreads; t++)
+    threads.push_back(thread(&FrequencyEngine::worker, this, t));
+
+  for (int epoch=0; epoch < (int)ar.times.size(); epoch++) {
+    optimum = ar.opts[epoch];
+    while (generation < ar.times[epoch]) {
+      int output_gen = generation;
+      compute_phenotype_moments();
+      if (burnin <= 0) stat_generation();
+      next_generation();
+      out.end_generation(output_gen);
+    }
+  }
+
+  if (nthreads > 1) {
+    finished = true;
+    barrier.wait();
+    for (int t=0; t < (int)threads.size(); t++) threads[t].join();
+  }
+
+  compute_phenotype_moments();
+  stat_final();
+  out.end_generation(generation);
+}
+
+/* END */
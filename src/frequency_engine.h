@@ -0,0 +1,103 @@
+#ifndef __FREQUENCY_ENGINE_H__
+#define __FREQUENCY_ENGINE_H__
+
+#include <vector>
+#include <map>
+
+#include "command_line.h"
+#include "sim_rand.h"
+#include "island.h"
+
+/* The frequency engine (--engine=frequency) is quant's fast, approximate
+ * mode, after qapprox.c. It keeps no individuals, only each site's derived
+ * allele count, and each generation draws the next count from a binomial of
+ * 2N (N haploid) copies, whose probability is the parents' frequency after
+ * selection and mutation.
+ *
+ * Selection is Wright's: a site of effect a moves by pq/k d log(W)/dp, k the
+ * ploidy, where W is the mean fitness exp(-(z-opt)^2/sig) of a Gaussian
+ * phenotype with the population's mean and variance. The variance is the
+ * sites' k a^2 pq, as in linkage equilibrium and Hardy-Weinberg, plus env^2/12
+ * of the uniform environmental noise. That gives
+ *
+ *   p' = p + pq (a^2 (1-2p) (2 d^2/S - 1)/S - 2 a d/S),   S = sig + 2V
+ *
+ * d the mean's distance from the optimum, which for a small variance is
+ * qapprox's p + s/2 a^2 pq ((2p-1) - 2d/a).
+ *
+ * In the finite sites model each copy mutates with probability u = mu/loci a
+ * generation, p'(1-u) + (1-p')u, as quant's mutations do on average. In the
+ * infinite sites model Poisson(2N mu) (N mu haploid) new sites arise each
+ * generation at count 1, with effects drawn as quant draws them, and a site
+ * is dropped once it's lost or fixed, a fixed site's effect moving the
+ * baseline as in Population::purge_lost().
+ *
+ * The run follows quant's epochs and burnin, and prints the frequencies,
+ * visits, fixations, segsites, phenotype, phenotype-var-mean, mutation,
+ * sojourn and burnin statistics to quant's output, in the same form (the
+ * mutation statistic only in the infinite sites model, where mutations are
+ * events). The sites are dealt into chunks of FREQUENCY_CHUNK, each drawing
+ * from its own random stream with RandStream::binomials(), and the chunks
+ * are shared among --threads threads, which meet at a SpinBarrier twice a
+ * generation. A run's output doesn't depend on the number of threads. */
+class FrequencyEngine {
+public:
+  FrequencyEngine(Args &ar);
+  ~FrequencyEngine();
+  void run(void);
+
+private:
+  void setup_initial_frequencies(void);
+  void add_site(double effect, int count);
+  double sample_effect_size(void);
+  void compute_phenotype_moments(void);
+  void draw_chunks(int thread);
+  void next_generation(void);
+  void absorb(void);
+  void mutate(void);
+  void worker(int thread);
+  void stat_generation(void);
+  void stat_final(void);
+  void stat_frequency_summary(void);
+  void stat_fixations(void);
+  void stat_segsites(void);
+  void stat_phenotype_summary(void);
+  void stat_print_visits(void);
+  void stat_print_phenotype_var_mean(void);
+  bool due(int h) const;
+
+  Args &ar;
+  int popsize;
+  int copies;                           /* of each site, 2N or N */
+  int nthreads;
+  int generation;
+  int burnin;
+  double u;                             /* per copy mutation probability (finite sites) */
+  double sig, env, optimum, baseline;
+
+  /* the sites, by position */
+  std::vector<double> effects;
+  std::vector<int> counts;
+  std::vector<unsigned int> ids;
+  std::vector<int> born;
+  std::vector<double> next_p;           /* each site's binomial probability */
+  unsigned int next_id;
+
+  /* the selection of the current generation, shared with the threads */
+  double curvature, slope;
+
+  std::vector<RandStream> streams;      /* one per chunk of sites */
+  RandStream rng;                       /* mutations and effect sizes */
+  SpinBarrier barrier;
+  bool finished;
+
+  /* statistics */
+  double phenotype_mean, phenotype_variance;
+  std::vector<long> visits;
+  std::map<double,int> fixations;
+  double phenotype_var_sum;
+  int phenotype_var_count;
+  int mutation_count;
+};
+
+#endif /* __FREQUENCY_ENGINE_H__ */
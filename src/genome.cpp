@@ -47,7 +47,7 @@ Genome::initialize(double u, double sg, double opt, double env) {
 void
 Genome::clear(void) {
   for (vector<mutation_loc>::iterator it = mutant_sites.begin(); it != mutant_sites.end(); it++) {
-    pop->sites[*it].set_genotype(individual, homozygote_ancestral);
+    pop->record_genotype(individual, *it, homozygote_ancestral);
   }
   mutant_sites.clear();
 #ifdef EXTRA_CHECKS
@@ -73,7 +73,7 @@ Genome::genvalue(void) {
 /* update the phenotype */
 double 
 Genome::update_phenotype(void) {
-  phenotype = genvalue() + ran1()*environmental_noise;
+  phenotype = genvalue() + ran1(rand_environment)*environmental_noise;
 
   return phenotype;
 }
@@ -92,6 +92,10 @@ Genome::update_fitness(void) {
 void 
 Genome::new_optimum(double opt) { optimum = opt; }
 
+/* set a new mutation rate, used when a branch continues with a different one */
+void 
+Genome::new_mu(double u) { mu = u; }
+
 /* replace this genome with a recombined product of two other genomes */
 void 
 Genome::mate(Genome *mother, Genome *father) {
@@ -108,8 +112,8 @@ Genome::mate(Genome *mother, Genome *father) {
      * logical operatio nbelow is always false, and so we always inherit the maternal 
      * derived allele with probability 1/2. Thus adding the haploid case doesn't 
      * change this expression form the original diploid implementation. */
-    if (mother->pop->sites[*it][mother->individual] != heterozygote || ran1() < 0.5) {
-      pop->sites[*it].set_genotype(individual, heterozygote); /* set the genotype in the Site object */
+    if (mother->pop->sites[*it][mother->individual] != heterozygote || ran1(rand_segregation) < 0.5) {
+      pop->record_genotype(individual, *it, heterozygote); /* set the genotype in the Site object */
       mutant_sites.push_back(*it); /* add this site to the list of ones with derived alleles */
     }
   }
@@ -123,7 +127,7 @@ Genome::mate(Genome *mother, Genome *father) {
       if (Site::ploidy_level == haploid) continue;
       /* if the father is not a heterozygote or we happen to sample the derived
        * allele, make the childe homozygote-derived */
-      if (father->pop->sites[*it][father->individual] != heterozygote || ran1() < 0.5)
+      if (father->pop->sites[*it][father->individual] != heterozygote || ran1(rand_segregation) < 0.5)
         child_genotype = homozygote_derived;
     } else {
       /* if the mother has a derived allele (equivalent to het in the diploid encoding), and 
@@ -137,17 +141,17 @@ Genome::mate(Genome *mother, Genome *father) {
         if (mother->pop->sites[*it][mother->individual] == heterozygote) {
           child_genotype = heterozygote;
         } else {
-          if (ran1() < 0.5) child_genotype = heterozygote;
+          if (ran1(rand_segregation) < 0.5) child_genotype = heterozygote;
         }
       } else {
-        if (father->pop->sites[*it][father->individual] != heterozygote || ran1() < 0.5)
+        if (father->pop->sites[*it][father->individual] != heterozygote || ran1(rand_segregation) < 0.5)
           child_genotype = heterozygote;
       }
       if (child_genotype > homozygote_ancestral)
         mutant_sites.push_back(*it); /* add this site to the list of ones with derived alleles */
     }
     if (child_genotype > homozygote_ancestral)
-      pop->sites[*it].set_genotype(individual, child_genotype); /* set the genotype in the Site object */
+      pop->record_genotype(individual, *it, child_genotype); /* set the genotype in the Site object */
   }
   
   mutate_genome();
@@ -169,9 +173,9 @@ Genome::mutate_genome(void) {
   /* draw a poisson number of mutations */
   int num_muts;
   if (Site::ploidy_level == diploid) {
-    num_muts = poidev(2.0*mu);
+    num_muts = poidev(2.0*mu, rand_mutation);
   } else {
-    num_muts = poidev(1.0*mu);
+    num_muts = poidev(1.0*mu, rand_mutation);
   }
   for (int i = 0; i < num_muts; i++) 
     mutate_site();
@@ -245,11 +249,11 @@ GenomeInfiniteSites::sample_effect_size(void) {
    * and with probability 0.5 they are 0,-a,-2a. HAPLOID: for haploid, the effect 
    * sizes are 0,a or 0,-a. This difference results from genotypes only having values
    * 0,1 instead of 0,1,2. */
-  if (ran1() < 0.5) sign = -1.0;
+  if (ran1(rand_effect) < 0.5) sign = -1.0;
 
   while (1) {
-    r = (int)(ran1() * effect_sizes.size());
-    if (ran1()*max < effect_probabilities[r]) 
+    r = (int)(ran1(rand_effect) * effect_sizes.size());
+    if (ran1(rand_effect)*max < effect_probabilities[r]) 
       return effect_sizes[r] * sign;
   }
 }
@@ -269,12 +273,12 @@ GenomeInfiniteSites::mutate_site(mutation_loc loc, double direction) {
   switch (pop->sites[loc][individual]) {
     case homozygote_ancestral:
       mutant_sites.push_back(loc);
-      pop->sites[loc].set_genotype(individual, heterozygote);
+      pop->record_genotype(individual, loc, heterozygote);
       break;
     case heterozygote:
       if (Site::ploidy_level == haploid)
         throw SimError("haploid populations can't mutate already mutated sites.\n");
-      pop->sites[loc].set_genotype(individual, homozygote_derived);
+      pop->record_genotype(individual, loc, homozygote_derived);
       break;
     case homozygote_derived:
       throw SimError("can't mutate a homozygote-derived site");
@@ -294,7 +298,7 @@ GenomeFiniteSites::GenomeFiniteSites(Population *p, int indiv) : Genome(p, indiv
 /* mutate a random site */
 void 
 GenomeFiniteSites::mutate_site(void) {
-  mutate_site( (mutation_loc)floor(ran1()*Population::num_loci) );
+  mutate_site( (mutation_loc)floor(ran1(rand_mutation)*Population::num_loci) );
   return;
 }
 
@@ -303,7 +307,7 @@ GenomeFiniteSites::mutate_site(void) {
  * case it's a heterozygote. When current genotype is homozygote only one 
  * direction is possible, and u is ignored. I only pass u when initially 
  * creating homozygote-derived genotypes, which I create by mutating a site 
- * twice 'up'. By default u has default value ran1() */
+ * twice 'up'. By default u has default value ran1(rand_mutation) */
 void 
 GenomeFiniteSites::mutate_site(mutation_loc loc, double u) {
   /* Here I don't need to wory about the haploid case, because that's not yet 
@@ -311,11 +315,11 @@ GenomeFiniteSites::mutate_site(mutation_loc loc, double u) {
   switch (pop->sites[loc][individual]) {
     case homozygote_ancestral:
       mutant_sites.push_back(loc);
-      pop->sites[loc].set_genotype(individual, heterozygote);
+      pop->record_genotype(individual, loc, heterozygote);
       break;
     case heterozygote:
       if (u < 0.5) {
-        pop->sites[loc].set_genotype(individual, homozygote_ancestral);
+        pop->record_genotype(individual, loc, homozygote_ancestral);
         /* this find() is inefficient because it needs to search the whole 
          * vector, luckily the vectors are short (unless there are many 
          * intermediate-frequency sites) and mutations do not occur that 
@@ -330,11 +334,11 @@ GenomeFiniteSites::mutate_site(mutation_loc loc, double u) {
         }
         mutant_sites.erase(x);
       } else {
-        pop->sites[loc].set_genotype(individual, homozygote_derived);
+        pop->record_genotype(individual, loc, homozygote_derived);
       }
       break;
     case homozygote_derived:
-      pop->sites[loc].set_genotype(individual, heterozygote);
+      pop->record_genotype(individual, loc, heterozygote);
       break;
     default:
       throw SimError("invalid genotype");
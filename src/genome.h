@@ -39,10 +39,12 @@ public:
 
   /* public class function */
   static void new_optimum(double);
+  static void new_mu(double);
   static void initialize(double u, double sig, double opt, double env);
 
   /* operators */
   friend std::ostream& operator<<(std::ostream &s, Genome &g);
+  friend class Checkpoint;
 
   /* genome-specific public data */
   double fitness;
@@ -106,7 +108,7 @@ public:
   GenomeFiniteSites(Population *p, int indiv);
   ~GenomeFiniteSites() { }
   void mutate_site(void);
-  void mutate_site(mutation_loc loc, double direction = ran1());
+  void mutate_site(mutation_loc loc, double direction = ran1(rand_mutation));
 };
 
 #endif /* __GENOME_H__ */
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "genotype_file.h"
+#include "error_handling.h"
+
+using std::string;
+using std::vector;
+
+/* the offset of the genotype matrix, after the effects and ids */
+static size_t matrix_offset(size_t nsites, bool has_ids) {
+  size_t off = sizeof(GenotypeFileHeader) + nsites*sizeof(double);
+  if (has_ids) off += nsites*sizeof(uint32_t);
+  return (off + 7) & ~(size_t)7;
+}
+
+/* Map a genotype file and check it's complete and consistent */
+GenotypeFile::GenotypeFile(const string &p) : path(p), base(NULL), size(0) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw SimError(0, "cannot open genotype file %s", path.c_str());
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw SimError(0, "cannot stat genotype file %s", path.c_str());
+  }
+  size = st.st_size;
+  if (size < sizeof(GenotypeFileHeader)) {
+    close(fd);
+    throw SimError(0, "%s is too short to be a genotype file", path.c_str());
+  }
+  base = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) throw SimError(0, "cannot map genotype file %s", path.c_str());
+
+  GenotypeFileHeader h;
+  memcpy(&h, base, sizeof(h));
+  if (memcmp(h.magic, "QGEN", 4) != 0) {
+    munmap((void *)base, size);
+    throw SimError(0, "%s is not a genotype file", path.c_str());
+  }
+  if (h.version != GENOTYPE_FILE_VERSION || (h.ploidy != 1 && h.ploidy != 2)) {
+    munmap((void *)base, size);
+    throw SimError(0, "unsupported genotype file %s", path.c_str());
+  }
+  popsize = h.popsize;
+  ploidy = h.ploidy;
+  nsites = h.nsites;
+  bool has_ids = (h.flags & GENOTYPE_FILE_IDS) != 0;
+  size_t off = matrix_offset(nsites, has_ids);
+  if (size < off + (size_t)nsites * popsize) {
+    munmap((void *)base, size);
+    throw SimError(0, "genotype file %s is truncated", path.c_str());
+  }
+  effects = (const double *)(base + sizeof(GenotypeFileHeader));
+  ids = has_ids ? (const uint32_t *)(effects + nsites) : NULL;
+  genotype_matrix = (const uint8_t *)(base + off);
+
+  /* the whole matrix is read in order, once */
+  madvise((void *)base, size, MADV_SEQUENTIAL);
+  madvise((void *)base, size, MADV_WILLNEED);
+}
+
+GenotypeFile::~GenotypeFile() {
+  if (base != NULL) munmap((void *)base, size);
+}
+
+/* Write a genotype file. ids may be empty, in which case none are stored */
+void
+GenotypeFile::write(const string &path, int popsize, int ploidy, const vector<double> &effects,
+    const vector<uint32_t> &ids, const vector<uint8_t> &genotypes) {
+  if (!ids.empty() && ids.size() != effects.size())
+    throw SimError("genotype file needs an id for every site, or none");
+  if (genotypes.size() != effects.size() * popsize)
+    throw SimError("genotype file needs a genotype for every individual at every site");
+
+  GenotypeFileHeader h;
+  memcpy(h.magic, "QGEN", 4);
+  h.version = GENOTYPE_FILE_VERSION;
+  h.popsize = popsize;
+  h.ploidy = ploidy;
+  h.nsites = effects.size();
+  h.flags = ids.empty() ? 0 : GENOTYPE_FILE_IDS;
+
+  FILE *f = fopen(path.c_str(), "wb");
+  if (f == NULL) throw SimError(0, "failed to open genotype file %s", path.c_str());
+  size_t pad = matrix_offset(h.nsites, !ids.empty()) - sizeof(h) - effects.size()*sizeof(double)
+    - ids.size()*sizeof(uint32_t);
+  static const char zeros[8] = { 0 };
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+  if (ok && !effects.empty()) ok = fwrite(&effects[0], sizeof(double), effects.size(), f) == effects.size();
+  if (ok && !ids.empty()) ok = fwrite(&ids[0], sizeof(uint32_t), ids.size(), f) == ids.size();
+  if (ok && pad > 0) ok = fwrite(zeros, pad, 1, f) == 1;
+  if (ok && !genotypes.empty()) ok = fwrite(&genotypes[0], 1, genotypes.size(), f) == genotypes.size();
+  if (fclose(f) != 0 || !ok) throw SimError(0, "failed to write genotype file %s", path.c_str());
+}
+
+/* END */
@@ -0,0 +1,65 @@
+#ifndef __GENOTYPE_FILE_H__
+#define __GENOTYPE_FILE_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* Genotype files hold a whole population's genotypes at a set of sites,
+ * with the sites' effects and, optionally, their ids. quant can start from
+ * one (--genotypes) and write its final state as one (--export-genotypes),
+ * and other tools can produce them from scratch:
+ *
+ *   header:  "QGEN", uint32 version, popsize, ploidy, nsites, flags
+ *   double   effect[nsites]
+ *   uint32   id[nsites]                  (if flags & GENOTYPE_FILE_IDS)
+ *   padding to a multiple of 8 bytes
+ *   uint8    genotype[nsites][popsize]   (derived allele counts, site by site)
+ *
+ * Each genotype is the number of derived alleles an individual carries at
+ * the site, 0 or 1 for haploids and 0, 1 or 2 for diploids. Integers and
+ * doubles are in the byte order of the machine that wrote the file. The
+ * file is mmap()ed rather than read, and the arrays used in place, so even
+ * a large population's state is available at once. */
+
+#define GENOTYPE_FILE_VERSION 1
+#define GENOTYPE_FILE_IDS 1
+
+struct GenotypeFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t popsize;
+  uint32_t ploidy;
+  uint32_t nsites;
+  uint32_t flags;
+};
+
+/* A genotype file, mapped into memory */
+class GenotypeFile {
+public:
+  GenotypeFile(const std::string &path);
+  ~GenotypeFile();
+
+  /* the derived allele counts of every individual at a site */
+  inline const uint8_t* genotypes(int site) const {
+    return genotype_matrix + (size_t)site * popsize;
+  }
+
+  static void write(const std::string &path, int popsize, int ploidy,
+    const std::vector<double> &effects, const std::vector<uint32_t> &ids,
+    const std::vector<uint8_t> &genotypes);
+
+  int popsize;
+  int ploidy;
+  int nsites;
+  const double *effects;
+  const uint32_t *ids;           /* NULL if the file has no ids */
+
+private:
+  std::string path;
+  const char *base;
+  size_t size;
+  const uint8_t *genotype_matrix;
+};
+
+#endif /* __GENOTYPE_FILE_H__ */
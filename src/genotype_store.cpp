@@ -0,0 +1,208 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "genotype_store.h"
+#include "error_handling.h"
+
+/* BSD and macOS spell it MAP_ANON */
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+using std::string;
+
+size_t GenotypeStore::budget = 0;
+string GenotypeStore::dir = "/tmp";
+size_t GenotypeStore::in_memory = 0;
+
+/* set the memory budget (in bytes, 0 for none) and the directory for files */
+void
+GenotypeStore::configure(const string &d, size_t b) {
+  if (!d.empty()) dir = d;
+  budget = b;
+}
+
+GenotypeStore::GenotypeStore(int N) : popsize(N), base(NULL), capacity(0), width(N),
+    shift(31), mask(0x7fffffff), ntiles(1), bytes(0), fd(-1) {
+}
+
+GenotypeStore::~GenotypeStore() {
+  if (base != NULL) munmap(base, bytes);
+  if (fd >= 0) close(fd);
+  else in_memory -= bytes;
+}
+
+/* Map zeroed storage for slots, either anonymous memory or an unlinked file */
+void
+GenotypeStore::allocate(size_t slots, bool to_file, char *&new_base, int &new_fd, size_t &new_bytes) const {
+  size_t tiles = to_file ? (popsize + TILE_WIDTH - 1) / TILE_WIDTH : 1;
+  new_bytes = tiles * slots * (to_file ? TILE_WIDTH : popsize);
+  new_fd = -1;
+  if (new_bytes == 0) {
+    new_base = NULL;
+    return;
+  }
+  if (!to_file) {
+    new_base = (char *)mmap(NULL, new_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (new_base == MAP_FAILED) throw SimError(0, "failed to allocate %lu bytes of genotypes", new_bytes);
+#ifdef MADV_HUGEPAGE
+    /* genotypes are looked up all over the store, so fewer, larger pages
+     * save a lot of TLB misses */
+    madvise(new_base, new_bytes, MADV_HUGEPAGE);
+#endif
+    return;
+  }
+  string path = dir + "/quant-genotypes-XXXXXX";
+  new_fd = mkstemp(&path[0]);
+  if (new_fd < 0) throw SimError(0, "failed to create genotype file in %s", dir.c_str());
+  /* nothing else should see the file, and it goes when we do */
+  unlink(path.c_str());
+  if (ftruncate(new_fd, new_bytes) != 0)
+    throw SimError(0, "failed to size genotype file to %lu bytes", new_bytes);
+  new_base = (char *)mmap(NULL, new_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, new_fd, 0);
+  if (new_base == MAP_FAILED) throw SimError("failed to map genotype file");
+}
+
+/* Make room for at least this many slots. The store grows by doubling, and
+ * moves to a file once the memory budget would be exceeded. Returns true if
+ * the genotypes had to be moved */
+bool
+GenotypeStore::reserve(size_t slots) {
+  if (slots <= capacity) return false;
+  size_t new_capacity = capacity < 32 ? 64 : 2*capacity;
+  if (new_capacity < slots) new_capacity = slots;
+
+  bool to_file = fd >= 0 ||
+    (budget > 0 && in_memory - bytes + new_capacity*popsize > budget);
+  char *new_base;
+  int new_fd;
+  size_t new_bytes;
+  allocate(new_capacity, to_file, new_base, new_fd, new_bytes);
+  size_t new_width = to_file ? TILE_WIDTH : popsize;
+  int new_shift = to_file ? TILE_SHIFT : 31;
+  int new_mask = to_file ? TILE_WIDTH-1 : 0x7fffffff;
+
+  /* copy the slots over, in runs that are contiguous in both layouts */
+  for (size_t slot=0; slot < capacity; slot++) {
+    int i = 0;
+    while (i < popsize) {
+      int n = popsize - i;
+      if ((int)(width - (i & mask)) < n) n = width - (i & mask);
+      if ((int)(new_width - (i & new_mask)) < n) n = new_width - (i & new_mask);
+      memcpy(new_base + ((size_t)(i >> new_shift) * new_capacity + slot) * new_width + (i & new_mask),
+        &at(slot, i), n);
+      i += n;
+    }
+  }
+
+  if (base != NULL) munmap(base, bytes);
+  if (fd >= 0) close(fd);
+  else in_memory -= bytes;
+  if (new_fd < 0) in_memory += new_bytes;
+  base = new_base;
+  fd = new_fd;
+  bytes = new_bytes;
+  capacity = new_capacity;
+  width = new_width;
+  shift = new_shift;
+  mask = new_mask;
+  ntiles = to_file ? (popsize + TILE_WIDTH - 1) / TILE_WIDTH : 1;
+  return true;
+}
+
+/* where a slot's genotypes are: individual i's is at 
+ * column[(i >> shift) * stride + (i & mask)] */
+void
+GenotypeStore::locate(size_t slot, char *&column, size_t &stride, int &s, int &m) {
+  column = base + slot*width;
+  stride = capacity*width;
+  s = shift;
+  m = mask;
+}
+
+/* set every genotype in a slot to homozygote ancestral */
+void
+GenotypeStore::zero(size_t slot) {
+  for (size_t t=0; t < ntiles; t++) {
+    size_t n = popsize - t*width < width ? popsize - t*width : width;
+    memset(base + (t*capacity + slot)*width, 0, n);
+  }
+}
+
+/* copy a slot's genotypes out to, or in from, popsize contiguous bytes */
+void
+GenotypeStore::read_column(size_t slot, char *dst) const {
+  for (size_t t=0; t < ntiles; t++) {
+    size_t n = popsize - t*width < width ? popsize - t*width : width;
+    memcpy(dst + t*width, base + (t*capacity + slot)*width, n);
+  }
+}
+
+void
+GenotypeStore::write_column(size_t slot, const char *src) {
+  for (size_t t=0; t < ntiles; t++) {
+    size_t n = popsize - t*width < width ? popsize - t*width : width;
+    memcpy(base + (t*capacity + slot)*width, src + t*width, n);
+  }
+}
+
+/* Find a non-zero genotype among the first slots, scanning the storage in
+ * order. Returns false if they're all zero */
+bool
+GenotypeStore::first_nonzero(size_t slots, size_t &slot, int &i) const {
+  for (size_t t=0; t < ntiles; t++) {
+    const char *start = base + t*capacity*width;
+    const char *stop = start + slots*width;
+    const char *p = start;
+    /* a word at a time, then find the byte */
+    while (p < stop && ((uintptr_t)p & 7) != 0 && *p == 0) p++;
+    while (p + 8 <= stop && *(const uint64_t *)p == 0) p += 8;
+    while (p < stop && *p == 0) p++;
+    if (p < stop) {
+      slot = (p - start) / width;
+      i = t*width + (p - start) % width;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Offspring are written in order, so a file's pages can be read ahead
+ * and dropped once written */
+void
+GenotypeStore::begin_offspring(void) {
+  if (fd >= 0) madvise(base, bytes, MADV_SEQUENTIAL);
+}
+
+/* individual i was the last in its tile, so drop the tile's pages. They're
+ * written back to the file as the kernel sees fit */
+void
+GenotypeStore::end_tile(int i) {
+  if (fd < 0) return;
+  size_t t = i >> shift;
+  madvise(base + t*capacity*width, capacity*width, MADV_DONTNEED);
+}
+
+/* parents are chosen at random, so reading ahead is wasted */
+void
+GenotypeStore::begin_parents(void) {
+  if (fd >= 0) madvise(base, bytes, MADV_RANDOM);
+}
+
+/* The store has been cleared, so free the file's pages and disk blocks.
+ * Reading them back gives zeros, which is what's there. Where holes can't be
+ * punched, the pages are only dropped from memory */
+void
+GenotypeStore::discard(void) {
+  if (fd < 0) return;
+#ifdef FALLOC_FL_PUNCH_HOLE
+  if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, bytes) == 0) return;
+#endif
+  madvise(base, bytes, MADV_DONTNEED);
+}
+
+/* END */
@@ -0,0 +1,77 @@
+#ifndef __GENOTYPE_STORE_H__
+#define __GENOTYPE_STORE_H__
+
+#include <stddef.h>
+#include <string>
+
+/* The genotypes of one population view, for every site slot. A Site finds
+ * its genotypes here by its position in the sites vector (its slot).
+ *
+ * Normally the genotypes are held in memory, a column of popsize bytes per
+ * slot. When the two views would need more than the memory budget
+ * (--genotype-memory), a store moves to a file in --genotype-dir that is
+ * mmap()ed, and its layout changes to tiles: for each block of TILE_WIDTH
+ * individuals, a TILE_WIDTH byte run for every slot. Offspring are made in
+ * order, so a generation writes the offspring view's file from start to
+ * finish, tile by tile, and the tiles behind it are dropped from memory.
+ * Parents are read in random order, and once the parent view has been
+ * cleared (it is then all zeros) its file is emptied without any I/O, ready
+ * to be written again as the next offspring. Only the parent tiles in use
+ * and the offspring tile being written need to be resident.
+ *
+ * Both layouts are addressed the same way: with the in-memory layout there
+ * is a single tile, as wide as the population. Sites keep their own copy
+ * of where their genotypes are (see locate()), which is out of date once
+ * reserve() has had to move them. */
+
+#define TILE_SHIFT 12
+#define TILE_WIDTH (1 << TILE_SHIFT)
+
+class GenotypeStore {
+public:
+  GenotypeStore(int popsize);
+  ~GenotypeStore();
+
+  /* an individual's genotype in a slot */
+  inline char& at(size_t slot, int i) {
+    return base[((size_t)(i >> shift) * capacity + slot) * width + (i & mask)];
+  }
+  inline char at(size_t slot, int i) const {
+    return base[((size_t)(i >> shift) * capacity + slot) * width + (i & mask)];
+  }
+
+  bool reserve(size_t slots);
+  void locate(size_t slot, char *&column, size_t &stride, int &shift, int &mask);
+  void zero(size_t slot);
+  void read_column(size_t slot, char *dst) const;
+  void write_column(size_t slot, const char *src);
+  bool first_nonzero(size_t slots, size_t &slot, int &i) const;
+  void begin_offspring(void);
+  void end_tile(int i);
+  void begin_parents(void);
+  void discard(void);
+  bool file_backed(void) const { return fd >= 0; }
+  int size(void) const { return popsize; }
+
+  static void configure(const std::string &dir, size_t budget);
+
+private:
+  void allocate(size_t slots, bool to_file, char *&new_base, int &new_fd, size_t &new_bytes) const;
+
+  int popsize;
+  char *base;
+  size_t capacity;             /* slots */
+  size_t width;                /* bytes of a slot in one tile */
+  int shift, mask;
+  size_t ntiles;
+  size_t bytes;
+  int fd;                      /* the backing file, or -1 if in memory */
+
+  /* the memory budget for all genotypes, 0 if unlimited, and where to put
+   * files once it's exceeded */
+  static size_t budget;
+  static std::string dir;
+  static size_t in_memory;     /* bytes held in memory by all stores */
+};
+
+#endif /* __GENOTYPE_STORE_H__ */
@@ -0,0 +1,418 @@
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+#include "island.h"
+#include "site.h"
+#include "error_handling.h"
+#include "statistic.h"
+#include "output.h"
+
+using std::vector;
+using std::thread;
+using std::map;
+
+/***************
+ * SpinBarrier *
+ ***************/
+
+SpinBarrier::SpinBarrier(int n) : waiting(0), phase(0) {
+  nthreads = n;
+}
+
+/* The last thread to arrive resets the count and advances the phase, which
+ * releases the others */
+void SpinBarrier::wait(void) {
+  int p = phase.load();
+  if (waiting.fetch_add(1) == nthreads-1) {
+    waiting.store(0);
+    phase.fetch_add(1);
+  } else {
+    while (phase.load() == p)
+      std::this_thread::yield();
+  }
+}
+
+/**********
+ * Island *
+ **********/
+
+/* set up the demes from the command line arguments */
+Island::Island(Args &a) : ar(a), barrier(a.demes) {
+  if (ar.sites_model != finite_sites)
+    throw SimUsageError("island model only supports the finite sites model");
+
+  ndemes = ar.demes;
+  popsize = ar.popsize;
+  nloci = ar.nloci;
+  mu = ar.mu;
+  sig = 2.0/ar.s;
+  env = ar.env;
+  generation = 0;
+  stat_generations = 0;
+
+  /* like quant, genotypes are 0,1,2 on top of an all-ancestral baseline */
+  baseline = 0;
+  for (int i=0; i < (int)ar.loci_counts.size(); i++) {
+    for (int j=0; j < ar.loci_counts[i]; j++) {
+      effects.push_back(ar.effect_sizes[i]);
+      baseline -= ar.effect_sizes[i];
+    }
+  }
+
+  /* as in Population::count_segregating(), every site is tracked, and in the
+   * finite sites model that's every locus */
+  for (int l=0; l < nloci; l++) segsites[effects[l]]++;
+  if (Statistic::is_activated(STAT_VISITS))
+    visits.assign(2*popsize*ndemes - 1, 0);
+
+  /* a single migration rate is split evenly among the other demes */
+  migration.assign(ndemes*ndemes, 0.0);
+  for (int s=0; s < ndemes; s++) {
+    for (int d=0; d < ndemes; d++) {
+      if (s == d) continue;
+      if (ar.migration.size() == 1)
+        migration[s*ndemes + d] = ar.migration[0] / (ndemes-1);
+      else if (ar.migration.size() > 1)
+        migration[s*ndemes + d] = ar.migration[s*ndemes + d];
+    }
+  }
+
+  demes.resize(ndemes);
+  for (int d=0; d < ndemes; d++) {
+    Deme &deme = demes[d];
+    deme.parents.assign((size_t)popsize*nloci, 0);
+    deme.offspring.assign((size_t)popsize*nloci, 0);
+    deme.phenotype.assign(popsize, 0);
+    deme.fitness.assign(popsize, 0);
+    deme.offspring_phenotype.assign(popsize, 0);
+    deme.offspring_fitness.assign(popsize, 0);
+    deme.counts.assign(nloci, 0);
+    deme.inbox.resize(ndemes);
+    deme.residents.resize(popsize);
+    for (int i=0; i < popsize; i++) deme.residents[i] = i;
+    if (Statistic::is_activated(STAT_VISITS)) deme.visits.assign(2*popsize - 1, 0);
+    deme.rng.reseed(ar.rand_seed, d);
+    deme.optimum_offset = ar.deme_opts.size() > 0 ? ar.deme_opts[d] : 0.0;
+    deme.optimum = ar.opts[0] + deme.optimum_offset;
+    deme.max_fitness = 0;
+    deme.phenotype_var_sum = 0;
+    deme.mutation_count = 0;
+  }
+}
+
+/* Scatter the initial frequencies into genotypes under Hardy-Weinberg, as
+ * Population::setup_initial_genotypes does, independently in each deme */
+void Island::setup_initial_genotypes(void) {
+  vector<int> hets(nloci), homs(nloci);
+  double f;
+  int loc = 0;
+  while (1) {
+    f = ar.get_initial_frequency();
+    if (f < 0 || loc == nloci) break;
+    hets[loc] = (int)round(2.0*f*(1.0-f)*popsize);
+    homs[loc] = (int)round(f*f*popsize);
+    loc++;
+  }
+  if (!(f < 0 && loc == nloci))
+    throw SimError(0, "incorrect number of frequencies. Expecting %d.", nloci);
+
+  vector<int> order(popsize);
+  for (int d=0; d < ndemes; d++) {
+    Deme &deme = demes[d];
+    for (int l=0; l < nloci; l++) {
+      for (int i=0; i < popsize; i++) order[i] = i;
+      for (int i=popsize-1; i > 0; i--) {
+        int j = (int)(deme.rng.uniform()*(i+1));
+        int tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+      }
+      int ind;
+      for (ind=0; ind < hets[l]; ind++)
+        deme.parents[(size_t)order[ind]*nloci + l] = heterozygote;
+      for (; ind < hets[l]+homs[l]; ind++)
+        deme.parents[(size_t)order[ind]*nloci + l] = homozygote_derived;
+    }
+    for (int i=0; i < popsize; i++)
+      update_individual(deme, &deme.parents[(size_t)i*nloci], i, deme.rng.uniform()*env,
+        deme.phenotype, deme.fitness);
+  }
+}
+
+/* compute the phenotype and fitness of individual ind with genotypes g under
+ * the deme's current optimum */
+void Island::update_individual(Deme &deme, const unsigned char *g, int ind, double env_draw,
+    vector<double> &ph, vector<double> &w) {
+  double p = baseline + env_draw;
+  for (int l=0; l < nloci; l++) p += g[l]*effects[l];
+  ph[ind] = p;
+  w[ind] = exp( -(p-deme.optimum)*(p-deme.optimum)/sig );
+  if (w[ind] > deme.max_fitness) deme.max_fitness = w[ind];
+}
+
+/* Create the offspring generation of deme d from its parents, make it the
+ * parent generation, and post its emigrants to the other demes' mailboxes */
+void Island::reproduce(int d) {
+  Deme &deme = demes[d];
+  double parent_max = deme.max_fitness;
+  deme.max_fitness = 0;
+
+  int mom, dad;
+  for (int off=0; off < popsize; off++) {
+    while (1) {
+      mom = (int)(popsize*deme.rng.uniform());
+      if (deme.rng.uniform()*parent_max <= deme.fitness[mom]) break;
+    }
+    while (1) {
+      dad = (int)(popsize*deme.rng.uniform());
+      if (deme.rng.uniform()*parent_max <= deme.fitness[dad]) break;
+    }
+
+    /* each parent transmits a derived allele with probability g/2 */
+    const unsigned char *gm = &deme.parents[(size_t)mom*nloci];
+    const unsigned char *gd = &deme.parents[(size_t)dad*nloci];
+    unsigned char *child = &deme.offspring[(size_t)off*nloci];
+    for (int l=0; l < nloci; l++)
+      child[l] = (deme.rng.uniform() < 0.5*gm[l]) + (deme.rng.uniform() < 0.5*gd[l]);
+
+    /* mutation, following the rules in GenomeFiniteSites::mutate_site */
+    int num_muts = deme.rng.poisson(2.0*mu);
+    for (int m=0; m < num_muts; m++) {
+      int l = (int)floor(deme.rng.uniform()*nloci);
+      if (child[l] == heterozygote)
+        child[l] = deme.rng.uniform() < 0.5 ? homozygote_ancestral : homozygote_derived;
+      else
+        child[l] = heterozygote;
+    }
+    deme.mutation_count += num_muts;
+
+    update_individual(deme, child, off, deme.rng.uniform()*env,
+      deme.offspring_phenotype, deme.offspring_fitness);
+  }
+  deme.parents.swap(deme.offspring);
+  deme.phenotype.swap(deme.offspring_phenotype);
+  deme.fitness.swap(deme.offspring_fitness);
+
+  /* emigration */
+  for (int dest=0; dest < ndemes; dest++) {
+    double m = migration[d*ndemes + dest];
+    if (dest == d || m <= 0) continue;
+    Migrants &box = demes[dest].inbox[d];
+    for (int i=0; i < popsize; i++) {
+      if (deme.rng.uniform() < m) {
+        box.genotypes.insert(box.genotypes.end(), &deme.parents[(size_t)i*nloci],
+          &deme.parents[(size_t)(i+1)*nloci]);
+        box.phenotypes.push_back(deme.phenotype[i]);
+      }
+    }
+  }
+}
+
+/* Each immigrant replaces a random resident, a different one for each, which
+ * are drawn without replacement by a partial Fisher-Yates shuffle of the
+ * residents. If more than N arrive, the last ones find no room. An
+ * immigrant's fitness is evaluated under the local optimum */
+void Island::receive_migrants(int d) {
+  Deme &deme = demes[d];
+  int replaced = 0;
+  for (int src=0; src < ndemes; src++) {
+    Migrants &box = deme.inbox[src];
+    for (int k=0; k < (int)box.phenotypes.size() && replaced < popsize; k++) {
+      int j = replaced + (int)((popsize-replaced)*deme.rng.uniform());
+      std::swap(deme.residents[replaced], deme.residents[j]);
+      int r = deme.residents[replaced++];
+      std::copy(&box.genotypes[(size_t)k*nloci], &box.genotypes[(size_t)k*nloci] + nloci,
+        &deme.parents[(size_t)r*nloci]);
+      double p = box.phenotypes[k];
+      deme.phenotype[r] = p;
+      deme.fitness[r] = exp( -(p-deme.optimum)*(p-deme.optimum)/sig );
+      if (deme.fitness[r] > deme.max_fitness) deme.max_fitness = deme.fitness[r];
+    }
+    box.genotypes.clear();
+    box.phenotypes.clear();
+  }
+}
+
+/* allele counts and phenotype sums for deme d's parent generation */
+void Island::compute_statistics(int d) {
+  Deme &deme = demes[d];
+  for (int l=0; l < nloci; l++) deme.counts[l] = 0;
+  deme.phenotype_sum = deme.phenotype_sumsq = 0;
+  for (int i=0; i < popsize; i++) {
+    const unsigned char *g = &deme.parents[(size_t)i*nloci];
+    for (int l=0; l < nloci; l++) deme.counts[l] += g[l];
+    deme.phenotype_sum += deme.phenotype[i];
+    deme.phenotype_sumsq += deme.phenotype[i]*deme.phenotype[i];
+  }
+}
+
+/* Print per-deme and global statistics. Only called from deme 0's thread,
+ * while the other demes are reproducing (which doesn't touch statistics) */
+void Island::print_statistics(void) {
+  double total = 2.0*popsize*ndemes;
+  double sum = 0, sumsq = 0;
+  for (int d=0; d < ndemes; d++) {
+    Deme &deme = demes[d];
+    double mean = deme.phenotype_sum/popsize;
+    double var = deme.phenotype_sumsq/popsize - mean*mean;
+    deme.phenotype_var_sum += var;
+    sum += deme.phenotype_sum;
+    sumsq += deme.phenotype_sumsq;
+
+    if (Statistic::is_activated(STAT_FREQUENCIES)) {
+      out << "deme: " << d << " gen: " << generation << " freqs:";
+      for (int l=0; l < nloci; l++) {
+        double f = deme.counts[l] / (2.0*popsize);
+        if (f < 1.0) out << " " << l << ":" << f;
+      }
+      out << '\n';
+    }
+    if (Statistic::is_activated(STAT_SEGSITES)) {
+      out << "deme: " << d << " gen: " << generation << " segsites:";
+      for (map<double,int>::iterator i=segsites.begin(); i != segsites.end(); i++)
+        out << " " << i->first << "," << i->second;
+      out << '\n';
+    }
+    if (Statistic::is_activated(STAT_PHENOTYPE))
+      out << "deme: " << d << " gen: " << generation << " pheno: " << mean << " " << var << '\n';
+  }
+
+  double mean = sum/(popsize*ndemes);
+  double var = sumsq/(popsize*ndemes) - mean*mean;
+  phenotype_var_sum += var;
+  stat_generations++;
+
+  if (Statistic::is_activated(STAT_FREQUENCIES)) {
+    out << "gen: " << generation << " freqs:";
+    for (int l=0; l < nloci; l++) {
+      int c = 0;
+      for (int d=0; d < ndemes; d++) c += demes[d].counts[l];
+      if (c < total) out << " " << l << ":" << c/total;
+    }
+    out << '\n';
+  }
+  if (Statistic::is_activated(STAT_SEGSITES)) {
+    out << "gen: " << generation << " segsites:";
+    for (map<double,int>::iterator i=segsites.begin(); i != segsites.end(); i++)
+      out << " " << i->first << "," << i->second;
+    out << '\n';
+  }
+  if (Statistic::is_activated(STAT_PHENOTYPE))
+    out << "gen: " << generation << " pheno: " << mean << " " << var << '\n';
+
+  /* Wright's Fst, as the ratio of the summed variance in frequency among
+   * demes to the summed pbar(1-pbar) over loci segregating in the total */
+  if (Statistic::is_activated(STAT_FST)) {
+    double between = 0, within = 0;
+    for (int l=0; l < nloci; l++) {
+      double pbar = 0, p2 = 0;
+      for (int d=0; d < ndemes; d++) {
+        double p = demes[d].counts[l] / (2.0*popsize);
+        pbar += p;
+        p2 += p*p;
+      }
+      pbar /= ndemes;
+      if (pbar <= 0 || pbar >= 1) continue;
+      between += p2/ndemes - pbar*pbar;
+      within += pbar*(1-pbar);
+    }
+    out << "gen: " << generation << " fst: " << (within > 0 ? between/within : 0) << '\n';
+  }
+}
+
+/* count one visit for each locus segregating in each deme, and in the demes
+ * taken together, as the visits statistic does each generation */
+void Island::stat_increment_visits(void) {
+  if (!Statistic::is_activated(STAT_VISITS)) return;
+  for (int l=0; l < nloci; l++) {
+    int total = 0;
+    for (int d=0; d < ndemes; d++) {
+      int c = demes[d].counts[l];
+      if (c > 0 && c < 2*popsize) demes[d].visits[c-1]++;
+      total += c;
+    }
+    if (total > 0 && total < 2*popsize*ndemes) visits[total-1]++;
+  }
+}
+
+/* print the final state, as at the end of quant's main loop */
+void Island::print_final(void) {
+  print_statistics();
+  if (Statistic::is_activated(STAT_VISITS)) {
+    for (int d=0; d < ndemes; d++) {
+      out << "deme: " << d << " visits:";
+      for (size_t c=0; c < demes[d].visits.size(); c++) out << " " << demes[d].visits[c];
+      out << '\n';
+    }
+    out << "visits:";
+    for (size_t c=0; c < visits.size(); c++) out << " " << visits[c];
+    out << '\n';
+  }
+  if (Statistic::is_activated(STAT_PHENOTYPE_VAR_MEAN)) {
+    for (int d=0; d < ndemes; d++)
+      out << "deme: " << d << " gen: " << generation << " phenotype_var_mean: "
+        << demes[d].phenotype_var_sum/stat_generations << '\n';
+    out << "gen: " << generation << " phenotype_var_mean: " << phenotype_var_sum/stat_generations << '\n';
+  }
+  if (Statistic::is_activated(STAT_MUTATION)) {
+    int total = 0;
+    for (int d=0; d < ndemes; d++) {
+      out << "deme: " << d << " mutations: " << demes[d].mutation_count << '\n';
+      total += demes[d].mutation_count;
+    }
+    out << "mutations: " << total << '\n';
+  }
+}
+
+/* The main loop of the thread for deme d. Every thread goes through the same
+ * sequence of generations, with the burnin and epoch bookkeeping of the main
+ * loop in quant.cpp */
+void Island::simulate(int d) {
+  Deme &deme = demes[d];
+  int burnin = ar.burnin;
+  int gen = 0;
+
+  for (int epoch=0; epoch < (int)ar.times.size(); epoch++) {
+    deme.optimum = ar.opts[epoch] + deme.optimum_offset;
+    while (gen < ar.times[epoch]) {
+      if (burnin <= 0) compute_statistics(d);
+      barrier.wait();
+      if (d == 0 && burnin <= 0) {
+        generation = gen;
+        print_statistics();
+        stat_increment_visits();
+      }
+      reproduce(d);
+      barrier.wait();
+      receive_migrants(d);
+
+      if (d == 0) {
+        if (burnin == 0 && gen == 0 && Statistic::is_activated(STAT_BURNIN))
+          out << "end burnin" << '\n';
+        out.end_generation(gen);
+      }
+      if (burnin <= 0) gen++;
+      else burnin--;
+    }
+  }
+
+  compute_statistics(d);
+  barrier.wait();
+  if (d == 0) {
+    generation = gen;
+    print_final();
+  }
+}
+
+/* run every deme on its own thread */
+void Island::run(void) {
+  phenotype_var_sum = 0;
+  setup_initial_genotypes();
+  vector<thread> threads;
+  for (int d=0; d < ndemes; d++)
+    threads.push_back(thread(&Island::simulate, this, d));
+  for (int d=0; d < ndemes; d++)
+    threads[d].join();
+}
+
+/* END */
@@ -0,0 +1,109 @@
+#ifndef __ISLAND_H__
+#define __ISLAND_H__
+
+#include <vector>
+#include <map>
+#include <atomic>
+
+#include "command_line.h"
+#include "sim_rand.h"
+
+/* A reusable barrier for a fixed number of threads. Threads spin (yielding)
+ * on a generation counter rather than blocking on a mutex, as every deme
+ * reaches the barrier at about the same time. */
+class SpinBarrier {
+public:
+  SpinBarrier(int n);
+  void wait(void);
+private:
+  int nthreads;
+  std::atomic<int> waiting;
+  std::atomic<int> phase;
+};
+
+/* Immigrants sent from one deme to another in one generation. Each mailbox
+ * slot has exactly one writer (the source deme, before the exchange barrier)
+ * and one reader (the destination deme, after it), so no locking is needed. */
+struct Migrants {
+  std::vector<unsigned char> genotypes;  /* nloci genotypes per migrant */
+  std::vector<double> phenotypes;
+};
+
+/* One deme of the island model. Genotypes are stored individual-major,
+ * genotype of individual i at locus l at g[i*nloci + l]. */
+struct Deme {
+  std::vector<unsigned char> parents;
+  std::vector<unsigned char> offspring;
+  std::vector<double> phenotype, fitness;
+  std::vector<double> offspring_phenotype, offspring_fitness;
+  double max_fitness;
+  double optimum_offset;                 /* added to each epoch's optimum */
+  double optimum;
+  RandStream rng;
+
+  /* inbox[s] holds migrants from deme s */
+  std::vector<Migrants> inbox;
+
+  /* the residents in an order that's shuffled as immigrants replace them */
+  std::vector<int> residents;
+
+  /* statistics of the parent generation */
+  std::vector<int> counts;
+  double phenotype_sum, phenotype_sumsq;
+  double phenotype_var_sum;
+  int mutation_count;
+  std::vector<long> visits;              /* visits[c-1], as for the visits statistic */
+};
+
+/* The Island model simulates D demes of the finite sites model, each of size
+ * N, connected by a migration matrix. m[s][d] is the probability that each
+ * offspring born in deme s is copied into deme d, replacing a random resident
+ * there, each immigrant a different one. Each deme has its own optimum (the epoch's optimum plus a per-deme
+ * offset), so the model can be used to study local adaptation.
+ *
+ * Each deme runs on its own thread. A generation is
+ *
+ *   1. compute the deme's statistics (counts, phenotype moments)
+ *   2. barrier; deme 0 prints per-deme and global statistics to out
+ *   3. reproduce within the deme, and post migrants to the destination
+ *      demes' mailboxes
+ *   4. barrier; each deme takes in its immigrants
+ *
+ * so the demes only synchronize twice per generation. */
+class Island {
+public:
+  Island(Args &ar);
+  ~Island() { }
+  void run(void);
+
+private:
+  void setup_initial_genotypes(void);
+  void simulate(int d);
+  void update_individual(Deme &deme, const unsigned char *g, int ind, double env_draw,
+    std::vector<double> &ph, std::vector<double> &w);
+  void reproduce(int d);
+  void receive_migrants(int d);
+  void compute_statistics(int d);
+  void print_statistics(void);
+  void stat_increment_visits(void);
+  void print_final(void);
+
+  Args &ar;
+  int ndemes;
+  int popsize;
+  int nloci;
+  int generation;
+  double mu, sig, env, baseline;
+  std::vector<double> effects;
+  std::vector<double> migration;         /* migration[s*ndemes + d] */
+  std::vector<Deme> demes;
+  SpinBarrier barrier;
+
+  /* accumulated by print_statistics for phenotype-var-mean */
+  double phenotype_var_sum;
+  int stat_generations;
+  std::vector<long> visits;              /* of the demes taken together */
+  std::map<double,int> segsites;         /* loci of each effect size */
+};
+
+#endif /* __ISLAND_H__ */
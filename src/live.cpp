@@ -0,0 +1,213 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "live.h"
+#include "error_handling.h"
+
+using std::string;
+using std::vector;
+
+/* the header, rounded up so the arrays that follow are aligned */
+static const size_t header_size = (sizeof(LiveHeader) + 7) & ~(size_t)7;
+
+size_t
+live_segment_size(uint32_t capacity, uint32_t nvisits) {
+  return header_size + (size_t)capacity*(sizeof(uint32_t) + sizeof(int32_t) + sizeof(double))
+    + (size_t)nvisits*sizeof(int32_t);
+}
+
+/* the arrays within a segment of the given capacity */
+static inline uint32_t* live_ids(const char *base, uint32_t) {
+  return (uint32_t *)(base + header_size);
+}
+static inline int32_t* live_counts(const char *base, uint32_t capacity) {
+  return (int32_t *)(base + header_size + (size_t)capacity*sizeof(uint32_t));
+}
+static inline double* live_effects(const char *base, uint32_t capacity) {
+  return (double *)(base + header_size + (size_t)capacity*(sizeof(uint32_t) + sizeof(int32_t)));
+}
+static inline int32_t* live_visits(const char *base, uint32_t capacity) {
+  return (int32_t *)(base + header_size + (size_t)capacity*(sizeof(uint32_t) + sizeof(int32_t) + sizeof(double)));
+}
+
+/* Create the segment, replacing any left by an earlier run of the same name */
+LivePublisher::LivePublisher(const string &n, int popsize, int ploidy, int nvisits) : name(n),
+    base(NULL), size(0), header(NULL) {
+  if (name.empty() || name[0] != '/') name = "/" + name;
+  shm_unlink(name.c_str());
+  fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) throw SimError(0, "failed to create shared memory segment %s", name.c_str());
+
+  /* capacity is kept even, so the effects are aligned */
+  uint32_t capacity = 256;
+  if (ftruncate(fd, live_segment_size(capacity, nvisits)) != 0)
+    throw SimError(0, "failed to size shared memory segment %s", name.c_str());
+  base = (char *)mmap(NULL, live_segment_size(capacity, nvisits), PROT_READ | PROT_WRITE,
+    MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) throw SimError(0, "failed to map shared memory segment %s", name.c_str());
+  size = live_segment_size(capacity, nvisits);
+
+  /* the segment starts out zeroed, which is a valid, even, sequence number */
+  header = (LiveHeader *)base;
+  header->version = LIVE_VERSION;
+  header->popsize = popsize;
+  header->ploidy = ploidy;
+  header->capacity = capacity;
+  header->nvisits = nvisits;
+  header->running = 1;
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header->magic, "QLIV", 4);
+}
+
+LivePublisher::~LivePublisher() {
+  close();
+}
+
+/* grow the segment to hold capacity sites. Only called under the lock */
+void
+LivePublisher::map_segment(uint32_t capacity) {
+  size_t new_size = live_segment_size(capacity, header->nvisits);
+  if (ftruncate(fd, new_size) != 0)
+    throw SimError(0, "failed to grow shared memory segment %s", name.c_str());
+  char *p = (char *)mremap(base, size, new_size, MREMAP_MAYMOVE);
+  if (p == MAP_FAILED) throw SimError(0, "failed to remap shared memory segment %s", name.c_str());
+  base = p;
+  size = new_size;
+  header = (LiveHeader *)base;
+  header->capacity = capacity;
+}
+
+/* start putting together a snapshot */
+void
+LivePublisher::begin(int gen, double m, double v) {
+  generation = gen;
+  mean = m;
+  variance = v;
+  ids.clear();
+  counts.clear();
+  effects.clear();
+}
+
+/* copy the snapshot into the segment */
+void
+LivePublisher::end(const vector<int> &visits) {
+  if (header == NULL) return;
+  uint64_t seq = header->sequence.load(std::memory_order_relaxed);
+  header->sequence.store(seq+1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  /* the site arrays move when the segment grows, so the old sites are
+   * simply written again below */
+  uint32_t nsites = ids.size();
+  if (nsites > header->capacity) {
+    uint32_t capacity = header->capacity;
+    while (capacity < nsites) capacity *= 2;
+    map_segment(capacity);
+  }
+  uint32_t capacity = header->capacity;
+  if (nsites > 0) {
+    memcpy(live_ids(base, capacity), &ids[0], nsites*sizeof(uint32_t));
+    memcpy(live_counts(base, capacity), &counts[0], nsites*sizeof(int32_t));
+    memcpy(live_effects(base, capacity), &effects[0], nsites*sizeof(double));
+  }
+  size_t nvisits = visits.size() < header->nvisits ? visits.size() : header->nvisits;
+  if (nvisits > 0) memcpy(live_visits(base, capacity), &visits[0], nvisits*sizeof(int32_t));
+  header->generation = generation;
+  header->nsites = nsites;
+  header->phenotype_mean = mean;
+  header->phenotype_variance = variance;
+  header->updates++;
+
+  header->sequence.store(seq+2, std::memory_order_release);
+}
+
+/* mark the simulation as finished, and remove the segment's name. Readers
+ * that have it mapped can still take a last snapshot */
+void
+LivePublisher::close(void) {
+  if (header == NULL) return;
+  uint64_t seq = header->sequence.load(std::memory_order_relaxed);
+  header->sequence.store(seq+1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  header->running = 0;
+  header->sequence.store(seq+2, std::memory_order_release);
+  munmap(base, size);
+  ::close(fd);
+  shm_unlink(name.c_str());
+  header = NULL;
+  base = NULL;
+}
+
+/* Map a segment published by another process */
+LiveReader::LiveReader(const string &n) : name(n), base(NULL), size(0) {
+  if (name.empty() || name[0] != '/') name = "/" + name;
+  fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) throw SimError(0, "no shared memory segment %s", name.c_str());
+  remap();
+  if (size < sizeof(LiveHeader) || memcmp(((const LiveHeader *)base)->magic, "QLIV", 4) != 0)
+    throw SimError(0, "%s isn't a published simulation, or isn't ready yet", name.c_str());
+  if (((const LiveHeader *)base)->version != LIVE_VERSION)
+    throw SimError(0, "unsupported version of shared memory segment %s", name.c_str());
+}
+
+LiveReader::~LiveReader() {
+  if (base != NULL) munmap((void *)base, size);
+  close(fd);
+}
+
+/* map the whole segment, as it is now */
+void
+LiveReader::remap(void) {
+  struct stat st;
+  if (fstat(fd, &st) != 0) throw SimError(0, "cannot stat shared memory segment %s", name.c_str());
+  if (base != NULL) munmap((void *)base, size);
+  size = st.st_size;
+  base = (const char *)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    base = NULL;
+    throw SimError(0, "cannot map shared memory segment %s", name.c_str());
+  }
+}
+
+/* Take a consistent copy of the published state. Returns false if the
+ * publisher was writing every time we looked */
+bool
+LiveReader::snapshot(LiveSnapshot &s, int attempts) {
+  for (int a=0; a < attempts; a++) {
+    const LiveHeader *h = (const LiveHeader *)base;
+    uint64_t seq = h->sequence.load(std::memory_order_acquire);
+    if (seq & 1) {
+      sched_yield();
+      continue;
+    }
+    uint32_t capacity = h->capacity;
+    uint32_t nvisits = h->nvisits;
+    uint32_t nsites = h->nsites;
+    if (live_segment_size(capacity, nvisits) > size) {
+      /* the segment has grown since we mapped it */
+      remap();
+      continue;
+    }
+    if (nsites > capacity) continue;
+    s.running = h->running != 0;
+    s.generation = h->generation;
+    s.popsize = h->popsize;
+    s.ploidy = h->ploidy;
+    s.updates = h->updates;
+    s.phenotype_mean = h->phenotype_mean;
+    s.phenotype_variance = h->phenotype_variance;
+    s.ids.assign(live_ids(base, capacity), live_ids(base, capacity) + nsites);
+    s.counts.assign(live_counts(base, capacity), live_counts(base, capacity) + nsites);
+    s.effects.assign(live_effects(base, capacity), live_effects(base, capacity) + nsites);
+    s.visits.assign(live_visits(base, capacity), live_visits(base, capacity) + nvisits);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (h->sequence.load(std::memory_order_relaxed) == seq) return true;
+  }
+  return false;
+}
+
+/* END */
@@ -0,0 +1,110 @@
+#ifndef __LIVE_H__
+#define __LIVE_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/* A running simulation can publish a snapshot of its state to a POSIX
+ * shared memory segment (--publish=<name>), which other processes on the
+ * same host map and read without the simulation writing any more output or
+ * waiting for them. The segment is a header followed by the arrays:
+ *
+ *   LiveHeader
+ *   uint32 id[capacity]
+ *   int32  count[capacity]       (derived allele counts)
+ *   double effect[capacity]
+ *   int32  visits[nvisits]       (the visits histogram, if being collected)
+ *
+ * of which the first nsites entries of each site array are in use. Updates
+ * are guarded by a sequence lock: the sequence number is odd while the
+ * publisher is writing, and a reader copies what it needs and then checks
+ * that the sequence number was even and hasn't changed, trying again if
+ * it has. The publisher never waits for readers. When more sites are
+ * needed, the segment is grown and capacity changed (under the lock), so
+ * readers must remap when capacity isn't what they mapped. */
+
+#define LIVE_VERSION 1
+
+struct LiveHeader {
+  char magic[4];
+  uint32_t version;
+  std::atomic<uint64_t> sequence;
+  uint32_t popsize;
+  uint32_t ploidy;
+  uint32_t capacity;
+  uint32_t nvisits;
+  int32_t running;                /* 0 once the simulation has finished */
+  int32_t generation;
+  uint32_t nsites;
+  uint32_t updates;               /* snapshots published so far */
+  double phenotype_mean;
+  double phenotype_variance;
+};
+
+/* one consistent copy of the published state */
+struct LiveSnapshot {
+  bool running;
+  int generation;
+  int popsize, ploidy;
+  unsigned int updates;
+  double phenotype_mean;
+  double phenotype_variance;
+  std::vector<uint32_t> ids;
+  std::vector<int32_t> counts;
+  std::vector<double> effects;
+  std::vector<int32_t> visits;
+};
+
+/* Creates a segment and publishes snapshots to it */
+class LivePublisher {
+public:
+  LivePublisher(const std::string &name, int popsize, int ploidy, int nvisits);
+  ~LivePublisher();
+  void begin(int generation, double mean, double variance);
+  inline void add_site(uint32_t id, int32_t count, double effect) {
+    ids.push_back(id);
+    counts.push_back(count);
+    effects.push_back(effect);
+  }
+  void end(const std::vector<int> &visits);
+  void close(void);
+
+private:
+  void map_segment(uint32_t capacity);
+
+  std::string name;
+  int fd;
+  char *base;
+  size_t size;
+  LiveHeader *header;
+  int generation;
+  double mean, variance;
+
+  /* the snapshot being put together, copied in under the lock */
+  std::vector<uint32_t> ids;
+  std::vector<int32_t> counts;
+  std::vector<double> effects;
+};
+
+/* Maps a published segment and takes snapshots of it */
+class LiveReader {
+public:
+  LiveReader(const std::string &name);
+  ~LiveReader();
+  bool snapshot(LiveSnapshot &s, int attempts = 1000);
+
+private:
+  void remap(void);
+
+  std::string name;
+  int fd;
+  const char *base;
+  size_t size;
+};
+
+/* the size of a segment with the given capacity */
+size_t live_segment_size(uint32_t capacity, uint32_t nvisits);
+
+#endif /* __LIVE_H__ */
@@ -0,0 +1,370 @@
+#include <math.h>
+#include <vector>
+#include <map>
+
+#include "lockstep.h"
+#include "site.h"
+#include "error_handling.h"
+#include "statistic.h"
+#include "output.h"
+
+using std::vector;
+using std::map;
+
+/* set up the lanes from the command line arguments */
+template <int L>
+Lockstep<L>::Lockstep(Args &a) : ar(a) {
+  if (ar.sites_model != finite_sites)
+    throw SimUsageError("lockstep engine only supports the finite sites model");
+
+  popsize = ar.popsize;
+  nloci = ar.nloci;
+  mu = ar.mu;
+  sig = 2.0/ar.s;
+  env = ar.env;
+  optimum = ar.opts[0];
+  generation = 0;
+
+  /* like quant, genotypes are 0,1,2 on top of an all-ancestral baseline */
+  baseline = 0;
+  for (int i=0; i < (int)ar.loci_counts.size(); i++) {
+    for (int j=0; j < ar.loci_counts[i]; j++) {
+      effects.push_back(ar.effect_sizes[i]);
+      baseline -= ar.effect_sizes[i];
+    }
+  }
+
+  parents.assign((size_t)popsize*nloci*L, 0);
+  offspring.assign((size_t)popsize*nloci*L, 0);
+  phenotype.assign((size_t)popsize*L, 0);
+  fitness.assign((size_t)popsize*L, 0);
+  offspring_phenotype.assign((size_t)popsize*L, 0);
+  offspring_fitness.assign((size_t)popsize*L, 0);
+  counts.assign((size_t)nloci*L, 0);
+
+  /* lane r uses stream 2r for segregation and 2r+1 for everything else */
+  for (int r=0; r < L; r++) {
+    RandStream seg(ar.rand_seed, 2*r);
+    seg_state[r] = seg.x;
+    rng[r].reseed(ar.rand_seed, 2*r+1);
+    mutation_count[r] = 0;
+    phenotype_var_sum[r] = 0;
+  }
+  phenotype_var_count = 0;
+  if (Statistic::is_activated(STAT_VISITS))
+    visits.assign((size_t)(2*popsize-1)*L, 0);
+}
+
+/* Scatter the initial frequencies into genotypes under Hardy-Weinberg, as
+ * Population::setup_initial_genotypes does, independently in each lane */
+template <int L>
+void Lockstep<L>::setup_initial_genotypes(void) {
+  vector<int> hets(nloci), homs(nloci);
+  double f;
+  int loc = 0;
+  while (1) {
+    f = ar.get_initial_frequency();
+    if (f < 0 || loc == nloci) break;
+    hets[loc] = (int)round(2.0*f*(1.0-f)*popsize);
+    homs[loc] = (int)round(f*f*popsize);
+    loc++;
+  }
+  if (!(f < 0 && loc == nloci))
+    throw SimError(0, "incorrect number of frequencies. Expecting %d.", nloci);
+
+  vector<int> order(popsize);
+  for (int r=0; r < L; r++) {
+    for (int l=0; l < nloci; l++) {
+      /* random order of individuals for this lane and locus */
+      for (int i=0; i < popsize; i++) order[i] = i;
+      for (int i=popsize-1; i > 0; i--) {
+        int j = (int)(rng[r].uniform()*(i+1));
+        int tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+      }
+      int ind;
+      for (ind=0; ind < hets[l]; ind++)
+        parents[((size_t)order[ind]*nloci + l)*L + r] = heterozygote;
+      for (; ind < hets[l]+homs[l]; ind++)
+        parents[((size_t)order[ind]*nloci + l)*L + r] = homozygote_derived;
+    }
+  }
+
+  for (int r=0; r < L; r++) max_fitness[r] = 0;
+  for (int i=0; i < popsize; i++) update_individual(parents, i, phenotype, fitness);
+}
+
+/* Compute the phenotype and fitness of individual ind in all lanes from the
+ * genotypes in g, storing them in phen and fit. The loops over loci and lanes
+ * vectorize across lanes. */
+template <int L>
+void Lockstep<L>::update_individual(const vector<unsigned char> &g, int ind,
+    vector<double> &phen, vector<double> &fit) {
+  double ph[L];
+  const unsigned char *geno = &g[(size_t)ind*nloci*L];
+  for (int r=0; r < L; r++) ph[r] = baseline;
+  for (int l=0; l < nloci; l++) {
+    double e = effects[l];
+    const unsigned char *gl = geno + (size_t)l*L;
+    for (int r=0; r < L; r++) ph[r] += gl[r]*e;
+  }
+  if (env != 0) {
+    for (int r=0; r < L; r++) ph[r] += rng[r].uniform()*env;
+  }
+
+  double *p = &phen[(size_t)ind*L];
+  double *w = &fit[(size_t)ind*L];
+  for (int r=0; r < L; r++) {
+    p[r] = ph[r];
+    w[r] = exp( -(ph[r]-optimum)*(ph[r]-optimum)/sig );
+    max_fitness[r] = w[r] > max_fitness[r] ? w[r] : max_fitness[r];
+  }
+}
+
+/* Create the offspring generation from the parents. Each offspring is made in
+ * all lanes at once: parents are chosen lane-by-lane, and then segregation at
+ * each locus is done for all lanes together. */
+template <int L>
+void Lockstep<L>::populate_offspring(void) {
+  double parent_max[L];
+  for (int r=0; r < L; r++) {
+    parent_max[r] = max_fitness[r];
+    max_fitness[r] = 0;
+  }
+
+  int mom[L], dad[L];
+  for (int off=0; off < popsize; off++) {
+    /* choose parents according to their fitness by rejection sampling */
+    for (int r=0; r < L; r++) {
+      while (1) {
+        mom[r] = (int)(popsize*rng[r].uniform());
+        if (rng[r].uniform()*parent_max[r] <= fitness[(size_t)mom[r]*L + r]) break;
+      }
+      while (1) {
+        dad[r] = (int)(popsize*rng[r].uniform());
+        if (rng[r].uniform()*parent_max[r] <= fitness[(size_t)dad[r]*L + r]) break;
+      }
+    }
+
+    /* Segregation. A parent transmits a derived allele with probability g/2,
+     * which with 48-bit uniforms x is x < g*2^47. The generator is stepped
+     * directly here, so that this loop is all integer operations across lanes */
+    unsigned char *child = &offspring[(size_t)off*nloci*L];
+    for (int l=0; l < nloci; l++) {
+      unsigned char *c = child + (size_t)l*L;
+      for (int r=0; r < L; r++) {
+        unsigned long long x1 = (RandStream::RAND48_A*seg_state[r] + RandStream::RAND48_C) & RandStream::RAND48_MASK;
+        unsigned long long x2 = (RandStream::RAND48_A*x1 + RandStream::RAND48_C) & RandStream::RAND48_MASK;
+        seg_state[r] = x2;
+        unsigned long long gm = parents[((size_t)mom[r]*nloci + l)*L + r];
+        unsigned long long gd = parents[((size_t)dad[r]*nloci + l)*L + r];
+        c[r] = (unsigned char)((x1 < (gm << 47)) + (x2 < (gd << 47)));
+      }
+    }
+
+    for (int r=0; r < L; r++) mutate(off, r);
+    update_individual(offspring, off, offspring_phenotype, offspring_fitness);
+  }
+  parents.swap(offspring);
+  phenotype.swap(offspring_phenotype);
+  fitness.swap(offspring_fitness);
+}
+
+/* Draw a poisson number of mutations for the newly created individual ind in
+ * lane r, following the rules in GenomeFiniteSites::mutate_site */
+template <int L>
+void Lockstep<L>::mutate(int ind, int r) {
+  int num_muts = rng[r].poisson(2.0*mu);
+  for (int m=0; m < num_muts; m++) {
+    int l = (int)floor(rng[r].uniform()*nloci);
+    unsigned char &g = offspring[((size_t)ind*nloci + l)*L + r];
+    switch (g) {
+      case homozygote_ancestral:
+        g = heterozygote;
+        break;
+      case heterozygote:
+        g = rng[r].uniform() < 0.5 ? homozygote_ancestral : homozygote_derived;
+        break;
+      default:
+        g = heterozygote;
+    }
+  }
+  mutation_count[r] += num_muts;
+}
+
+/* count derived alleles at each locus in each lane of the parents */
+template <int L>
+void Lockstep<L>::count_alleles(void) {
+  for (size_t k=0; k < counts.size(); k++) counts[k] = 0;
+  for (int i=0; i < popsize; i++) {
+    const unsigned char *g = &parents[(size_t)i*nloci*L];
+    for (size_t k=0; k < (size_t)nloci*L; k++) counts[k] += g[k];
+  }
+}
+
+/* mean and variance of the phenotype, in each lane */
+template <int L>
+void Lockstep<L>::compute_phenotype_moments(void) {
+  double sum[L], sumsq[L];
+  for (int r=0; r < L; r++) sum[r] = sumsq[r] = 0;
+  for (int i=0; i < popsize; i++) {
+    const double *p = &phenotype[(size_t)i*L];
+    for (int r=0; r < L; r++) {
+      sum[r] += p[r];
+      sumsq[r] += p[r]*p[r];
+    }
+  }
+  for (int r=0; r < L; r++) {
+    phenotype_mean[r] = sum[r]/popsize;
+    phenotype_variance[r] = sumsq[r]/popsize - phenotype_mean[r]*phenotype_mean[r];
+  }
+}
+
+/* print the frequencies of each locus that isn't fixed, per lane */
+template <int L>
+void Lockstep<L>::stat_frequency_summary(void) {
+  if (!Statistic::is_activated(STAT_FREQUENCIES)) return;
+  for (int r=0; r < L; r++) {
+    out << "rep: " << r << " gen: " << generation << " freqs:";
+    for (int l=0; l < nloci; l++) {
+      double f = counts[(size_t)l*L + r] / (2.0*popsize);
+      if (f < 1.0)
+        out << " " << l << ":" << f;
+    }
+    out << '\n';
+  }
+}
+
+/* print the phenotype mean and variance, per lane */
+template <int L>
+void Lockstep<L>::stat_phenotype_summary(void) {
+  if (!Statistic::is_activated(STAT_PHENOTYPE)) return;
+  for (int r=0; r < L; r++)
+    out << "rep: " << r << " gen: " << generation << " pheno: " << phenotype_mean[r]
+      << " " << phenotype_variance[r] << '\n';
+}
+
+/* accumulate the phenotype variance for phenotype-var-mean */
+template <int L>
+void Lockstep<L>::stat_update_phenotype_var_mean(void) {
+  if (!Statistic::is_activated(STAT_PHENOTYPE_VAR_MEAN)) return;
+  for (int r=0; r < L; r++) phenotype_var_sum[r] += phenotype_variance[r];
+  phenotype_var_count++;
+}
+
+/* count one visit for each segregating locus, per lane */
+template <int L>
+void Lockstep<L>::stat_increment_visits(void) {
+  if (!Statistic::is_activated(STAT_VISITS)) return;
+  for (size_t k=0; k < counts.size(); k++) {
+    int c = counts[k];
+    if (c > 0 && c < 2*popsize)
+      visits[(size_t)(c-1)*L + k%L]++;
+  }
+}
+
+/* Print the number of sites of each effect size, per lane. As in
+ * Population::count_segregating(), every site still tracked counts, and in
+ * the finite sites model that's every locus, so it's the same in each lane */
+template <int L>
+void Lockstep<L>::stat_segsites(void) {
+  if (!Statistic::is_activated(STAT_SEGSITES)) return;
+  map<double,int> segsites;
+  for (int l=0; l < nloci; l++) segsites[effects[l]]++;
+  for (int r=0; r < L; r++) {
+    out << "rep: " << r << " gen: " << generation << " segsites:";
+    for (map<double,int>::iterator i=segsites.begin(); i != segsites.end(); i++)
+      out << " " << i->first << "," << i->second;
+    out << '\n';
+  }
+}
+
+template <int L>
+void Lockstep<L>::stat_print_visits(void) {
+  if (!Statistic::is_activated(STAT_VISITS)) return;
+  for (int r=0; r < L; r++) {
+    out << "rep: " << r << " visits:";
+    for (int c=0; c < 2*popsize-1; c++)
+      out << " " << visits[(size_t)c*L + r];
+    out << '\n';
+  }
+}
+
+template <int L>
+void Lockstep<L>::stat_print_phenotype_var_mean(void) {
+  if (!Statistic::is_activated(STAT_PHENOTYPE_VAR_MEAN)) return;
+  for (int r=0; r < L; r++)
+    out << "rep: " << r << " gen: " << generation << " phenotype_var_mean: "
+      << phenotype_var_sum[r]/phenotype_var_count << '\n';
+}
+
+/* Run all the epochs. The bookkeeping of burnin and generations follows the
+ * main loop in quant.cpp. */
+template <int L>
+void Lockstep<L>::run(void) {
+  setup_initial_genotypes();
+
+  bool need_counts = Statistic::is_activated(STAT_FREQUENCIES) ||
+    Statistic::is_activated(STAT_VISITS) || Statistic::is_activated(STAT_SEGSITES);
+  bool need_moments = Statistic::is_activated(STAT_PHENOTYPE) ||
+    Statistic::is_activated(STAT_PHENOTYPE_VAR_MEAN);
+  int burnin = ar.burnin;
+
+  generation = 0;
+  for (int epoch=0; epoch < (int)ar.times.size(); epoch++) {
+    optimum = ar.opts[epoch];
+    while (generation < ar.times[epoch]) {
+      if (burnin <= 0) {
+        if (need_counts) count_alleles();
+        stat_frequency_summary();
+        stat_increment_visits();
+        stat_segsites();
+        if (need_moments) compute_phenotype_moments();
+        stat_phenotype_summary();
+        stat_update_phenotype_var_mean();
+      }
+
+      populate_offspring();
+
+      if (burnin == 0 && generation == 0 && Statistic::is_activated(STAT_BURNIN))
+        out << "end burnin" << '\n';
+      out.end_generation(generation);
+      if (burnin <= 0) {
+        generation++;
+      } else {
+        burnin--;
+      }
+    }
+  }
+
+  /* print the final state */
+  if (need_counts) count_alleles();
+  stat_frequency_summary();
+  if (need_moments) compute_phenotype_moments();
+  stat_phenotype_summary();
+  stat_segsites();
+  stat_print_visits();
+  stat_update_phenotype_var_mean();
+  stat_print_phenotype_var_mean();
+  if (Statistic::is_activated(STAT_MUTATION)) {
+    for (int r=0; r < L; r++)
+      out << "rep: " << r << " mutations: " << mutation_count[r] << '\n';
+  }
+}
+
+/* only these lane counts are instantiated */
+template class Lockstep<8>;
+template class Lockstep<16>;
+
+void run_lockstep(Args &ar) {
+  if (ar.lanes == 8) {
+    Lockstep<8> engine(ar);
+    engine.run();
+  } else if (ar.lanes == 16) {
+    Lockstep<16> engine(ar);
+    engine.run();
+  } else {
+    throw SimUsageError("lockstep engine supports 8 or 16 lanes");
+  }
+}
+
+/* END */
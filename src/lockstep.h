@@ -0,0 +1,92 @@
+#ifndef __LOCKSTEP_H__
+#define __LOCKSTEP_H__
+
+#include <vector>
+
+#include "command_line.h"
+#include "sim_rand.h"
+
+/* The Lockstep engine simulates L independent replicates of the finite sites
+ * model side by side. A single replicate of a small population (N of a few
+ * hundred or thousand) is too small to keep the vector units busy, so instead
+ * every per-individual and per-locus value is stored interleaved by replicate,
+ * with the replicate index varying fastest:
+ *
+ *   genotype of individual i at locus l in replicate r: g[(i*nloci + l)*L + r]
+ *   phenotype/fitness of individual i in replicate r:   p[i*L + r]
+ *   derived allele count at locus l in replicate r:     c[l*L + r]
+ *
+ * so the phenotype, fitness, segregation and allele counting loops have an
+ * inner loop over the L replicates that the compiler turns into vector
+ * instructions. Each replicate ("lane") draws from its own RandStream, so the
+ * lanes are statistically independent, and each lane's statistics are printed
+ * separately, prefixed by "rep: <lane>". Only the parent choice (rejection
+ * sampling, whose number of iterations differs between lanes) and mutation are
+ * done lane-by-lane.
+ *
+ * The model is the same as the finite sites model of Population and
+ * GenomeFiniteSites: diploid, genotypes 0/1/2 on top of the all-ancestral
+ * baseline, Gaussian fitness around the optimum, and mutations that move a
+ * genotype one step with the same rules as GenomeFiniteSites::mutate_site. */
+template <int L>
+class Lockstep {
+public:
+  Lockstep(Args &ar);
+  ~Lockstep() { }
+  void run(void);
+
+private:
+  void setup_initial_genotypes(void);
+  void update_individual(const std::vector<unsigned char> &g, int ind,
+    std::vector<double> &ph, std::vector<double> &w);
+  void populate_offspring(void);
+  void mutate(int ind, int lane);
+  void count_alleles(void);
+  void compute_phenotype_moments(void);
+  void stat_frequency_summary(void);
+  void stat_phenotype_summary(void);
+  void stat_update_phenotype_var_mean(void);
+  void stat_increment_visits(void);
+  void stat_segsites(void);
+  void stat_print_visits(void);
+  void stat_print_phenotype_var_mean(void);
+
+  Args &ar;
+  int popsize;
+  int nloci;
+  int generation;
+  double mu;
+  double sig;
+  double env;
+  double optimum;
+  double baseline;
+  std::vector<double> effects;          /* effect size of each locus */
+
+  /* interleaved storage, see above */
+  std::vector<unsigned char> parents;
+  std::vector<unsigned char> offspring;
+  std::vector<double> phenotype;
+  std::vector<double> fitness;
+  std::vector<double> offspring_phenotype;
+  std::vector<double> offspring_fitness;
+  std::vector<int> counts;
+  double max_fitness[L];
+  double phenotype_mean[L];
+  double phenotype_variance[L];
+
+  /* one random number stream per lane, plus a second per lane for
+   * segregation whose state is kept in a plain array so it vectorizes */
+  RandStream rng[L];
+  unsigned long long seg_state[L];
+
+  /* accumulated statistics, per lane */
+  std::vector<long> visits;             /* visits[c*L + r] */
+  double phenotype_var_sum[L];
+  int phenotype_var_count;
+  int mutation_count[L];
+};
+
+/* run the engine for the given number of lanes (8 or 16) */
+void run_lockstep(Args &ar);
+
+#endif /* __LOCKSTEP_H__ */
@@ -0,0 +1,38 @@
+#include "moments.h"
+#include "error_handling.h"
+
+/* Constructor. All the accumulators start out empty */
+Moments::Moments(int size) : n(size, 0.0), mu(size, 0.0), m2(size, 0.0) {
+  if (size < 0) throw SimError("cannot have a negative number of moments");
+}
+
+/* add k samples, sample j going to accumulator bins[j] */
+void
+Moments::post(const int *bins, const double *x, int k) {
+  int size = mu.size();
+  for (int j=0; j < k; j++) {
+    if (bins[j] < 0 || bins[j] >= size) throw SimError("index exceeds size of Moments instance");
+    post(bins[j], x[j]);
+  }
+}
+
+/* Combine another set's samples into this one, accumulator by accumulator.
+ * No division depends on the one before, so this vectorizes */
+void
+Moments::merge(const Moments &other) {
+  int size = mu.size();
+  if (other.size() != size) throw SimError("can only merge moments of the same size");
+  if (size == 0) return;
+  double *pn = &n[0], *pmu = &mu[0], *pm2 = &m2[0];
+  const double *on = &other.n[0], *omu = &other.mu[0], *om2 = &other.m2[0];
+  for (int i=0; i < size; i++) {
+    double c = pn[i] + on[i];
+    double d = omu[i] - pmu[i];
+    double w = c > 0 ? on[i] / c : 0.0;
+    pmu[i] += d * w;
+    pm2[i] += om2[i] + d * d * pn[i] * w;
+    pn[i] = c;
+  }
+}
+
+/* END */
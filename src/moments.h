@@ -0,0 +1,47 @@
+#ifndef __MOMENTS_H__
+#define __MOMENTS_H__
+
+#include <vector>
+
+/* A set of running means and variances, kept with Welford's updates, which
+ * don't accumulate the rounding error of recomputing the mean from its sum
+ * at every sample. Each of the size() accumulators is a count, a mean and
+ * M2, the sum of squared deviations from the mean, stored as three arrays
+ * (structure of arrays), so merging two sets runs down each array in turn.
+ *
+ * Merging (Chan et al.'s pairwise update) gives the moments of the
+ * combined samples, to rounding, whatever order the samples came in. So
+ * sets collected separately, on different threads, replicates or either
+ * side of a checkpoint, can be combined. */
+class Moments {
+public:
+  Moments(int size);
+  ~Moments() { }
+
+  /* add a sample to accumulator i */
+  void post(int i, double x) {
+    double c = ++n[i];
+    double d = x - mu[i];
+    mu[i] += d / c;
+    m2[i] += d * (x - mu[i]);
+  }
+  void post(double x) { post(0, x); }
+  void post(const int *bins, const double *x, int k);
+  void merge(const Moments &other);
+
+  int size(void) const { return mu.size(); }
+  int count(int i) const { return (int)n[i]; }
+  double mean(int i) const { return mu[i]; }
+  double variance(int i) const { return n[i] > 0 ? m2[i] / n[i] : 0.0; }
+  double raw_second(int i) const { return variance(i) + mu[i]*mu[i]; }
+
+  friend class Checkpoint;
+  friend class BatchMeans;
+
+private:
+  std::vector<double> n;     /* samples in each accumulator */
+  std::vector<double> mu;    /* their means */
+  std::vector<double> m2;    /* and sums of squared deviations from the mean */
+};
+
+#endif /* __MOMENTS_H__ */
@@ -0,0 +1,254 @@
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <charconv>
+
+#include "output.h"
+#include "error_handling.h"
+
+using std::string;
+using std::mutex;
+using std::unique_lock;
+using std::lock_guard;
+
+OutputBuffer out(true);
+
+AsyncWriter::AsyncWriter(size_t cap) : capacity(cap), gzip(false), running(false),
+    stopping(false), index(NULL), tee(NULL), offset(0), gz(NULL) {
+}
+
+AsyncWriter::~AsyncWriter() {
+  try { finish(); } catch (SimError &e) { }
+}
+
+/* Queue a buffer for writing. Its contents are taken, leaving buf empty.
+ * The writer thread is started with the first buffer */
+void
+AsyncWriter::submit(string &buf, int first, int last) {
+  unique_lock<mutex> guard(lock);
+  if (!running) {
+    if (!index_path.empty()) {
+      /* blocks are compressed one by one, and their offsets recorded */
+      if (index == NULL) {
+        index = fopen(index_path.c_str(), "w");
+        if (index == NULL) throw SimError(0, "failed to open index file %s", index_path.c_str());
+        fprintf(index, "# first_gen last_gen offset bytes%s\n", gzip ? " gzip" : "");
+        offset = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+        if (offset < 0) throw SimError("an index needs output redirected to a file");
+      }
+    } else if (gzip) {
+      gz = gzdopen(dup(STDOUT_FILENO), "wb");
+      if (gz == NULL) throw SimError("failed to open compressed output");
+    }
+    running = true;
+    stopping = false;
+    worker = std::thread(&AsyncWriter::run, this);
+  }
+  while (queue.size() >= capacity) not_full.wait(guard);
+  queue.push_back(OutputBlock());
+  queue.back().text.swap(buf);
+  queue.back().first = first;
+  queue.back().last = last;
+  queue.back().tee = tee;
+  not_empty.notify_one();
+}
+
+/* write everything that's been queued, and stop the writer thread. A later
+ * submit() starts it again, so this is also used to get stdout into a
+ * consistent state before forking */
+void
+AsyncWriter::finish(void) {
+  {
+    lock_guard<mutex> guard(lock);
+    if (!running) return;
+    stopping = true;
+    not_empty.notify_one();
+  }
+  worker.join();
+  running = false;
+  if (index != NULL) {
+    int err = fclose(index);
+    index = NULL;
+    if (err != 0) throw SimError(0, "failed to write index file %s", index_path.c_str());
+  }
+  if (gz != NULL) {
+    int err = gzclose(gz);
+    gz = NULL;
+    if (err != Z_OK) throw SimError("failed to finish compressed output");
+  }
+}
+
+/* the writer thread: take buffers off the queue until told to stop */
+void
+AsyncWriter::run(void) {
+  while (1) {
+    OutputBlock block;
+    {
+      unique_lock<mutex> guard(lock);
+      while (queue.empty() && !stopping) not_empty.wait(guard);
+      if (queue.empty()) return;
+      block.text.swap(queue.front().text);
+      block.first = queue.front().first;
+      block.last = queue.front().last;
+      block.tee = queue.front().tee;
+      queue.pop_front();
+      not_full.notify_one();
+    }
+    write_out(block);
+  }
+}
+
+/* write a block to stdout, and index it */
+void
+AsyncWriter::write_out(const OutputBlock &block) {
+  if (block.tee != NULL && !block.text.empty())
+    fwrite(block.text.data(), 1, block.text.size(), block.tee);
+  if (gz != NULL) {
+    if (!block.text.empty()) gzwrite(gz, block.text.data(), block.text.size());
+    return;
+  }
+  if (index == NULL) {
+    write_bytes(block.text.data(), block.text.size());
+    return;
+  }
+  off_t start = offset;
+  if (gzip) {
+    compress_block(block.text);
+    write_bytes(compressed.data(), compressed.size());
+  } else {
+    write_bytes(block.text.data(), block.text.size());
+  }
+  fprintf(index, "%d %d %lld %lld\n", block.first, block.last, (long long)start,
+    (long long)(offset - start));
+}
+
+/* Write bytes to stdout. There's no one to report an error to on this
+ * thread, so output is abandoned, as it would be by cout */
+void
+AsyncWriter::write_bytes(const char *p, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = write(STDOUT_FILENO, p + done, size - done);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    done += n;
+  }
+  offset += done;
+}
+
+/* compress text into a complete gzip member */
+void
+AsyncWriter::compress_block(const string &text) {
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  /* 15 window bits, plus 16 for a gzip header and trailer */
+  if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15+16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    compressed.clear();
+    return;
+  }
+  compressed.resize(deflateBound(&z, text.size()) + 32);
+  z.next_in = (Bytef *)text.data();
+  z.avail_in = text.size();
+  z.next_out = (Bytef *)&compressed[0];
+  z.avail_out = compressed.size();
+  deflate(&z, Z_FINISH);
+  compressed.resize(compressed.size() - z.avail_out);
+  deflateEnd(&z);
+}
+
+OutputBuffer::~OutputBuffer() {
+  if (!to_stdout) return;
+  try { finish(); } catch (SimError &e) { }
+}
+
+/* integer and floating point formatting, without the locale */
+template<class T> static inline void format_integer(string &buf, T x) {
+  char tmp[24];
+  std::to_chars_result r = std::to_chars(tmp, tmp+sizeof(tmp), x);
+  buf.append(tmp, r.ptr - tmp);
+}
+
+OutputBuffer& OutputBuffer::operator<<(int x) { format_integer(buf, x); return *this; }
+OutputBuffer& OutputBuffer::operator<<(unsigned int x) { format_integer(buf, x); return *this; }
+OutputBuffer& OutputBuffer::operator<<(long x) { format_integer(buf, x); return *this; }
+OutputBuffer& OutputBuffer::operator<<(unsigned long x) { format_integer(buf, x); return *this; }
+
+OutputBuffer&
+OutputBuffer::operator<<(double x) {
+  format(buf, x);
+  return *this;
+}
+
+void
+OutputBuffer::format(string &s, unsigned int x) const {
+  format_integer(s, x);
+}
+
+void
+OutputBuffer::format(string &s, double x) const {
+  char tmp[64];
+  std::to_chars_result r = std::to_chars(tmp, tmp+sizeof(tmp), x, std::chars_format::general, digits);
+  s.append(tmp, r.ptr - tmp);
+}
+
+/* write to an index, in blocks of the given number of generations */
+void
+OutputBuffer::set_index(const string &path, int generations) {
+  writer.set_index(path);
+  block_generations = generations;
+}
+
+/* The end of a generation's output. This is handed to the writer, either
+ * now, or once the block is full */
+void
+OutputBuffer::end_generation(int gen) {
+  if (block_first < 0) block_first = gen;
+  block_last = gen;
+  if (++block_count >= block_generations) end_block();
+}
+
+/* copy everything handed to the writer from now on to f as well, or stop
+ * copying if f is NULL. The buffer so far goes in a block of its own, so
+ * the copy starts exactly here */
+void
+OutputBuffer::set_tee(FILE *f) {
+  end_block();
+  writer.set_tee(f);
+}
+
+/* hand what's been buffered to the writer as a block */
+void
+OutputBuffer::end_block(void) {
+  if (!to_stdout) return;
+  submitted += buf.size();
+  if (!buf.empty()) writer.submit(buf, block_first, block_last);
+  block_first = block_last = -1;
+  block_count = 0;
+}
+
+/* write out anything buffered, and wait for it to be written */
+void
+OutputBuffer::finish(void) {
+  end_block();
+  writer.finish();
+}
+
+/* read a whole line, however long, without the newline */
+bool
+read_line(gzFile in, string &line) {
+  char buf[65536];
+  line.clear();
+  while (gzgets(in, buf, sizeof(buf)) != NULL) {
+    size_t n = strlen(buf);
+    if (n > 0 && buf[n-1] == '\n') {
+      line.append(buf, n-1);
+      return true;
+    }
+    line.append(buf, n);
+  }
+  return !line.empty();
+}
+
+/* END */
@@ -0,0 +1,136 @@
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
+#include <zlib.h>
+
+/* a buffer of output, the range of generations it covers (-1 if none), and
+ * where else it's to be copied, if anywhere */
+struct OutputBlock {
+  std::string text;
+  int first, last;
+  FILE *tee;
+};
+
+/* Writes buffers to standard output on a background thread, optionally
+ * gzip compressed. Buffers are handed over through a bounded queue, so the
+ * simulation only waits if it gets more than a queue's worth of buffers
+ * ahead of the disk.
+ *
+ * With an index, each buffer is a block of generations. When compressing,
+ * each block is its own gzip member (so the whole output is still one
+ * valid gzip file), and a line
+ *
+ *   <first generation> <last generation> <offset> <bytes>
+ *
+ * is added to the index file for each block, giving where in the output
+ * the block can be found and decompressed on its own. The qextract tool
+ * uses the index to pull out a range of generations.
+ *
+ * Blocks can also be copied, uncompressed, to a tee file (used by the run
+ * cache). The tee applies to the blocks submitted while it is set. */
+class AsyncWriter {
+public:
+  AsyncWriter(size_t capacity = 64);
+  ~AsyncWriter();
+  void submit(std::string &buf, int first = -1, int last = -1);
+  void finish(void);
+  void set_gzip(bool z) { gzip = z; }
+  void set_index(const std::string &path) { index_path = path; }
+  void set_tee(FILE *f) { tee = f; }
+
+private:
+  void run(void);
+  void write_out(const OutputBlock &block);
+  void write_bytes(const char *p, size_t n);
+  void compress_block(const std::string &text);
+
+  size_t capacity;
+  bool gzip;
+  bool running;
+  bool stopping;
+  std::string index_path;
+  FILE *index;
+  FILE *tee;
+  off_t offset;                          /* bytes written to stdout so far */
+  std::string compressed;
+  std::deque<OutputBlock> queue;
+  std::mutex lock;
+  std::condition_variable not_empty, not_full;
+  std::thread worker;
+  gzFile gz;
+};
+
+/* The simulation's statistics are written into an OutputBuffer rather than
+ * to cout. Numbers are formatted with std::to_chars, which doesn't consult
+ * the locale, but gives the same text as an ostream with the same precision
+ * (6 significant digits by default). Lines end with '\n', and nothing is
+ * written until the buffer is handed to the writer by end_generation(),
+ * which happens every generation, or, with an index, once every
+ * block_generations generations.
+ *
+ * Only the global out writes to standard output. Any other buffer just
+ * formats: its text stays in the buffer, to be read with str(). */
+class OutputBuffer {
+public:
+  OutputBuffer(bool stdout_writer = false) : digits(6), submitted(0), to_stdout(stdout_writer),
+    block_generations(1), block_first(-1), block_last(-1), block_count(0) { }
+  ~OutputBuffer();
+
+  OutputBuffer& operator<<(const char *s) { buf.append(s); return *this; }
+  OutputBuffer& operator<<(const std::string &s) { buf.append(s); return *this; }
+  OutputBuffer& operator<<(char c) { buf.push_back(c); return *this; }
+  OutputBuffer& operator<<(int x);
+  OutputBuffer& operator<<(unsigned int x);
+  OutputBuffer& operator<<(long x);
+  OutputBuffer& operator<<(unsigned long x);
+  OutputBuffer& operator<<(double x);
+
+  /* append x to s as it would be written here */
+  void format(std::string &s, double x) const;
+  void format(std::string &s, unsigned int x) const;
+
+  /* significant digits used for doubles, as with ostream::precision() */
+  int precision(void) const { return digits; }
+  int precision(int p) { int old = digits; digits = p; return old; }
+
+  /* what's been formatted but not yet handed to the writer */
+  const std::string& str(void) const { return buf; }
+  void clear(void) { buf.clear(); }
+
+  void end_generation(int gen = -1);
+  void end_block(void);
+  void finish(void);
+  void set_gzip(bool z) { writer.set_gzip(z); }
+  void set_index(const std::string &path, int generations);
+  void set_tee(FILE *f);
+
+  /* bytes handed to the writer so far (before any compression) */
+  size_t written(void) const { return submitted; }
+
+private:
+  std::string buf;
+  int digits;
+  size_t submitted;
+  bool to_stdout;
+  AsyncWriter writer;
+
+  /* the block being accumulated */
+  int block_generations;
+  int block_first, block_last;
+  int block_count;
+};
+
+/* all statistics go through this buffer */
+extern OutputBuffer out;
+
+/* Read a line of quant's output, compressed or not (gzopen() reads either),
+ * without the newline. Used by the tools that read quant's output */
+bool read_line(gzFile in, std::string &line);
+
+#endif /* __OUTPUT_H__ */
@@ -1,21 +1,28 @@
+#include <math.h>
+#include <string.h>
 #include <vector>
 #include <valarray>
 #include <queue>
 #include <iostream>
+#include <algorithm>
+#include <new>
+#include <string>
 
 #include "population.h"
 #include "genome.h"
 #include "error_handling.h"
 #include "sim_rand.h"
 #include "statistic.h"
+#include "output.h"
 
 using std::valarray;
-using std::cout;
 using std::endl;
 using std::ostream;
 using std::vector;
 using std::queue;
 using std::map;
+using std::string;
+using std::pair;
 
 /* storage for class variables */
 int Population::num_loci = 0;
@@ -29,9 +36,180 @@ int Population::generation = 0;
 /* static storage used by population-level statistics */
 map<double,int> Population::fixations;
 vector<int> Population::visits;
-RunningMean *Population::delta_p_first_moment;
-RunningMean *Population::delta_p_second_moment;
-RunningMean *Population::phenotype_var_mean;
+vector<int> Population::delta_counts;
+vector<mutation_id> Population::delta_ids;
+int Population::delta_generations = 0;
+int Population::keyframe_every = 1000;
+Moments *Population::delta_p_moments;
+Moments *Population::phenotype_var_mean;
+vector<int> Population::site_class;
+vector<int> Population::class_sites;
+vector<int> Population::class_since;
+int Population::visit_samples = 0;
+bool Population::segregating_live = false;
+map<double,int> Population::segregating;
+vector<int> Population::freq_text_at;
+string Population::freq_text;
+vector<string> Population::freq_blocks;
+vector<char> Population::freq_formatted;
+SiteChanges Population::visits_changes;
+SiteChanges Population::frequency_changes;
+valarray<double> Population::quantile_probs;
+int Population::quantile_every = 0;
+map<pair<int,double>, QuantileSketch> Population::sketches;
+BurninDetector *Population::burnin_detector = NULL;
+bool Population::converged = false;
+vector<int> Population::target_kinds;
+vector<double> Population::target_ses;
+vector<BatchMeans*> Population::target_means;
+vector<double> Population::target_sample;
+
+/* what the quantiles statistic's sketches summarize */
+enum { SKETCH_SOJOURN_LOSS, SKETCH_SOJOURN_FIXATION, SKETCH_SEGSITES, SKETCH_PHENOTYPE_VARIANCE };
+static const char *sketch_names[] = { "sojourn-loss", "sojourn-fixation", "segsites", "phenotype-variance" };
+
+/* what the convergence statistic's targets track: each generation's
+ * phenotype variance, its segregating sites, and its sites with each
+ * derived allele count (whose means are the visits statistic over the
+ * generations) */
+enum { TARGET_PHENOTYPE_VAR, TARGET_SEGSITES, TARGET_VISITS, NUM_TARGETS };
+static const char *target_names[] = { "phenotype-var", "segsites", "visits" };
+
+/* the least number of batches a target's standard error is taken from */
+#define TARGET_BATCHES 32
+
+/* sites in each block of the frequencies statistic's line, which is kept as
+ * text and formatted again only where sites have changed */
+#define FREQ_BLOCK 64
+
+/* The collectors of the built in statistics, which the simulation calls
+ * through Statistic's hooks. fst is collected by the island model, and
+ * burnin is printed by next_generation() itself */
+class FrequencyCollector : public StatCollector {
+public:
+  FrequencyCollector() : StatCollector(ON_GENERATION | ON_FINAL) { }
+  void on_generation(Population &pop) { pop.stat_frequency_summary(); }
+  void on_final(Population &pop) { pop.stat_frequency_summary(); }
+};
+
+class FrequencyDeltaCollector : public StatCollector {
+public:
+  FrequencyDeltaCollector() : StatCollector(ON_GENERATION | ON_FINAL) { }
+  void on_generation(Population &pop) { pop.stat_frequency_deltas(); }
+  void on_final(Population &pop) { pop.stat_frequency_deltas(); }
+};
+
+class VisitsCollector : public StatCollector {
+public:
+  VisitsCollector() : StatCollector(ON_GENERATION | ON_FINAL) { }
+  void on_generation(Population &pop) { pop.stat_increment_visits(); }
+  void on_final(Population &) { Population::stat_print_visits(); }
+};
+
+class FixationsCollector : public StatCollector {
+public:
+  FixationsCollector() : StatCollector(ON_GENERATION) { }
+  void on_generation(Population &pop) { pop.stat_fixations(); }
+};
+
+class SegsitesCollector : public StatCollector {
+public:
+  SegsitesCollector() : StatCollector(ON_GENERATION | ON_FINAL) { }
+  void on_generation(Population &pop) { pop.stat_segsites(); }
+  void on_final(Population &pop) { pop.stat_segsites(); }
+};
+
+/* the phenotype moments are computed before the hooks are called */
+class PhenotypeCollector : public StatCollector {
+public:
+  PhenotypeCollector() : StatCollector(ON_GENERATION | ON_FINAL) { }
+  void on_generation(Population &pop) { pop.stat_phenotype_summary(); }
+  void on_final(Population &pop) { pop.stat_phenotype_summary(); }
+};
+
+class PMomentsCollector : public StatCollector {
+public:
+  PMomentsCollector() : StatCollector(ON_OFFSPRING | ON_FINAL) { }
+  void on_offspring(Population &pop) { pop.stat_update_p_moments(); }
+  void on_final(Population &) { Population::stat_print_p_moments(); }
+};
+
+/* The final update makes it an average over g+1 generations, including the
+ * initial population and g offspring populations */
+class PhenotypeVarMeanCollector : public StatCollector {
+public:
+  PhenotypeVarMeanCollector() : StatCollector(ON_GENERATION | ON_FINAL) { }
+  void on_generation(Population &pop) { pop.stat_update_phenotype_var_mean(); }
+  void on_final(Population &pop) {
+    pop.stat_update_phenotype_var_mean();
+    pop.stat_print_phenotype_var_mean();
+  }
+};
+
+/* dump each site as it's created, so we have a record of its creation */
+class MutationCollector : public StatCollector {
+public:
+  MutationCollector() : StatCollector(ON_BIRTH | ON_FINAL) { }
+  void on_birth(Population &pop, mutation_loc loc) {
+    out << "gen: " << Population::generation << " site: id: " << pop.sites[loc].id
+      << " effect: " << pop.sites[loc].effect << '\n';
+  }
+  void on_final(Population &) { out << "mutations: " << Genome::mutation_count << '\n'; }
+};
+
+class SojournCollector : public StatCollector {
+public:
+  SojournCollector() : StatCollector(ON_ABSORPTION) { }
+  void on_absorption(Population &pop, mutation_loc loc, bool fixed) {
+    const Site &site = pop.sites[loc];
+    out << "gen: " << Population::generation << " absorption " << (fixed ? "fixation" : "loss")
+      << " site: " << site.id << " sojourn: " << Population::generation-site.generation_created
+      << " effect: " << site.effect << '\n';
+  }
+};
+
+/* sketches of the sojourns the sojourn statistic would print, and of each
+ * generation's segregating sites and phenotype variance, printed as
+ * quantiles every quantile_every generations, and as quantiles and the
+ * sketches themselves at the end */
+class QuantilesCollector : public StatCollector {
+public:
+  QuantilesCollector() : StatCollector(ON_ABSORPTION | ON_GENERATION | ON_FINAL) { }
+  void on_absorption(Population &pop, mutation_loc loc, bool fixed) {
+    Population::stat_sojourn_quantile(pop.sites[loc], fixed);
+  }
+  void on_generation(Population &pop) {
+    pop.stat_update_quantiles();
+    if (Population::quantile_every > 0 && Population::generation % Population::quantile_every == 0)
+      Population::stat_print_quantiles(false);
+  }
+  void on_final(Population &pop) {
+    pop.stat_update_quantiles();
+    Population::stat_print_quantiles(true);
+  }
+};
+
+/* batch means of the --target-se statistics, which set converged once
+ * they've all been met, and their precision at the end */
+class ConvergenceCollector : public StatCollector {
+public:
+  ConvergenceCollector() : StatCollector(ON_GENERATION | ON_FINAL) { }
+  void on_generation(Population &pop) { pop.stat_update_convergence(); }
+  void on_final(Population &) { Population::stat_print_convergence(); }
+};
+
+static FrequencyCollector frequency_collector;
+static FrequencyDeltaCollector frequency_delta_collector;
+static VisitsCollector visits_collector;
+static FixationsCollector fixations_collector;
+static SegsitesCollector segsites_collector;
+static PhenotypeCollector phenotype_collector;
+static PMomentsCollector pmoments_collector;
+static PhenotypeVarMeanCollector phenotype_var_mean_collector;
+static MutationCollector mutation_collector;
+static SojournCollector sojourn_collector;
+static QuantilesCollector quantiles_collector;
+static ConvergenceCollector convergence_collector;
 
 /* Initialize the class variables of Population */
 void Population::initialize(int N, Model m) {
@@ -39,30 +217,83 @@ void Population::initialize(int N, Model m) {
   popsize = N;
   sites_model = m;
   initialized = true;
-  if (Statistic::is_activated("visits")) {
+  Statistic::add_collector(STAT_FREQUENCIES, &frequency_collector);
+  Statistic::add_collector(STAT_FREQUENCY_DELTAS, &frequency_delta_collector);
+  Statistic::add_collector(STAT_VISITS, &visits_collector);
+  Statistic::add_collector(STAT_FIXATIONS, &fixations_collector);
+  Statistic::add_collector(STAT_SEGSITES, &segsites_collector);
+  Statistic::add_collector(STAT_PHENOTYPE, &phenotype_collector);
+  Statistic::add_collector(STAT_PMOMENTS, &pmoments_collector);
+  Statistic::add_collector(STAT_PHENOTYPE_VAR_MEAN, &phenotype_var_mean_collector);
+  Statistic::add_collector(STAT_MUTATION, &mutation_collector);
+  Statistic::add_collector(STAT_SOJOURN, &sojourn_collector);
+  Statistic::add_collector(STAT_QUANTILES, &quantiles_collector);
+  Statistic::add_collector(STAT_CONVERGENCE, &convergence_collector);
+  if (Statistic::is_activated(STAT_VISITS)) {
     if (Site::ploidy_level == diploid) {
       visits = vector<int>(2*N-1, 0);
     } else {
       visits = vector<int>(N-1, 0);
     }
+    class_sites = vector<int>(visits.size()+1, 0);
+    class_since = vector<int>(visits.size()+1, 0);
   }
-  if (Statistic::is_activated("pmoments")) {
+  if (Statistic::is_activated(STAT_PMOMENTS)) {
     int bins;
     if (Site::ploidy_level == diploid) {
       bins = 2*N+1;
     } else {
       bins = N+1;
     }
-    /* Note, this memory is not freed until program exit */
-    delta_p_first_moment = new RunningMean(bins);
-    delta_p_second_moment = new RunningMean(bins);
+    /* Note, this memory is not freed until finalize() */
+    delta_p_moments = new Moments(bins);
   }
-  if (Statistic::is_activated("phenotype-var-mean")) {
-    /* Note, this memory is not freed until program exit */
-    phenotype_var_mean = new RunningMean(1);
+  if (Statistic::is_activated(STAT_PHENOTYPE_VAR_MEAN)) {
+    /* Note, this memory is not freed until finalize() */
+    phenotype_var_mean = new Moments(1);
   }
 }
 
+/* Put the class variables back as they were before initialize(), so another
+ * simulation can be set up in the same process. The populations must all
+ * have been deleted */
+void Population::finalize(void) {
+  if (!pop_views.empty()) throw SimError("populations must be deleted before finalizing");
+  initialized = false;
+  num_loci = 0;
+  generation = 0;
+  while (!lost.empty()) lost.pop();
+  fixations.clear();
+  visits.clear();
+  delta_counts.clear();
+  delta_ids.clear();
+  delta_generations = 0;
+  site_class.clear();
+  class_sites.clear();
+  class_since.clear();
+  visit_samples = 0;
+  segregating_live = false;
+  segregating.clear();
+  freq_text_at.clear();
+  freq_text.clear();
+  freq_blocks.clear();
+  freq_formatted.clear();
+  visits_changes.reset();
+  frequency_changes.reset();
+  sketches.clear();
+  delete burnin_detector;
+  burnin_detector = NULL;
+  converged = false;
+  for (size_t i=0; i < target_means.size(); i++) delete target_means[i];
+  target_kinds.clear();
+  target_ses.clear();
+  target_means.clear();
+  delete delta_p_moments;
+  delete phenotype_var_mean;
+  delta_p_moments = phenotype_var_mean = NULL;
+  Site::next_unique_id = 0;
+}
+
 /* Create a population */
 Population::Population(void) {
   /* populations can't be added after initialize has been called */
@@ -72,20 +303,51 @@ Population::Population(void) {
    * each time a fitness is updated */
   max_fitness = 0;
 
-  /* allocate genomes of this populations */
+  store = new GenotypeStore(popsize);
+
+  /* allocate genomes of this populations, in one block, so their 
+   * phenotypes and fitnesses can be read in place */
+  if (sites_model == infinite_sites) {
+    genome_stride = sizeof(GenomeInfiniteSites);
+  } else {
+    genome_stride = sizeof(GenomeFiniteSites);
+  }
+  genome_block = (char *)::operator new(popsize * genome_stride);
   for (int i=0; i < popsize; i++) {
+    void *p = genome_block + i*genome_stride;
     if (sites_model == infinite_sites) {
-      genomes.push_back(new GenomeInfiniteSites(this, i));
+      genomes.push_back(new (p) GenomeInfiniteSites(this, i));
     } else {
-      genomes.push_back(new GenomeFiniteSites(this, i));
+      genomes.push_back(new (p) GenomeFiniteSites(this, i));
     }
   }
   /* add this population to the class list */
   pop_views.push_back(this);
 }
 
+Population::~Population() {
+  for (int i=0; i < (int)genomes.size(); i++) genomes[i]->~Genome();
+  ::operator delete(genome_block);
+  delete store;
+  pop_views.erase(std::find(pop_views.begin(), pop_views.end(), this));
+}
+
 /* set up sites based on initial genotypes */
 void Population::setup_initial_genotypes(valarray<int> &hets, valarray<int> &homs) {
+  place_initial_genotypes(hets, homs, NULL);
+}
+
+/* set up infinite sites model sites with the given effects, rather than
+ * effects drawn as for new mutations */
+void Population::setup_initial_genotypes(valarray<int> &hets, valarray<int> &homs,
+    const valarray<double> &effects) {
+  if (sites_model != infinite_sites) throw SimError("only infinite sites are given effects");
+  if (effects.size() != hets.size()) throw SimError("len(effects) != len(hets)");
+  place_initial_genotypes(hets, homs, &effects);
+}
+
+void Population::place_initial_genotypes(valarray<int> &hets, valarray<int> &homs,
+    const valarray<double> *effects) {
   if (hets.size() != homs.size()) throw SimError("len(hets) != len(homs)");
   if (hets.max() > popsize) throw SimError("too many heterozygotes");
   if (homs.max() > popsize) throw SimError("too many homozygotes");
@@ -100,7 +362,7 @@ void Population::setup_initial_genotypes(valarray<int> &hets, valarray<int> &hom
     ranint(popsize,ranout);
 
     if (sites_model == infinite_sites)
-      loc = create_site(GenomeInfiniteSites::sample_effect_size());
+      loc = create_site(effects ? (*effects)[k] : GenomeInfiniteSites::sample_effect_size());
     else
       loc = (mutation_loc)k;
 
@@ -126,41 +388,196 @@ void Population::setup_initial_genotypes(valarray<int> &hets, valarray<int> &hom
   return;
 }
 
+/* Set up the initial population from a genotype file. Each of the file's
+ * sites becomes a new site, with its effect, and its id if it has one. In 
+ * the finite sites model these are the population's loci */
+void Population::setup_initial_genotypes(const GenotypeFile &g) {
+  if (g.popsize != popsize) 
+    throw SimError(0, "genotype file has population size %d, not %d", g.popsize, popsize);
+  if (g.ploidy != (int)Site::ploidy_level) 
+    throw SimError(0, "genotype file has ploidy %d, not %d", g.ploidy, (int)Site::ploidy_level);
+  if (num_loci != 0) throw SimError("can only set up genotypes in an empty population");
+
+  mutation_id next_id = Site::next_unique_id;
+  for (int k=0; k < g.nsites; k++) {
+    mutation_loc loc = create_site(g.effects[k]);
+    if (sites_model == finite_sites) Genome::baseline -= g.effects[k];
+    if (g.ids != NULL) {
+      for (vector<Population*>::iterator it = pop_views.begin(); it != pop_views.end(); it++)
+        (*it)->sites[loc].id = g.ids[k];
+      if (g.ids[k] >= next_id) next_id = g.ids[k]+1;
+    }
+
+    /* mutate each individual up once per derived allele */
+    const uint8_t *column = g.genotypes(k);
+    for (int ind=0; ind < popsize; ind++) {
+      if (column[ind] > g.ploidy) 
+        throw SimError(0, "invalid genotype %d at site %d", column[ind], k);
+      for (int a=0; a < column[ind]; a++) genomes[ind]->mutate_site(loc, up);
+    }
+  }
+  if (g.ids != NULL) Site::next_unique_id = next_id;
+
+  /* compute fitnesses */
+  for (int ind = 0; ind < popsize; ind++) {
+    genomes[ind]->update_phenotype();
+    genomes[ind]->update_fitness();
+  }
+  return;
+}
+
+/* Write the genotypes at every site in use to a genotype file, which can be
+ * used to start another run */
+void Population::export_genotypes(const std::string &path) {
+  vector<double> effects;
+  vector<uint32_t> ids;
+  vector<uint8_t> genotypes;
+  for (mutation_loc loc=0; loc < sites.size(); loc++) {
+    Site &site = sites[loc];
+    if (site.reusable) continue;
+    effects.push_back(site.effect);
+    ids.push_back(site.id);
+    for (int ind=0; ind < popsize; ind++) genotypes.push_back((uint8_t)site[ind]);
+  }
+  GenotypeFile::write(path, popsize, (int)Site::ploidy_level, effects, ids, genotypes);
+  return;
+}
+
 void Population::clear_generation(void) {
   /* clear out all the children's genomes */
   for (int i = 0; i < popsize; i++) 
     genomes[i]->clear();
 
-  for (int i = 0; i < popsize; i++) {
-    for (int s = 0; s < (int)sites.size(); s++) {
-      if (sites[s][i] != 0)
-        throw SimError(0, "not clear: site %d in individual %d has genotype %d", sites[s].id, i, sites[s][i]);
+  /* check the whole view is clear, reading the genotypes in storage order */
+  size_t s;
+  int i;
+  if (store->first_nonzero(sites.size(), s, i))
+    throw SimError(0, "not clear: site %d in individual %d has genotype %d", sites[s].id, i, sites[s][i]);
+
+  /* which lets an out-of-core store drop its contents */
+  store->discard();
+}
+
+/* Advance the simulation one generation, from the parents in 
+ * pops[parent_pop] to the offspring in the other view, which then become 
+ * the parents. While there's burnin left it counts down, and after that the 
+ * generation counts up */
+void Population::next_generation(Population *pops, int &parent_pop, int &burnin) {
+  Population &parents = pops[parent_pop];
+  Population &offspring = pops[1-parent_pop];
+
+  offspring.populate_from(parents);
+
+#ifdef EXTRA_CHECKS
+  /* Check the new generation */
+  for (int i=0; i < popsize; i++) {
+    offspring.genomes[i]->check();
+  }
+#endif /* EXTRA_CHECKS */
+
+  /* It's important to update the p_moments just after the next generation is
+   * generated. This is becuase stat_update_p_moments refers to the receiver
+   * (the offspring) as the current generation and the other population 
+   * view as the parental generation for computing changes in allele frequencies.
+   * And it's important to run it before lost sites are purged, becuase those 
+   * decreases in allele frequencies would be missed (as purged sites are not 
+   * counted) */
+  if (burnin <= 0)
+    Statistic::offspring(offspring, generation);
+
+  /* Clear the parents' genomes, to make room for the next generation. Also,
+   * this allows us to safely purge sites that have been lost in the child 
+   * generation (becuase they'll also be zeroed in the parent generation) */
+  parents.clear_generation();
+
+  /* if we're using the infinite sites model, we should do some cleanup */
+  if (sites_model == infinite_sites)
+    offspring.purge_lost();
+
+  /* generations start counting after the burnin is over. An adaptive
+   * burnin says how long it ran, and from when it was settled (NA if it 
+   * ran out first) */
+  if (burnin == 0 && generation == 0 && Statistic::is_activated(STAT_BURNIN)) {
+    out << "end burnin";
+    if (burnin_detector != NULL) {
+      out << ": " << burnin_detector->count() << " stationary from: ";
+      if (burnin_detector->stationary_from() < 0) out << "NA";
+      else out << burnin_detector->stationary_from();
+    }
+    out << '\n';
+  }
+  if (burnin <= 0) {
+    generation++;
+    if (generation == 0) {
+      if (Statistic::is_activated(STAT_BURNIN))
+        out << "burnin mutations: " << Genome::mutation_count << '\n';
+      Genome::mutation_count = 0;
+    }
+  } else {
+    burnin--;
+    if (burnin_detector != NULL) {
+      double x[3];
+      offspring.burnin_sample(x);
+      if (burnin_detector->post(x)) burnin = 0;
     }
   }
+
+  /* swap the parent and offspring in preparation for the next gen */
+  parent_pop = 1-parent_pop;
 }
 
 /* create the next generation (this object) from the parent generation */
 void Population::populate_from(const Population &parpop) {
   int mom, dad;
 
+  store->begin_offspring();
+  parpop.store->begin_parents();
+
   /* loop over the offspring, creating each by mating two parents sampled 
    * according to their fitnesses */
   for (int off = 0; off < popsize; off++) {
     while (1) {
-      mom = (int)(popsize*ran1());
-      if (ran1()*parpop.max_fitness <= parpop.genomes[mom]->fitness)
+      mom = (int)(popsize*ran1(rand_parent));
+      if (ran1(rand_parent)*parpop.max_fitness <= parpop.genomes[mom]->fitness)
         break;
     }
     while (1) {
-      dad = (int)(popsize*ran1());
-      if (ran1()*parpop.max_fitness <= parpop.genomes[dad]->fitness)
+      dad = (int)(popsize*ran1(rand_parent));
+      if (ran1(rand_parent)*parpop.max_fitness <= parpop.genomes[dad]->fitness)
         break;
     }
     /* have some sex */
     genomes[off]->mate(parpop.genomes[mom], parpop.genomes[dad]);
+    if (((off+1) & (TILE_WIDTH-1)) == 0 && store->file_backed()) 
+      store->end_tile(off);
   }
 }
 
+/* the sites that are neither lost nor fixed. Fixed sites of the finite
+ * sites model stay in sites, so this is not the size of sites */
+int
+Population::segregating_sites(void) {
+  int fixed_count = (int)Site::ploidy_level * popsize;
+  int n = 0;
+  for (mutation_loc loc=0; loc < sites.size(); loc++) {
+    int c = sites[loc].derived_alleles_count;
+    if (!sites[loc].reusable && c > 0 && c < fixed_count) n++;
+  }
+  return n;
+}
+
+/* What an adaptive burnin watches: the segregating sites (neither lost
+ * nor fixed), the phenotype variance, and the balance of mutation and 
+ * absorption, as the change in the segregating sites since last time */
+void
+Population::burnin_sample(double *x) {
+  int segregating_now = segregating_sites();
+  compute_phenotype_moments(true);
+  x[0] = segregating_now;
+  x[1] = phenotype_variance;
+  x[2] = burnin_detector->count() > 0 ? segregating_now - burnin_detector->last(0) : 0.0;
+}
+
 /* Create a new site. If there are lost sites, reuse one of these. Either way 
  * the result site gets a new mutation ID */
 mutation_loc
@@ -176,16 +593,27 @@ Population::create_site(double e) {
   } else {
     loc = num_loci++;
     /* go through each population view and create a new site object */
-    for (vector<Population*>::iterator it = pop_views.begin(); it != pop_views.end(); it++) 
-      (*it)->sites.push_back(Site(popsize, e, id, generation));
+    for (vector<Population*>::iterator it = pop_views.begin(); it != pop_views.end(); it++) {
+      (*it)->reserve_sites(loc+1);
+      (*it)->sites.push_back(Site((*it)->store, loc, e, id, generation));
+    }
   }
 
-  /* dump the site from one of the pop views so we have a record of its creation */
-  if (Statistic::is_activated("mutation"))
-    cout << "gen: " << generation << " " << pop_views[0]->sites[loc] << endl;
+  site_changed(loc);
+  stat_site_born(e);
+  Statistic::birth(*pop_views[0], loc);
   return loc;
 }
 
+/* make room in the store for n sites, and if the genotypes had to be 
+ * moved, tell the existing sites where they are now */
+void
+Population::reserve_sites(size_t n) {
+  if (!store->reserve(n)) return;
+  for (vector<Site>::iterator it = sites.begin(); it != sites.end(); it++)
+    it->attach();
+}
+
 /* cleanup unused sites */
 void
 Population::purge_lost(void) { 
@@ -204,11 +632,9 @@ Population::purge_lost(void) {
       }
       /* record this site as having been lost */
       lost.push(loc);
-      if (Statistic::is_activated("sojourn")) {
-        cout << "gen: " << generation << " absorption loss site: " << sites[loc].id 
-          << " sojourn: " << generation-sites[loc].generation_created 
-          << " effect: " << sites[loc].effect << endl;
-      }
+      site_changed(loc);
+      stat_site_absorbed(sites[loc].effect);
+      Statistic::absorption(*this, loc, false);
     } else if (sites[loc].derived_alleles_count == Site::ploidy_level*popsize && !sites[loc].reusable) {
       /* dealing with a fixed site is more complicated because we need to remove
        * it from all genomes and adjust the baseline to reflect this sites now 
@@ -225,11 +651,9 @@ Population::purge_lost(void) {
       /* adjust the genomic baseline to reflect the fixation */
       Genome::baseline += Site::ploidy_level*sites[loc].effect;
       fixations[sites[loc].effect]++;
-      if (Statistic::is_activated("sojourn")) {
-        cout << "gen: " << generation << " absorption fixation site: " << sites[loc].id 
-          << " sojourn: " << generation-sites[loc].generation_created 
-          << " effect: " << sites[loc].effect << endl;
-      }
+      site_changed(loc);
+      stat_site_absorbed(sites[loc].effect);
+      Statistic::absorption(*this, loc, true);
     }
   }
 }
@@ -244,79 +668,275 @@ Population::other_view(void) {
   }
 }
 
+/* Count a generation's visits to each derived allele count. Only the sites
+ * whose count has changed since the last time move between count classes;
+ * the classes' visits are added up when they change or are printed. Lost 
+ * and fixed sites aren't counted */
 void
 Population::stat_increment_visits(void) {
-  if (!Statistic::is_activated("visits")) return;
-  for (mutation_loc loc=0; loc < sites.size(); loc++) {
-    if (!sites[loc].reusable) 
-      visits[sites[loc].derived_alleles_count-1]++;
-  }
+  if (!Statistic::is_activated(STAT_VISITS)) return;
+  update_classes();
+  visit_samples++;
   return;
 }
 
+/* move the sites whose counts have changed to their new count classes,
+ * looking only at those listed in visits_changes after the first time */
+void
+Population::update_classes(void) {
+  if (site_class.size() < sites.size()) site_class.resize(sites.size(), 0);
+  size_t n = visits_changes.all ? sites.size() : visits_changes.locs.size();
+  for (size_t i=0; i < n; i++) {
+    mutation_loc loc = visits_changes.all ? i : visits_changes.locs[i];
+    int c = sites[loc].reusable ? 0 : sites[loc].derived_alleles_count;
+    if (c != site_class[loc]) {
+      move_class(site_class[loc], c);
+      site_class[loc] = c;
+    }
+  }
+  visits_changes.clear();
+}
+
+/* move a site from one count class to another, first adding up the visits
+ * of each while it had its old number of sites */
+void
+Population::move_class(int from, int to) {
+  int classes = visits.size();
+  if (from >= 1 && from <= classes) {
+    visits[from-1] += class_sites[from] * (visit_samples - class_since[from]);
+    class_since[from] = visit_samples;
+    class_sites[from]--;
+  }
+  if (to >= 1 && to <= classes) {
+    visits[to-1] += class_sites[to] * (visit_samples - class_since[to]);
+    class_since[to] = visit_samples;
+    class_sites[to]++;
+  }
+}
+
+/* bring visits up to date */
+void
+Population::flush_visits(void) {
+  for (int c=1; c <= (int)visits.size(); c++) {
+    visits[c-1] += class_sites[c] * (visit_samples - class_since[c]);
+    class_since[c] = visit_samples;
+  }
+}
+
 void
 Population::stat_print_visits(void) {
-  if (!Statistic::is_activated("visits")) return;
-  cout << "visits:";
+  if (!Statistic::is_activated(STAT_VISITS)) return;
+  flush_visits();
+  out << "visits:";
   for (int i=0; i<(int)visits.size(); i++)
-    cout << " " << visits[i];
-  cout << endl;
+    out << " " << visits[i];
+  out << '\n';
   return;
 }
 
 void
 Population::stat_fixations(void) {
-  if (!Statistic::is_activated("fixations")) return;
-  cout << "gen: " << generation << " fixations:";
+  if (!Statistic::is_activated(STAT_FIXATIONS)) return;
+  out << "gen: " << generation << " fixations:";
   for (map<double,int>::iterator i=fixations.begin(); i!=fixations.end(); i++) {
-    cout << " " << i->first << "," << i->second;
+    out << " " << i->first << "," << i->second;
   }
-  cout << endl;
+  out << '\n';
   return;
 }
 
-/* print out the frequencies of all the sites that have mutated so far */
+/* Print out the frequencies of all the sites that have mutated so far. The
+ * line is kept as text in blocks of FREQ_BLOCK sites, and only the blocks
+ * with sites listed in frequency_changes are formatted again */
 void
 Population::stat_frequency_summary(void) {
-  if (!Statistic::is_activated("frequencies")) return;
-  cout << "gen: " << generation << " freqs:";
-  for (mutation_loc loc=0; loc < sites.size(); loc++) {
-    /* print only sites that haven't been recorded as lost */
-    if (!sites[loc].reusable) {
-      double f = sites[loc].frequency();
-      if (f < 1.0) 
-        cout << " " << sites[loc].id << ":" << f;
+  if (!Statistic::is_activated(STAT_FREQUENCIES)) return;
+  size_t blocks = (sites.size() + FREQ_BLOCK - 1) / FREQ_BLOCK;
+  size_t first_new = frequency_changes.all ? 0 : freq_blocks.size();
+  freq_blocks.resize(blocks);
+  freq_formatted.assign(blocks, 0);
+  for (size_t b=first_new; b < blocks; b++) format_frequencies(b);
+  for (size_t i=0; i < frequency_changes.locs.size(); i++) {
+    size_t b = frequency_changes.locs[i] / FREQ_BLOCK;
+    if (!freq_formatted[b]) format_frequencies(b);
+  }
+  frequency_changes.clear();
+
+  out << "gen: " << generation << " freqs:";
+  for (size_t b=0; b < blocks; b++) out << freq_blocks[b];
+  out << '\n';
+  return;
+}
+
+/* Format a block of the freqs line, of the sites that haven't been recorded
+ * as lost, or fixed. A frequency depends only on the derived allele count,
+ * so each count's text is formatted the first time it's needed and reused
+ * after that */
+void
+Population::format_frequencies(size_t block) {
+  int fixed_count = (int)Site::ploidy_level * popsize;
+  if (freq_text_at.empty()) freq_text_at.assign(fixed_count, -1);
+  string &text = freq_blocks[block];
+  text.clear();
+  size_t end = std::min(sites.size(), (block+1)*FREQ_BLOCK);
+  for (mutation_loc loc=block*FREQ_BLOCK; loc < end; loc++) {
+    Site &site = sites[loc];
+    if (site.reusable || site.derived_alleles_count >= fixed_count) continue;
+    int c = site.derived_alleles_count;
+    if (freq_text_at[c] < 0) {
+      freq_text_at[c] = freq_text.size();
+      out.format(freq_text, site.frequency());
+      freq_text.push_back('\0');
+    }
+    text.push_back(' ');
+    out.format(text, site.id);
+    text.push_back(':');
+    text.append(freq_text.c_str() + freq_text_at[c]);
+  }
+  freq_formatted[block] = 1;
+}
+
+/* Print the changes in the segregating sites since the last generation.
+ * Every keyframe_every generations a full keyframe is printed instead,
+ *
+ *   gen: <g> keyframe: <loc>:<id>:<count>:<effect> ...
+ *
+ * and in between, the sites that have appeared, been absorbed (lost or
+ * fixed) or changed count, keyed by their position in the sites vector
+ *
+ *   gen: <g> delta: +<loc>:<id>:<count>:<effect> -<loc> <loc>:<change> ...
+ *
+ * Segregating sites are those printed by stat_frequency_summary(), and
+ * undelta rebuilds its output from these lines */
+void
+Population::stat_frequency_deltas(void) {
+  if (!Statistic::is_activated(STAT_FREQUENCY_DELTAS)) return;
+  int fixed_count = (int)Site::ploidy_level * popsize;
+  if (delta_counts.size() < sites.size()) {
+    delta_counts.resize(sites.size(), -1);
+    delta_ids.resize(sites.size(), 0);
+  }
+
+  if (delta_generations == 0) {
+    out << "gen: " << generation << " keyframe:";
+    for (mutation_loc loc=0; loc < sites.size(); loc++) {
+      Site &site = sites[loc];
+      if (!site.reusable && site.derived_alleles_count < fixed_count) {
+        out << " " << (int)loc << ":" << site.id << ":" << site.derived_alleles_count
+          << ":" << site.effect;
+        delta_counts[loc] = site.derived_alleles_count;
+        delta_ids[loc] = site.id;
+      } else {
+        delta_counts[loc] = -1;
+      }
+    }
+  } else {
+    out << "gen: " << generation << " delta:";
+    for (mutation_loc loc=0; loc < sites.size(); loc++) {
+      Site &site = sites[loc];
+      bool present = !site.reusable && site.derived_alleles_count < fixed_count;
+      bool was_present = delta_counts[loc] >= 0;
+      if (was_present && (!present || delta_ids[loc] != site.id)) {
+        out << " -" << (int)loc;
+        delta_counts[loc] = -1;
+      }
+      if (!present) continue;
+      if (delta_counts[loc] < 0) {
+        out << " +" << (int)loc << ":" << site.id << ":" << site.derived_alleles_count
+          << ":" << site.effect;
+        delta_ids[loc] = site.id;
+      } else if (delta_counts[loc] != site.derived_alleles_count) {
+        int change = site.derived_alleles_count - delta_counts[loc];
+        out << " " << (int)loc << ":" << (change > 0 ? "+" : "") << change;
+      }
+      delta_counts[loc] = site.derived_alleles_count;
     }
   }
-  cout << endl;
+  out << '\n';
+  if (++delta_generations >= keyframe_every) delta_generations = 0;
+  return;
+}
+
+/* Append this generation's segregating sites and phenotype moments to a
+ * binary trajectory file. These are the same sites printed by
+ * stat_frequency_summary(), i.e., fixed sites are left out */
+void
+Population::stat_write_trajectory(TrajectoryWriter &w) {
+  compute_phenotype_moments(true);
+  w.begin_generation(generation, phenotype_mean, phenotype_variance);
+  int fixed_count = (int)Site::ploidy_level * popsize;
+  for (mutation_loc loc=0; loc < sites.size(); loc++) {
+    if (!sites[loc].reusable && sites[loc].derived_alleles_count < fixed_count)
+      w.add_site(sites[loc].id, sites[loc].derived_alleles_count, sites[loc].effect);
+  }
+  w.end_generation();
+  return;
+}
+
+/* publish the segregating sites' counts, the phenotype moments and the 
+ * visits histogram to shared memory */
+void
+Population::stat_publish(LivePublisher &p) {
+  compute_phenotype_moments(true);
+  p.begin(generation, phenotype_mean, phenotype_variance);
+  int fixed_count = (int)Site::ploidy_level * popsize;
+  for (mutation_loc loc=0; loc < sites.size(); loc++) {
+    if (!sites[loc].reusable && sites[loc].derived_alleles_count < fixed_count)
+      p.add_site(sites[loc].id, sites[loc].derived_alleles_count, sites[loc].effect);
+  }
+  if (!visits.empty()) flush_visits();
+  p.end(visits);
   return;
 }
 
 /* print out the number of segregating sites for each effect size */
 void
 Population::stat_segsites(void) {
-  if (!Statistic::is_activated("segsites")) return;
-  cout << "gen: " << generation << " segsites:";
-  map<double,int> counts;
+  if (!Statistic::is_activated(STAT_SEGSITES)) return;
+  count_segregating();
+  out << "gen: " << generation << " segsites:";
+  for (map<double,int>::iterator i=segregating.begin(); i != segregating.end(); i++) {
+    out << " " << i->first << "," << i->second;
+  }
+  out << '\n';
+  return;
+}
+
+/* The segregating sites of each effect size are kept up to date as sites
+ * are born and absorbed, once they've been counted here the first time */
+void
+Population::count_segregating(void) {
+  if (segregating_live) return;
+  segregating.clear();
   for (mutation_loc loc=0; loc < sites.size(); loc++) {
     /* record only sites that haven't been lost */
-    if (!sites[loc].reusable) counts[sites[loc].effect]++;
-  }
-  for (map<double,int>::iterator i=counts.begin(); i != counts.end(); i++) {
-    cout << " " << i->first << "," << i->second;
+    if (!sites[loc].reusable) segregating[sites[loc].effect]++;
   }
-  cout << endl;
-  return;
+  segregating_live = true;
+}
+
+void
+Population::stat_site_born(double effect) {
+  if (segregating_live) segregating[effect]++;
+}
+
+void
+Population::stat_site_absorbed(double effect) {
+  if (!segregating_live) return;
+  map<double,int>::iterator i = segregating.find(effect);
+  if (i == segregating.end()) return;
+  if (--i->second == 0) segregating.erase(i);
 }
 
 /* Since multiple statistics use the phenotype moments, we compute them here 
  * and store them in the Phenotype object
  */
 void
-Population::compute_phenotype_moments(void) {
+Population::compute_phenotype_moments(bool force) {
   double sum, sumsq, p;
 
-  if (Statistic::is_activated("phenotype") || Statistic::is_activated("phenotype-var-mean")) {
+  if (force || Statistic::is_activated(STAT_PHENOTYPE) || Statistic::is_activated(STAT_PHENOTYPE_VAR_MEAN) ||
+      Statistic::is_activated(STAT_QUANTILES) || Statistic::is_activated(STAT_CONVERGENCE)) {
     sum = sumsq = 0.0;
     
     for (int ind=0; ind < popsize; ind++) {
@@ -330,23 +950,52 @@ Population::compute_phenotype_moments(void) {
   }
 }
 
+/* collect this generation's statistics, with this view as the parents */
+void
+Population::stat_generation(void) {
+  compute_phenotype_moments();
+  Statistic::generation(*this, generation);
+}
+
+/* and the final statistics, with this view as the final population */
+void
+Population::stat_final(void) {
+  compute_phenotype_moments();
+  Statistic::final(*this);
+}
+
+/* the phenotype mean and variance, whether or not they're being printed */
+void
+Population::phenotype_moments(double &mean, double &variance) {
+  compute_phenotype_moments(true);
+  mean = phenotype_mean;
+  variance = phenotype_variance;
+}
+
+/* where the genomes are: individual i's is stride*i bytes past first */
+void
+Population::genome_layout(const Genome *&first, size_t &stride) const {
+  first = genomes[0];
+  stride = genome_stride;
+}
+
 /* print out the phenotype mean and variance */
 void
 Population::stat_phenotype_summary(void) {
-  if (!Statistic::is_activated("phenotype")) return;
+  if (!Statistic::is_activated(STAT_PHENOTYPE)) return;
 
   /* compute_phenotype_moments must be called before this function will return 
    * accurate results */
-  cout << "gen: " << generation << " pheno: " << phenotype_mean
-    << " " << phenotype_variance << endl;
+  out << "gen: " << generation << " pheno: " << phenotype_mean
+    << " " << phenotype_variance << '\n';
   return;
 }
 
 /* Update the estimates for the first and second moment of the change in allele
- * frequency. */
+ * frequency. Both come from the mean and variance of the change */
 void
 Population::stat_update_p_moments(void) {
-  if (!Statistic::is_activated("pmoments")) return;
+  if (!Statistic::is_activated(STAT_PMOMENTS)) return;
 
   double delta;
 	int current_p, previous_p;
@@ -361,33 +1010,184 @@ Population::stat_update_p_moments(void) {
       current_p = sites[loc].derived_alleles_count;
       previous_p = other_view()->sites[loc].derived_alleles_count;
       delta =  (double)(current_p - previous_p) / popsize;
-      delta_p_first_moment->post(previous_p, (double)delta);
-      delta_p_second_moment->post(previous_p, pow((double)delta, 2.0));
+      delta_p_moments->post(previous_p, delta);
 		}
   }
 }
 
 void
 Population::stat_update_phenotype_var_mean(void) {
-  if (!Statistic::is_activated("phenotype-var-mean")) return;
+  if (!Statistic::is_activated(STAT_PHENOTYPE_VAR_MEAN)) return;
   phenotype_var_mean->post(phenotype_variance);
 }
 
+/* add an absorbed site's sojourn to its sketch */
+void
+Population::stat_sojourn_quantile(const Site &site, bool fixed) {
+  int kind = fixed ? SKETCH_SOJOURN_FIXATION : SKETCH_SOJOURN_LOSS;
+  sketches[pair<int,double>(kind, site.effect)].insert(generation - site.generation_created);
+}
+
+/* Add this generation's segregating sites of each effect size, and its
+ * phenotype variance, to their sketches. An effect size with none counts
+ * as 0, once it's been seen */
+void
+Population::stat_update_quantiles(void) {
+  count_segregating();
+  map<double,int>::iterator seg = segregating.begin();
+  for (map<double,int>::iterator i=segregating.begin(); i != segregating.end(); i++)
+    sketches[pair<int,double>(SKETCH_SEGSITES, i->first)];
+  for (map<pair<int,double>, QuantileSketch>::iterator it = sketches.lower_bound(pair<int,double>(SKETCH_SEGSITES, -HUGE_VAL));
+      it != sketches.end() && it->first.first == SKETCH_SEGSITES; it++) {
+    while (seg != segregating.end() && seg->first < it->first.second) seg++;
+    bool present = seg != segregating.end() && seg->first == it->first.second;
+    it->second.insert(present ? seg->second : 0);
+  }
+  sketches[pair<int,double>(SKETCH_PHENOTYPE_VARIANCE, 0.0)].insert(phenotype_variance);
+}
+
+/* Print each sketch's quantiles, 
+ *
+ *   gen: <g> quantiles: <name>[:<effect>] n: <count> <p>:<quantile> ...
+ *
+ * and at the end, the sketches themselves, for qmerge,
+ *
+ *   gen: <g> sketch: <name>[:<effect>] n: <count> <level>:<value> ... */
+void
+Population::stat_print_quantiles(bool final) {
+  for (map<pair<int,double>, QuantileSketch>::iterator it = sketches.begin(); it != sketches.end(); it++) {
+    const QuantileSketch &q = it->second;
+    out << "gen: " << generation << " quantiles: " << sketch_names[it->first.first];
+    if (it->first.first != SKETCH_PHENOTYPE_VARIANCE) out << ":" << it->first.second;
+    out << " n: " << q.count();
+    for (size_t i=0; i < quantile_probs.size(); i++)
+      out << " " << quantile_probs[i] << ":" << q.quantile(quantile_probs[i]);
+    out << '\n';
+  }
+  if (!final) return;
+  for (map<pair<int,double>, QuantileSketch>::iterator it = sketches.begin(); it != sketches.end(); it++) {
+    const QuantileSketch &q = it->second;
+    out << "gen: " << generation << " sketch: " << sketch_names[it->first.first];
+    if (it->first.first != SKETCH_PHENOTYPE_VARIANCE) out << ":" << it->first.second;
+    out << " n: " << q.count();
+    /* the values in full, so merged sketches lose nothing */
+    int old_precision = out.precision(17);
+    for (int h=0; h < q.levels(); h++) {
+      for (size_t i=0; i < q.items(h).size(); i++)
+        out << " " << h << ":" << q.items(h)[i];
+    }
+    out.precision(old_precision);
+    out << '\n';
+  }
+}
+
+/* Track a statistic's standard error, until it's down to se. Its batch
+ * means are set up here, once the populations have been initialized */
+void
+Population::add_target(const char *stat, double se) {
+  int kind;
+  for (kind=0; kind < NUM_TARGETS; kind++) {
+    if (strcmp(stat, target_names[kind]) == 0) break;
+  }
+  if (kind == NUM_TARGETS)
+    throw SimUsageError(string(stat) + " can't be given a target standard error");
+  if (kind == TARGET_VISITS && !Statistic::is_activated(STAT_VISITS))
+    throw SimUsageError("a target for visits needs the visits statistic");
+  target_kinds.push_back(kind);
+  target_ses.push_back(se);
+  target_means.push_back(new BatchMeans(kind == TARGET_VISITS ? visits.size() : 1, TARGET_BATCHES));
+}
+
+/* Add this generation's samples to each target's batch means. Whether the
+ * targets have been met only changes when a batch is completed. A target
+ * is met once the largest standard error of its series is down to its
+ * target, and that series' batches are long enough that the lag 1
+ * autocorrelation of their means is within two standard errors of 0 */
+void
+Population::stat_update_convergence(void) {
+  bool changed = false;
+  for (size_t t=0; t < target_kinds.size(); t++) {
+    switch (target_kinds[t]) {
+      case TARGET_PHENOTYPE_VAR:
+        changed |= target_means[t]->post(phenotype_variance);
+        break;
+      case TARGET_SEGSITES:
+        changed |= target_means[t]->post(segregating_sites());
+        break;
+      case TARGET_VISITS:
+        update_classes();
+        target_sample.assign(class_sites.begin()+1, class_sites.end());
+        changed |= target_means[t]->post(&target_sample[0]);
+        break;
+    }
+  }
+  if (!changed) return;
+
+  converged = !target_kinds.empty();
+  for (size_t t=0; t < target_kinds.size() && converged; t++) {
+    const BatchMeans &bm = *target_means[t];
+    int worst = 0;
+    double se = bm.se(0);
+    for (int i=1; i < bm.size(); i++) {
+      double e = bm.se(i);
+      if (e > se) {
+        se = e;
+        worst = i;
+      }
+    }
+    converged = bm.batches() >= TARGET_BATCHES && se <= target_ses[t] && 
+      bm.lag1(worst) < 2/sqrt((double)bm.batches());
+  }
+}
+
+/* Print each target's precision,
+ *
+ *   gen: <g> convergence: <stat> n: <samples> [mean: <mean>] se: <se> ess: <ess> 
+ *     batches: <count>x<length> target: <se wanted>
+ *
+ * For visits, se is the largest of the counts' standard errors and ess the
+ * smallest of their effective sample sizes */
+void
+Population::stat_print_convergence(void) {
+  for (size_t t=0; t < target_kinds.size(); t++) {
+    const BatchMeans &bm = *target_means[t];
+    double se = bm.se(0), ess = bm.ess(0);
+    for (int i=1; i < bm.size(); i++) {
+      if (bm.se(i) > se) se = bm.se(i);
+      if (bm.ess(i) < ess) ess = bm.ess(i);
+    }
+    out << "gen: " << generation << " convergence: " << target_names[target_kinds[t]]
+      << " n: " << bm.count();
+    if (bm.size() == 1) out << " mean: " << bm.mean(0);
+    out << " se: " << se << " ess: " << ess << " batches: " << bm.batches() << "x" 
+      << bm.batch_length() << " target: " << target_ses[t] << '\n';
+  }
+}
+
 /* Print out the mean (over generations) of the generation-wise phenotype 
  * variance */
 void
 Population::stat_print_phenotype_var_mean(void) {
-  if (!Statistic::is_activated("phenotype-var-mean")) return;
-  cout << "gen: " << generation << " phenotype_var_mean: " << (*phenotype_var_mean)[0] << endl;
+  if (!Statistic::is_activated(STAT_PHENOTYPE_VAR_MEAN)) return;
+  out << "gen: " << generation << " phenotype_var_mean: " << phenotype_var_mean->mean(0) << '\n';
 }
 
 
 /* Print out the first and second moments for the change in allele frequency */
 void
 Population::stat_print_p_moments(void) {
-  if (!Statistic::is_activated("pmoments")) return;
-  cout << "gen: " << generation << " delta_p_first_moment:" << *delta_p_first_moment << endl;
-  cout << "gen: " << generation << " delta_p_second_moment:" << *delta_p_second_moment << endl;
+  if (!Statistic::is_activated(STAT_PMOMENTS)) return;
+  const Moments &m = *delta_p_moments;
+  int old_precision = out.precision(8);
+  out << "gen: " << generation << " delta_p_first_moment:";
+  for (int i=0; i < m.size(); i++)
+    out << " " << m.mean(i) << "," << m.count(i);
+  out << '\n';
+  out << "gen: " << generation << " delta_p_second_moment:";
+  for (int i=0; i < m.size(); i++)
+    out << " " << m.raw_second(i) << "," << m.count(i);
+  out << '\n';
+  out.precision(old_precision);
 }
 
 /* print out the segregating sites of all individuals in the population */
@@ -8,14 +8,60 @@
 
 #include "common.h"
 #include "genome.h"
-#include "running_mean.h"
+#include "moments.h"
+#include "quantile_sketch.h"
+#include "batch_means.h"
+#include "burnin.h"
+#include "trajectory.h"
+#include "genotype_file.h"
+#include "live.h"
+
+/* The sites whose derived allele counts may have changed since a statistic
+ * last looked, each listed once, so that the statistic need only look at
+ * those. Until it has first looked at every site (all is set), nothing is
+ * listed */
+class SiteChanges {
+public:
+  SiteChanges() : all(true) { }
+  inline void mark(mutation_loc loc) {
+    if (all) return;
+    if (loc >= marked.size()) marked.resize(loc+1, 0);
+    if (marked[loc]) return;
+    marked[loc] = 1;
+    locs.push_back(loc);
+  }
+  /* the statistic has looked at the sites listed, or at all of them */
+  void clear(void) {
+    for (size_t i=0; i < locs.size(); i++) marked[locs[i]] = 0;
+    locs.clear();
+    all = false;
+  }
+  /* the next look has to be at every site */
+  void reset(void) {
+    clear();
+    all = true;
+  }
+
+  bool all;
+  std::vector<mutation_loc> locs;
+
+private:
+  std::vector<char> marked;
+};
 
 class Population {
 public:
   Population(void);
-  ~Population() { }
+  ~Population();
   void setup_initial_genotypes(std::valarray<int> &hets, std::valarray<int> &homs);
+  void setup_initial_genotypes(std::valarray<int> &hets, std::valarray<int> &homs,
+    const std::valarray<double> &effects);
+  void setup_initial_genotypes(const GenotypeFile &g);
+  void export_genotypes(const std::string &path);
+  void stat_generation(void);
+  void stat_final(void);
   void stat_frequency_summary(void);
+  void stat_frequency_deltas(void);
   void stat_phenotype_summary(void);
   void stat_increment_visits(void);
   void stat_fixations(void);
@@ -25,17 +71,44 @@ public:
   void stat_print_phenotype_var_mean(void);
   static void stat_print_p_moments(void);
   static void stat_print_visits(void);
-  void compute_phenotype_moments(void);
-  void record_genotype(int indiv, mutation_loc loc, genotype g);
+  static void flush_visits(void);
+  static void stat_site_born(double effect);
+  static void stat_site_absorbed(double effect);
+  void count_segregating(void);
+  static void stat_sojourn_quantile(const Site &site, bool fixed);
+  void stat_update_quantiles(void);
+  static void stat_print_quantiles(bool final);
+  static void add_target(const char *stat, double se);
+  void stat_update_convergence(void);
+  static void stat_print_convergence(void);
+  void compute_phenotype_moments(bool force = false);
+  void stat_write_trajectory(TrajectoryWriter &w);
+  void stat_publish(LivePublisher &p);
+  static int visits_bins(void) { return visits.size(); }
+  /* set an individual's genotype at a site, noting the change in its count */
+  inline void record_genotype(int indiv, mutation_loc loc, genotype g) {
+    sites[loc].set_genotype(indiv, g);
+    site_changed(loc);
+  }
+  static inline void site_changed(mutation_loc loc) {
+    visits_changes.mark(loc);
+    frequency_changes.mark(loc);
+  }
   void populate_from(const Population &parpop);
   void clear_generation(void);
   void purge_lost(void);
   Population* other_view(void);
+  void reserve_sites(size_t n);
+  void phenotype_moments(double &mean, double &variance);
+  void genome_layout(const Genome *&first, size_t &stride) const;
   friend std::ostream& operator<<(std::ostream &s, const Population &p);
+  friend class Checkpoint;
 
   /* I need a few class functions */
   static mutation_loc create_site(double e);
   static void initialize(int N, Model m);
+  static void finalize(void);
+  static void next_generation(Population *pops, int &parent_pop, int &burnin);
 
   /* maximum fitness in the population, used for rejection sampling */
   double max_fitness;
@@ -44,6 +117,19 @@ public:
   static int num_loci;
   static int generation;
 
+  /* generations between full keyframes of the frequency-deltas statistic */
+  static int keyframe_every;
+
+  /* the quantiles statistic's probabilities, and generations between them */
+  static std::valarray<double> quantile_probs;
+  static int quantile_every;
+
+  /* ends the burnin once it's settled, with --burnin=auto */
+  static BurninDetector *burnin_detector;
+
+  /* set once every --target-se has been met, so the run can stop */
+  static bool converged;
+
   /* I keep records in two ways: A list of genomes, each of which contains 
    * the loci that have derived alleles in that individual, and a list of
    * sites which contain the genotypes of all the individuals for that site.
@@ -51,8 +137,17 @@ public:
   std::vector<Site> sites;
 
 private:
+  void place_initial_genotypes(std::valarray<int> &hets, std::valarray<int> &homs,
+    const std::valarray<double> *effects);
   std::vector<Genome*> genomes;
 
+  /* the genomes are allocated together, genome_stride bytes apart */
+  char *genome_block;
+  size_t genome_stride;
+
+  /* the genotypes of this view's sites */
+  GenotypeStore *store;
+
   /* These are only used by statistics, if requested */
   double phenotype_mean;
   double phenotype_variance;
@@ -84,10 +179,46 @@ private:
 
   /* use by statistics */
   static std::vector<int> visits;
+  static std::vector<int> delta_counts;        /* counts when last emitted, -1 if absent */
+  static std::vector<mutation_id> delta_ids;   /* site ids when last emitted */
+  static int delta_generations;                /* generations since the last keyframe */
   static std::map<double,int> fixations;
-  static RunningMean *delta_p_first_moment;
-  static RunningMean *delta_p_second_moment;
-  static RunningMean *phenotype_var_mean;
+
+  /* Kept up to date as sites change, rather than recomputed by scanning the
+   * sites every generation. visits is brought up to date lazily: each count
+   * class's visits are added when the number of sites in it changes, as 
+   * class_sites[c] * (visit_samples - class_since[c]) */
+  static std::vector<int> site_class;          /* each site's count when visits last looked */
+  static std::vector<int> class_sites;         /* segregating sites with each count */
+  static std::vector<int> class_since;         /* visit_samples when that last changed */
+  static int visit_samples;                    /* generations visits have been collected */
+  static bool segregating_live;                /* whether segregating is being kept */
+  static std::map<double,int> segregating;     /* segregating sites of each effect size */
+  static std::vector<int> freq_text_at;        /* offsets of each count's frequency text, */
+  static std::string freq_text;                /* formatted once, or -1 if not yet */
+  static std::vector<std::string> freq_blocks; /* the freqs line's text, FREQ_BLOCK sites each */
+  static std::vector<char> freq_formatted;     /* blocks formatted this time */
+  static SiteChanges visits_changes;           /* sites changed since visits looked, */
+  static SiteChanges frequency_changes;        /* and since frequencies did */
+  static void move_class(int from, int to);
+  void update_classes(void);
+  void format_frequencies(size_t block);
+  int segregating_sites(void);
+  void burnin_sample(double *x);
+
+  /* the quantiles statistic's sketches, by what they summarize (the
+   * SKETCH_ kinds) and effect size (0 for the phenotype variance) */
+  static std::map<std::pair<int,double>, QuantileSketch> sketches;
+
+  /* the convergence statistic's targets: what each tracks (the TARGET_
+   * kinds), the standard error it's to reach, and its batch means */
+  static std::vector<int> target_kinds;
+  static std::vector<double> target_ses;
+  static std::vector<BatchMeans*> target_means;
+  static std::vector<double> target_sample;    /* a generation's samples */
+
+  static Moments *delta_p_moments;             /* change in count, by the count before */
+  static Moments *phenotype_var_mean;
 };
 
 #endif /* __POPULATION_H__ */
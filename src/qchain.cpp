@@ -0,0 +1,180 @@
+/*
+ *  qchain.cpp
+ *
+ *  Exact results for a single site under quant's model, from its
+ *  Wright-Fisher chain (see wf_chain.h), in place of long simulations. In
+ *  the infinite sites model, for a new site of the given effect:
+ *
+ *    visits: <expected visits to each count, 1 to 2N-1>
+ *    absorption: loss: <p> fixation: <p> sojourn: <mean> loss_sojourn: <mean> fixation_sojourn: <mean>
+ *    sojourn: <t> loss: <p> fixation: <p>       (one line per generation t)
+ *
+ *  The visits line is in the form of quant's visits statistic, for sites
+ *  arising at rate 2N mu (N mu haploid) over --generations generations, so
+ *  it can be read and compared the same way. The mean sojourns by fate are
+ *  conditional on the fate. In the finite sites model, for a locus among
+ *  --loci:
+ *
+ *    stationary: <probability of each count, 0 to 2N>
+ *    visits: <expected visits to each count, 1 to 2N-1, over all the loci>
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "error_handling.h"
+#include "common.h"
+#include "wf_chain.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::vector;
+
+void usage(void);
+
+/* read a number, or complain about the option it was given to */
+double number(const char *s, const char *option) {
+  char *end;
+  double x = strtod(s, &end);
+  if (end == s || *end != '\0') throw SimUsageError(std::string("non-numeric ") + option);
+  return x;
+}
+
+int
+main(int argc, char **argv) { try {
+  int N = 100, loci = 1, max_sojourn = 0;
+  double s = 0.1, mu = 0.001, effect = 1.0, opt = 0.0, env = 0.0, background = 0.0;
+  double generations = 1.0, tail = 1e-6;
+  Model model = infinite_sites;
+  enum ploidy ploidy_level = diploid;
+
+  while (1) {
+    static struct option long_options[] = {
+      {"popsize", required_argument, 0, 'N'},
+      {"s", required_argument, 0, 's'},
+      {"mu", required_argument, 0, 'u'},
+      {"model", required_argument, 0, 'm'},
+      {"effect", required_argument, 0, 'e'},
+      {"opt", required_argument, 0, 'o'},
+      {"env", required_argument, 0, 'E'},
+      {"background", required_argument, 0, 'b'},
+      {"loci", required_argument, 0, 'l'},
+      {"haploid", no_argument, 0, 'h'},
+      {"generations", required_argument, 0, 'g'},
+      {"max-sojourn", required_argument, 0, 'M'},
+      {"tail", required_argument, 0, 'T'},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "N:s:u:m:e:o:E:b:l:hg:M:T:", long_options, &option_index);
+    if (c == -1) break;
+    switch (c) {
+      case 'N': N = (int)number(optarg, "popsize"); break;
+      case 's': s = number(optarg, "s"); break;
+      case 'u': mu = number(optarg, "mu"); break;
+      case 'm':
+        if (strcmp(optarg, "infinite") == 0) model = infinite_sites;
+        else if (strcmp(optarg, "finite") == 0) model = finite_sites;
+        else throw SimUsageError("invalid model");
+        break;
+      case 'e': effect = number(optarg, "effect"); break;
+      case 'o': opt = number(optarg, "opt"); break;
+      case 'E': env = number(optarg, "env"); break;
+      case 'b': background = number(optarg, "background"); break;
+      case 'l': loci = (int)number(optarg, "loci"); break;
+      case 'h': ploidy_level = haploid; break;
+      case 'g': generations = number(optarg, "generations"); break;
+      case 'M': max_sojourn = (int)number(optarg, "max-sojourn"); break;
+      case 'T': tail = number(optarg, "tail"); break;
+      default:
+        throw SimUsageError("unrecognized option");
+    }
+  }
+  if (optind != argc) throw SimUsageError("qchain takes no arguments besides options");
+  if (N < 1) throw SimUsageError("population size must be positive");
+  if (!(s > 0)) throw SimUsageError("s must be positive");
+  if (mu < 0) throw SimUsageError("negative mutation rate");
+  if (loci < 1) throw SimUsageError("must have at least one locus");
+  if (model == finite_sites && ploidy_level == haploid)
+    throw SimUsageError("haploid not implemented for finite sites model");
+  int n = (int)ploidy_level * N;
+  if (max_sojourn <= 0) max_sojourn = 20 * n;
+
+  WrightFisherChain chain(N, ploidy_level, model, effect, s, opt, env, background, mu / loci);
+  cout.precision(10);
+
+  if (model == finite_sites) {
+    vector<double> pi;
+    chain.stationary(pi);
+    cout << "stationary:";
+    for (int x=0; x <= n; x++) cout << " " << pi[x];
+    cout << endl << "visits:";
+    for (int x=1; x < n; x++) cout << " " << pi[x] * loci * generations;
+    cout << endl;
+    return 0;
+  }
+
+  vector<double> y, h, loss, fixed;
+  chain.visits(y);
+  chain.fixation(h);
+  double arising = n * mu * generations;
+  cout << "visits:";
+  for (int x=1; x < n; x++) cout << " " << y[x] * arising;
+  cout << endl;
+
+  /* the mean sojourns by fate, from the sites' visits and where they end up */
+  double total = 0.0, to_fixation = 0.0;
+  for (int x=1; x < n; x++) {
+    total += y[x];
+    to_fixation += y[x] * h[x];
+  }
+  double p_fix = h[1];
+  cout << "absorption: loss: " << 1.0 - p_fix << " fixation: " << p_fix
+    << " sojourn: " << total
+    << " loss_sojourn: " << (p_fix < 1.0 ? (total - to_fixation) / (1.0 - p_fix) : NAN)
+    << " fixation_sojourn: " << (p_fix > 0.0 ? to_fixation / p_fix : NAN) << endl;
+
+  chain.sojourn(max_sojourn, tail, loss, fixed);
+  for (int t=1; t < (int)loss.size(); t++)
+    cout << "sojourn: " << t << " loss: " << loss[t] << " fixation: " << fixed[t] << endl;
+
+/* catch any errors that were thrown anywhere inside this block */
+} catch (SimUsageError e) {
+   cerr << endl << "detected usage error: " << e.detail << endl << endl;
+   usage();
+   return 1;
+} catch(SimError &e) {
+   cerr << "uncaught exception: " << e.detail << endl;
+   return 1;
+} return 0; }
+
+/* print a help message */
+void
+usage(void) {
+  cerr << "usage: qchain [options]\n"
+    << "  -N/--popsize <int>    population size (100)\n"
+    << "  -s/--s <float>        Barton's selection parameter, as for quant (0.1)\n"
+    << "  -u/--mu <float>       mutation rate, as for quant (0.001)\n"
+    << "  -m/--model infinite|finite\n"
+    << "  -e/--effect <float>   the site's effect size (1)\n"
+    << "  -o/--opt <float>      the optimum (0)\n"
+    << "  -E/--env <float>      environmental noise, as for quant (0)\n"
+    << "  -b/--background <float> variance of the rest of the phenotype, averaged over (0)\n"
+    << "  -l/--loci <int>       number of finite sites loci, which share mu (1)\n"
+    << "  -h/--haploid          a haploid population (default is diploid)\n"
+    << "  -g/--generations <float> generations the visits are for (1)\n"
+    << "  -M/--max-sojourn <int> follow the sojourn distribution this long at most\n"
+    << "                        (20 times the copies of the site)\n"
+    << "  -T/--tail <float>     or until this much probability is left (1e-6)\n"
+    << "\n";
+  return;
+}
+
+/* END */
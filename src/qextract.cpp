@@ -0,0 +1,208 @@
+/*
+ *  qextract.cpp
+ *
+ *  Pull a range of generations, and optionally only some statistics, out of
+ *  quant output written with --index. Only the blocks that overlap the
+ *  range are read (and decompressed, if the output was written with
+ *  --gzip-output), so a window of a long run can be had without reading
+ *  the rest of the file. The cmd and params lines are always printed.
+ *
+ *  Statistics are selected by the word following the generation, as in
+ *  'gen: <g> freqs: ...', or the first word of lines without a generation,
+ *  as in 'mutations: ...'.
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <climits>
+
+#include "error_handling.h"
+#include "output.h"
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+using std::set;
+using std::ifstream;
+using std::stringstream;
+
+void usage(void);
+
+/* one line of the index */
+struct IndexEntry {
+  int first, last;
+  long long offset, bytes;
+};
+
+/* read the index written by quant --index */
+void read_index(const string &path, vector<IndexEntry> &entries) {
+  ifstream in(path.c_str());
+  if (!in) throw SimError(0, "cannot open index %s", path.c_str());
+  string line;
+  while (getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    stringstream s(line);
+    IndexEntry e;
+    if (!(s >> e.first >> e.last >> e.offset >> e.bytes))
+      throw SimError(0, "bad line in index %s: %s", path.c_str(), line.c_str());
+    entries.push_back(e);
+  }
+}
+
+/* read a block, inflating it if it's a gzip member */
+void read_block(int fd, const IndexEntry &e, string &text) {
+  string raw(e.bytes, '\0');
+  size_t done = 0;
+  while (done < raw.size()) {
+    ssize_t n = pread(fd, &raw[done], raw.size() - done, e.offset + done);
+    if (n <= 0) throw SimError(0, "failed to read block at offset %lld", e.offset);
+    done += n;
+  }
+  if (raw.size() < 2 || (unsigned char)raw[0] != 0x1f || (unsigned char)raw[1] != 0x8b) {
+    text.swap(raw);
+    return;
+  }
+
+  z_stream z;
+  memset(&z, 0, sizeof(z));
+  if (inflateInit2(&z, 15+16) != Z_OK) throw SimError("failed to start decompression");
+  z.next_in = (Bytef *)&raw[0];
+  z.avail_in = raw.size();
+  text.clear();
+  char buf[65536];
+  int err;
+  do {
+    z.next_out = (Bytef *)buf;
+    z.avail_out = sizeof(buf);
+    err = inflate(&z, Z_NO_FLUSH);
+    if (err != Z_OK && err != Z_STREAM_END) {
+      inflateEnd(&z);
+      throw SimError(0, "failed to decompress block at offset %lld", e.offset);
+    }
+    text.append(buf, sizeof(buf) - z.avail_out);
+  } while (err != Z_STREAM_END);
+  inflateEnd(&z);
+}
+
+/* the statistic a line belongs to, and its generation, or INT_MIN if none */
+string line_stat(const string &line, int &gen) {
+  gen = INT_MIN;
+  size_t start = 0;
+  if (line.compare(0, 5, "gen: ") == 0) {
+    char *end;
+    gen = strtol(line.c_str()+5, &end, 10);
+    start = end - line.c_str();
+    while (start < line.size() && line[start] == ' ') start++;
+  }
+  size_t stop = line.find_first_of(": ", start);
+  return line.substr(start, stop == string::npos ? string::npos : stop - start);
+}
+
+int
+main(int argc, char **argv) { try {
+  int from = INT_MIN, to = INT_MAX;
+  string index_path;
+  set<string> stats;
+
+  while (1) {
+    static struct option long_options[] = {
+      {"from", required_argument, 0, 'f'},
+      {"to", required_argument, 0, 't'},
+      {"stat", required_argument, 0, 's'},
+      {"index", required_argument, 0, 'i'},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "f:t:s:i:", long_options, &option_index);
+    if (c == -1) break;
+    char *end;
+    switch (c) {
+      case 'f':
+        from = strtol(optarg, &end, 10);
+        if (optarg == end) throw SimUsageError("non-numeric from generation");
+        break;
+      case 't':
+        to = strtol(optarg, &end, 10);
+        if (optarg == end) throw SimUsageError("non-numeric to generation");
+        break;
+      case 's':
+        stats.insert(string(optarg));
+        break;
+      case 'i':
+        index_path = string(optarg);
+        break;
+      default:
+        throw SimUsageError("unrecognized option");
+    }
+  }
+  if (optind != argc-1) throw SimUsageError("must give exactly one output file");
+  string path(argv[optind]);
+  if (index_path.empty()) index_path = path + ".idx";
+
+  vector<IndexEntry> entries;
+  read_index(index_path, entries);
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw SimError(0, "cannot open %s", path.c_str());
+
+  string text;
+  for (size_t i=0; i < entries.size(); i++) {
+    const IndexEntry &e = entries[i];
+    bool header = e.first < 0;
+    if (!header && (e.last < from || e.first > to)) continue;
+    read_block(fd, e, text);
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+      size_t nl = text.find('\n', pos);
+      if (nl == string::npos) nl = text.size();
+      string line = text.substr(pos, nl - pos);
+      pos = nl + 1;
+      if (!header) {
+        int gen;
+        string stat = line_stat(line, gen);
+        if (gen != INT_MIN && (gen < from || gen > to)) continue;
+        if (!stats.empty() && stats.count(stat) == 0) continue;
+      }
+      out << line << '\n';
+    }
+    out.end_generation();
+  }
+  close(fd);
+  out.finish();
+
+/* catch any errors that were thrown anywhere inside this block */
+} catch (SimUsageError e) {
+   cerr << endl << "detected usage error: " << e.detail << endl << endl;
+   usage();
+   return 1;
+} catch(SimError &e) {
+   cerr << "uncaught exception: " << e.detail << endl;
+   return 1;
+} return 0; }
+
+/* print a help message */
+void
+usage(void) {
+  cerr << "usage: qextract [options] <quant output>\n"
+    << "  -f/--from <int>       first generation to extract\n"
+    << "  -t/--to <int>         last generation to extract\n"
+    << "  -s/--stat <str>       only extract this statistic, e.g. freqs, pheno, site, absorption,\n"
+    << "                        mutations (may be given more than once)\n"
+    << "  -i/--index <file>     the index written by quant --index (default: <quant output>.idx)\n"
+    << "\n";
+  return;
+}
+
+/* END */
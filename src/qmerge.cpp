@@ -0,0 +1,138 @@
+/*
+ *  qmerge.cpp
+ *
+ *  Merge the quantile sketches printed by the 'quantiles' statistic at the
+ *  end of each of a number of quant runs (replicates, say), and print the
+ *  quantiles of the combined sketches, one line for each sketch name,
+ *
+ *    quantiles: <name> n: <count> <p>:<quantile> ...
+ *
+ *  in the same form quant prints them. Input files may be gzip compressed,
+ *  and standard input is read if no file is given.
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "error_handling.h"
+#include "output.h"
+#include "quantile_sketch.h"
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+using std::map;
+
+void usage(void);
+
+/* Read a 'gen: <g> sketch: <name> n: <count> <level>:<value> ...' line into
+ * its sketch */
+void read_sketch(const string &line, size_t at, map<string,QuantileSketch> &sketches) {
+  const char *p = line.c_str() + at + strlen(" sketch: ");
+  const char *name_end = strchr(p, ' ');
+  if (name_end == NULL || strncmp(name_end, " n: ", 4) != 0)
+    throw SimError(0, "bad sketch line: %.60s", line.c_str());
+  string name(p, name_end - p);
+  char *end;
+  long n = strtol(name_end + 4, &end, 10);
+
+  QuantileSketch s;
+  p = end;
+  while (*p == ' ') {
+    long level = strtol(p+1, &end, 10);
+    if (*end != ':') throw SimError(0, "bad sketch item in %s", name.c_str());
+    double v = strtod(end+1, &end);
+    s.insert((int)level, v);
+    p = end;
+  }
+  if (s.count() != n) throw SimError(0, "sketch %s doesn't add up to its count", name.c_str());
+
+  map<string,QuantileSketch>::iterator it = sketches.find(name);
+  if (it == sketches.end()) sketches.insert(std::make_pair(name, s));
+  else it->second.merge(s);
+}
+
+int
+main(int argc, char **argv) { try {
+  double default_probs[] = { 0.001, 0.05, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 0.999 };
+  vector<double> probs(default_probs, default_probs + 10);
+
+  while (1) {
+    static struct option long_options[] = {
+      {"probs", required_argument, 0, 'p'},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "p:", long_options, &option_index);
+    if (c == -1) break;
+    switch (c) {
+      case 'p': {
+        probs.clear();
+        char *p = optarg, *end;
+        while (*p != '\0') {
+          double x = strtod(p, &end);
+          if (end == p || x < 0 || x > 1) throw SimUsageError("probabilities must be between 0 and 1");
+          probs.push_back(x);
+          p = *end == ',' ? end+1 : end;
+          if (*end != ',' && *end != '\0') throw SimUsageError("probabilities must be separated by commas");
+        }
+        break;
+      }
+      default:
+        throw SimUsageError("unrecognized option");
+    }
+  }
+
+  vector<string> paths(argv + optind, argv + argc);
+  if (paths.empty()) paths.push_back("");
+  map<string,QuantileSketch> sketches;
+  string line;
+  for (size_t i=0; i < paths.size(); i++) {
+    gzFile in = paths[i].empty() ? gzdopen(dup(STDIN_FILENO), "rb") : gzopen(paths[i].c_str(), "rb");
+    if (in == NULL) throw SimError(0, "cannot open %s", paths[i].empty() ? "stdin" : paths[i].c_str());
+    while (read_line(in, line)) {
+      size_t at = line.find(" sketch: ");
+      if (line.compare(0, 5, "gen: ") == 0 && at != string::npos) read_sketch(line, at, sketches);
+    }
+    gzclose(in);
+  }
+
+  for (map<string,QuantileSketch>::iterator it = sketches.begin(); it != sketches.end(); it++) {
+    out << "quantiles: " << it->first << " n: " << it->second.count();
+    for (size_t i=0; i < probs.size(); i++)
+      out << " " << probs[i] << ":" << it->second.quantile(probs[i]);
+    out << '\n';
+  }
+  out.end_generation();
+  out.finish();
+
+/* catch any errors that were thrown anywhere inside this block */
+} catch (SimUsageError e) {
+   cerr << endl << "detected usage error: " << e.detail << endl << endl;
+   usage();
+   return 1;
+} catch(SimError &e) {
+   cerr << "uncaught exception: " << e.detail << endl;
+   return 1;
+} return 0; }
+
+/* print a help message */
+void
+usage(void) {
+  cerr << "usage: qmerge [options] [quant output ...]\n"
+    << "  -p/--probs <list>     quantiles to print\n"
+    << "                        (default: 0.001,0.05,0.1,0.25,0.5,0.75,0.9,0.95,0.99,0.999)\n"
+    << "\n";
+  return;
+}
+
+/* END */
@@ -0,0 +1,236 @@
+/*
+ *  qtheory.cpp
+ *
+ *  Evaluate the infinite sites model's mean-field theory over a grid of
+ *  population sizes, selection parameters and mutation rates, in parallel,
+ *  and print it as a table (with a header line) that R can read with
+ *  read.table(header=TRUE) and merge against quant's params (popsize, s,
+ *  mu and ploidy are named as on quant's params line). For each point
+ *  of the grid, the phenotype variance is the root of f.diploid (or
+ *  f.haploid) of modeling/phenotypic_variance.r, generalized to a mixture of
+ *  effect sizes, and each effect size's sites follow the Poisson random
+ *  field for selection against that variance (see stationary.h).
+ *
+ *  The summary table has a row for each point and effect size:
+ *
+ *    popsize s mu ploidy effect v segsites neutral_segsites fixation sojourn
+ *
+ *  with the expected number of segregating sites of the effect, what it
+ *  would be without selection, and the fixation probability and expected
+ *  sojourn (in generations) of a new mutation of the effect. s is quant's s
+ *  (the width of the fitness function is 1/s), and mu is the rate for all
+ *  effects together, as given to quant.
+ *
+ *  The spectrum table (--table=spectrum) has a row for each point, effect
+ *  size and derived allele count, 1 to 2N-1 (N-1 haploid), the counts of
+ *  quant's visits statistic:
+ *
+ *    popsize s mu ploidy effect count sites sojourn
+ *
+ *  with the expected number of the effect's sites at the count in any one
+ *  generation (the stationary density; visits over generations), and the
+ *  expected generations a new mutation spends there (the sojourn density).
+ *
+ *  Each axis is a comma-separated list of values, or from:to:length for
+ *  length evenly spaced values, as R's seq(from, to, length.out=length).
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <valarray>
+
+#include "error_handling.h"
+#include "command_line.h"
+#include "stationary.h"
+#include "threadpool.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::stringstream;
+using std::vector;
+using std::valarray;
+
+void usage(void);
+
+/* read an axis, either a comma-separated list or from:to:length */
+void parse_axis(const char *s, valarray<double> &x) {
+  if (strchr(s, ':') == NULL) {
+    valdouble_from_string(s, x);
+    return;
+  }
+  char *end;
+  double from = strtod(s, &end);
+  if (*end != ':') throw SimUsageError("axes are from:to:length");
+  double to = strtod(end+1, &end);
+  if (*end != ':') throw SimUsageError("axes are from:to:length");
+  long length = strtol(end+1, &end, 10);
+  if (*end != '\0' || length < 1) throw SimUsageError("an axis needs a positive length");
+  x.resize(length);
+  for (long i=0; i < length; i++)
+    x[i] = length == 1 ? from : from + (to - from) * i / (length - 1);
+}
+
+/* One point of the grid. Its rows are kept to be printed in grid order */
+class TheoryPoint : public PoolTask {
+public:
+  TheoryPoint(int N, double s, double mu, enum ploidy p, const valarray<double> &effects,
+      const valarray<double> &probs, bool spectrum) : N(N), s(s), mu(mu), ploidy_level(p),
+      effects(effects), probs(probs), spectrum(spectrum) { }
+  void run(int worker);
+
+  int N;
+  double s, mu;
+  enum ploidy ploidy_level;
+  valarray<double> effects, probs;
+  bool spectrum;
+  string rows;
+};
+
+void
+TheoryPoint::run(int) {
+  Stationary st(N, ploidy_level, mu, 1.0/s);
+  double v = st.infinite_sites_variance(effects, probs);
+  stringstream r;
+  r.precision(10);
+  vector<double> e;
+  for (int k=0; k < (int)effects.size(); k++) {
+    double mu_k = mu * probs[k] / probs.sum();
+    /* at a mutation rate of 1, a new mutation arises at each of the n
+     * copies each generation, so the spectrum over n is the sojourn */
+    st.site_spectrum(effects[k], 1.0, v, e);
+    int n = (int)e.size() - 1;
+    if (spectrum) {
+      for (int c=1; c < n; c++) {
+        r << N << " " << s << " " << mu << " " << (ploidy_level == diploid ? "diploid" : "haploid")
+          << " " << effects[k] << " " << c << " " << e[c] * mu_k << " " << e[c] / n << "\n";
+      }
+      continue;
+    }
+    double sojourn = 0.0, harmonic = 0.0;
+    for (int c=1; c < n; c++) sojourn += e[c];
+    for (int c=1; c < n; c++) harmonic += 1.0 / c;
+    sojourn /= n;
+    r << N << " " << s << " " << mu << " " << (ploidy_level == diploid ? "diploid" : "haploid")
+      << " " << effects[k] << " " << v << " " << sojourn * n * mu_k << " " << 2.0*n*mu_k*harmonic
+      << " " << st.fixation_probability(effects[k], v) << " " << sojourn << "\n";
+  }
+  rows = r.str();
+}
+
+int
+main(int argc, char **argv) { try {
+  valarray<double> popsizes(1000.0, 1), ss(0.1, 1), mus(0.001, 1), effects(1.0, 1), probs;
+  enum ploidy ploidy_level = diploid;
+  bool spectrum = false;
+  int threads = 0;
+
+  while (1) {
+    static struct option long_options[] = {
+      {"popsize", required_argument, 0, 'N'},
+      {"s", required_argument, 0, 's'},
+      {"mu", required_argument, 0, 'u'},
+      {"effects", required_argument, 0, 'e'},
+      {"eprobs", required_argument, 0, 'p'},
+      {"haploid", no_argument, 0, 'h'},
+      {"table", required_argument, 0, 'T'},
+      {"threads", required_argument, 0, 't'},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "N:s:u:e:p:hT:t:", long_options, &option_index);
+    if (c == -1) break;
+    switch (c) {
+      case 'N': parse_axis(optarg, popsizes); break;
+      case 's': parse_axis(optarg, ss); break;
+      case 'u': parse_axis(optarg, mus); break;
+      case 'e': valdouble_from_string(optarg, effects); break;
+      case 'p': valdouble_from_string(optarg, probs); break;
+      case 'h': ploidy_level = haploid; break;
+      case 'T':
+        if (strcmp(optarg, "summary") == 0) spectrum = false;
+        else if (strcmp(optarg, "spectrum") == 0) spectrum = true;
+        else throw SimUsageError("table must be summary or spectrum");
+        break;
+      case 't': {
+        char *end;
+        threads = strtol(optarg, &end, 10);
+        if (optarg == end) throw SimUsageError("non-numeric number of threads");
+        break;
+      }
+      default:
+        throw SimUsageError("unrecognized option");
+    }
+  }
+  if (optind != argc) throw SimUsageError("qtheory takes no arguments besides options");
+  if (probs.size() == 0) {
+    if (effects.size() != 1) throw SimUsageError("must specify effect size probabilities");
+    probs.resize(1, 1.0);
+  }
+  if (probs.size() != effects.size())
+    throw SimUsageError("effect sizes and effect probabilities must be same length");
+  if (probs.min() < 0 || probs.sum() <= 0) throw SimUsageError("invalid effect probabilities");
+  /* evenly spaced population sizes are rounded */
+  popsizes = popsizes.apply(round);
+  if (popsizes.min() < 1) throw SimUsageError("population sizes must be positive");
+  if (ss.min() <= 0) throw SimUsageError("s must be positive");
+  if (mus.min() < 0) throw SimUsageError("negative mutation rate");
+
+  /* the grid, in the order its rows are printed */
+  vector<TheoryPoint*> grid;
+  for (size_t i=0; i < popsizes.size(); i++)
+    for (size_t j=0; j < ss.size(); j++)
+      for (size_t k=0; k < mus.size(); k++)
+        grid.push_back(new TheoryPoint((int)popsizes[i], ss[j], mus[k], ploidy_level, effects, probs, spectrum));
+
+  /* the largest populations take longest, so go first */
+  WorkStealingPool pool(threads);
+  for (int i=(int)grid.size()-1; i >= 0; i--) pool.add(grid[i]);
+  pool.run();
+  if (pool.errors().size() > 0) throw SimError(0, "%s", pool.errors()[0].c_str());
+
+  if (spectrum) cout << "popsize s mu ploidy effect count sites sojourn" << endl;
+  else cout << "popsize s mu ploidy effect v segsites neutral_segsites fixation sojourn" << endl;
+  for (size_t i=0; i < grid.size(); i++) {
+    cout << grid[i]->rows;
+    delete grid[i];
+  }
+
+/* catch any errors that were thrown anywhere inside this block */
+} catch (SimUsageError e) {
+   cerr << endl << "detected usage error: " << e.detail << endl << endl;
+   usage();
+   return 1;
+} catch(SimError &e) {
+   cerr << "uncaught exception: " << e.detail << endl;
+   return 1;
+} return 0; }
+
+/* print a help message */
+void
+usage(void) {
+  cerr << "usage: qtheory [options]\n"
+    << "  -N/--popsize <axis>   population sizes (1000)\n"
+    << "  -s/--s <axis>         Barton's selection parameter, as for quant (0.1)\n"
+    << "  -u/--mu <axis>        mutation rates, as for quant (0.001)\n"
+    << "  -e/--effects <vec>    effect sizes (1)\n"
+    << "  -p/--eprobs <vec>     effect size probabilities\n"
+    << "  -h/--haploid          a haploid population (default is diploid)\n"
+    << "  -T/--table summary|spectrum\n"
+    << "      summary: variance, segregating sites, fixation and sojourn of each effect\n"
+    << "      spectrum: expected sites and sojourn at each derived allele count\n"
+    << "  -t/--threads <int>    number of worker threads (default: one per core)\n"
+    << "Axes are comma-separated values, or from:to:length for evenly spaced ones\n"
+    << "\n";
+  return;
+}
+
+/* END */
@@ -10,6 +10,8 @@
 #include <valarray>
 #include <vector>
 #include <iostream>
+#include <sstream>
+#include <memory>
 
 #include "error_handling.h"
 #include "command_line.h"
@@ -18,8 +20,14 @@
 #include "population.h"
 #include "common.h"
 #include "statistic.h"
-
-#define OFFSPRING_POP (1-parent_pop)
+#include "lockstep.h"
+#include "island.h"
+#include "frequency_engine.h"
+#include "branch.h"
+#include "output.h"
+#include "checkpoint.h"
+#include "run_cache.h"
+#include "stationary.h"
 
 using std::valarray;
 using std::vector;
@@ -42,12 +50,63 @@ main(int argc, char **argv) { try {
 
   /* read in the command line arguments and print them out */
   Args ar(argc, argv);
-  cout << ar << endl;
+  out.set_gzip(ar.gzip_output);
+  if (!ar.index_file.empty()) out.set_index(ar.index_file, ar.index_every);
+  std::stringstream params;
+  params << ar << '\n';
+  out << params.str();
+  /* the parameters are a block of their own, so they can always be extracted */
+  out.end_block();
+
+  /* several replicates simulated side by side use their own engine */
+  if (ar.lanes > 0) {
+    run_lockstep(ar);
+    out.finish();
+    return 0;
+  }
+
+  /* as does the structured population */
+  if (ar.demes > 0) {
+    Island island(ar);
+    island.run();
+    out.finish();
+    return 0;
+  }
+
+  /* the frequency engine writes through out, as the simulation does */
+  if (ar.engine == engine_frequency) {
+    FrequencyEngine engine(ar);
+    engine.run();
+    out.finish();
+    return 0;
+  }
+
+  /* a run that's been done before is read back from the cache. Otherwise
+   * its output is kept as it's written, and if it extends a cached run,
+   * that run's output is replayed and the simulation picks up from its end */
+  std::unique_ptr<RunCache> cache;
+  if (!ar.cache_dir.empty()) {
+    cache.reset(new RunCache(ar.cache_dir, ar, argv[0]));
+    if (cache->find()) {
+      cache->replay();
+      out.finish();
+      return 0;
+    }
+    cache->begin();
+    if (cache->find_prefix()) {
+      cache->replay();
+      ar.resume_file = cache->prefix_checkpoint();
+    }
+  }
 
   /* set up simulation-wide genome parameters */
   Genome::initialize(ar.mu, 2.0/ar.s, ar.opts[0], ar.env);
   Site::ploidy_level = ar.ploidy_level;
+  GenotypeStore::configure(ar.genotype_dir, (size_t)(ar.genotype_memory * 1048576));
   Population::initialize(ar.popsize, ar.sites_model);
+  if (ar.auto_burnin) Population::burnin_detector = new BurninDetector(3, ar.popsize);
+  for (size_t i=0; i < ar.target_stats.size(); i++)
+    Population::add_target(ar.target_stats[i].c_str(), ar.target_ses[i]);
   /* set the optimum to the first one */
   Genome::new_optimum(ar.opts[0]);
 
@@ -55,10 +114,13 @@ main(int argc, char **argv) { try {
    * one for the parent generation and one for the offspring generation */
   Population *pops = new Population[2];
 
+  /* a resumed run takes its sites and genotypes from the checkpoint */
+  bool resuming = !ar.resume_file.empty();
+
   /* model-specific setup */
   if (ar.sites_model == infinite_sites) {
     GenomeInfiniteSites::setup_effect_probabilities(ar.effect_probabilities, ar.effect_sizes);
-  } else {
+  } else if (!resuming && ar.genotypes_file.empty()) {
     /* loop over loci counts for each effect size and make a site with this effect */
     for (int i=0; i < (int)ar.loci_counts.size(); i++) {
       for (int j=0; j < ar.loci_counts[i]; j++) {
@@ -73,7 +135,7 @@ main(int argc, char **argv) { try {
   }
 
   /* initial frequencies, read in from standard input */
-  if (ar.nloci > 0) {
+  if (ar.nloci > 0 && !resuming && !ar.stationary_freqs()) {
     if (ar.ploidy_level == haploid) 
       throw SimError("haploid version doesn't support frequencies on stdin");
     valarray<int> heterozygotes(ar.nloci);
@@ -96,94 +158,156 @@ main(int argc, char **argv) { try {
     pops[0].setup_initial_genotypes(heterozygotes, derived_homozygotes);
   }
 
-  /* I use Dicks' trick of flipping back and forth between populations 
-   * There's a macro OFFSPRING_POP which is defined as (1-parent_pop) to
-   * make the code as readable as possible */
+  /* or drawn from the stationary distribution, near equilibrium */
+  if (ar.stationary_freqs() && !resuming) {
+    Stationary st(ar.popsize, ar.ploidy_level, ar.mu, 1.0/ar.s);
+    vector<int> counts;
+    vector<double> effects;
+    double v;
+    if (ar.sites_model == infinite_sites)
+      st.sample_sites(ar.effect_sizes, ar.effect_probabilities, effects, counts, v);
+    else
+      st.sample_loci(ar.effect_sizes, ar.loci_counts, counts, v);
+    valarray<int> heterozygotes(counts.size());
+    valarray<int> derived_homozygotes(counts.size());
+    for (int i=0; i < (int)counts.size(); i++) 
+      Stationary::hardy_weinberg(counts[i], ar.popsize, ar.ploidy_level, 
+        heterozygotes[i], derived_homozygotes[i]);
+    if (ar.sites_model == finite_sites) {
+      pops[0].setup_initial_genotypes(heterozygotes, derived_homozygotes);
+    } else if (counts.size() > 0) {
+      valarray<double> site_effects(&effects[0], effects.size());
+      pops[0].setup_initial_genotypes(heterozygotes, derived_homozygotes, site_effects);
+    }
+    if (Statistic::is_activated(STAT_BURNIN))
+      out << "stationary sites: " << counts.size() << " variance: " << v << '\n';
+  }
+
+  /* or the whole initial state, from a genotype file */
+  if (!ar.genotypes_file.empty() && !resuming) {
+    GenotypeFile g(ar.genotypes_file);
+    pops[0].setup_initial_genotypes(g);
+  }
+
+  /* I use Dicks' trick of flipping back and forth between populations. 
+   * Population::next_generation() fills the other view from pops[parent_pop]
+   * and flips parent_pop */
   int parent_pop = 0;
 
   /* epochs correspond to periods between which opt is constant and across which it changes */
   Population::generation = 0;
-  for (int epoch=0; epoch < (int)ar.times.size(); epoch++) {
+  Population::keyframe_every = ar.keyframe_every;
+  Population::quantile_probs = ar.quantile_probs;
+  Population::quantile_every = ar.quantile_every;
+  bool branched = false;
+  /* opened once the burnin is over, as branches each write their own */
+  TrajectoryWriter *trajectory = NULL;
+  LivePublisher *live = NULL;
+
+  /* pick up where a checkpointed run left off */
+  LoopState loop = { 0, 0 };
+  if (resuming) {
+    Checkpoint::read(ar.resume_file, ar, pops, loop);
+    parent_pop = loop.parent_pop;
+  }
+  if (!ar.checkpoint_file.empty()) Checkpoint::install_signal_handlers();
+
+  /* runs to the end of the last epoch, or until the --target-se
+   * statistics have converged */
+  for (int epoch=loop.epoch; epoch < (int)ar.times.size() && !Population::converged; epoch++) {
     /* update the optimum, for the first epoch, this has been done above */
     if (epoch > 0) Genome::new_optimum(ar.opts[epoch]);
 
-    while (Population::generation < ar.times[epoch]) {
+    while (Population::generation < ar.times[epoch] && !Population::converged) {
+      /* the generation this iteration's output is labelled with */
+      int output_gen = Population::generation;
+      bool burning_in = ar.burnin > 0;
+
+      /* Once the burnin is over, split into branches. The parent only
+       * collects the branches' output, and each child carries on from 
+       * here with its own seed and parameters */
+      if (ar.branches > 0 && ar.burnin == 0 && !branched) {
+        branched = true;
+        int k = fork_branches(ar);
+        if (k < 0) return 0;
+        setup_branch(ar, k);
+      }
+
       /* only print output if we've discarded the burnin */
       if (ar.burnin <= 0) {
-        pops[parent_pop].stat_frequency_summary();
-        pops[parent_pop].stat_increment_visits();
-        pops[parent_pop].stat_fixations();
-        pops[parent_pop].stat_segsites();
-
-        /* first compute the phenotype moments, so the next two statistics can 
-         * use them */
-        pops[parent_pop].compute_phenotype_moments();
-        pops[parent_pop].stat_phenotype_summary();
-        pops[parent_pop].stat_update_phenotype_var_mean();
+        if (!ar.trajectory_file.empty()) {
+          if (trajectory == NULL) 
+            trajectory = new TrajectoryWriter(ar.trajectory_file, ar.popsize, (int)ar.ploidy_level);
+          pops[parent_pop].stat_write_trajectory(*trajectory);
+        }
+        if (!ar.publish_name.empty() && Population::generation % ar.publish_every == 0) {
+          if (live == NULL) 
+            live = new LivePublisher(ar.publish_name, ar.popsize, (int)ar.ploidy_level, Population::visits_bins());
+          pops[parent_pop].stat_publish(*live);
+        }
+        pops[parent_pop].stat_generation();
       } 
 
       /* advance the population simulation one generation */
-      pops[OFFSPRING_POP].populate_from(pops[parent_pop]);
+      Population::next_generation(pops, parent_pop, ar.burnin);
 
-#ifdef EXTRA_CHECKS
-      /* Check the new generation */
-      for (int i=0; i < ar.popsize; i++) {
-        pops[OFFSPRING_POP].genomes[i]->check();
-      }
-#endif /* EXTRA_CHECKS */
-
-      /* It's important to update the p_moments just after the next generation is
-       * generated. This is becuase stat_update_p_moments refers to the receiver
-       * (pops[OFFSPRING_POP]) as the current generation and the other population 
-       * view as the parental generation for computing changes in allele frequencies.
-       * And it's important to run it before lost sites are purged, becuase those 
-       * decreases in allele frequencies would be missed (as purged sites are not 
-       * counted) */
-      if (ar.burnin <= 0)
-        pops[OFFSPRING_POP].stat_update_p_moments();
-
-      /* Clear the parents' genomes, to make room for the next generation. Also,
-       * this allows us to safely purge sites that have been lost in the child 
-       * generation (becuase they'll also be zeroed in the parent generation) */
-      pops[parent_pop].clear_generation();
-
-      /* if we're using the infinite sites model, we should do some cleanup */
-      if (ar.sites_model == infinite_sites)
-        pops[OFFSPRING_POP].purge_lost();
-
-      /* generations start counting after the burnin is over */
-      if (ar.burnin == 0 && Population::generation == 0 && Statistic::is_activated("burnin"))
-        cout << "end burnin" << endl;
-      if (ar.burnin <= 0) {
-        Population::generation++;
-        if (Population::generation == 0) {
-          if (Statistic::is_activated("burnin"))
-            cout << "burnin mutations: " << Genome::mutation_count << endl;
-          Genome::mutation_count = 0;
+      /* Pass this generation's output on to be written. The burnin's
+       * output, all labelled generation 0, goes in blocks of its own, so
+       * the indexed blocks after it start with generation 0 */
+      out.end_generation(output_gen);
+      if (burning_in && ar.burnin <= 0) out.end_block();
+
+      /* checkpoint, if one is due or has been asked for by a signal */
+      if (!ar.checkpoint_file.empty() && (checkpoint_requested || (ar.checkpoint_every > 0 && 
+          ar.burnin <= 0 && Population::generation % ar.checkpoint_every == 0))) {
+        LoopState here = { epoch, parent_pop };
+        Checkpoint::write(ar.checkpoint_file, ar, pops, here);
+        cerr << "checkpoint: gen: " << Population::generation << " file: " << ar.checkpoint_file << endl;
+        if (checkpoint_requested == CHECKPOINT_STOP) {
+          if (trajectory != NULL) {
+            trajectory->close();
+            delete trajectory;
+          }
+          delete live;
+          out.finish();
+          return 2;
         }
-      } else {
-        ar.burnin--;
+        checkpoint_requested = 0;
       }
-
-      /* swap the parent and offspring in preparation for the next gen */
-      parent_pop = OFFSPRING_POP;
+      if (Population::converged) 
+        cerr << "converged: gen: " << Population::generation << endl;
     }
   } /* end of main loop */
 
+  /* a cached run keeps its state here, for longer runs to carry on from */
+  if (cache) {
+    LoopState here = { (int)ar.times.size()-1, parent_pop };
+    cache->end_loop(ar, pops, here);
+  }
+
   /* print the final state */
-  pops[parent_pop].stat_frequency_summary();
-  pops[parent_pop].compute_phenotype_moments();
-  pops[parent_pop].stat_phenotype_summary();
-  pops[parent_pop].stat_segsites();
-  Population::stat_print_visits();
-  Population::stat_print_p_moments();
-  /* update the phenotype_var_mean one last time. It will be an average over 
-   * g+1 generations, including the initial population and g offspring 
-   * populations */
-  pops[parent_pop].stat_update_phenotype_var_mean();
-  pops[parent_pop].stat_print_phenotype_var_mean();
-  if (Statistic::is_activated("mutation")) 
-    cout << "mutations: " << Genome::mutation_count << endl;
+  if (!ar.trajectory_file.empty()) {
+    if (trajectory == NULL) 
+      trajectory = new TrajectoryWriter(ar.trajectory_file, ar.popsize, (int)ar.ploidy_level);
+    pops[parent_pop].stat_write_trajectory(*trajectory);
+    trajectory->close();
+    delete trajectory;
+  }
+  if (!ar.publish_name.empty()) {
+    if (live == NULL) 
+      live = new LivePublisher(ar.publish_name, ar.popsize, (int)ar.ploidy_level, Population::visits_bins());
+    pops[parent_pop].stat_publish(*live);
+    delete live;
+  }
+  pops[parent_pop].stat_final();
+  if (!ar.export_genotypes_file.empty())
+    pops[parent_pop].export_genotypes(ar.export_genotypes_file);
+  out.end_generation(Population::generation);
+  if (cache) {
+    cache->commit();
+    cache.reset();
+  }
+  out.finish();
 
 /* catch any errors that were thrown anywhere inside this block */
 } catch (SimUsageError e) {
@@ -211,22 +335,76 @@ usage(void) {
     << "  -s/--s <float>        Barton's selection parameter\n"
     << "  --seed=<int>          seed for random number generator\n"
     << "  --burnin=<int>        number of generations of burnin discarded\n"
+    << "  --burnin=auto[:<int>] end the burnin once the segregating sites, phenotype variance and\n"
+    << "                        mutation-absorption balance have settled (MSER), after at most\n"
+    << "                        this many generations (20N)\n"
     << "  --env=<float>         environmental variance\n"
     << "  --haploid             use a haploid population (default is diploid)\n"
+    << "  --lockstep=<8|16>     simulate 8 or 16 independent replicates side by side, each\n"
+    << "                        one's output prefixed by 'rep: <k>' (finite sites only)\n"
+    << "  --checkpoint=<file>   write the full state of the run here on SIGUSR1 (and carry on),\n"
+    << "                        or SIGTERM (and exit with status 2)\n"
+    << "  --checkpoint-every=<int> also write a checkpoint every this many generations\n"
+    << "  --resume=<file>       carry on from a checkpoint; give the same arguments as the\n"
+    << "                        checkpointed run\n"
+    << "  --genotypes=<file>    start from the genotypes in a binary genotype file (see\n"
+    << "                        genotype_file.h), instead of initial frequencies and loci\n"
+    << "  --export-genotypes=<file> write the final genotypes to a binary genotype file\n"
+    << "  --publish=<name>      publish a snapshot of the sites, phenotype moments and visits\n"
+    << "                        to the POSIX shared memory segment <name> (see live.h, and qwatch)\n"
+    << "  --publish-every=<int> generations between published snapshots (1)\n"
+    << "  --genotype-memory=<MB> keep at most this much of the genotypes in memory, and the\n"
+    << "                        rest in files, streamed through a generation at a time\n"
+    << "  --genotype-dir=<dir>  where to put genotype files beyond the memory limit (/tmp)\n"
+    << "  --cache=<dir>         read the output of a run done before from this cache, or add\n"
+    << "                        this run to it; longer runs carry on from shorter ones\n"
+    << "  --trajectory=<file>   also write site counts and phenotype moments each generation\n"
+    << "                        to a compressed binary file (see trajectory.h, and trajtext)\n"
+    << "  --index=<file>        write an index of the output's blocks of generations to file, for\n"
+    << "                        qextract; with --gzip-output, each block is compressed separately\n"
+    << "  --index-every=<int>   generations per indexed block (1000)\n"
+    << "  --keyframe-every=<int> generations between full keyframes of frequency-deltas (1000)\n"
+    << "  --gzip-output         gzip compress the output\n"
+    << "  --crn                 common random numbers: separate random streams for parent choice,\n"
+    << "                        segregation, mutation, effect sizes and environment, so runs that\n"
+    << "                        share a seed can be compared pairwise across parameter values\n"
+    << "Branching (share one burnin among several continuations):\n"
+    << "  --branches=<int>      after the burnin, fork this many branches, each with its own seed\n"
+    << "  --branch-mu=<float vec> per-branch mutation rate (comma-separated)\n"
+    << "  --branch-opts=<vecs>  per-branch optima, each branch's vector separated by ':'\n"
+    << "  --branch-times=<vecs> per-branch epoch end times, each branch's vector separated by ':'\n"
+    << "Frequency engine (a fast approximation for large populations, see frequency_engine.h):\n"
+    << "  --engine=individual|frequency  simulate individuals (the default), or draw each\n"
+    << "                        site's next derived allele count from a binomial\n"
+    << "  --threads=<int>       threads the frequency engine draws the sites on (one per core)\n"
+    << "Island model options (finite sites only):\n"
+    << "  --demes=<int>         number of demes, each of size N, each simulated on its own thread\n"
+    << "  --migration=<float vec> a single migration rate, split evenly among the other demes,\n"
+    << "                        or a demes x demes matrix (row-major, source by destination)\n"
+    << "  --deme-opts=<float vec> per-deme offsets added to each epoch's optimum\n"
     << "Infinite-sites-specific options:\n"
     << "  --eprobs=<double vec> effect size probabilities (comma-separated)\n"
     << "Finite-sites-specific options:\n"
     << "  --loci=<int vec>      number of loci of each effect size (comma-separated)\n"
     << "Initial frequency initialization:\n"
-    << "  --freqs stdin | even   method for initializing frequencies\n"
+    << "  --freqs stdin | even | stationary   method for initializing frequencies\n"
     << "      stdin: read in frequencies from standard input\n"
     << "      even: evenly spaced. ith freq is i/(1+n) where n is the number of loci\n"
+    << "      stationary: draw the sites (infinite, with --loci=0) or the loci's frequencies\n"
+    << "        (finite) from the stationary distribution of the diffusion, near equilibrium\n"
     << "Statistics control:\n"
     << "  --enable-stat=<str>   enable a statistic\n"
     << "  --disable-stat=<str>  disable a statistic\n"
     << "  --disable-all-stats   turn off all statistics (must precede enable options)\n"
+    << "  --stat-every=<str>:<int>  collect a statistic only every so many generations (1);\n"
+    << "                        its final value is always printed\n"
+    << "  --quantile-probs=<list>  quantiles the quantiles statistic prints\n"
+    << "                        (0.001,0.05,0.1,0.25,0.5,0.75,0.9,0.95,0.99,0.999)\n"
+    << "  --quantile-every=<int>  print them every so many generations too (0: only at the end)\n"
     << "      Available statistics (default):\n"
     << "        frequencies         print allele IDs and frequencies (on)\n"
+    << "        frequency-deltas    print only changes in derived allele counts, with periodic\n"
+    << "                            keyframes; undelta rebuilds the frequencies (off)\n"
     << "        phenotype           mean phenotype and variance (on)\n"
     << "        phenotype-var-mean  mean (over generations) of each generation's phenotype variance (off)\n"
     << "        mutation            ID and generation for each new mutation (on)\n"
@@ -236,6 +414,14 @@ usage(void) {
     << "        fixations           number of fixations of each effect size (off)\n"
     << "        segsites            number of segregating sites of each effect size (off)\n"
     << "        pmoments            empirical first and second moments of the change in allele frequency (off)\n"
+    << "        fst                 Wright's Fst among demes, for the island model (off)\n"
+    << "        quantiles           quantile sketches of sojourn times by fate and of segregating\n"
+    << "                            sites, by effect size, and of the phenotype variance (off)\n"
+    << "        convergence         batch means standard errors and effective sample sizes of the\n"
+    << "                            --target-se statistics (on with --target-se)\n"
+    << "  --target-se=<str>:<float> stop once the mean of phenotype-var, segsites (in all) or visits\n"
+    << "                        (each count's sites a generation) has this standard error; may be\n"
+    << "                        repeated, and the run stops when all are met, or at the last time\n"
     << "\n";
   return;
 }
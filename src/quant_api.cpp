@@ -0,0 +1,287 @@
+#include <stdlib.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+#include <valarray>
+
+#include "quant_api.h"
+#include "error_handling.h"
+#include "common.h"
+#include "sim_rand.h"
+#include "genome.h"
+#include "population.h"
+#include "statistic.h"
+#include "output.h"
+#include "command_line.h"
+
+using std::string;
+using std::vector;
+using std::valarray;
+
+struct Callback {
+  quant_callback f;
+  void *user;
+  int every;
+};
+
+struct quant_sim {
+  Population *pops;
+  int popsize;
+  int parent_pop;
+  int burnin;
+  vector<Callback> callbacks;
+};
+
+static string last_error;
+static quant_sim *current = NULL;
+
+void
+quant_default_params(quant_params *p) {
+  /* the same defaults as quant's */
+  p->popsize = 5000;
+  p->seed = 0;
+  p->burnin = 5000;
+  p->mu = 0.0001;
+  p->s = 0.01;
+  p->env = 0.0;
+  p->optimum = 0.0;
+  p->model = 0;
+  p->haploid = 0;
+  p->crn = 0;
+  p->neffects = 0;
+  p->effects = NULL;
+  p->eprobs = NULL;
+  p->loci = NULL;
+  p->nfreqs = 0;
+  p->freqs = NULL;
+  p->stats = NULL;
+}
+
+const char*
+quant_last_error(void) {
+  return last_error.c_str();
+}
+
+/* undo whatever of a simulation's setup was done, so another can be made */
+static void
+teardown(quant_sim *sim) {
+  out.finish();
+  delete [] sim->pops;
+  sim->pops = NULL;
+  Population::finalize();
+  use_shared_stream();
+  delete sim;
+  current = NULL;
+}
+
+/* Set up a simulation, in the same order quant does, so the random numbers
+ * are drawn the same way */
+static void
+setup(quant_sim *sim, const quant_params *p) {
+  if (p->popsize <= 0) throw SimError("popsize must be positive");
+  if (p->model != QUANT_INFINITE_SITES && p->model != QUANT_FINITE_SITES)
+    throw SimError("model must be QUANT_INFINITE_SITES or QUANT_FINITE_SITES");
+  if (p->neffects <= 0 || p->effects == NULL) throw SimError("must give effects");
+  if (p->model == QUANT_FINITE_SITES) {
+    if (p->loci == NULL) throw SimError("must give loci counts");
+    if (p->haploid) throw SimError("haploid not implemented for finite sites model");
+  }
+  if (p->nfreqs > 0 && p->freqs == NULL) throw SimError("nfreqs given without freqs");
+  if (p->nfreqs > 0 && p->haploid) throw SimError("haploid version doesn't support initial frequencies");
+
+  valarray<double> effects(p->effects, p->neffects);
+  valarray<double> eprobs(1.0, p->neffects);
+  if (p->eprobs != NULL) eprobs = valarray<double>(p->eprobs, p->neffects);
+  int nloci = 0;
+  if (p->model == QUANT_FINITE_SITES) {
+    for (int i=0; i < p->neffects; i++) {
+      if (p->loci[i] <= 0) throw SimError("non-positive number of loci");
+      nloci += p->loci[i];
+    }
+    if (p->nfreqs > 0 && p->nfreqs != nloci)
+      throw SimError(0, "incorrect number of frequencies. Expecting %d.", nloci);
+  } else {
+    nloci = p->nfreqs;
+  }
+
+  /* statistics printed as text, if any */
+  Statistic::initialize_defaults();
+  Statistic::deactivate_all();
+  if (p->stats != NULL && p->stats[0] != '\0') {
+    vector<string> names;
+    strsplit(p->stats, names, ',');
+    for (size_t i=0; i < names.size(); i++) Statistic::activate(names[i].c_str());
+  }
+
+  srand48(p->seed);
+  if (p->crn) use_role_streams(p->seed);
+  else use_shared_stream();
+
+  Genome::initialize(p->mu, 2.0/p->s, p->optimum, p->env);
+  Site::ploidy_level = p->haploid ? haploid : diploid;
+  Population::initialize(p->popsize, (Model)p->model);
+  Genome::new_optimum(p->optimum);
+  sim->pops = new Population[2];
+
+  if (p->model == QUANT_INFINITE_SITES) {
+    GenomeInfiniteSites::setup_effect_probabilities(eprobs, effects);
+  } else {
+    for (int i=0; i < p->neffects; i++) {
+      for (int j=0; j < p->loci[i]; j++) {
+        Population::create_site(effects[i]);
+        GenomeFiniteSites::baseline -= effects[i];
+      }
+    }
+  }
+
+  /* initial frequencies, given or evenly spaced, as quant reads them */
+  if (nloci > 0) {
+    valarray<int> heterozygotes(nloci);
+    valarray<int> derived_homozygotes(nloci);
+    for (int loc=0; loc < nloci; loc++) {
+      double f = p->nfreqs > 0 ? p->freqs[loc] : (loc+1.0) / (nloci+1);
+      heterozygotes[loc] = (int)round(2.0*f*(1.0-f)*p->popsize);
+      derived_homozygotes[loc] = (int)round(f*f*p->popsize);
+    }
+    sim->pops[0].setup_initial_genotypes(heterozygotes, derived_homozygotes);
+  }
+
+  sim->popsize = p->popsize;
+  sim->parent_pop = 0;
+  sim->burnin = p->burnin;
+  Population::generation = 0;
+}
+
+quant_sim*
+quant_create(const quant_params *p) {
+  if (current != NULL) {
+    last_error = "only one simulation can exist at a time";
+    return NULL;
+  }
+  quant_sim *sim = new quant_sim;
+  sim->pops = NULL;
+  current = sim;
+  try {
+    setup(sim, p);
+  } catch (SimError &e) {
+    last_error = e.detail;
+    try { teardown(sim); } catch (SimError &e2) { }
+    return NULL;
+  }
+  return sim;
+}
+
+void
+quant_destroy(quant_sim *sim) {
+  if (sim == NULL) return;
+  try { teardown(sim); } catch (SimError &e) { }
+}
+
+/* Run the simulation on, one generation at a time as quant's main loop does */
+int
+quant_step(quant_sim *sim, int generations) {
+  try {
+    for (int g=0; g < generations; g++) {
+      int output_gen = Population::generation;
+      if (sim->burnin <= 0) {
+        Population &parents = sim->pops[sim->parent_pop];
+        parents.stat_generation();
+
+        for (size_t i=0; i < sim->callbacks.size(); i++) {
+          if (Population::generation % sim->callbacks[i].every == 0)
+            sim->callbacks[i].f(sim, sim->callbacks[i].user);
+        }
+      }
+      Population::next_generation(sim->pops, sim->parent_pop, sim->burnin);
+      out.end_generation(output_gen);
+    }
+  } catch (SimError &e) {
+    last_error = e.detail;
+    return -1;
+  }
+  return 0;
+}
+
+/* a new optimum, which the fitnesses of the next offspring are based on (as
+ * at the end of one of quant's epochs) */
+int
+quant_set_optimum(quant_sim *, double optimum) {
+  Genome::new_optimum(optimum);
+  return 0;
+}
+
+int
+quant_add_callback(quant_sim *sim, quant_callback f, void *user, int every) {
+  if (f == NULL || every < 1) {
+    last_error = "a callback needs a function and a positive interval";
+    return -1;
+  }
+  Callback c = { f, user, every };
+  sim->callbacks.push_back(c);
+  return 0;
+}
+
+int
+quant_generation(const quant_sim *) {
+  return Population::generation;
+}
+
+int
+quant_burnin_left(const quant_sim *sim) {
+  return sim->burnin > 0 ? sim->burnin : 0;
+}
+
+/* a span over one field of each of the parents' sites */
+template<class T> static quant_span
+site_span(const quant_sim *sim, T Site::*field) {
+  const vector<Site> &sites = sim->pops[sim->parent_pop].sites;
+  quant_span s;
+  s.data = sites.empty() ? NULL : &(sites[0].*field);
+  s.stride = sizeof(Site);
+  s.size = sites.size();
+  return s;
+}
+
+quant_span
+quant_site_counts(const quant_sim *sim) {
+  return site_span(sim, &Site::derived_alleles_count);
+}
+
+quant_span
+quant_site_effects(const quant_sim *sim) {
+  return site_span(sim, &Site::effect);
+}
+
+quant_span
+quant_site_ids(const quant_sim *sim) {
+  return site_span(sim, &Site::id);
+}
+
+/* and over one field of each of the parents' genomes */
+static quant_span
+genome_span(const quant_sim *sim, double Genome::*field) {
+  const Genome *first;
+  quant_span s;
+  sim->pops[sim->parent_pop].genome_layout(first, s.stride);
+  s.data = &(first->*field);
+  s.size = sim->popsize;
+  return s;
+}
+
+quant_span
+quant_phenotypes(const quant_sim *sim) {
+  return genome_span(sim, &Genome::phenotype);
+}
+
+quant_span
+quant_fitnesses(const quant_sim *sim) {
+  return genome_span(sim, &Genome::fitness);
+}
+
+void
+quant_phenotype_moments(const quant_sim *sim, double *mean, double *variance) {
+  sim->pops[sim->parent_pop].phenotype_moments(*mean, *variance);
+}
+
+/* END */
@@ -0,0 +1,149 @@
+#ifndef __QUANT_API_H__
+#define __QUANT_API_H__
+
+#include <stddef.h>
+
+/* An interface for running quant's simulation from other programs, in C or
+ * C++, linked against libquant.a. A simulation is set up from a
+ * quant_params struct (the same parameters as quant's options), stepped
+ * along a number of generations at a time, and its state read in place:
+ * the sites' derived allele counts, effects and ids, and the individuals'
+ * phenotypes and fitnesses, are each given as a quant_span, a pointer and a
+ * stride into the simulation's own storage. Nothing is copied, but a span
+ * is only good until the simulation is next stepped or destroyed.
+ *
+ *   quant_params p;
+ *   quant_default_params(&p);
+ *   p.model = QUANT_FINITE_SITES;
+ *   ...
+ *   quant_sim *sim = quant_create(&p);
+ *   if (sim == NULL) fprintf(stderr, "%s\n", quant_last_error());
+ *   quant_step(sim, 1000);
+ *   quant_span counts = quant_site_counts(sim);
+ *   for (size_t i=0; i < counts.size; i++) ... quant_span_int(counts, i) ...
+ *   quant_destroy(sim);
+ *
+ * Callbacks registered with quant_add_callback() are called every so many
+ * generations once the burnin is over, at the point quant prints its
+ * statistics, with the population as it is at the start of the generation.
+ *
+ * The simulation engine keeps its state in class variables, so only one
+ * simulation can exist at a time, but any number can be run one after
+ * another in the same process. A simulation gives the same results as quant
+ * given the same parameters and seed. Functions that can fail return NULL
+ * or -1, and quant_last_error() says why. */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define QUANT_INFINITE_SITES 1
+#define QUANT_FINITE_SITES 2
+
+typedef struct quant_params {
+  int popsize;
+  unsigned int seed;
+  int burnin;                   /* generations of burnin */
+  double mu;                    /* mutation rate */
+  double s;                     /* Barton's selection parameter */
+  double env;                   /* environmental variance */
+  double optimum;               /* the phenotypic optimum, see quant_set_optimum() */
+  int model;                    /* QUANT_INFINITE_SITES or QUANT_FINITE_SITES */
+  int haploid;                  /* non-zero for a haploid population */
+  int crn;                      /* non-zero for common random numbers (as --crn) */
+  int neffects;
+  const double *effects;        /* neffects effect sizes */
+  const double *eprobs;         /* infinite sites: their probabilities (NULL if equal) */
+  const int *loci;              /* finite sites: the number of loci of each */
+  int nfreqs;
+  const double *freqs;          /* initial derived allele frequencies: one per locus in
+                                 * the finite sites model (NULL for evenly spaced), or one
+                                 * per starting site in the infinite sites model */
+  const char *stats;            /* comma-separated statistics for quant's text output on
+                                 * stdout (as --enable-stat), or NULL for none */
+} quant_params;
+
+typedef struct quant_sim quant_sim;
+
+/* a strided array: element i is stride*i bytes past data */
+typedef struct quant_span {
+  const void *data;
+  size_t stride;
+  size_t size;
+} quant_span;
+
+static inline int quant_span_int(quant_span s, size_t i) {
+  return *(const int *)((const char *)s.data + i*s.stride);
+}
+static inline unsigned int quant_span_uint(quant_span s, size_t i) {
+  return *(const unsigned int *)((const char *)s.data + i*s.stride);
+}
+static inline double quant_span_double(quant_span s, size_t i) {
+  return *(const double *)((const char *)s.data + i*s.stride);
+}
+
+typedef void (*quant_callback)(const quant_sim *sim, void *user);
+
+void quant_default_params(quant_params *p);
+quant_sim* quant_create(const quant_params *p);
+void quant_destroy(quant_sim *sim);
+const char* quant_last_error(void);
+
+int quant_step(quant_sim *sim, int generations);
+int quant_set_optimum(quant_sim *sim, double optimum);
+int quant_add_callback(quant_sim *sim, quant_callback f, void *user, int every);
+
+/* the generation (0 until the burnin is over), and the burnin left */
+int quant_generation(const quant_sim *sim);
+int quant_burnin_left(const quant_sim *sim);
+
+/* The sites, one per slot. In the infinite sites model, slots of sites that
+ * have been lost or fixed are kept for reuse, with a count of 0 */
+quant_span quant_site_counts(const quant_sim *sim);     /* int: derived alleles */
+quant_span quant_site_effects(const quant_sim *sim);    /* double */
+quant_span quant_site_ids(const quant_sim *sim);        /* unsigned int: mutation ids */
+
+/* the individuals */
+quant_span quant_phenotypes(const quant_sim *sim);      /* double */
+quant_span quant_fitnesses(const quant_sim *sim);       /* double */
+void quant_phenotype_moments(const quant_sim *sim, double *mean, double *variance);
+
+#ifdef __cplusplus
+}
+
+#include <iterator>
+
+/* and for C++, spans that can be indexed and iterated over */
+template<class T> class quant_view {
+public:
+  quant_view(quant_span s) : span(s) { }
+  const T& operator[](size_t i) const { return *(const T *)((const char *)span.data + i*span.stride); }
+  size_t size(void) const { return span.size; }
+
+  class iterator {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    iterator(const char *p, size_t s) : p(p), stride(s) { }
+    const T& operator*() const { return *(const T *)p; }
+    iterator& operator++() { p += stride; return *this; }
+    iterator operator++(int) { iterator old = *this; p += stride; return old; }
+    bool operator==(const iterator &o) const { return p == o.p; }
+    bool operator!=(const iterator &o) const { return p != o.p; }
+  private:
+    const char *p;
+    size_t stride;
+  };
+  iterator begin(void) const { return iterator((const char *)span.data, span.stride); }
+  iterator end(void) const { return iterator((const char *)span.data + span.size*span.stride, span.stride); }
+
+private:
+  quant_span span;
+};
+#endif
+
+#endif /* __QUANT_API_H__ */
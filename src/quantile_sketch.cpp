@@ -0,0 +1,146 @@
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include "quantile_sketch.h"
+#include "error_handling.h"
+
+using std::vector;
+using std::pair;
+
+QuantileSketch::QuantileSketch(int k) : k(k), n(0), size(0), max_size(0) {
+  if (k < 8) throw SimError("quantile sketches need k of at least 8");
+  grow();
+}
+
+/* Compactors further below the top get geometrically smaller, by 2/3 a
+ * level, but never fewer than two items */
+int
+QuantileSketch::capacity(int level) const {
+  int depth = compactors.size() - 1 - level;
+  int c = (int)ceil(k * pow(2.0/3.0, depth));
+  return c < 2 ? 2 : c;
+}
+
+/* add a compactor on top */
+void
+QuantileSketch::grow(void) {
+  compactors.push_back(vector<double>());
+  keep_odd.push_back(0);
+  max_size = 0;
+  for (int h=0; h < (int)compactors.size(); h++) max_size += capacity(h);
+}
+
+/* compact the lowest compactor that's over its capacity */
+void
+QuantileSketch::compress(void) {
+  for (int h=0; h < (int)compactors.size(); h++) {
+    if ((int)compactors[h].size() < capacity(h)) continue;
+    if (h+1 == (int)compactors.size()) grow();
+    vector<double> &level = compactors[h];
+    std::sort(level.begin(), level.end());
+    /* an odd item out stays where it is */
+    size_t even = level.size() & ~(size_t)1;
+    for (size_t i = keep_odd[h]; i < even; i += 2) compactors[h+1].push_back(level[i]);
+    keep_odd[h] ^= 1;
+    level.erase(level.begin(), level.begin() + even);
+    size -= even/2;
+    return;
+  }
+}
+
+void
+QuantileSketch::insert(double x) {
+  compactors[0].push_back(x);
+  n++;
+  if (++size >= max_size) compress();
+}
+
+/* add an item standing for 2^level values, as written by another sketch */
+void
+QuantileSketch::insert(int level, double x) {
+  if (level < 0 || level > 62) throw SimError(0, "bad quantile sketch level %d", level);
+  while ((int)compactors.size() <= level) grow();
+  compactors[level].push_back(x);
+  n += 1L << level;
+  size++;
+  while (size >= max_size) compress();
+}
+
+/* combine another sketch of the same k into this one */
+void
+QuantileSketch::merge(const QuantileSketch &other) {
+  if (other.k != k) throw SimError("can only merge quantile sketches of the same k");
+  while (compactors.size() < other.compactors.size()) grow();
+  for (int h=0; h < (int)other.compactors.size(); h++) {
+    const vector<double> &items = other.compactors[h];
+    compactors[h].insert(compactors[h].end(), items.begin(), items.end());
+  }
+  n += other.n;
+  size += other.size;
+  while (size >= max_size) compress();
+}
+
+/* The value with a fraction p of the (weighted) items at or below it */
+double
+QuantileSketch::quantile(double p) const {
+  if (n == 0) return NAN;
+  vector<pair<double,long> > weighted;
+  weighted.reserve(size);
+  for (int h=0; h < (int)compactors.size(); h++) {
+    for (size_t i=0; i < compactors[h].size(); i++)
+      weighted.push_back(pair<double,long>(compactors[h][i], 1L << h));
+  }
+  std::sort(weighted.begin(), weighted.end());
+  double target = p * n;
+  long seen = 0;
+  for (size_t i=0; i < weighted.size(); i++) {
+    seen += weighted[i].second;
+    if (seen >= target) return weighted[i].first;
+  }
+  return weighted.back().first;
+}
+
+/* flatten the sketch onto the end of v: k, n, levels, then for each level,
+ * which half it keeps next, its item count and the items */
+void
+QuantileSketch::save(vector<double> &v) const {
+  v.push_back(k);
+  v.push_back(n);
+  v.push_back(compactors.size());
+  for (int h=0; h < (int)compactors.size(); h++) {
+    v.push_back(keep_odd[h]);
+    v.push_back(compactors[h].size());
+    v.insert(v.end(), compactors[h].begin(), compactors[h].end());
+  }
+}
+
+/* read back a sketch saved at p, returning where it ends */
+const double*
+QuantileSketch::restore(const double *p, const double *end) {
+  if (end - p < 3) throw SimError("truncated quantile sketch");
+  k = (int)p[0];
+  n = (long)p[1];
+  int levels = (int)p[2];
+  p += 3;
+  compactors.clear();
+  keep_odd.clear();
+  size = 0;
+  for (int h=0; h < levels; h++) {
+    grow();
+    if (end - p < 2) throw SimError("truncated quantile sketch");
+    keep_odd[h] = (char)p[0];
+    size_t count = (size_t)p[1];
+    p += 2;
+    if ((size_t)(end - p) < count) throw SimError("truncated quantile sketch");
+    compactors[h].assign(p, p + count);
+    size += count;
+    p += count;
+  }
+  if (levels == 0) grow();
+  return p;
+}
+
+/* END */
@@ -0,0 +1,50 @@
+#ifndef __QUANTILE_SKETCH_H__
+#define __QUANTILE_SKETCH_H__
+
+#include <vector>
+
+/* A KLL quantile sketch (Karnin, Lang and Liberty 2016): a bounded summary
+ * of a stream of values from which any quantile can be estimated, with a
+ * rank error of about 1.7/k (1% for the default k of 200) whatever the
+ * length of the stream. The values are kept in a stack of compactors; an
+ * item at level h stands for 2^h of the values seen. When the sketch is
+ * full, the lowest compactor over its capacity is sorted and every other
+ * item is promoted a level, the rest dropped. Which half is kept
+ * alternates, rather than being chosen at random, so a sketch only depends
+ * on its input and the simulation's random numbers aren't touched.
+ *
+ * Sketches of the same k can be merged, level by level, giving a sketch of
+ * the combined streams with the same error bound, so sketches from
+ * replicates, or from either side of a checkpoint, can be combined. The
+ * sketch's state can be flattened into doubles (and read back) for
+ * checkpoints, and written as text, one <level>:<value> token per item,
+ * for qmerge. */
+class QuantileSketch {
+public:
+  QuantileSketch(int k = 200);
+
+  void insert(double x);
+  void insert(int level, double x);
+  void merge(const QuantileSketch &other);
+  double quantile(double p) const;
+  long count(void) const { return n; }
+  int levels(void) const { return compactors.size(); }
+  const std::vector<double>& items(int level) const { return compactors[level]; }
+
+  void save(std::vector<double> &v) const;
+  const double* restore(const double *p, const double *end);
+
+private:
+  int capacity(int level) const;
+  void grow(void);
+  void compress(void);
+
+  int k;
+  long n;                                       /* values seen */
+  int size;                                     /* items held */
+  int max_size;                                 /* items held before compressing */
+  std::vector<std::vector<double> > compactors;
+  std::vector<char> keep_odd;                   /* which half each level keeps next */
+};
+
+#endif /* __QUANTILE_SKETCH_H__ */
@@ -0,0 +1,119 @@
+/*
+ *  qwatch.cpp
+ *
+ *  Watch a simulation that is publishing its state to shared memory with
+ *  quant --publish=<name>. Each snapshot is printed in the same form as
+ *  quant's statistics ('gen: <g> freqs: ...', 'gen: <g> pheno: ...' and,
+ *  if visits are being collected, 'gen: <g> visits: ...'). Nothing is
+ *  printed for generations that haven't changed since the last look.
+ */
+
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+
+#include "error_handling.h"
+#include "output.h"
+#include "live.h"
+
+using std::cerr;
+using std::endl;
+using std::string;
+
+void usage(void);
+
+/* print a snapshot as quant would have printed it */
+void print_snapshot(const LiveSnapshot &s, bool visits) {
+  double alleles = (double)s.ploidy * s.popsize;
+  out << "gen: " << s.generation << " freqs:";
+  for (size_t i=0; i < s.ids.size(); i++)
+    out << " " << s.ids[i] << ":" << s.counts[i] / alleles;
+  out << '\n';
+  out << "gen: " << s.generation << " pheno: " << s.phenotype_mean << " " << s.phenotype_variance << '\n';
+  if (visits && !s.visits.empty()) {
+    out << "gen: " << s.generation << " visits:";
+    for (size_t i=0; i < s.visits.size(); i++) out << " " << s.visits[i];
+    out << '\n';
+  }
+  out.end_generation(s.generation);
+}
+
+int
+main(int argc, char **argv) { try {
+  double interval = 1.0;
+  int count = 0;
+  bool visits = true;
+
+  while (1) {
+    static struct option long_options[] = {
+      {"interval", required_argument, 0, 'i'},
+      {"count", required_argument, 0, 'n'},
+      {"no-visits", no_argument, 0, 'v'},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "i:n:v", long_options, &option_index);
+    if (c == -1) break;
+    char *end;
+    switch (c) {
+      case 'i':
+        interval = strtod(optarg, &end);
+        if (optarg == end || interval < 0) throw SimUsageError("interval must be a non-negative number");
+        break;
+      case 'n':
+        count = strtol(optarg, &end, 10);
+        if (optarg == end || count < 0) throw SimUsageError("count must be a non-negative integer");
+        break;
+      case 'v':
+        visits = false;
+        break;
+      default:
+        throw SimUsageError("unrecognized option");
+    }
+  }
+  if (optind != argc-1) throw SimUsageError("must give exactly one shared memory name");
+
+  LiveReader reader(argv[optind]);
+  LiveSnapshot s;
+  unsigned int last = 0;
+  bool first = true;
+  for (int n=0; count == 0 || n < count; ) {
+    if (!reader.snapshot(s)) throw SimError("the simulation never stopped writing long enough to read");
+    if (first || s.updates != last) {
+      print_snapshot(s, visits);
+      out.finish();
+      last = s.updates;
+      first = false;
+      n++;
+    }
+    if (!s.running) break;
+    usleep((useconds_t)(interval * 1e6));
+  }
+  out.finish();
+
+/* catch any errors that were thrown anywhere inside this block */
+} catch (SimUsageError e) {
+   cerr << endl << "detected usage error: " << e.detail << endl << endl;
+   usage();
+   return 1;
+} catch(SimError &e) {
+   cerr << "uncaught exception: " << e.detail << endl;
+   return 1;
+} return 0; }
+
+/* print a help message */
+void
+usage(void) {
+  cerr << "usage: qwatch [options] <shared memory name>\n"
+    << "  -i/--interval <float>  seconds between looks (1)\n"
+    << "  -n/--count <int>       stop after printing this many snapshots (0, until the\n"
+    << "                         simulation finishes)\n"
+    << "  -v/--no-visits         don't print the visits histogram\n"
+    << "\n";
+  return;
+}
+
+/* END */
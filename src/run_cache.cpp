@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "run_cache.h"
+#include "error_handling.h"
+#include "output.h"
+#include "statistic.h"
+
+using std::string;
+using std::stringstream;
+using std::ifstream;
+using std::map;
+using std::valarray;
+
+#define RUN_CACHE_VERSION 1
+
+/* 64-bit FNV-1a, continuing from h */
+uint64_t
+RunCache::hash(const char *p, size_t n, uint64_t h) {
+  for (size_t i=0; i < n; i++) {
+    h ^= (unsigned char)p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+static string hex(uint64_t h) {
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+  return string(buf);
+}
+
+static uint64_t hash_file(const string &path) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == NULL) throw SimError(0, "cannot read %s", path.c_str());
+  char buf[65536];
+  uint64_t h = RunCache::hash(NULL, 0);
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) h = RunCache::hash(buf, n, h);
+  fclose(f);
+  return h;
+}
+
+/* The file a program was run from: argv[0] if it's a path, or else the first
+ * match on the PATH, as the shell found it */
+static string executable(const string &argv0) {
+  if (argv0.find('/') != string::npos) return argv0;
+  const char *path = getenv("PATH");
+  string dirs = path == NULL ? "" : path;
+  size_t begin = 0;
+  while (begin <= dirs.size()) {
+    size_t end = dirs.find(':', begin);
+    if (end == string::npos) end = dirs.size();
+    string dir = dirs.substr(begin, end - begin);
+    string candidate = (dir.empty() ? string(".") : dir) + "/" + argv0;
+    if (access(candidate.c_str(), X_OK) == 0) return candidate;
+    begin = end + 1;
+  }
+  throw SimError(0, "cannot find %s to key the run cache", argv0.c_str());
+}
+
+/* a vector at full precision, so that parameters that print the same in
+ * the params line still get different keys */
+template<class T> static string full_vector(const valarray<T> &x, const char *label) {
+  string s = string(" ") + label + "=";
+  char buf[32];
+  for (size_t i=0; i < x.size(); i++) {
+    snprintf(buf, sizeof(buf), "%s%.17g", i > 0 ? "," : "", (double)x[i]);
+    s += buf;
+  }
+  return s;
+}
+
+/* remove a cache entry, or what there is of one */
+static void remove_entry(const string &path) {
+  const char *files[] = { "output", "checkpoint", "checkpoint.tmp", "meta", "meta.tmp" };
+  for (size_t i=0; i < sizeof(files)/sizeof(files[0]); i++)
+    unlink((path + "/" + files[i]).c_str());
+  rmdir(path.c_str());
+}
+
+/* Work out the run's key */
+RunCache::RunCache(const string &d, const Args &ar, const string &program) : dir(d), times(ar.times), opts(ar.opts),
+    found_bytes(0), output(NULL), start(0), loop_bytes(0) {
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+    throw SimError(0, "cannot create cache directory %s", dir.c_str());
+
+  /* the params line, without what doesn't change the output. The times and
+   * optima are left out of the stem, and the vectors are added again at
+   * full precision */
+  Args k(ar);
+  k.cmd = "";
+  k.gzip_output = false;
+  k.genotype_memory = 0;
+  k.genotype_dir = "";
+  k.genotypes_file = "";
+  k.cache_dir = "";
+  k.times.resize(0);
+  k.opts.resize(0);
+  stringstream s;
+  s.precision(17);
+  s << k;
+  stem = s.str();
+  stem.erase(0, stem.find('\n') + 1);
+
+  stem += full_vector(ar.effect_sizes, "effects");
+  if (ar.sites_model == infinite_sites)
+    stem += full_vector(ar.effect_probabilities, "eprobs");
+  stringstream extra;
+  extra << " keyframe_every=" << ar.keyframe_every;
+  if (Statistic::is_activated(STAT_QUANTILES)) {
+    extra << full_vector(ar.quantile_probs, "quantile_probs") << " quantile_every=" << ar.quantile_every;
+  }
+  extra << " stats=";
+  string sep = "";
+  for (int h=0; h < Statistic::count(); h++) {
+    if (Statistic::is_activated(h)) {
+      extra << sep << Statistic::name(h);
+      if (Statistic::every(h) != 1) extra << ":" << Statistic::every(h);
+      sep = ",";
+    }
+  }
+  if (!ar.genotypes_file.empty()) extra << " genotypes=" << hex(hash_file(ar.genotypes_file));
+  /* a different build may well simulate differently */
+  extra << " build=" << hex(hash_file(executable(program)));
+  stem += extra.str();
+  key = stem + full_vector(times, "times") + full_vector(opts, "opts");
+
+  name = hex(hash(stem.data(), stem.size())) + "-" + hex(hash(key.data(), key.size()));
+}
+
+/* A run that didn't commit (it failed, or threw) leaves nothing behind: the
+ * output stops being copied once what's been written so far is out, and the
+ * entry that was being built is removed */
+RunCache::~RunCache() {
+  if (output != NULL) {
+    out.set_tee(NULL);
+    try { out.finish(); } catch (SimError &e) { }
+    fclose(output);
+  }
+  if (!tmp.empty()) remove_entry(tmp);
+}
+
+/* the fields of an entry's meta file, or false if it isn't a complete entry */
+static bool read_meta(const string &path, map<string,string> &meta) {
+  ifstream f((path + "/meta").c_str());
+  if (!f) return false;
+  string line;
+  while (std::getline(f, line)) {
+    size_t sp = line.find(' ');
+    if (sp == string::npos) continue;
+    meta[line.substr(0, sp)] = line.substr(sp+1);
+  }
+  stringstream v;
+  v << RUN_CACHE_VERSION;
+  return meta["version"] == v.str();
+}
+
+/* Look for this very run. If it's there, replay() gives its output */
+bool
+RunCache::find(void) {
+  map<string,string> meta;
+  string path = dir + "/" + name;
+  if (!read_meta(path, meta) || meta["key"] != key) return false;
+  struct stat st;
+  if (stat((path + "/output").c_str(), &st) != 0) return false;
+  found = path;
+  found_bytes = st.st_size;
+  return true;
+}
+
+/* Look for the longest run this one extends. If there is one, replay()
+ * gives the output of its main loop, and the simulation carries on from
+ * prefix_checkpoint() */
+bool
+RunCache::find_prefix(void) {
+  DIR *d = opendir(dir.c_str());
+  if (d == NULL) return false;
+  string prefix = name.substr(0, name.find('-') + 1);
+  int best = -1;
+  struct dirent *e;
+  while ((e = readdir(d)) != NULL) {
+    if (strncmp(e->d_name, prefix.c_str(), prefix.size()) != 0) continue;
+    string path = dir + "/" + e->d_name;
+    map<string,string> meta;
+    if (!read_meta(path, meta) || meta["stem"] != stem) continue;
+    valarray<int> t;
+    valarray<double> o;
+    try {
+      valint_from_string(meta["times"], t);
+      valdouble_from_string(meta["opts"], o);
+    } catch (SimError &err) {
+      continue;
+    }
+
+    /* the same epochs, except the last may end sooner */
+    size_t a = t.size();
+    if (a == 0 || a > times.size() || o.size() != a) continue;
+    bool prefix_of = t[a-1] <= times[a-1];
+    for (size_t i=0; i < a && prefix_of; i++) {
+      if (o[i] != opts[i] || (i < a-1 && t[i] != times[i])) prefix_of = false;
+    }
+    if (!prefix_of || t[a-1] <= best) continue;
+    best = t[a-1];
+    found = path;
+    found_checkpoint = path + "/checkpoint";
+    found_bytes = strtoul(meta["loop_bytes"].c_str(), NULL, 10);
+  }
+  closedir(d);
+  return best >= 0;
+}
+
+/* pass the output of the run that was found on to be written */
+void
+RunCache::replay(void) {
+  FILE *f = fopen((found + "/output").c_str(), "rb");
+  if (f == NULL) throw SimError(0, "cannot read cached output in %s", found.c_str());
+  string chunk;
+  size_t left = found_bytes;
+  while (left > 0) {
+    chunk.resize(left < 65536 ? left : 65536);
+    size_t n = fread(&chunk[0], 1, chunk.size(), f);
+    if (n == 0) break;
+    chunk.resize(n);
+    out << chunk;
+    out.end_block();
+    left -= n;
+  }
+  fclose(f);
+  if (left > 0) throw SimError(0, "cached output in %s is truncated", found.c_str());
+}
+
+/* start building this run's entry, with a copy of the output from here on */
+void
+RunCache::begin(void) {
+  tmp = dir + "/tmp-XXXXXX";
+  if (mkdtemp(&tmp[0]) == NULL) {
+    tmp.clear();
+    throw SimError(0, "cannot create a directory in cache %s", dir.c_str());
+  }
+  output = fopen((tmp + "/output").c_str(), "wb");
+  if (output == NULL) throw SimError(0, "cannot create cached output in %s", tmp.c_str());
+  out.set_tee(output);
+  start = out.written();
+}
+
+/* The main loop is done: keep its state, and how much it wrote */
+void
+RunCache::end_loop(const Args &ar, Population *pops, const LoopState &loop) {
+  Checkpoint::write(tmp + "/checkpoint", ar, pops, loop);
+  out.end_block();
+  loop_bytes = out.written() - start;
+}
+
+/* The run is finished: write out its output, and move the entry into place */
+void
+RunCache::commit(void) {
+  out.finish();
+  out.set_tee(NULL);
+  int err = ferror(output);
+  err |= fclose(output);
+  output = NULL;
+  if (err != 0) throw SimError(0, "failed to write cached output in %s", tmp.c_str());
+
+  FILE *f = fopen((tmp + "/meta").c_str(), "w");
+  if (f == NULL) throw SimError(0, "cannot create cache entry in %s", tmp.c_str());
+  fprintf(f, "version %d\nkey %s\nstem %s\n", RUN_CACHE_VERSION, key.c_str(), stem.c_str());
+  fprintf(f, "times %s\nopts %s\n", full_vector(times, "").substr(2).c_str(),
+    full_vector(opts, "").substr(2).c_str());
+  fprintf(f, "loop_bytes %lu\n", (unsigned long)loop_bytes);
+  if (fclose(f) != 0) throw SimError(0, "failed to write cache entry in %s", tmp.c_str());
+
+  /* if the same run finished first elsewhere, its entry is kept */
+  if (rename(tmp.c_str(), (dir + "/" + name).c_str()) != 0) {
+    if (errno != EEXIST && errno != ENOTEMPTY)
+      throw SimError(0, "failed to add %s to cache %s", name.c_str(), dir.c_str());
+    remove_entry(tmp);
+  }
+  tmp.clear();
+}
+
+/* END */
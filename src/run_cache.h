@@ -0,0 +1,75 @@
+#ifndef __RUN_CACHE_H__
+#define __RUN_CACHE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <valarray>
+
+#include "command_line.h"
+#include "checkpoint.h"
+
+/* A cache of finished runs (--cache=<dir>), so that a run that has been
+ * done before is read back instead of simulated again. A run is keyed by
+ * the text of its resolved parameters (the params line, printed at full
+ * precision), the keyframe interval, the statistics that are turned on,
+ * the contents of any --genotypes file and the quant executable itself (found
+ * from argv[0]).
+ * The parameters that only affect how the output is written
+ * (--gzip-output, --genotype-memory and so on) aren't part of the key, nor
+ * is the command line.
+ *
+ * Each run is a directory in the cache, named by two hashes: one of its
+ * key without the times and optima (the stem), and one of the whole key.
+ * It holds
+ *
+ *   output      everything quant wrote after the params line, uncompressed
+ *   checkpoint  the state at the end of the main loop (see checkpoint.h)
+ *   meta        the key, the times and optima, and the length of the part
+ *               of the output written by the main loop
+ *
+ * and is built under a temporary name and renamed into place once the run
+ * has finished, so concurrent runs never see part of one.
+ *
+ * When there is no run with the same key, a run with the same stem whose
+ * epochs are a prefix of this run's (the same times and optima, except
+ * that its last epoch may end sooner) is extended: its main loop output is
+ * replayed, and the simulation resumes from its checkpoint. */
+class RunCache {
+public:
+  RunCache(const std::string &dir, const Args &ar, const std::string &program);
+  ~RunCache();
+
+  bool find(void);
+  bool find_prefix(void);
+  void replay(void);
+  void begin(void);
+  void end_loop(const Args &ar, Population *pops, const LoopState &loop);
+  void commit(void);
+
+  /* the checkpoint of the run found by find_prefix() */
+  const std::string& prefix_checkpoint(void) const { return found_checkpoint; }
+
+  static uint64_t hash(const char *p, size_t n, uint64_t h = 14695981039346656037ULL);
+
+private:
+  std::string dir;
+  std::string key;               /* the full key, and the key less its epochs */
+  std::string stem;
+  std::string name;              /* this run's entry */
+  std::valarray<int> times;
+  std::valarray<double> opts;
+
+  /* a run found in the cache, and how much of its output to replay */
+  std::string found;
+  std::string found_checkpoint;
+  size_t found_bytes;
+
+  /* the entry being built */
+  std::string tmp;
+  FILE *output;
+  size_t start;                  /* out.written() when the copy began */
+  size_t loop_bytes;
+};
+
+#endif /* __RUN_CACHE_H__ */
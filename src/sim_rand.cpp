@@ -1,17 +1,63 @@
 #include <valarray>
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
 #include "sim_rand.h"
 
 using std::valarray;
 
+/* binomials drawn together by RandStream::binomials() */
+#define BINOMIAL_BLOCK 256
+
+/* below this mean count of the rarer outcome, binomials are drawn by
+ * inversion, and above it by rejection */
+#define BINOMIAL_INVERSION 10.0
+
+float gammln(float xx);
+
+RandStream *role_streams = NULL;
+
 double
 ran1() {
   return drand48();
 }
 
+/* switch to common-random-numbers mode, with one stream per role */
+void
+use_role_streams(unsigned int seed) {
+  if (role_streams == NULL) role_streams = new RandStream[num_rand_roles];
+  for (int r=0; r < num_rand_roles; r++) role_streams[r].reseed(seed, r);
+}
+
+/* and back, to all roles sharing drand48() */
+void
+use_shared_stream(void) {
+  delete [] role_streams;
+  role_streams = NULL;
+}
+
+/* With role streams, small means are drawn by inversion, which uses exactly
+ * one uniform per draw, so the stream stays in step across runs with
+ * different means, and a larger mean never gives a smaller draw */
+int
+poidev(double xm, rand_role role) {
+  if (role_streams == NULL) return poidev(xm);
+  if (xm >= 12.0) return role_streams[role].poisson(xm);
+  double u = role_streams[role].uniform();
+  double p = exp(-xm);
+  double cdf = p;
+  int k = 0;
+  while (u > cdf && k < 1000) {
+    k++;
+    p *= xm / k;
+    cdf += p;
+  }
+  return k;
+}
+
 #define PI 3.141592654
 int
 poidev(double xm) {
-   float gammln(float);
    static float sq,alxm,g,oldm=(-1.0);
    float em,t,y;
    
@@ -76,3 +122,161 @@ gammln(float xx) {
   return -tmp+log(2.5066282746310005*ser/x);
 }
 
+/* splitmix64, used to turn a (seed, stream) pair into well-mixed state */
+static unsigned long long
+mix64(unsigned long long z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/* a seed for drand48() that is unrelated to, but determined by, seed and stream */
+unsigned int
+derive_seed(unsigned int seed, unsigned int stream) {
+  return (unsigned int)(mix64(((unsigned long long)seed << 32) | stream) >> 32);
+}
+
+RandStream::RandStream(unsigned int seed, unsigned int stream) {
+  reseed(seed, stream);
+}
+
+/* start the stream over from the given seed */
+void
+RandStream::reseed(unsigned int seed, unsigned int stream) {
+  x = mix64(((unsigned long long)seed << 32) | stream) & RAND48_MASK;
+  oldm = -1.0;
+}
+
+/* the same algorithm as poidev(), but drawing from this stream */
+#define PI 3.141592654
+int
+RandStream::poisson(double xm) {
+  double em, t, y;
+
+  if (xm < 12.0) {
+    if (xm != oldm) {
+      oldm = xm;
+      g = exp(-xm);
+    }
+    em = -1;
+    t = 1.0;
+    do {
+      ++em;
+      t *= uniform();
+    } while (t > g);
+  } else {
+    if (xm != oldm) {
+      oldm = xm;
+      sq = sqrt(2.0*xm);
+      alxm = log(xm);
+      g = xm*alxm-gammln(xm+1.0);
+    }
+    do {
+      do {
+        y = tan(PI*uniform());
+        em = sq*y+xm;
+      } while (em < 0.0);
+      em = floor(em);
+      t = 0.9*(1.0+y*y)*exp(em*alxm-gammln(em+1.0)-g);
+    } while (uniform() > t);
+  }
+  return (int)em;
+}
+#undef PI
+
+/* The binomial by inversion, for p <= 1/2 and n p below BINOMIAL_INVERSION,
+ * starting from the uniform u: the probabilities of 0, 1, ... are stepped
+ * through by their ratios until u is used up. Rounding can leave a little
+ * of u past n, in which case it starts over */
+int
+RandStream::binomial_inversion(int n, double p, double u) {
+  double s = p / (1.0 - p), a = (n + 1) * s, first = exp(n * log1p(-p));
+  while (1) {
+    double r = first;
+    int k = 0;
+    while (u > r && k < n) {
+      u -= r;
+      k++;
+      r *= a / k - s;
+    }
+    if (u <= r) return k;
+    u = uniform();
+  }
+}
+
+/* The binomial by transformed rejection with squeeze (Hormann's BTRS), for
+ * p <= 1/2 and n p at least BINOMIAL_INVERSION, from a first pair of
+ * uniforms u and v. The squeeze accepts most tries without the exact test,
+ * which needs lgamma() */
+int
+RandStream::binomial_rejection(int n, double p, double u, double v) {
+  double spq = sqrt(n * p * (1.0 - p));
+  double b = 1.15 + 2.53*spq, a = -0.0873 + 0.0248*b + 0.01*p, c = n*p + 0.5;
+  double vr = 0.92 - 4.2/b, alpha = (2.83 + 5.1/b) * spq, lpq = log(p / (1.0 - p));
+  int m = (int)floor((n + 1) * p);
+  double h = lgamma(m + 1.0) + lgamma(n - m + 1.0);
+  while (1) {
+    double x = u - 0.5, us = 0.5 - fabs(x);
+    double k = floor((2.0*a/us + b)*x + c);
+    if (k >= 0 && k <= n) {
+      if (us >= 0.07 && v <= vr) return (int)k;
+      double lv = log(v * alpha / (a/(us*us) + b));
+      if (lv <= h - lgamma(k + 1.0) - lgamma(n - k + 1.0) + (k - m)*lpq) return (int)k;
+    }
+    u = uniform();
+    v = uniform();
+  }
+}
+
+/* a binomial draw of n trials with success probability p */
+int
+RandStream::binomial(int n, double p) {
+  int k;
+  binomials(n, &p, &k, 1);
+  return k;
+}
+
+/* Binomial draws of n trials for each of count success probabilities p, into
+ * k. They're taken BINOMIAL_BLOCK at a time: the uniforms for every draw's
+ * first try are drawn in order, then the first try of BTRS and its squeeze
+ * are worked out for the whole block in a loop without branches, which the
+ * compiler can vectorize, and only the draws the squeeze doesn't settle are
+ * finished one by one, by inversion for small means or by going on with
+ * BTRS. A draw uses the rarer outcome's probability, so p above 1/2 counts
+ * the failures */
+void
+RandStream::binomials(int n, const double *p, int *k, int count) {
+  double u[BINOMIAL_BLOCK], v[BINOMIAL_BLOCK], rare[BINOMIAL_BLOCK], first[BINOMIAL_BLOCK];
+  int settled[BINOMIAL_BLOCK];
+  for (int start=0; start < count; start += BINOMIAL_BLOCK) {
+    int m = std::min(BINOMIAL_BLOCK, count - start);
+    const double *pb = p + start;
+    int *kb = k + start;
+    for (int i=0; i < m; i++) {
+      u[i] = uniform();
+      v[i] = uniform();
+    }
+    for (int i=0; i < m; i++) {
+      double r = pb[i] < 0.5 ? pb[i] : 1.0 - pb[i];
+      double spq = sqrt(n * r * (1.0 - r));
+      double b = 1.15 + 2.53*spq, a = -0.0873 + 0.0248*b + 0.01*r;
+      double x = u[i] - 0.5, us = 0.5 - fabs(x);
+      double draw = floor((2.0*a/us + b)*x + n*r + 0.5);
+      rare[i] = r;
+      first[i] = draw;
+      settled[i] = (us >= 0.07) & (v[i] <= 0.92 - 4.2/b) & (draw >= 0) & (draw <= n);
+    }
+    for (int i=0; i < m; i++) {
+      double r = rare[i];
+      int x;
+      if (!(r > 0)) x = 0;
+      else if (n * r < BINOMIAL_INVERSION) x = binomial_inversion(n, r, u[i]);
+      else if (settled[i]) x = (int)first[i];
+      else x = binomial_rejection(n, r, u[i], v[i]);
+      kb[i] = pb[i] < 0.5 ? x : n - x;
+    }
+  }
+}
+
+/* END */
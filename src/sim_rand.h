@@ -6,5 +6,62 @@
 double ran1();
 int poidev(double xm);
 void ranint(int n, std::valarray<int> &);
+unsigned int derive_seed(unsigned int seed, unsigned int stream);
+
+/* The roles random numbers play in the simulation. In common-random-numbers
+ * mode each role draws from its own stream, so a change of parameters that
+ * alters how many draws one role makes (say, more mutations with a higher
+ * mu) doesn't shift the draws seen by the others. Runs at neighboring
+ * parameter values that share a seed then differ mostly because of the
+ * parameters, not Monte Carlo noise. */
+enum rand_role { rand_parent, rand_segregation, rand_mutation, rand_effect,
+  rand_environment, num_rand_roles };
+
+void use_role_streams(unsigned int seed);
+void use_shared_stream(void);
+int poidev(double xm, rand_role role);
+
+/* An independent stream of uniform random numbers. It uses the same linear
+ * congruential generator as drand48(), but keeps its own 48-bit state, so
+ * many streams can be advanced side by side (and, with the state kept in
+ * a plain integer, in vectorizable loops). The state is seeded by hashing the
+ * seed together with a stream number, so streams with different numbers are
+ * unrelated. */
+class RandStream {
+public:
+  RandStream(unsigned int seed = 0, unsigned int stream = 0);
+  void reseed(unsigned int seed, unsigned int stream);
+  int poisson(double xm);
+  int binomial(int n, double p);
+  void binomials(int n, const double *p, int *k, int count);
+
+  /* uniform on [0,1), identical to erand48() given the same state */
+  inline double uniform(void) {
+    x = (RAND48_A * x + RAND48_C) & RAND48_MASK;
+    return (double)x * RAND48_SCALE;
+  }
+
+  unsigned long long x;
+
+  static const unsigned long long RAND48_A = 0x5DEECE66DULL;
+  static const unsigned long long RAND48_C = 0xBULL;
+  static const unsigned long long RAND48_MASK = (1ULL << 48) - 1;
+  static constexpr double RAND48_SCALE = 1.0 / 281474976710656.0;
+
+private:
+  int binomial_inversion(int n, double p, double u);
+  int binomial_rejection(int n, double p, double u, double v);
+
+  /* cached values for the most recent poisson mean, as in poidev() */
+  double oldm, g, sq, alxm;
+};
+
+/* the per-role streams, or NULL when all roles share drand48() */
+extern RandStream *role_streams;
+
+inline double
+ran1(rand_role role) {
+  return role_streams ? role_streams[role].uniform() : ran1();
+}
 
 #endif /* __SIM_RAND_H__ */
@@ -11,7 +11,9 @@ using std::ostream;
 mutation_id Site::next_unique_id = 0;
 enum ploidy Site::ploidy_level;
 
-Site::Site(int N, double e, mutation_id sid, int gen) : genotypes(N) {
+Site::Site(GenotypeStore *s, size_t loc, double e, mutation_id sid, int gen) : store(s), slot(loc) {
+  attach();
+  store->zero(slot);
   effect = e;
   derived_alleles_count = 0;
   reusable = false;
@@ -19,25 +21,27 @@ Site::Site(int N, double e, mutation_id sid, int gen) : genotypes(N) {
   generation_created = gen;
 }
 
-/* get a particular individual's genotype at this site */
-genotype Site::operator[](int i) {
-  return (genotype)genotypes[i];
+/* Cache where the store keeps this site's genotypes. The store must have
+ * room for the slot, and this must be called again whenever it grows */
+void Site::attach(void) {
+  store->locate(slot, column, stride, shift, mask);
 }
 
 /* used for assignment to a particular individual's genotype at this site */
 void Site::set_genotype(int i, genotype g) {
-  if (i > (int)genotypes.size()) 
+  if (i > store->size()) 
     throw SimError(0, "invalid individual: %d", i);
   /* update the the allele count */
-  derived_alleles_count += g - genotypes[i];
-  genotypes[i] = g;
+  char &x = column[(size_t)(i >> shift) * stride + (i & mask)];
+  derived_alleles_count += g - x;
+  x = g;
   return;
 }
 
 /* compute the frequency of derived alleles at this site */
 double Site::frequency(void) {
   double ploidy = (double)ploidy_level;
-  return derived_alleles_count / (ploidy * genotypes.size());
+  return derived_alleles_count / (ploidy * store->size());
 }
 
 /* take a site that was lost and use it for a new mutation */
@@ -52,7 +56,7 @@ void Site::renew(double e, mutation_id sid, int gen) {
 
 /* set all the genotypes back to ancestral derived */
 void Site::reset(void) {
-  genotypes = homozygote_ancestral;
+  store->zero(slot);
   derived_alleles_count = 0;
 }
 
@@ -3,12 +3,14 @@
 
 #include <valarray>
 
+#include "genotype_store.h"
+
 enum genotype { homozygote_ancestral, heterozygote, homozygote_derived };
 typedef unsigned int mutation_id;
 
 class Site {
 public:
-  Site(int N, double e, mutation_id sid, int gen);
+  Site(GenotypeStore *s, size_t slot, double e, mutation_id sid, int gen);
   ~Site() { }
   void set_genotype(int i, genotype g);
   double frequency(void);
@@ -18,8 +20,14 @@ public:
 
   /* operators */
   friend std::ostream& operator<<(std::ostream &o, Site &s);
+  friend class Checkpoint;
   /* access a particular individual's genotype */
-  genotype operator[](int i);
+  inline genotype operator[](int i) const {
+    return (genotype)column[(size_t)(i >> shift) * stride + (i & mask)];
+  }
+
+  /* find the genotypes again after the store has moved them */
+  void attach(void);
 
   /* effect size of a derived allele at this site */
   double effect;
@@ -41,8 +49,15 @@ public:
   static enum ploidy ploidy_level;
 
 private:
-  /* genotypes for each individual in the population */
-  std::valarray<char> genotypes;
+  /* genotypes for each individual in the population are kept by the 
+   * population view's store, in this site's slot */
+  GenotypeStore *store;
+  size_t slot;
+
+  /* where the store keeps them, as of the last attach() */
+  char *column;
+  size_t stride;
+  int shift, mask;
 };
 
 #endif /* __SITE_H__ */
@@ -0,0 +1,235 @@
+#include <math.h>
+
+#include <valarray>
+#include <vector>
+#include <algorithm>
+
+#include "stationary.h"
+#include "sim_rand.h"
+#include "error_handling.h"
+
+using std::valarray;
+using std::vector;
+
+/* bisection steps taken in finding the variance */
+#define ROOT_STEPS 200
+
+/* counts of the site spectrum computed together */
+#define SPECTRUM_BLOCK 64
+
+Stationary::Stationary(int N, enum ploidy p, double mu, double Vs) : N(N),
+    ploidy_level(p), mu(mu), Vs(Vs) {
+  if (N <= 0) throw SimError("stationary state needs a positive population size");
+  if (!(Vs > 0) || isinf(Vs)) throw SimError("stationary state needs selection (s > 0)");
+  if (mu < 0) throw SimError("negative mutation rate");
+}
+
+/* the factor sqrt(1 + v^2/(Vs (2v+Vs))) of the mean-field relations, by
+ * which the variance is reduced */
+double
+Stationary::correction(double v) const {
+  return sqrt(1.0 + v*v / (Vs*(2.0*v + Vs)));
+}
+
+/* 2 gamma, the scaled selection against a derived allele of effect a when
+ * the rest of the phenotype variance is v, as in f.diploid and f.haploid */
+double
+Stationary::scaled_selection(double a, double v) const {
+  if (ploidy_level == diploid)
+    return 2.0*N*a*a / ((v+Vs) * correction(v));
+  return N*a*a * sqrt(1.0 - v*v/((v+Vs)*(v+Vs))) / (v+Vs);
+}
+
+/* The variance the sites of all effect sizes would keep up, given v, in the
+ * mean-field approximation. Each effect size gets its share of mu */
+double
+Stationary::variance_terms(double v, const valarray<double> &effects,
+    const valarray<double> &probs) const {
+  double total = probs.sum(), c = correction(v), sum = 0.0;
+  for (int k=0; k < (int)effects.size(); k++) {
+    double a2 = effects[k]*effects[k], mu_k = mu * probs[k] / total;
+    if (a2 == 0.0 || mu_k == 0.0) continue;
+    double x = scaled_selection(effects[k], v);
+    if (ploidy_level == diploid) {
+      /* 1/x - 1/(e^x - 1) goes to 1/2 - x/12 as x goes to 0 */
+      double h = x < 1e-4 ? 0.5 - x/12.0 : 1.0/x - 1.0/expm1(x);
+      sum += 8.0*N*mu_k*a2 * h / c;
+    } else {
+      sum += 2.0*N*mu_k*a2 * ((v+Vs)/(N*a2) - 1.0/(c*expm1(x)));
+    }
+  }
+  return sum;
+}
+
+/* the mean-field phenotype variance in the infinite sites model, the root of
+ * f.diploid (or f.haploid) generalized to several effect sizes */
+double
+Stationary::infinite_sites_variance(const valarray<double> &effects,
+    const valarray<double> &probs) const {
+  if (effects.size() != probs.size() || probs.sum() <= 0)
+    throw SimError("effects and their probabilities don't match");
+  double lo = 0.0, hi = 1e6;
+  if (variance_terms(lo, effects, probs) <= 0.0) return 0.0;
+  if (variance_terms(hi, effects, probs) > hi)
+    throw SimError("no stationary variance below 1e6");
+  for (int i=0; i < ROOT_STEPS && hi - lo > 1e-12*hi; i++) {
+    double mid = 0.5*(lo + hi);
+    if (variance_terms(mid, effects, probs) > mid) lo = mid;
+    else hi = mid;
+  }
+  return 0.5*(lo + hi);
+}
+
+/* The expected number of segregating sites of effect a with each derived
+ * allele count, 0 to 2N (N haploid), from the Poisson random field with
+ * mutation rate mu_a, given the variance v */
+void
+Stationary::site_spectrum(double a, double mu_a, double v, vector<double> &expected) const {
+  int n = (int)ploidy_level * N;
+  double theta = 2.0 * n * mu_a, x = scaled_selection(a, v);
+  expected.assign(n+1, 0.0);
+  if (x < 1e-8) {
+    for (int c=1; c < n; c++) expected[c] = theta / c;
+    return;
+  }
+  /* The probability a site at q is lost rather than fixed is
+   * (exp(-x q) - exp(-x)) / (1 - exp(-x)). exp(-x q) is a geometric
+   * sequence in the count, so it's taken in blocks of SPECTRUM_BLOCK counts,
+   * as the block's first term times the powers of the ratio, with no
+   * exp() in the inner loop, which the compiler can then vectorize */
+  double powers[SPECTRUM_BLOCK];
+  double ratio = exp(-x / n), fixed = exp(-x), scale = theta / (-expm1(-x)) / n;
+  powers[0] = 1.0;
+  for (int j=1; j < SPECTRUM_BLOCK; j++) powers[j] = powers[j-1] * ratio;
+  for (int c0=0; c0 < n; c0 += SPECTRUM_BLOCK) {
+    double first = exp(-x * c0 / n);
+    int m = std::min(SPECTRUM_BLOCK, n - c0);
+    double *block = &expected[c0];
+    for (int j=0; j < m; j++) {
+      double q = (double)(c0 + j) / n;
+      block[j] = scale * (first * powers[j] - fixed) / (q*(1.0-q));
+    }
+  }
+  expected[0] = 0.0;
+}
+
+/* the probability a new mutation of effect a fixes, given the variance v */
+double
+Stationary::fixation_probability(double a, double v) const {
+  double p = 1.0 / ((int)ploidy_level * N), x = scaled_selection(a, v);
+  if (x < 1e-8) return p;
+  return exp(-x*(1.0-p)) * expm1(-x*p) / expm1(-x);
+}
+
+/* Draw the segregating sites of the infinite sites model: their effects
+ * (with a random sign, as new mutations get) and derived allele counts. v is
+ * set to the variance they were drawn for */
+void
+Stationary::sample_sites(const valarray<double> &effects, const valarray<double> &probs,
+    vector<double> &site_effects, vector<int> &counts, double &v) const {
+  v = infinite_sites_variance(effects, probs);
+  site_effects.clear();
+  counts.clear();
+  vector<double> expected;
+  for (int k=0; k < (int)effects.size(); k++) {
+    if (effects[k] == 0.0 || probs[k] == 0.0) continue;
+    site_spectrum(effects[k], mu * probs[k] / probs.sum(), v, expected);
+    for (int c=1; c < (int)expected.size(); c++) expected[c] += expected[c-1];
+    double total = expected.back();
+    int m = poidev(total, rand_mutation);
+    for (int i=0; i < m; i++) {
+      double x = ran1(rand_mutation) * total;
+      int c = std::upper_bound(expected.begin(), expected.end(), x) - expected.begin();
+      if (c >= (int)expected.size() - 1) c = expected.size() - 2;
+      counts.push_back(c);
+      site_effects.push_back(ran1(rand_effect) < 0.5 ? -effects[k] : effects[k]);
+    }
+  }
+}
+
+/* The probability of each derived allele count, 0 to 2N, at a finite sites
+ * locus of effect a mutating at rate u each way, given the variance v. The
+ * counts 0 and 2N take the half cell next to them, where the density is
+ * near q^(4Nu-1) */
+void
+Stationary::locus_distribution(double a, double u, double v, vector<double> &p) const {
+  int n = (int)ploidy_level * N;
+  double beta = 2.0 * n * u, S = (double)n * a*a / (Vs + v);
+  if (!(beta > 0)) throw SimError("stationary loci need mutation (mu > 0)");
+  vector<double> logp(n+1);
+  logp[0] = logp[n] = beta * log(0.5/n) - log(beta);
+  for (int c=1; c < n; c++) {
+    double q = (double)c / n;
+    logp[c] = (beta - 1.0) * (log(q) + log1p(-q)) - S*q*(1.0-q) - log((double)n);
+  }
+  double top = *std::max_element(logp.begin(), logp.end()), sum = 0.0;
+  p.resize(n+1);
+  for (int c=0; c <= n; c++) sum += (p[c] = exp(logp[c] - top));
+  for (int c=0; c <= n; c++) p[c] /= sum;
+}
+
+/* the variance of the finite sites loci, each at its stationary distribution
+ * for the variance itself */
+double
+Stationary::finite_sites_variance(const valarray<double> &effects,
+    const valarray<int> &loci) const {
+  if (effects.size() != loci.size() || loci.sum() <= 0)
+    throw SimError("effects and loci don't match");
+  int n = (int)ploidy_level * N;
+  double u = mu / loci.sum(), hi = 0.0;
+  for (int k=0; k < (int)effects.size(); k++)
+    hi += loci[k] * (int)ploidy_level * effects[k]*effects[k] / 4.0;
+  double lo = 0.0;
+  vector<double> p;
+  for (int i=0; i < ROOT_STEPS && hi - lo > 1e-12*hi; i++) {
+    double mid = 0.5*(lo + hi), sum = 0.0;
+    for (int k=0; k < (int)effects.size(); k++) {
+      locus_distribution(effects[k], u, mid, p);
+      double h = 0.0;
+      for (int c=1; c < n; c++) h += p[c] * c * (double)(n-c) / ((double)n*n);
+      sum += loci[k] * (int)ploidy_level * effects[k]*effects[k] * h;
+    }
+    if (sum > mid) lo = mid;
+    else hi = mid;
+  }
+  return 0.5*(lo + hi);
+}
+
+/* Draw the derived allele count of each finite sites locus, in the order the
+ * loci are made, effect size by effect size. v is set to the variance they
+ * were drawn for */
+void
+Stationary::sample_loci(const valarray<double> &effects, const valarray<int> &loci,
+    vector<int> &counts, double &v) const {
+  v = finite_sites_variance(effects, loci);
+  double u = mu / loci.sum();
+  counts.clear();
+  vector<double> p;
+  for (int k=0; k < (int)effects.size(); k++) {
+    locus_distribution(effects[k], u, v, p);
+    for (int c=1; c < (int)p.size(); c++) p[c] += p[c-1];
+    for (int i=0; i < loci[k]; i++) {
+      double x = ran1(rand_mutation) * p.back();
+      int c = std::upper_bound(p.begin(), p.end(), x) - p.begin();
+      counts.push_back(std::min(c, (int)p.size() - 1));
+    }
+  }
+}
+
+/* split a derived allele count among heterozygotes and derived homozygotes
+ * as near Hardy-Weinberg proportions as the count allows */
+void
+Stationary::hardy_weinberg(int count, int N, enum ploidy p, int &hets, int &homs) {
+  if (count < 0 || count > (int)p * N) throw SimError(0, "invalid derived allele count %d", count);
+  if (p == haploid) {
+    hets = count;
+    homs = 0;
+    return;
+  }
+  homs = (int)round((double)count*count / (4.0*N));
+  if (2*homs > count) homs = count/2;
+  if (count - homs > N) homs = count - N;
+  hets = count - 2*homs;
+}
+
+/* END */
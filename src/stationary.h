@@ -0,0 +1,65 @@
+#ifndef __STATIONARY_H__
+#define __STATIONARY_H__
+
+#include <valarray>
+#include <vector>
+
+#include "common.h"
+
+/* Standing variation drawn from the stationary state of the diffusion
+ * approximation, so a run can start close to mutation-selection-drift
+ * equilibrium (--freqs=stationary) and needs only a short burnin.
+ *
+ * Selection on a site comes from its effect a against the rest of the
+ * phenotype variance v: with fitness exp(-(z-opt)^2/(2Vs)) (Vs is 1/s) and
+ * the phenotype spread N(opt, v) around it, a copy of the derived allele
+ * costs about a^2/(2(Vs+v)). The variance itself is the mean-field one, the
+ * root of the relations f.diploid and f.haploid of the modeling scripts
+ * (modeling/phenotypic_variance.r), summed over the effect sizes.
+ *
+ * In the infinite sites model each effect size's segregating sites, and
+ * their derived allele counts, are drawn from the Poisson random field of
+ * Sawyer and Hartl: the expected number of sites at frequency q is
+ *
+ *   theta exp(-2 gamma q) (1 - exp(-2 gamma (1-q))) / ((1 - exp(-2 gamma)) q (1-q)) dq
+ *
+ * with theta 4N mu (2N mu haploid) for that effect's share of mu, and
+ * gamma the scaled selection against the derived allele. In the finite
+ * sites model each locus mutates both ways, at mu over the number of loci,
+ * and its frequency is drawn from Wright's distribution for it,
+ *
+ *   q^(4Nu-1) (1-q)^(4Nu-1) exp(-2N a^2 q(1-q) / (Vs+v))
+ *
+ * with v the variance of the loci's frequencies, found self-consistently. */
+class Stationary {
+public:
+  Stationary(int N, enum ploidy p, double mu, double Vs);
+
+  double infinite_sites_variance(const std::valarray<double> &effects,
+    const std::valarray<double> &probs) const;
+  void site_spectrum(double a, double mu_a, double v, std::vector<double> &expected) const;
+  double fixation_probability(double a, double v) const;
+  void sample_sites(const std::valarray<double> &effects, const std::valarray<double> &probs,
+    std::vector<double> &site_effects, std::vector<int> &counts, double &v) const;
+
+  double finite_sites_variance(const std::valarray<double> &effects,
+    const std::valarray<int> &loci) const;
+  void locus_distribution(double a, double u, double v, std::vector<double> &p) const;
+  void sample_loci(const std::valarray<double> &effects, const std::valarray<int> &loci,
+    std::vector<int> &counts, double &v) const;
+
+  static void hardy_weinberg(int count, int N, enum ploidy p, int &hets, int &homs);
+
+private:
+  double variance_terms(double v, const std::valarray<double> &effects,
+    const std::valarray<double> &probs) const;
+  double scaled_selection(double a, double v) const;
+  double correction(double v) const;
+
+  int N;
+  enum ploidy ploidy_level;
+  double mu;
+  double Vs;
+};
+
+#endif /* __STATIONARY_H__ */
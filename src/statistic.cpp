@@ -1,58 +1,149 @@
-#include <map>
+#include <vector>
 #include <string>
 
 #include "statistic.h"
 #include "error_handling.h"
 
-using std::map;
+using std::vector;
 using std::string;
 
-/* populate the directory with the valid statistics, and their defaults */
-map<string,bool> Statistic::directory;
+/* the registry: each statistic's name, cadence and collector, by handle */
+vector<string> Statistic::names;
+vector<int> Statistic::cadence;
+vector<StatCollector*> Statistic::collectors;
+vector<int> Statistic::final_order;
+uint64_t Statistic::active = 0;
+uint64_t Statistic::watching[NUM_STAT_HOOKS];
 
-/* given we only have class variables we use an initializer */
+/* given we only have class variables we use an initializer. The built in
+ * statistics are added in the order of their handles */
 void Statistic::initialize_defaults(void) {
-  directory[string("frequencies")] = true;
-  directory[string("phenotype")] = true;
-  directory[string("phenotype-var-mean")] = false;
-  directory[string("burnin")] = true;
-  directory[string("sojourn")] = true;
-  directory[string("mutation")] = true;
-  directory[string("visits")] = false;
-  directory[string("fixations")] = false;
-  directory[string("segsites")] = false;
-  directory[string("pmoments")] = false;
+  names.clear();
+  cadence.clear();
+  collectors.clear();
+  final_order.clear();
+  active = 0;
+  for (int i=0; i < NUM_STAT_HOOKS; i++) watching[i] = 0;
+
+  add("frequencies", true);
+  add("frequency-deltas", false);
+  add("visits", false);
+  add("fixations", false);
+  add("segsites", false);
+  add("phenotype", true);
+  add("pmoments", false);
+  add("phenotype-var-mean", false);
+  add("mutation", true);
+  add("sojourn", true);
+  add("burnin", true);
+  add("fst", false);
+  add("quantiles", false);
+  add("convergence", false);
+
+  /* the final population's lines come in the order quant has always printed
+   * them, which isn't the per-generation order: the phenotype before the
+   * segregating sites, and the visits after both */
+  static const int final_builtin[] = {
+    STAT_FREQUENCIES, STAT_FREQUENCY_DELTAS, STAT_PHENOTYPE, STAT_SEGSITES, STAT_VISITS,
+    STAT_PMOMENTS, STAT_PHENOTYPE_VAR_MEAN, STAT_MUTATION, STAT_FIXATIONS, STAT_SOJOURN,
+    STAT_BURNIN, STAT_FST, STAT_QUANTILES, STAT_CONVERGENCE
+  };
+  final_order.assign(final_builtin, final_builtin + NUM_BUILTIN_STATS);
+}
+
+/* register a statistic, returning its handle. Statistics added after the
+ * built in ones come last in the final lines too */
+int Statistic::add(const char *key, bool on) {
+  if (names.size() == 64) throw SimError("too many statistics");
+  for (size_t i=0; i < names.size(); i++) {
+    if (names[i] == key) throw SimError(0, "statistic registered twice: %s", key);
+  }
+  int h = names.size();
+  names.push_back(key);
+  cadence.push_back(1);
+  collectors.push_back(NULL);
+  if (h >= NUM_BUILTIN_STATS) final_order.push_back(h);
+  if (on) active |= (uint64_t)1 << h;
+  return h;
+}
+
+/* the handle of a statistic by key */
+int Statistic::handle(const char *key) {
+  for (size_t i=0; i < names.size(); i++) {
+    if (names[i] == key) return i;
+  }
+  throw SimError(0, "invalid statistic: %s", key);
 }
 
 /* turn off all the statistics */
 void Statistic::deactivate_all(void) {
-  for (map<string,bool>::iterator it=directory.begin(); it != directory.end(); it++)
-    (*it).second = false;
+  active = 0;
 }
 
 /* activate statistic by key */
 void Statistic::activate(const char *key) {
-  string k(key);
-  if (directory.count(key) == 0)
-    throw SimError(0, "invalid statistic: %s", key);
-  directory[key] = true;
+  active |= (uint64_t)1 << handle(key);
 }
 
 /* deactivate a statistic by key */
 void Statistic::deactivate(const char *key) {
-  string k(key);
-  if (directory.count(key) == 0)
-    throw SimError(0, "invalid statistic: %s", key);
-  directory[key] = false;
+  active &= ~((uint64_t)1 << handle(key));
 }
 
-/* used to check if a statistic should be printed. All statistics should call 
- * this first to see if they should be printed */
+/* check a statistic by key. The simulation checks handles instead */
 bool Statistic::is_activated(const char *key) {
-  string k(key);
-  if (directory.count(key) == 0)
-    throw SimError(0, "invalid statistic: %s", key);
-  return directory[key];
+  return is_activated(handle(key));
+}
+
+/* collect a statistic only every so many generations */
+void Statistic::set_every(const char *key, int every) {
+  if (every < 1) throw SimError(0, "statistic %s must be collected every 1 or more generations", key);
+  cadence[handle(key)] = every;
+}
+
+/* give a statistic its collector, replacing any it had */
+void Statistic::add_collector(int h, StatCollector *c) {
+  uint64_t bit = (uint64_t)1 << h;
+  collectors[h] = c;
+  for (int i=0; i < NUM_STAT_HOOKS; i++) {
+    if (c->hooks & (1u << i)) watching[i] |= bit;
+    else watching[i] &= ~bit;
+  }
+}
+
+/* Each hook visits the activated statistics watching it, in the order of
+ * their handles (the lowest set bit first), except the final one, which
+ * follows final_order */
+void Statistic::run_birth(Population &pop, mutation_loc loc) {
+  for (uint64_t m = active & watching[0]; m != 0; m &= m-1)
+    collectors[__builtin_ctzll(m)]->on_birth(pop, loc);
+}
+
+void Statistic::run_absorption(Population &pop, mutation_loc loc, bool fixed) {
+  for (uint64_t m = active & watching[1]; m != 0; m &= m-1)
+    collectors[__builtin_ctzll(m)]->on_absorption(pop, loc, fixed);
+}
+
+void Statistic::run_offspring(Population &pop, int gen) {
+  for (uint64_t m = active & watching[2]; m != 0; m &= m-1) {
+    int h = __builtin_ctzll(m);
+    if (gen % cadence[h] == 0) collectors[h]->on_offspring(pop);
+  }
+}
+
+void Statistic::generation(Population &pop, int gen) {
+  for (uint64_t m = active & watching[3]; m != 0; m &= m-1) {
+    int h = __builtin_ctzll(m);
+    if (gen % cadence[h] == 0) collectors[h]->on_generation(pop);
+  }
+}
+
+void Statistic::final(Population &pop) {
+  uint64_t m = active & watching[4];
+  for (size_t i=0; i < final_order.size(); i++) {
+    int h = final_order[i];
+    if ((m >> h) & 1) collectors[h]->on_final(pop);
+  }
 }
 
 /* END */
@@ -2,21 +2,109 @@
 #define __STATISTIC_H__
 
 #include "population.h"
-#include <map>
+#include <vector>
 #include <string>
+#include <stdint.h>
 
-/* The Statistic class provides an interface to turn on printing of statistics and a means to check if a statistic should be printed. It doesn't actually print anything. For a function to 'implement' the Statistic interface, it just needs to abide by checking whether printing has been activated and only do anyting when it's been activated */
+/* Handles of the built in statistics. Within each hook but the final one,
+ * collectors are called in the order of their handles, so this is also the
+ * order of the statistics' lines in a generation's output. The final lines
+ * have an order of their own (see Statistic::initialize_defaults()) */
+enum {
+  STAT_FREQUENCIES,
+  STAT_FREQUENCY_DELTAS,
+  STAT_VISITS,
+  STAT_FIXATIONS,
+  STAT_SEGSITES,
+  STAT_PHENOTYPE,
+  STAT_PMOMENTS,
+  STAT_PHENOTYPE_VAR_MEAN,
+  STAT_MUTATION,
+  STAT_SOJOURN,
+  STAT_BURNIN,
+  STAT_FST,
+  STAT_QUANTILES,
+  STAT_CONVERGENCE,
+  NUM_BUILTIN_STATS
+};
+
+/* the points in a run where a statistic can collect */
+enum {
+  ON_BIRTH = 1,         /* a site has been created */
+  ON_ABSORPTION = 2,    /* a site has been lost or fixed, before it's made reusable */
+  ON_OFFSPRING = 4,     /* the offspring have been made, before lost sites are purged */
+  ON_GENERATION = 8,    /* each generation after the burnin, with the parents */
+  ON_FINAL = 16         /* once, with the final population */
+};
+#define NUM_STAT_HOOKS 5
+
+/* A statistic's collector is called at the hooks it names when it's
+ * constructed, and only while the statistic is activated. The per-offspring
+ * and per-generation hooks are called only every so many generations, as set
+ * by Statistic::set_every() */
+class StatCollector {
+public:
+  StatCollector(unsigned int h) : hooks(h) { }
+  virtual ~StatCollector() { }
+  virtual void on_birth(Population &, mutation_loc) { }
+  virtual void on_absorption(Population &, mutation_loc, bool) { }
+  virtual void on_offspring(Population &) { }
+  virtual void on_generation(Population &) { }
+  virtual void on_final(Population &) { }
+
+  unsigned int hooks;
+};
+
+/* The Statistic class keeps the registry of statistics: each is registered
+ * once by name and gets an integer handle, which is what the simulation
+ * checks (a bit test), and can have a collector that is called at the hooks
+ * below. Names are only used to turn statistics on and off from the command
+ * line. A disabled statistic costs nothing: the hooks only visit collectors
+ * that are both activated and interested */
 class Statistic {
 public:
   Statistic() { }
   ~Statistic() { }
   static void initialize_defaults(void);
+  static int add(const char *key, bool on);
+  static int handle(const char *key);
   static void activate(const char *key);
   static void deactivate(const char *key);
   static bool is_activated(const char *key);
   static void deactivate_all(void);
+  static void set_every(const char *key, int every);
+  static void add_collector(int h, StatCollector *c);
+
+  static inline bool is_activated(int h) { return (active >> h) & 1; }
+  static int count(void) { return names.size(); }
+  static const std::string& name(int h) { return names[h]; }
+  static int every(int h) { return cadence[h]; }
+
+  /* the hooks, called by the simulation. gen is the generation, for the
+   * cadences */
+  static inline void birth(Population &pop, mutation_loc loc) {
+    if (active & watching[0]) run_birth(pop, loc);
+  }
+  static inline void absorption(Population &pop, mutation_loc loc, bool fixed) {
+    if (active & watching[1]) run_absorption(pop, loc, fixed);
+  }
+  static inline void offspring(Population &pop, int gen) {
+    if (active & watching[2]) run_offspring(pop, gen);
+  }
+  static void generation(Population &pop, int gen);
+  static void final(Population &pop);
+
+private:
+  static void run_birth(Population &pop, mutation_loc loc);
+  static void run_absorption(Population &pop, mutation_loc loc, bool fixed);
+  static void run_offspring(Population &pop, int gen);
 
-  static std::map<std::string,bool> directory;
+  static std::vector<std::string> names;
+  static std::vector<int> cadence;
+  static std::vector<StatCollector*> collectors;
+  static std::vector<int> final_order;
+  static uint64_t active;
+  static uint64_t watching[NUM_STAT_HOOKS];
 };
 
 #endif /* __STATISTIC_H__ */
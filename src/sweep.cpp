@@ -0,0 +1,640 @@
+/*
+ *  sweep.cpp
+ *
+ *  Run a grid of quant simulations on the local machine. The grid is read
+ *  from a spec file, every (point, replicate) pair becomes a job, and the jobs
+ *  are run longest-expected-first on a work-stealing thread pool. Each job
+ *  writes its output to a path determined only by its parameters and
+ *  replicate number, so a sweep can be interrupted and re-launched, in which
+ *  case completed jobs are skipped.
+ *
+ *  The spec file has one "key = value" per line, '#' starts a comment:
+ *
+ *    quant = ../quant
+ *    outdir = out/phenotype_effect_grid
+ *    model = infinite
+ *    N = 1000
+ *    mu = 0.004,0.008,0.012       scalar axes: alternatives separated by ','
+ *    s = 0.1
+ *    effects = 0.05;0.1;1,2       vector axes: alternatives separated by ';'
+ *    eprobs = 1;1;0.5,0.5         (paired with effects)
+ *    opts = 0
+ *    times = 40000                (paired with opts)
+ *    loci = 0
+ *    burnin = 10000
+ *    replicates = 10
+ *    seed = 1
+ *    args = --freqs=even --disable-all-stats --enable-stat=phenotype
+ *
+ *  Any axis value of the form @file reads the alternatives from a file, one
+ *  per line, e.g. "mu = @mu_0.001-0.15_by_0.0051".
+ *
+ *  With "crn = yes", replicate r of every point uses the same seed and quant
+ *  is run with --crn (common random numbers), so runs at neighboring points
+ *  are positively correlated. With "compare = <stat>[,<stat>...]" the sweep
+ *  reads the last value of each named statistic (e.g. phenotype_var_mean)
+ *  from each replicate's output (compressed or not) and, for each pair of
+ *  points that are neighbors along one axis, with every other axis held
+ *  fixed, reports the mean difference with both its paired and unpaired standard
+ *  errors. Under crn the paired standard error is the one to use, and is
+ *  typically much smaller.
+ */
+
+#include <getopt.h>
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <mutex>
+
+#include "error_handling.h"
+#include "command_line.h"
+#include "threadpool.h"
+#include "output.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::stringstream;
+using std::ifstream;
+using std::vector;
+using std::map;
+using std::mutex;
+using std::lock_guard;
+
+extern char **environ;
+
+void usage(void);
+
+/* keys that may appear in a spec file, and which of them are grid axes */
+static const char *scalar_axes[] = { "N", "mu", "s", NULL };
+static const char *vector_axes[] = { "effects", "opts", NULL };
+static const char *paired_axes[] = { "eprobs", "times", NULL };
+static const char *fixed_keys[] = { "quant", "outdir", "model", "loci", "burnin",
+  "env", "replicates", "seed", "threads", "stdin", "args", "crn", "compare", NULL };
+
+/* the axes of the grid, in the order they're expanded */
+static const char *grid_axes[] = { "N", "mu", "s", "effects", "opts", NULL };
+#define NUM_GRID_AXES 5
+
+/* One point of the parameter grid. Values are kept as the strings given in
+ * the spec so that output paths match what the user wrote. coords gives the
+ * point's index along each of grid_axes */
+struct SweepPoint {
+  string N, mu, s, effects, eprobs, opts, times;
+  int coords[NUM_GRID_AXES];
+};
+
+/* the parsed spec file */
+class SweepSpec {
+public:
+  SweepSpec(const char *file);
+  void expand(vector<SweepPoint> &points) const;
+  string get(const char *key, const char *dflt) const;
+  int get_int(const char *key, int dflt) const;
+
+  map<string,string> fixed;
+  map<string,vector<string> > axes;
+
+private:
+  void read_alternatives(const string &key, const string &value, char sep);
+};
+
+/* a single quant run: one point of the grid and one replicate */
+class SweepJob : public PoolTask {
+public:
+  SweepJob(const SweepSpec &spec, const SweepPoint &p, int rep, unsigned int seed);
+  void run(int worker);
+  void command(vector<string> &argv) const;
+
+  string path;            /* where the output goes */
+  double expected_cost;   /* used to schedule longest-first */
+  int status;             /* exit status of quant, or -1 if it didn't run */
+  double seconds;
+
+  static mutex report_lock;
+
+  /* index of the job's point in the grid */
+  int point_index;
+
+private:
+  const SweepSpec &spec;
+  SweepPoint point;
+  int replicate;
+  unsigned int seed;
+};
+
+mutex SweepJob::report_lock;
+
+/* sort jobs by decreasing expected cost */
+bool longer_job(const SweepJob *a, const SweepJob *b) {
+  return a->expected_cost > b->expected_cost;
+}
+
+/* strip leading and trailing whitespace */
+string trim(const string &s) {
+  size_t b = s.find_first_not_of(" \t\r\n");
+  if (b == string::npos) return string("");
+  size_t e = s.find_last_not_of(" \t\r\n");
+  return s.substr(b, e-b+1);
+}
+
+/* make a directory and all its parents, like mkdir -p */
+void make_path(const string &dir) {
+  for (size_t pos = dir.find('/', 1); ; pos = dir.find('/', pos+1)) {
+    string sub = dir.substr(0, pos);
+    if (mkdir(sub.c_str(), 0777) != 0 && errno != EEXIST)
+      throw SimError(0, "failed to create directory %s", sub.c_str());
+    if (pos == string::npos) break;
+  }
+}
+
+/* make a key_value path component, following the naming used by the
+ * run-*.sh scripts, with any characters that aren't safe in a path replaced */
+string path_component(const string &key, const string &value) {
+  string v(value);
+  for (size_t i=0; i < v.size(); i++)
+    if (v[i] == '/' || v[i] == ' ') v[i] = '_';
+  return key + "_" + v;
+}
+
+/* Read in the spec file */
+SweepSpec::SweepSpec(const char *file) {
+  ifstream in(file);
+  if (!in) throw SimError(0, "cannot open spec file %s", file);
+
+  string line;
+  int lineno = 0;
+  while (getline(in, line)) {
+    lineno++;
+    size_t hash = line.find('#');
+    if (hash != string::npos) line.erase(hash);
+    line = trim(line);
+    if (line.empty()) continue;
+    size_t eq = line.find('=');
+    stringstream where;
+    where << "line " << lineno << " of spec: ";
+    if (eq == string::npos) {
+      where << "expecting key = value";
+      throw SimUsageError(where);
+    }
+    string key = trim(line.substr(0, eq));
+    string value = trim(line.substr(eq+1));
+    if (value.empty()) {
+      where << "no value for " << key;
+      throw SimUsageError(where);
+    }
+
+    bool known = false;
+    for (int i=0; scalar_axes[i] != NULL; i++) {
+      if (key == scalar_axes[i]) { read_alternatives(key, value, ','); known = true; }
+    }
+    for (int i=0; vector_axes[i] != NULL; i++) {
+      if (key == vector_axes[i] || key == paired_axes[i]) { read_alternatives(key, value, ';'); known = true; }
+    }
+    for (int i=0; fixed_keys[i] != NULL; i++) {
+      if (key == fixed_keys[i]) { fixed[key] = value; known = true; }
+    }
+    if (!known) {
+      where << "unknown key " << key;
+      throw SimUsageError(where);
+    }
+  }
+
+  /* check required keys and pairings */
+  if (fixed.count("model") == 0) throw SimUsageError("spec must give a model");
+  if (axes.count("effects") == 0) throw SimUsageError("spec must give effects");
+  if (axes.count("opts") == 0) throw SimUsageError("spec must give opts");
+  if (axes.count("times") == 0) throw SimUsageError("spec must give times");
+  if (fixed.count("loci") == 0) throw SimUsageError("spec must give loci");
+  if (fixed.count("crn") && fixed["crn"] != "yes" && fixed["crn"] != "no")
+    throw SimUsageError("crn must be yes or no");
+  for (int i=0; vector_axes[i] != NULL; i++) {
+    if (axes.count(paired_axes[i]) == 0) continue;
+    if (axes[paired_axes[i]].size() != axes[vector_axes[i]].size())
+      throw SimUsageError(string(paired_axes[i]) + " must have as many alternatives as " + vector_axes[i]);
+  }
+  if (axes["opts"].size() != axes["times"].size())
+    throw SimUsageError("opts and times must have the same number of alternatives");
+}
+
+/* Split an axis value into its alternatives, checking they are numeric. A
+ * value of @file reads alternatives one per line from file */
+void SweepSpec::read_alternatives(const string &key, const string &value, char sep) {
+  vector<string> alts;
+  if (value[0] == '@') {
+    ifstream in(value.substr(1).c_str());
+    if (!in) throw SimError(0, "cannot open %s", value.c_str()+1);
+    string line;
+    while (getline(in, line)) {
+      line = trim(line);
+      if (!line.empty()) alts.push_back(line);
+    }
+  } else {
+    strsplit(value, alts, sep);
+  }
+  if (alts.size() == 0) throw SimUsageError("no alternatives given for " + key);
+
+  for (size_t i=0; i < alts.size(); i++) {
+    alts[i] = trim(alts[i]);
+    std::valarray<double> check;
+    valdouble_from_string(alts[i], check);
+  }
+  axes[key] = alts;
+}
+
+/* Expand the axes into the full grid of points */
+void SweepSpec::expand(vector<SweepPoint> &points) const {
+  map<string,vector<string> > a(axes);
+  /* scalar axes with no alternatives given are left to quant's defaults */
+  const char *optional[] = { "N", "mu", "s", NULL };
+  for (int i=0; optional[i] != NULL; i++)
+    if (a.count(optional[i]) == 0) a[optional[i]].push_back(string(""));
+
+  for (size_t n=0; n < a["N"].size(); n++) {
+    for (size_t u=0; u < a["mu"].size(); u++) {
+      for (size_t s=0; s < a["s"].size(); s++) {
+        for (size_t e=0; e < a["effects"].size(); e++) {
+          for (size_t o=0; o < a["opts"].size(); o++) {
+            SweepPoint p;
+            p.N = a["N"][n];
+            p.mu = a["mu"][u];
+            p.s = a["s"][s];
+            p.effects = a["effects"][e];
+            p.eprobs = a.count("eprobs") ? a["eprobs"][e] : string("");
+            p.opts = a["opts"][o];
+            p.times = a["times"][o];
+            p.coords[0] = n;
+            p.coords[1] = u;
+            p.coords[2] = s;
+            p.coords[3] = e;
+            p.coords[4] = o;
+            points.push_back(p);
+          }
+        }
+      }
+    }
+  }
+}
+
+/* look up a fixed key, with a default */
+string SweepSpec::get(const char *key, const char *dflt) const {
+  map<string,string>::const_iterator it = fixed.find(key);
+  if (it == fixed.end()) return string(dflt);
+  return it->second;
+}
+
+/* look up a fixed integer key, with a default */
+int SweepSpec::get_int(const char *key, int dflt) const {
+  string v = get(key, "");
+  if (v.empty()) return dflt;
+  char *end;
+  int x = strtol(v.c_str(), &end, 10);
+  if (v.c_str() == end) throw SimUsageError(string("non-numeric ") + key);
+  return x;
+}
+
+/* Set up a job. The output path depends only on the point and replicate, and
+ * the expected cost uses the expected number of segregating sites from
+ * runs/equilibrium/S2N.r, so cost ~ generations * N * (1 + S) */
+SweepJob::SweepJob(const SweepSpec &sp, const SweepPoint &p, int rep, unsigned int sd)
+    : spec(sp), point(p), replicate(rep), seed(sd) {
+  status = -1;
+  seconds = 0;
+
+  stringstream dir;
+  dir << spec.get("outdir", "out") << "/";
+  string sep("");
+  if (!p.N.empty()) { dir << sep << path_component("N", p.N); sep = "-"; }
+  if (!p.mu.empty()) { dir << sep << path_component("mu", p.mu); sep = "-"; }
+  if (!p.s.empty()) { dir << sep << path_component("s", p.s); sep = "-"; }
+  dir << sep << path_component("effects", p.effects);
+  if (!p.eprobs.empty()) dir << "-" << path_component("eprobs", p.eprobs);
+  dir << "-" << path_component("opts", p.opts);
+  dir << "-" << path_component("times", p.times);
+  stringstream file;
+  file << dir.str() << "/rep_" << replicate << ".out";
+  path = file.str();
+
+  double N = p.N.empty() ? 5000 : strtod(p.N.c_str(), NULL);
+  double mu = p.mu.empty() ? 0.0001 : strtod(p.mu.c_str(), NULL);
+  std::valarray<int> times;
+  valint_from_string(p.times, times);
+  std::valarray<int> loci;
+  valint_from_string(spec.get("loci", "0"), loci);
+  /* an adaptive burnin may stop early, but may also go on to its limit,
+   * which is 20N unless given as auto:<gens> */
+  double burnin;
+  string b = spec.get("burnin", "");
+  if (b.compare(0, 4, "auto") == 0)
+    burnin = b.size() > 5 && b[4] == ':' ? strtod(b.c_str()+5, NULL) : 20.0*N;
+  else
+    burnin = spec.get_int("burnin", (int)N);
+  double segsites = 2.0*N*mu*(log(2.0*N)+0.6775) + loci.sum();
+  expected_cost = (burnin + times[times.size()-1]) * N * (1.0 + segsites);
+}
+
+/* build the argument vector for quant */
+void SweepJob::command(vector<string> &argv) const {
+  argv.push_back(spec.get("quant", "quant"));
+  argv.push_back("--model=" + spec.get("model", ""));
+  if (!point.N.empty()) argv.push_back("--popsize=" + point.N);
+  if (!point.mu.empty()) argv.push_back("--mu=" + point.mu);
+  if (!point.s.empty()) argv.push_back("--s=" + point.s);
+  argv.push_back("--effects=" + point.effects);
+  if (!point.eprobs.empty()) argv.push_back("--eprobs=" + point.eprobs);
+  argv.push_back("--opts=" + point.opts);
+  argv.push_back("--times=" + point.times);
+  argv.push_back("--loci=" + spec.get("loci", ""));
+  if (spec.fixed.count("burnin")) argv.push_back("--burnin=" + spec.get("burnin", ""));
+  if (spec.fixed.count("env")) argv.push_back("--env=" + spec.get("env", ""));
+  stringstream s;
+  s << "--seed=" << seed;
+  argv.push_back(s.str());
+  if (spec.get("crn", "no") == "yes") argv.push_back("--crn");
+
+  /* extra arguments are passed through, split on whitespace */
+  stringstream extra(spec.get("args", ""));
+  string a;
+  while (extra >> a) argv.push_back(a);
+}
+
+/* Run quant, writing to a temporary file that is renamed into place when
+ * quant succeeds, so a path only exists once its run has completed */
+void SweepJob::run(int worker) {
+  struct stat st;
+  if (stat(path.c_str(), &st) == 0) {
+    lock_guard<mutex> guard(report_lock);
+    cout << "skip: " << path << endl;
+    status = 0;
+    return;
+  }
+  make_path(path.substr(0, path.rfind('/')));
+  string tmp = path + ".tmp";
+
+  vector<string> args;
+  command(args);
+  vector<char*> argv;
+  for (size_t i=0; i < args.size(); i++) argv.push_back((char*)args[i].c_str());
+  argv.push_back(NULL);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, 0, spec.get("stdin", "/dev/null").c_str(), O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, 1, tmp.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0666);
+
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  pid_t pid;
+  int err = posix_spawnp(&pid, argv[0], &actions, NULL, &argv[0], environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0) {
+    unlink(tmp.c_str());
+    throw SimError(0, "failed to start %s: %s", argv[0], strerror(err));
+  }
+
+  int wstatus;
+  if (waitpid(pid, &wstatus, 0) < 0) throw SimError(0, "waitpid failed for %s", path.c_str());
+  gettimeofday(&end, NULL);
+  seconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1e6;
+  status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128+WTERMSIG(wstatus);
+
+  /* a failed run's partial output is removed, rather than left beside the
+   * completed ones */
+  if (status != 0) unlink(tmp.c_str());
+  else if (rename(tmp.c_str(), path.c_str()) != 0)
+    throw SimError(0, "failed to rename %s", tmp.c_str());
+
+  lock_guard<mutex> guard(report_lock);
+  cout << "done: " << path << " worker: " << worker << " status: " << status
+    << " seconds: " << seconds << endl;
+}
+
+/* Find the last value of a statistic in a quant output file, i.e., the
+ * number following the last "<stat>:". Returns false if it never appears */
+bool last_stat_value(const string &path, const string &stat, double &value) {
+  gzFile in = gzopen(path.c_str(), "rb");
+  if (in == NULL) return false;
+  string key = stat + ":";
+  string line;
+  bool found = false;
+  while (read_line(in, line)) {
+    size_t pos = line.find(key);
+    if (pos == string::npos) continue;
+    if (pos > 0 && line[pos-1] != ' ') continue;
+    char *end;
+    const char *start = line.c_str() + pos + key.size();
+    double x = strtod(start, &end);
+    if (end == start) continue;
+    value = x;
+    found = true;
+  }
+  gzclose(in);
+  return found;
+}
+
+/* mean and (n-1) variance */
+void moments(const vector<double> &x, double &mean, double &var) {
+  mean = 0;
+  var = 0;
+  if (x.empty()) return;
+  for (size_t i=0; i < x.size(); i++) mean += x[i];
+  mean /= x.size();
+  if (x.size() < 2) return;
+  for (size_t i=0; i < x.size(); i++) var += (x[i]-mean)*(x[i]-mean);
+  var /= x.size()-1;
+}
+
+/* The axis along which two points are neighbors, i.e., one step apart on
+ * that axis and the same on every other, or -1 if they aren't neighbors */
+int neighbor_axis(const SweepPoint &a, const SweepPoint &b) {
+  int axis = -1;
+  for (int k=0; k < NUM_GRID_AXES; k++) {
+    int step = b.coords[k] - a.coords[k];
+    if (step == 0) continue;
+    if (step != 1 || axis >= 0) return -1;
+    axis = k;
+  }
+  return axis;
+}
+
+/* Report the difference in each compared statistic between each pair of
+ * grid points that are neighbors along one axis, so each difference is the
+ * effect of changing that one parameter. Only replicates with a value at
+ * both points are used, so the paired and unpaired standard errors are
+ * computed from the same runs */
+void report_paired_differences(const SweepSpec &spec, const vector<SweepJob*> &jobs,
+    const vector<SweepPoint> &points, int replicates) {
+  int npoints = (int)points.size();
+  vector<string> stats;
+  strsplit(spec.get("compare", ""), stats, ',');
+  for (size_t k=0; k < stats.size(); k++) {
+    string stat = trim(stats[k]);
+    vector<vector<double> > values(npoints, vector<double>(replicates, 0.0));
+    vector<vector<bool> > have(npoints, vector<bool>(replicates, false));
+    vector<string> dirs(npoints);
+    for (size_t i=0; i < jobs.size(); i++) {
+      const SweepJob &j = *jobs[i];
+      int r = (int)(i % replicates);
+      dirs[j.point_index] = j.path.substr(0, j.path.rfind('/'));
+      double v;
+      if (last_stat_value(j.path, stat, v)) {
+        values[j.point_index][r] = v;
+        have[j.point_index][r] = true;
+      }
+    }
+
+    for (int p=0; p < npoints; p++) {
+      for (int q=p+1; q < npoints; q++) {
+        int axis = neighbor_axis(points[p], points[q]);
+        if (axis < 0) continue;
+        vector<double> a, b, d;
+        for (int r=0; r < replicates; r++) {
+          if (!have[p][r] || !have[q][r]) continue;
+          a.push_back(values[p][r]);
+          b.push_back(values[q][r]);
+          d.push_back(values[q][r] - values[p][r]);
+        }
+        int n = (int)d.size();
+        double ma, va, mb, vb, md, vd;
+        moments(a, ma, va);
+        moments(b, mb, vb);
+        moments(d, md, vd);
+        double paired_se = n > 1 ? sqrt(vd/n) : 0;
+        double unpaired_se = n > 1 ? sqrt((va+vb)/n) : 0;
+        cout << "paired: stat: " << stat << " axis: " << grid_axes[axis]
+          << " from: " << dirs[p] << " to: " << dirs[q]
+          << " n: " << n << " diff: " << md << " se: " << paired_se
+          << " unpaired_se: " << unpaired_se << endl;
+      }
+    }
+  }
+}
+
+int
+main(int argc, char **argv) { try {
+  int threads = 0;
+  bool dry_run = false;
+
+  while (1) {
+    static struct option long_options[] = {
+      {"threads", required_argument, 0, 't'},
+      {"dry-run", no_argument, 0, 'n'},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "t:n", long_options, &option_index);
+    if (c == -1) break;
+    switch (c) {
+      case 't': {
+        char *end;
+        threads = strtol(optarg, &end, 10);
+        if (optarg == end) throw SimUsageError("non-numeric number of threads");
+        break;
+      }
+      case 'n':
+        dry_run = true;
+        break;
+      default:
+        throw SimUsageError("unrecognized option");
+    }
+  }
+  if (optind != argc-1) throw SimUsageError("must give exactly one spec file");
+
+  SweepSpec spec(argv[optind]);
+  if (threads <= 0) threads = spec.get_int("threads", 0);
+  int replicates = spec.get_int("replicates", 1);
+  unsigned int seed = (unsigned int)spec.get_int("seed", 0);
+
+  /* every job gets its own seed, determined by its position in the grid,
+   * unless using common random numbers, in which case the seed depends only
+   * on the replicate */
+  bool crn = spec.get("crn", "no") == "yes";
+  vector<SweepPoint> points;
+  spec.expand(points);
+  vector<SweepJob*> grid;
+  for (size_t p=0; p < points.size(); p++) {
+    for (int r=0; r < replicates; r++) {
+      unsigned int sd = crn ? seed + r : seed + p*replicates + r;
+      grid.push_back(new SweepJob(spec, points[p], r, sd));
+      grid.back()->point_index = (int)p;
+    }
+  }
+  vector<SweepJob*> jobs(grid);
+  std::stable_sort(jobs.begin(), jobs.end(), longer_job);
+
+  if (dry_run) {
+    for (size_t i=0; i < jobs.size(); i++) {
+      vector<string> args;
+      jobs[i]->command(args);
+      for (size_t j=0; j < args.size(); j++) cout << (j ? " " : "") << args[j];
+      cout << " > " << jobs[i]->path << endl;
+    }
+    return 0;
+  }
+
+  WorkStealingPool pool(threads);
+  for (size_t i=0; i < jobs.size(); i++) pool.add(jobs[i]);
+  cout << "sweep: points: " << points.size() << " jobs: " << jobs.size()
+    << " threads: " << pool.size() << endl;
+  pool.run();
+
+  int failed = 0;
+  for (size_t i=0; i < jobs.size(); i++) {
+    if (jobs[i]->status != 0) {
+      cerr << "failed: " << jobs[i]->path << " status: " << jobs[i]->status << endl;
+      failed++;
+    }
+  }
+  if (spec.fixed.count("compare"))
+    report_paired_differences(spec, grid, points, replicates);
+  for (size_t i=0; i < grid.size(); i++) delete grid[i];
+  for (size_t i=0; i < pool.errors().size(); i++)
+    cerr << "error: " << pool.errors()[i] << endl;
+  cout << "sweep: failed: " << failed << " steals: " << pool.steals() << endl;
+  return failed > 0 ? 1 : 0;
+
+/* catch any errors that were thrown anywhere inside this block */
+} catch (SimUsageError e) {
+   cerr << endl << "detected usage error: " << e.detail << endl << endl;
+   usage();
+   return 1;
+} catch(SimError &e) {
+   cerr << "uncaught exception: " << e.detail << endl;
+   return 1;
+} return 0; }
+
+/* print a help message */
+void
+usage(void) {
+  cerr << "usage: sweep [options] <spec file>\n"
+    << "  -t/--threads <int>    number of worker threads (default: spec 'threads', or one per core)\n"
+    << "  -n/--dry-run          print the commands in the order they'd be scheduled, but don't run them\n"
+    << "Spec keys (key = value, one per line):\n"
+    << "  N, mu, s              scalar axes, alternatives separated by ','\n"
+    << "  effects, opts         vector axes, alternatives separated by ';'\n"
+    << "  eprobs, times         paired with effects and opts respectively\n"
+    << "  model, loci, burnin, env, replicates, seed, threads, quant, outdir, stdin, args\n"
+    << "  crn = yes|no          use common random numbers across points (same seed per replicate)\n"
+    << "  compare = <stats>     report paired differences of these statistics between consecutive points\n"
+    << "  Axis values of the form @file are read one alternative per line from file\n"
+    << "\n";
+  return;
+}
+
+/* END */
@@ -0,0 +1,85 @@
+#include "gtest/gtest.h"
+#include "batch_means.h"
+#include "error_handling.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+/* the number of batches stays between batches and 2*batches */
+TEST(BatchMeansTest, BatchesStayBounded) {
+  BatchMeans b(1, 4);
+  EXPECT_TRUE(isnan(b.se(0)));
+  for (int j=0; j < 1000; j++) {
+    b.post(j % 3);
+    EXPECT_LT(b.batches(), 8);
+    if (j >= 8) {
+      EXPECT_GE(b.batches(), 4);
+    }
+  }
+  EXPECT_EQ(b.count(), 1000);
+  EXPECT_EQ(b.batch_length(), 128);
+  EXPECT_DOUBLE_EQ(b.mean(0), 999.0 / 1000);
+  EXPECT_THROW(BatchMeans(1, 1), SimError);
+}
+
+/* Independent samples have the usual standard error, and an AR(1) series
+ * the larger one its autocorrelation gives, with the effective sample
+ * size cut by (1-r)/(1+r) */
+TEST(BatchMeansTest, StandardErrors) {
+  srand48(11);
+  int n = 1 << 18;
+  double r = 0.9, y = 0.0;
+  BatchMeans b(2);
+  for (int j=0; j < n; j++) {
+    double x[2];
+    x[0] = drand48() - 0.5;
+    y = r*y + drand48() - 0.5;
+    x[1] = y;
+    b.post(x);
+  }
+  double sd = sqrt(1.0/12);
+  EXPECT_NEAR(b.se(0), sd / sqrt((double)n), 0.3 * sd / sqrt((double)n));
+  EXPECT_NEAR(b.ess(0) / n, 1.0, 0.5);
+  double se1 = sd / (1-r) / sqrt((double)n);
+  EXPECT_NEAR(b.se(1), se1, 0.3 * se1);
+  EXPECT_NEAR(b.ess(1) / n, (1-r)/(1+r), 0.5*(1-r)/(1+r));
+  EXPECT_LT(fabs(b.lag1(0)), 0.5);
+}
+
+/* a series that doesn't vary is known exactly */
+TEST(BatchMeansTest, ConstantSeries) {
+  BatchMeans b(1);
+  for (int j=0; j < 500; j++) b.post(3.0);
+  EXPECT_EQ(b.se(0), 0.0);
+  EXPECT_EQ(b.ess(0), 500);
+  EXPECT_EQ(b.lag1(0), 0.0);
+}
+
+/* batch means read back from their saved state carry on the same */
+TEST(BatchMeansTest, SaveRestore) {
+  BatchMeans a(2, 8), b(2, 8);
+  double x[2];
+  for (int j=0; j < 300; j++) {
+    x[0] = j % 7;
+    x[1] = (j * 13) % 5;
+    a.post(x);
+  }
+  std::vector<double> v;
+  a.save(v);
+  EXPECT_EQ(b.restore(&v[0], &v[0] + v.size()), &v[0] + v.size());
+  for (int j=0; j < 300; j++) {
+    x[0] = j % 4;
+    x[1] = j % 9;
+    a.post(x);
+    b.post(x);
+  }
+  EXPECT_EQ(b.count(), a.count());
+  for (int i=0; i < 2; i++) {
+    EXPECT_EQ(b.mean(i), a.mean(i));
+    EXPECT_EQ(b.se(i), a.se(i));
+  }
+  BatchMeans c(3, 8);
+  EXPECT_THROW(c.restore(&v[0], &v[0] + v.size()), SimError);
+  EXPECT_THROW(b.restore(&v[0], &v[0] + 10), SimError);
+}
@@ -0,0 +1,55 @@
+#include "gtest/gtest.h"
+#include "sim_rand.h"
+#include "run_quant.h"
+
+#include <string>
+#include <sstream>
+
+static const char *branch_run = "./quant --model=infinite --loci=0 --popsize=30 --mu=0.05 "
+  "--effects=0.5 --opts=1 --times=40 --seed=7 ";
+
+/* the output of branch k, without its branch_params: line */
+static std::string branch_output(const std::string &output, int k) {
+  std::stringstream begin, end;
+  begin << "branch: " << k << "\n";
+  end << "end branch: " << k << " ";
+  size_t b = output.find(begin.str());
+  if (b == std::string::npos) return std::string();
+  b = output.find('\n', b + begin.str().size()) + 1;
+  size_t e = output.find(end.str(), b);
+  return e == std::string::npos ? std::string() : output.substr(b, e - b);
+}
+
+/* the branches carry on from the trunk, whose output up to the fork is that
+ * of a run without branches */
+TEST(BranchTest, SharesTrunkUntilFork) {
+  std::string straight, branched;
+  ASSERT_EQ(run_command(std::string(branch_run) + "--burnin=20", straight), 0);
+  ASSERT_EQ(run_command(std::string(branch_run) + "--burnin=20 --branches=2", branched), 0);
+  std::string after = after_params(branched);
+  size_t fork = after.find("branch: 0\n");
+  ASSERT_NE(fork, std::string::npos);
+  std::string trunk = after.substr(0, fork);
+  EXPECT_FALSE(trunk.empty());
+  EXPECT_EQ(after_params(straight).compare(0, trunk.size(), trunk), 0);
+  EXPECT_NE(branch_output(branched, 0), branch_output(branched, 1));
+}
+
+/* With common random numbers and no environmental noise, nothing is drawn
+ * before the fork that the simulation uses, so a branch that changes
+ * nothing is a run with the branch's seed */
+TEST(BranchTest, UnchangedBranchMatchesStraightRun) {
+  std::string branched;
+  ASSERT_EQ(run_command(std::string(branch_run) + "--burnin=0 --crn --branches=2", branched), 0);
+  for (int k=0; k < 2; k++) {
+    std::stringstream seed;
+    seed << "--burnin=0 --crn --seed=" << derive_seed(7, k+1);
+    std::string straight;
+    ASSERT_EQ(run_command(std::string(branch_run) + seed.str(), straight), 0);
+    std::string branch = branch_output(branched, k);
+    EXPECT_FALSE(branch.empty());
+    EXPECT_EQ(branch, after_params(straight)) << "branch " << k;
+  }
+}
+
+/* END */
@@ -0,0 +1,69 @@
+#include "gtest/gtest.h"
+#include "burnin.h"
+#include "error_handling.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+/* post samples of y(t) until the detector's done, or max samples */
+static long run(BurninDetector &b, double (*y)(long), long max) {
+  for (long t=0; t < max; t++) {
+    double x[2] = { y(t), drand48() };
+    if (b.post(x)) return t+1;
+  }
+  return -1;
+}
+
+static double stationary(long) { return drand48(); }
+static double transient(long t) { return drand48() + 5.0 * exp(-t / 300.0); }
+static double trend(long t) { return drand48() + t / 100.0; }
+
+/* a stationary series settles as soon as it's allowed to, from the start */
+TEST(BurninDetectorTest, StationaryFromStart) {
+  srand48(5);
+  BurninDetector b(2, 200);
+  long t = run(b, stationary, 100000);
+  EXPECT_GE(t, 400);
+  EXPECT_LT(t, 1000);
+  EXPECT_EQ(b.count(), t);
+  EXPECT_LT(b.stationary_from(), t/4);
+  double x[2] = { 0.5, 0.5 };
+  EXPECT_TRUE(b.post(x));
+}
+
+/* a decaying transient is cut off after it's died away */
+TEST(BurninDetectorTest, TransientCutOff) {
+  srand48(6);
+  BurninDetector b(2, 200);
+  long t = run(b, transient, 100000);
+  ASSERT_GT(t, 0);
+  EXPECT_GT(b.stationary_from(), 600);
+  EXPECT_LT(b.stationary_from(), 3000);
+}
+
+/* a series that keeps going up never settles */
+TEST(BurninDetectorTest, TrendNeverSettles) {
+  srand48(7);
+  BurninDetector b(2, 200);
+  EXPECT_EQ(run(b, trend, 50000), -1);
+  EXPECT_EQ(b.stationary_from(), -1);
+}
+
+/* a detector read back from its saved state carries on the same */
+TEST(BurninDetectorTest, SaveRestore) {
+  srand48(8);
+  BurninDetector a(2, 200), b(2, 200);
+  run(a, transient, 300);
+  std::vector<double> v;
+  a.save(v);
+  EXPECT_EQ(b.restore(&v[0], &v[0] + v.size()), &v[0] + v.size());
+  EXPECT_EQ(b.last(0), a.last(0));
+  srand48(9);
+  long ta = run(a, transient, 100000);
+  srand48(9);
+  long tb = run(b, transient, 100000);
+  EXPECT_EQ(ta, tb);
+  EXPECT_EQ(a.stationary_from(), b.stationary_from());
+  EXPECT_THROW(b.restore(&v[0], &v[0] + v.size() - 1), SimError);
+}
@@ -0,0 +1,48 @@
+#include "gtest/gtest.h"
+#include "run_quant.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+
+class CheckpointTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    char name[] = "/tmp/checkpoint_test_XXXXXX";
+    int fd = mkstemp(name);
+    close(fd);
+    path = name;
+  }
+  virtual void TearDown() {
+    unlink(path.c_str());
+  }
+  std::string path;
+};
+
+/* two epochs, and statistics that accumulate over the run */
+static const char *checkpoint_run = "./quant --model=infinite --loci=0 --popsize=40 --mu=0.1 "
+  "--effects=0.5 --opts=1,0 --times=50,100 --burnin=20 --seed=5 --enable-stat=visits "
+  "--enable-stat=fixations --enable-stat=segsites --enable-stat=pmoments "
+  "--enable-stat=phenotype-var-mean ";
+
+/* The output of a run up to a checkpoint, followed by that of the run
+ * resumed from it, is byte for byte the output of the run uninterrupted.
+ * The last checkpoint of the run is written at generation 60, in the
+ * second epoch */
+TEST_F(CheckpointTest, ResumeMatchesUninterruptedRun) {
+  std::string uninterrupted, checkpointed, resumed;
+  std::string checkpoint = "--checkpoint=" + path + " --checkpoint-every=60 ";
+  ASSERT_EQ(run_command(checkpoint_run, uninterrupted), 0);
+  ASSERT_EQ(run_command(std::string(checkpoint_run) + checkpoint + "2>/dev/null", checkpointed), 0);
+  EXPECT_EQ(after_params(checkpointed), after_params(uninterrupted));
+
+  ASSERT_EQ(run_command(std::string(checkpoint_run) + checkpoint + "--resume=" + path +
+    " 2>/dev/null", resumed), 0);
+  std::string full = after_params(uninterrupted);
+  size_t stop = full.find("\ngen: 60 ");
+  ASSERT_NE(stop, std::string::npos);
+  EXPECT_EQ(after_params(resumed).compare(0, 9, "gen: 60 f"), 0);
+  EXPECT_EQ(full.substr(0, stop+1) + after_params(resumed), full);
+}
+
+/* END */
@@ -0,0 +1,22 @@
+#include "gtest/gtest.h"
+#include "run_quant.h"
+
+#include <stdlib.h>
+#include <string>
+
+/* The segsites target counts the sites that are neither lost nor fixed. In
+ * the finite sites model the loci stay on once they're absorbed, and without
+ * mutation drift absorbs them all, so the mean falls well below the number
+ * of loci and the run doesn't stop early on a standard error of 0 */
+TEST(ConvergenceTest, SegsitesTargetSkipsAbsorbedLoci) {
+  std::string output;
+  ASSERT_EQ(run_command("./quant --model=finite --popsize=10 --loci=10 --effects=0.5 --mu=0 "
+    "--opts=0 --times=1000 --burnin=0 --freqs=even --seed=3 --disable-all-stats "
+    "--enable-stat=convergence --target-se=segsites:0.0001", output), 0);
+  EXPECT_EQ(output.find("converged:"), std::string::npos);
+  size_t mean = output.find("convergence: segsites n: 1000 mean: ");
+  ASSERT_NE(mean, std::string::npos);
+  EXPECT_LT(atof(output.c_str() + output.find("mean: ", mean) + 6), 5.0);
+}
+
+/* END */
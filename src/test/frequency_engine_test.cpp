@@ -0,0 +1,74 @@
+#include "gtest/gtest.h"
+#include "wf_chain.h"
+#include "run_quant.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <sstream>
+
+/* the mean derived allele frequency of each freqs line, over nloci loci,
+ * those not listed being fixed */
+static std::vector<double> mean_frequencies(const std::string &output, int nloci) {
+  std::vector<double> means;
+  std::vector<std::string> lines = output_lines(output);
+  for (size_t i=0; i < lines.size(); i++) {
+    size_t at = lines[i].find(" freqs:");
+    if (lines[i].compare(0, 5, "gen: ") != 0 || at == std::string::npos) continue;
+    std::stringstream s(lines[i].substr(at + 7));
+    std::string site;
+    double sum = 0;
+    int listed = 0;
+    while (s >> site) {
+      sum += atof(site.c_str() + site.find(':') + 1);
+      listed++;
+    }
+    means.push_back((sum + nloci - listed) / nloci);
+  }
+  return means;
+}
+
+/* The sites are dealt into chunks, each with its own stream, so the output
+ * doesn't depend on how many threads draw the chunks. 10000 loci make three
+ * chunks */
+TEST(FrequencyEngineTest, SameOutputOnAnyThreads) {
+  const char *run = "./quant --engine=frequency --model=finite --popsize=100 --loci=10000 "
+    "--effects=0.5 --mu=0.05 --s=0.5 --env=0.2 --opts=1 --times=20 --burnin=5 --freqs=even "
+    "--seed=9 --enable-stat=visits --enable-stat=segsites --enable-stat=phenotype-var-mean ";
+  std::string one, three;
+  ASSERT_EQ(run_command(std::string(run) + "--threads=1", one), 0);
+  ASSERT_EQ(run_command(std::string(run) + "--threads=3", three), 0);
+  EXPECT_FALSE(after_params(one).empty());
+  EXPECT_TRUE(after_params(one) == after_params(three));
+}
+
+/* Without selection, the mean frequency over many loci follows what the
+ * Wright-Fisher chain expects of each: neutrally its next frequency is
+ * linear in the count, u + (1-2u) p, so the mean goes the same way */
+TEST(FrequencyEngineTest, NeutralMeanFollowsChain) {
+  const int N = 50, nloci = 20000, times = 50;
+  const double mu = 200;
+  std::stringstream run;
+  run << "yes 0.1 | head -n " << nloci << " | ./quant --engine=frequency --model=finite "
+    << "--popsize=" << N << " --loci=" << nloci << " --effects=0 --mu=" << mu
+    << " --opts=0 --times=" << times << " --burnin=0 --seed=1 --disable-all-stats "
+    << "--enable-stat=frequencies";
+  std::string output;
+  ASSERT_EQ(run_command(run.str(), output), 0);
+  std::vector<double> means = mean_frequencies(output, nloci);
+  ASSERT_EQ((int)means.size(), times + 1);
+
+  WrightFisherChain chain(N, diploid, finite_sites, 0.0, 0.1, 0.0, 0.0, 0.0, mu/nloci);
+  double a = chain.next_frequency(0), b = chain.next_frequency(chain.copies()) - a;
+  double expected = means[0];
+  for (int gen=1; gen <= times; gen++) {
+    expected = a + b*expected;
+    /* each locus' frequency varies by at most 1/2, so four standard errors
+     * of the mean over the loci */
+    EXPECT_NEAR(means[gen], expected, 4*0.5/sqrt((double)nloci)) << "gen " << gen;
+  }
+  EXPECT_GT(means[times], means[0] + 0.2);
+}
+
+/* END */
@@ -0,0 +1,69 @@
+#include "gtest/gtest.h"
+#include "genotype_file.h"
+#include "error_handling.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+class GenotypeFileTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    char name[] = "/tmp/genotype_file_test_XXXXXX";
+    int fd = mkstemp(name);
+    close(fd);
+    path = name;
+  }
+  virtual void TearDown() {
+    unlink(path.c_str());
+  }
+  std::string path;
+};
+
+/* an odd number of sites with ids, so the matrix needs padding */
+TEST_F(GenotypeFileTest, RoundTrip) {
+  int N = 5;
+  std::vector<double> effects;
+  std::vector<uint32_t> ids;
+  std::vector<uint8_t> genotypes;
+  for (int s=0; s < 3; s++) {
+    effects.push_back(s - 1.5);
+    ids.push_back(10 + s);
+    for (int i=0; i < N; i++) genotypes.push_back((i + s) % 3);
+  }
+  GenotypeFile::write(path, N, 2, effects, ids, genotypes);
+
+  GenotypeFile g(path);
+  EXPECT_EQ(g.popsize, N);
+  EXPECT_EQ(g.ploidy, 2);
+  ASSERT_EQ(g.nsites, 3);
+  ASSERT_TRUE(g.ids != NULL);
+  for (int s=0; s < 3; s++) {
+    EXPECT_DOUBLE_EQ(g.effects[s], s - 1.5);
+    EXPECT_EQ(g.ids[s], (uint32_t)(10 + s));
+    for (int i=0; i < N; i++) EXPECT_EQ(g.genotypes(s)[i], (i + s) % 3);
+  }
+}
+
+TEST_F(GenotypeFileTest, WithoutIds) {
+  std::vector<double> effects(2, 1.0);
+  std::vector<uint32_t> ids;
+  std::vector<uint8_t> genotypes(8, 1);
+  GenotypeFile::write(path, 4, 1, effects, ids, genotypes);
+
+  GenotypeFile g(path);
+  EXPECT_EQ(g.ploidy, 1);
+  EXPECT_TRUE(g.ids == NULL);
+  EXPECT_EQ(g.genotypes(1)[3], 1);
+}
+
+TEST_F(GenotypeFileTest, RejectsTruncated) {
+  std::vector<double> effects(2, 1.0);
+  std::vector<uint32_t> ids;
+  std::vector<uint8_t> genotypes(20, 0);
+  GenotypeFile::write(path, 10, 2, effects, ids, genotypes);
+  ASSERT_EQ(truncate(path.c_str(), 40), 0);
+  EXPECT_THROW(GenotypeFile g(path), SimError);
+}
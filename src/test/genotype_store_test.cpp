@@ -0,0 +1,55 @@
+#include "gtest/gtest.h"
+#include "run_quant.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+class GenotypeStoreTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    for (int k=0; k < 2; k++) {
+      char name[] = "/tmp/genotype_store_test_XXXXXX";
+      int fd = mkstemp(name);
+      close(fd);
+      paths[k] = name;
+    }
+  }
+  virtual void TearDown() {
+    for (int k=0; k < 2; k++) unlink(paths[k].c_str());
+  }
+
+  std::string contents(const std::string &path) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    std::stringstream s;
+    s << in.rdbuf();
+    return s.str();
+  }
+
+  std::string paths[2];
+};
+
+/* more individuals than fit in one tile, so the spilled store has two, the
+ * second of them partly used */
+static const char *store_run = "./quant --model=infinite --loci=0 --popsize=5000 --mu=0.01 "
+  "--effects=0.5 --opts=1 --times=15 --burnin=5 --seed=3 --enable-stat=segsites ";
+
+/* a store spilled to tiled files gives the same run as the one in memory */
+TEST_F(GenotypeStoreTest, SpilledMatchesInMemory) {
+  std::string in_memory, spilled, output;
+  ASSERT_EQ(run_command(std::string(store_run) + "--trajectory=" + paths[0], in_memory), 0);
+  ASSERT_EQ(run_command(std::string(store_run) + "--trajectory=" + paths[1] +
+    " --genotype-memory=0.001 --genotype-dir=/tmp", spilled), 0);
+  EXPECT_EQ(after_params(spilled), after_params(in_memory));
+  std::string trajectory = contents(paths[0]);
+  EXPECT_FALSE(trajectory.empty());
+  EXPECT_TRUE(trajectory == contents(paths[1]));
+
+  /* the budget really is exceeded: the files can't be made here */
+  EXPECT_NE(run_command(std::string(store_run) +
+    "--genotype-memory=0.001 --genotype-dir=/nonexistent 2>/dev/null", output), 0);
+}
+
+/* END */
@@ -0,0 +1,46 @@
+#include "gtest/gtest.h"
+#include "run_quant.h"
+
+#include <string>
+#include <vector>
+
+/* the lines of one deme's own statistics */
+static std::string deme_lines(const std::string &output, int d) {
+  std::stringstream prefix;
+  prefix << "deme: " << d << " ";
+  std::string lines;
+  std::vector<std::string> all = output_lines(output);
+  for (size_t i=0; i < all.size(); i++) {
+    if (all[i].compare(0, prefix.str().size(), prefix.str()) == 0) lines += all[i] + "\n";
+  }
+  return lines;
+}
+
+static const char *island_run = "./quant --model=finite --popsize=40 --loci=8 --effects=0.5 "
+  "--mu=0.02 --s=0.5 --env=0.2 --opts=1 --times=30 --burnin=10 --freqs=even --seed=4 "
+  "--enable-stat=visits --enable-stat=segsites --enable-stat=phenotype-var-mean --migration=0 ";
+
+/* Without migration each deme is on its own, drawing only from its own
+ * stream, so a deme's statistics don't depend on how many others there are
+ * or what they're doing */
+TEST(IslandTest, DemesWithoutMigrationAreIndependent) {
+  std::string two, three;
+  ASSERT_EQ(run_command(std::string(island_run) + "--demes=2", two), 0);
+  ASSERT_EQ(run_command(std::string(island_run) + "--demes=3 --deme-opts=0,0,-1", three), 0);
+  for (int d=0; d < 2; d++) {
+    std::string lines = deme_lines(two, d);
+    EXPECT_NE(lines.find(" visits: "), std::string::npos);
+    EXPECT_NE(lines.find(" segsites: 0.5,8"), std::string::npos);
+    EXPECT_EQ(lines, deme_lines(three, d)) << "deme " << d;
+  }
+  EXPECT_NE(deme_lines(two, 0), deme_lines(two, 1));
+}
+
+/* the statistics the demes don't collect are refused, not dropped */
+TEST(IslandTest, RefusesUncollectedStatistics) {
+  std::string output;
+  EXPECT_NE(run_command(std::string(island_run) + "--demes=2 --enable-stat=pmoments 2>/dev/null",
+    output), 0);
+}
+
+/* END */
@@ -0,0 +1,57 @@
+#include "gtest/gtest.h"
+#include "live.h"
+#include "error_handling.h"
+
+#include <unistd.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class LiveTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    std::stringstream s;
+    s << "quant_live_test_" << getpid();
+    name = s.str();
+  }
+  std::string name;
+};
+
+/* publish more sites than the initial capacity, so the segment grows
+ * between the reader's snapshots */
+TEST_F(LiveTest, SnapshotsFollowPublisher) {
+  LivePublisher p(name, 100, 2, 3);
+  LiveReader r(name);
+  std::vector<int> visits(3);
+  LiveSnapshot s;
+
+  for (int gen=0; gen < 3; gen++) {
+    int nsites = gen == 2 ? 1000 : 10*gen;
+    p.begin(gen, 0.5*gen, 0.25);
+    for (int i=0; i < nsites; i++) p.add_site(i, i % 200, i % 2 ? 1.0 : -1.0);
+    visits[gen] = gen+1;
+    p.end(visits);
+
+    ASSERT_TRUE(r.snapshot(s));
+    EXPECT_TRUE(s.running);
+    EXPECT_EQ(s.generation, gen);
+    EXPECT_EQ(s.updates, (unsigned int)gen+1);
+    EXPECT_EQ(s.popsize, 100);
+    EXPECT_DOUBLE_EQ(s.phenotype_mean, 0.5*gen);
+    ASSERT_EQ((int)s.ids.size(), nsites);
+    for (int i=0; i < nsites; i++) {
+      EXPECT_EQ(s.ids[i], (uint32_t)i);
+      EXPECT_EQ(s.counts[i], i % 200);
+      EXPECT_DOUBLE_EQ(s.effects[i], i % 2 ? 1.0 : -1.0);
+    }
+    ASSERT_EQ(s.visits.size(), 3u);
+    EXPECT_EQ(s.visits[gen], gen+1);
+  }
+
+  /* the reader keeps its mapping after the publisher is done */
+  p.close();
+  ASSERT_TRUE(r.snapshot(s));
+  EXPECT_FALSE(s.running);
+  EXPECT_EQ(s.generation, 2);
+  EXPECT_THROW(LiveReader gone(name), SimError);
+}
@@ -0,0 +1,175 @@
+#include "gtest/gtest.h"
+#include "sim_rand.h"
+#include "run_quant.h"
+
+#include <math.h>
+#include <string>
+#include <vector>
+#include <sstream>
+
+/* A scalar reference for one lane of the lockstep engine: the same model
+ * written out plainly for a single replicate, drawing from the lane's two
+ * streams in the same order, and printing the lane's freqs, segsites and
+ * pheno lines as the engine does */
+class ReferenceLane {
+public:
+  ReferenceLane(int lane, unsigned int seed, int N, int loci, double effect, double mu,
+      double s, double env, double opt)
+      : N(N), nloci(loci), effect(effect), mu(mu), sig(2.0/s), env(env), opt(opt),
+        rng(seed, 2*lane+1), seg(seed, 2*lane), prefix() {
+    std::stringstream p;
+    p << "rep: " << lane << " ";
+    prefix = p.str();
+    baseline = 0;
+    for (int l=0; l < nloci; l++) baseline -= effect;
+    parents.assign(N*nloci, 0);
+    offspring.assign(N*nloci, 0);
+    phenotype.assign(N, 0);
+    fitness.assign(N, 0);
+    offspring_phenotype.assign(N, 0);
+    offspring_fitness.assign(N, 0);
+  }
+
+  /* even initial frequencies under Hardy-Weinberg */
+  void setup(void) {
+    std::vector<int> order(N);
+    for (int l=0; l < nloci; l++) {
+      double f = (l + 1.0) / (nloci + 1);
+      int hets = (int)round(2.0*f*(1.0-f)*N), homs = (int)round(f*f*N);
+      for (int i=0; i < N; i++) order[i] = i;
+      for (int i=N-1; i > 0; i--) {
+        int j = (int)(rng.uniform()*(i+1));
+        int tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+      }
+      for (int k=0; k < hets+homs; k++) parents[order[k]*nloci + l] = k < hets ? 1 : 2;
+    }
+    max_fitness = 0;
+    for (int i=0; i < N; i++) update(parents, i, phenotype, fitness);
+  }
+
+  void update(const std::vector<int> &g, int i, std::vector<double> &ph, std::vector<double> &w) {
+    double p = baseline;
+    for (int l=0; l < nloci; l++) p += g[i*nloci + l]*effect;
+    if (env != 0) p += rng.uniform()*env;
+    ph[i] = p;
+    w[i] = exp(-(p-opt)*(p-opt)/sig);
+    if (w[i] > max_fitness) max_fitness = w[i];
+  }
+
+  int choose_parent(double parent_max) {
+    while (1) {
+      int k = (int)(N*rng.uniform());
+      if (rng.uniform()*parent_max <= fitness[k]) return k;
+    }
+  }
+
+  void next_generation(void) {
+    double parent_max = max_fitness;
+    max_fitness = 0;
+    for (int off=0; off < N; off++) {
+      int mom = choose_parent(parent_max);
+      int dad = choose_parent(parent_max);
+      /* each parent transmits a derived allele with probability g/2 */
+      for (int l=0; l < nloci; l++) {
+        double x1 = seg.uniform(), x2 = seg.uniform();
+        offspring[off*nloci + l] = (x1 < parents[mom*nloci + l]/2.0) + (x2 < parents[dad*nloci + l]/2.0);
+      }
+      int muts = rng.poisson(2.0*mu);
+      for (int m=0; m < muts; m++) {
+        int &g = offspring[off*nloci + (int)floor(rng.uniform()*nloci)];
+        if (g == 1) g = rng.uniform() < 0.5 ? 0 : 2;
+        else g = 1;
+      }
+      update(offspring, off, offspring_phenotype, offspring_fitness);
+    }
+    parents.swap(offspring);
+    phenotype.swap(offspring_phenotype);
+    fitness.swap(offspring_fitness);
+  }
+
+  void print_freqs(int gen, std::stringstream &s) {
+    s << prefix << "gen: " << gen << " freqs:";
+    for (int l=0; l < nloci; l++) {
+      int c = 0;
+      for (int i=0; i < N; i++) c += parents[i*nloci + l];
+      double f = c / (2.0*N);
+      if (f < 1.0) s << " " << l << ":" << f;
+    }
+    s << "\n";
+  }
+
+  void print_segsites(int gen, std::stringstream &s) {
+    s << prefix << "gen: " << gen << " segsites: " << effect << "," << nloci << "\n";
+  }
+
+  void print_pheno(int gen, std::stringstream &s) {
+    double sum = 0, sumsq = 0;
+    for (int i=0; i < N; i++) {
+      sum += phenotype[i];
+      sumsq += phenotype[i]*phenotype[i];
+    }
+    double mean = sum/N;
+    s << prefix << "gen: " << gen << " pheno: " << mean << " " << sumsq/N - mean*mean << "\n";
+  }
+
+  /* the lane's lines of a run with a burnin */
+  std::string run(int burnin, int generations) {
+    std::stringstream s;
+    setup();
+    int gen = 0;
+    while (gen < generations) {
+      if (burnin <= 0) {
+        print_freqs(gen, s);
+        print_segsites(gen, s);
+        print_pheno(gen, s);
+      }
+      next_generation();
+      if (burnin <= 0) gen++;
+      else burnin--;
+    }
+    print_freqs(gen, s);
+    print_pheno(gen, s);
+    print_segsites(gen, s);
+    return s.str();
+  }
+
+private:
+  int N, nloci;
+  double effect, mu, sig, env, opt, baseline, max_fitness;
+  RandStream rng, seg;
+  std::string prefix;
+  std::vector<int> parents, offspring;
+  std::vector<double> phenotype, fitness, offspring_phenotype, offspring_fitness;
+};
+
+/* each lane of a lockstep run gives what the scalar model does with the
+ * lane's streams */
+TEST(LockstepTest, MatchesScalarReference) {
+  std::string output;
+  ASSERT_EQ(run_command("./quant --model=finite --lockstep=8 --popsize=30 --loci=6 --effects=0.5 "
+    "--mu=0.05 --s=0.5 --env=0.3 --opts=1 --times=20 --burnin=5 --freqs=even --seed=11 "
+    "--disable-all-stats --enable-stat=frequencies --enable-stat=segsites --enable-stat=phenotype",
+    output), 0);
+
+  int lanes[] = { 0, 5 };
+  for (int k=0; k < 2; k++) {
+    std::stringstream prefix;
+    prefix << "rep: " << lanes[k] << " ";
+    std::string lane;
+    std::vector<std::string> lines = output_lines(output);
+    for (size_t i=0; i < lines.size(); i++) {
+      if (lines[i].compare(0, prefix.str().size(), prefix.str()) == 0) lane += lines[i] + "\n";
+    }
+    ReferenceLane ref(lanes[k], 11, 30, 6, 0.5, 0.05, 0.5, 0.3, 1.0);
+    EXPECT_EQ(lane, ref.run(5, 20)) << "lane " << lanes[k];
+  }
+}
+
+/* the statistics lockstep doesn't collect are refused, not dropped */
+TEST(LockstepTest, RefusesUncollectedStatistics) {
+  std::string output;
+  EXPECT_NE(run_command("./quant --model=finite --lockstep=8 --popsize=30 --loci=6 --effects=0.5 "
+    "--opts=1 --times=20 --freqs=even --enable-stat=fixations 2>/dev/null", output), 0);
+}
+
+/* END */
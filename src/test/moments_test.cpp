@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+#include "moments.h"
+#include "error_handling.h"
+
+TEST(MomentsTest, StartsOutEmpty) {
+  Moments m(3);
+  EXPECT_EQ(m.size(), 3);
+  for (int i=0; i < 3; i++) {
+    EXPECT_EQ(m.count(i), 0);
+    EXPECT_EQ(m.mean(i), 0);
+    EXPECT_EQ(m.variance(i), 0);
+  }
+}
+
+TEST(MomentsTest, MeanAndVariance) {
+  Moments m(2);
+  double x[] = { 2, 4, 4, 4, 5, 5, 7, 9 };
+  for (int j=0; j < 8; j++) m.post(1, x[j]);
+  EXPECT_EQ(m.count(1), 8);
+  EXPECT_DOUBLE_EQ(m.mean(1), 5.0);
+  EXPECT_DOUBLE_EQ(m.variance(1), 4.0);
+  EXPECT_DOUBLE_EQ(m.raw_second(1), 29.0);
+  EXPECT_EQ(m.count(0), 0);
+}
+
+/* a large offset doesn't swamp a small variance */
+TEST(MomentsTest, StableWithLargeMean) {
+  Moments m(1);
+  for (int j=0; j < 1000000; j++) m.post(1e9 + (j % 2 ? 1.0 : -1.0));
+  EXPECT_DOUBLE_EQ(m.mean(0), 1e9);
+  EXPECT_NEAR(m.variance(0), 1.0, 1e-9);
+}
+
+/* sets merged together have the moments of all their samples */
+TEST(MomentsTest, MergeMatchesOneSet) {
+  Moments all(2), a(2), b(2);
+  int bins[] = { 0, 1, 0, 0, 1, 1, 0 };
+  double x[] = { 0.5, -1, 2, 3.25, 7, 1, -4 };
+  all.post(bins, x, 7);
+  a.post(bins, x, 3);
+  b.post(bins+3, x+3, 4);
+  a.merge(b);
+  for (int i=0; i < 2; i++) {
+    EXPECT_EQ(a.count(i), all.count(i));
+    EXPECT_DOUBLE_EQ(a.mean(i), all.mean(i));
+    EXPECT_DOUBLE_EQ(a.variance(i), all.variance(i));
+  }
+
+  /* merging into or from an empty set */
+  Moments empty(2);
+  empty.merge(all);
+  EXPECT_DOUBLE_EQ(empty.variance(0), all.variance(0));
+  all.merge(Moments(2));
+  EXPECT_EQ(all.count(0), 4);
+  EXPECT_THROW(all.merge(Moments(3)), SimError);
+}
+
+TEST(MomentsTest, BatchIndexThrowsException) {
+  Moments m(2);
+  int bins[] = { 2 };
+  double x[] = { 1.0 };
+  EXPECT_THROW(m.post(bins, x, 1), SimError);
+}
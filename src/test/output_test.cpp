@@ -0,0 +1,44 @@
+#include "gtest/gtest.h"
+#include "output.h"
+
+#include <sstream>
+
+/* doubles and integers should be formatted just as cout would */
+TEST(OutputBufferTest, MatchesOstream) {
+  double values[] = { 0, 1, -1, 0.5, 1.0/3, 123456789.0, 1e-7, 2.5e10, -0.000123456789 };
+  OutputBuffer b;
+  std::stringstream s;
+  for (int i=0; i < (int)(sizeof(values)/sizeof(double)); i++) {
+    b << values[i] << ' ';
+    s << values[i] << ' ';
+  }
+  b << 42 << " " << -7 << " " << 4000000000u << '\n';
+  s << 42 << " " << -7 << " " << 4000000000u << '\n';
+  EXPECT_EQ(b.str(), s.str());
+}
+
+TEST(OutputBufferTest, Precision) {
+  OutputBuffer b;
+  std::stringstream s;
+  EXPECT_EQ(b.precision(8), 6);
+  s.precision(8);
+  b << 1.0/7;
+  s << 1.0/7;
+  EXPECT_EQ(b.str(), s.str());
+  EXPECT_EQ(b.precision(6), 8);
+  b.clear();
+  EXPECT_EQ(b.str(), "");
+}
+
+/* only the global buffer writes to standard output; another keeps its text */
+TEST(OutputBufferTest, LocalBufferKeepsText) {
+  OutputBuffer b;
+  b << "gen: " << 3 << '\n';
+  b.end_generation(3);
+  b.finish();
+  EXPECT_EQ(b.str(), "gen: 3\n");
+  EXPECT_EQ(b.written(), 0u);
+  b.clear();
+}
+
+/* END */
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+#include "run_quant.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class QextractTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    char name[] = "/tmp/qextract_test_XXXXXX";
+    int fd = mkstemp(name);
+    close(fd);
+    path = name;
+    index = path + ".idx";
+  }
+  virtual void TearDown() {
+    unlink(path.c_str());
+    unlink(index.c_str());
+  }
+
+  /* a run with a burnin that isn't a whole number of blocks */
+  void run(const std::string &extra) {
+    std::string output;
+    ASSERT_EQ(run_command("./quant --model=infinite --loci=0 --popsize=30 --mu=0.1 --effects=0.5 "
+      "--opts=1 --times=200 --burnin=130 --seed=9 --index-every=50 --index=" + index + " " +
+      extra + " > " + path, output), 0);
+  }
+
+  /* the lines of a full read of the output for generations from to to,
+   * and only of the statistic stat if it's given */
+  std::string full_read(int from, int to, const std::string &stat) {
+    std::string output;
+    run_command("gzip -dcf " + path, output);
+    std::vector<std::string> lines = output_lines(output);
+    std::string text;
+    for (size_t i=0; i < lines.size(); i++) {
+      if (lines[i].compare(0, 5, "gen: ") != 0) continue;
+      int gen = atoi(lines[i].c_str() + 5);
+      if (gen < from || gen > to) continue;
+      if (!stat.empty() && lines[i].find(" " + stat + ": ") == std::string::npos) continue;
+      text += lines[i] + "\n";
+    }
+    return text;
+  }
+
+  std::string path, index;
+};
+
+/* the generations after the burnin are counted from the start of a block */
+TEST_F(QextractTest, BlocksStartAfterBurnin) {
+  run("");
+  std::ifstream in(index.c_str());
+  std::string line;
+  std::vector<std::string> labels;
+  while (getline(in, line)) {
+    std::stringstream s(line);
+    std::string first, last;
+    s >> first >> last;
+    if (first != "#") labels.push_back(first + " " + last);
+  }
+  ASSERT_GE(labels.size(), 3u);
+  EXPECT_EQ(labels[0], "-1 -1");
+  EXPECT_EQ(labels[labels.size()-2], "150 199");
+  int after = 0;
+  while (after < (int)labels.size() && labels[after] != "0 49") after++;
+  ASSERT_LT(after, (int)labels.size());
+  for (int i=1; i < after; i++) EXPECT_EQ(labels[i], "0 0");
+}
+
+/* an extracted block is what a full read gives for its generations */
+TEST_F(QextractTest, MatchesFullRead) {
+  const char *formats[] = { "", "--gzip-output" };
+  for (int k=0; k < 2; k++) {
+    run(formats[k]);
+    std::string window, pheno;
+    ASSERT_EQ(run_command("./qextract --from=50 --to=99 " + path, window), 0);
+    EXPECT_EQ(after_params(window), full_read(50, 99, ""));
+    EXPECT_NE(after_params(window).find("gen: 99 freqs: "), std::string::npos);
+    ASSERT_EQ(run_command("./qextract --from=60 --to=120 --stat=pheno " + path, pheno), 0);
+    EXPECT_EQ(after_params(pheno), full_read(60, 120, "pheno"));
+  }
+}
+
+/* END */
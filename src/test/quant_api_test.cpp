@@ -0,0 +1,114 @@
+#include "gtest/gtest.h"
+#include "quant_api.h"
+
+#include <string>
+#include <vector>
+
+class QuantApiTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    quant_default_params(&p);
+    p.popsize = 100;
+    p.burnin = 20;
+    p.seed = 5;
+    p.model = QUANT_FINITE_SITES;
+    p.neffects = 2;
+    p.effects = effects;
+    p.loci = loci;
+    p.optimum = 1.0;
+  }
+  quant_params p;
+  double effects[2] = { 1.0, 2.0 };
+  int loci[2] = { 10, 5 };
+};
+
+/* the state after a number of generations */
+static void run(const quant_params &p, int generations, std::vector<int> &counts,
+    std::vector<double> &phenotypes) {
+  quant_sim *sim = quant_create(&p);
+  ASSERT_TRUE(sim != NULL) << quant_last_error();
+  ASSERT_EQ(quant_step(sim, generations), 0);
+  quant_view<int> c(quant_site_counts(sim));
+  counts.assign(c.begin(), c.end());
+  quant_view<double> ph(quant_phenotypes(sim));
+  phenotypes.assign(ph.begin(), ph.end());
+  quant_destroy(sim);
+}
+
+/* simulations one after another in a process don't affect each other */
+TEST_F(QuantApiTest, RepeatsWithSameSeed) {
+  std::vector<int> c1, c2;
+  std::vector<double> ph1, ph2;
+  run(p, 100, c1, ph1);
+  run(p, 100, c2, ph2);
+  ASSERT_EQ(c1.size(), 15u);
+  ASSERT_EQ(ph1.size(), 100u);
+  EXPECT_EQ(c1, c2);
+  EXPECT_EQ(ph1, ph2);
+
+  p.seed = 6;
+  run(p, 100, c2, ph2);
+  EXPECT_NE(ph1, ph2);
+}
+
+/* the spans read the simulation's own state */
+TEST_F(QuantApiTest, SpansMatchState) {
+  quant_sim *sim = quant_create(&p);
+  ASSERT_TRUE(sim != NULL) << quant_last_error();
+  ASSERT_EQ(quant_step(sim, 50), 0);
+  EXPECT_EQ(quant_generation(sim), 30);
+  EXPECT_EQ(quant_burnin_left(sim), 0);
+
+  quant_span effects = quant_site_effects(sim);
+  quant_span ids = quant_site_ids(sim);
+  ASSERT_EQ(effects.size, 15u);
+  for (size_t i=0; i < effects.size; i++) {
+    EXPECT_DOUBLE_EQ(quant_span_double(effects, i), i < 10 ? 1.0 : 2.0);
+    EXPECT_EQ(quant_span_uint(ids, i), (unsigned int)i);
+  }
+
+  quant_view<double> phenotypes(quant_phenotypes(sim));
+  double sum = 0;
+  for (size_t i=0; i < phenotypes.size(); i++) sum += phenotypes[i];
+  double mean, variance;
+  quant_phenotype_moments(sim, &mean, &variance);
+  EXPECT_NEAR(mean, sum / p.popsize, 1e-12);
+  quant_view<double> fitnesses(quant_fitnesses(sim));
+  for (size_t i=0; i < fitnesses.size(); i++) {
+    EXPECT_GT(fitnesses[i], 0.0);
+    EXPECT_LE(fitnesses[i], 1.0);
+  }
+  quant_destroy(sim);
+}
+
+static void count_call(const quant_sim *sim, void *user) {
+  ((std::vector<int> *)user)->push_back(quant_generation(sim));
+}
+
+/* callbacks start after the burnin */
+TEST_F(QuantApiTest, CallbacksEveryGenerations) {
+  quant_sim *sim = quant_create(&p);
+  ASSERT_TRUE(sim != NULL) << quant_last_error();
+  std::vector<int> gens;
+  ASSERT_EQ(quant_add_callback(sim, count_call, &gens, 10), 0);
+  ASSERT_EQ(quant_step(sim, 45), 0);
+  ASSERT_EQ(gens.size(), 3u);
+  EXPECT_EQ(gens[0], 0);
+  EXPECT_EQ(gens[1], 10);
+  EXPECT_EQ(gens[2], 20);
+  EXPECT_EQ(quant_add_callback(sim, count_call, &gens, 0), -1);
+  quant_destroy(sim);
+}
+
+TEST_F(QuantApiTest, Errors) {
+  p.loci = NULL;
+  EXPECT_TRUE(quant_create(&p) == NULL);
+  EXPECT_EQ(std::string(quant_last_error()), "must give loci counts");
+
+  /* a failed setup doesn't stop the next one */
+  p.loci = loci;
+  quant_sim *sim = quant_create(&p);
+  ASSERT_TRUE(sim != NULL) << quant_last_error();
+  EXPECT_TRUE(quant_create(&p) == NULL);
+  quant_destroy(sim);
+}
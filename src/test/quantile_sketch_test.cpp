@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+#include "quantile_sketch.h"
+#include "error_handling.h"
+
+#include <math.h>
+#include <vector>
+
+/* a short stream is held exactly */
+TEST(QuantileSketchTest, ExactWhenSmall) {
+  QuantileSketch q;
+  for (int i=100; i >= 1; i--) q.insert(i);
+  EXPECT_EQ(q.count(), 100);
+  EXPECT_EQ(q.levels(), 1);
+  EXPECT_EQ(q.quantile(0.0), 1);
+  EXPECT_EQ(q.quantile(0.5), 50);
+  EXPECT_EQ(q.quantile(1.0), 100);
+  EXPECT_TRUE(isnan(QuantileSketch().quantile(0.5)));
+}
+
+/* a long stream stays small, with rank errors of about 1% */
+TEST(QuantileSketchTest, BoundedRankError) {
+  QuantileSketch q;
+  int n = 1000000;
+  for (int i=0; i < n; i++) q.insert((i * 7919L) % n);
+  EXPECT_EQ(q.count(), n);
+  int held = 0;
+  for (int h=0; h < q.levels(); h++) held += q.items(h).size();
+  EXPECT_LT(held, 1000);
+  double probs[] = { 0.001, 0.1, 0.5, 0.9, 0.999 };
+  for (int i=0; i < 5; i++)
+    EXPECT_NEAR(q.quantile(probs[i]) / n, probs[i], 0.02);
+}
+
+/* merged sketches summarize both streams */
+TEST(QuantileSketchTest, Merge) {
+  QuantileSketch a, b;
+  for (int i=0; i < 50000; i++) a.insert(i);
+  for (int i=50000; i < 100000; i++) b.insert(i);
+  a.merge(b);
+  EXPECT_EQ(a.count(), 100000);
+  EXPECT_NEAR(a.quantile(0.25), 25000, 2000);
+  EXPECT_NEAR(a.quantile(0.75), 75000, 2000);
+  EXPECT_THROW(a.merge(QuantileSketch(100)), SimError);
+}
+
+/* a sketch read back from its saved state, or from its items, is the same */
+TEST(QuantileSketchTest, SaveRestore) {
+  QuantileSketch a;
+  for (int i=0; i < 20000; i++) a.insert(i % 977);
+  std::vector<double> v;
+  a.save(v);
+  QuantileSketch b, c;
+  EXPECT_EQ(b.restore(&v[0], &v[0] + v.size()), &v[0] + v.size());
+  for (int h=0; h < a.levels(); h++) {
+    for (size_t i=0; i < a.items(h).size(); i++) c.insert(h, a.items(h)[i]);
+  }
+  for (int i=1; i < 10; i++) {
+    EXPECT_EQ(b.quantile(i/10.0), a.quantile(i/10.0));
+    EXPECT_EQ(c.quantile(i/10.0), a.quantile(i/10.0));
+  }
+  EXPECT_EQ(c.count(), a.count());
+  EXPECT_THROW(b.restore(&v[0], &v[0] + 5), SimError);
+}
@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+#include "run_quant.h"
+
+#include <stdlib.h>
+#include <string>
+
+static const char *cache_run = "./quant --model=infinite --loci=0 --popsize=40 --mu=0.1 "
+  "--effects=0.5 --enable-stat=visits --enable-stat=phenotype-var-mean --burnin=10 --seed=5 "
+  "--opts=1,0 ";
+
+class RunCacheTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    char name[] = "/tmp/run_cache_test_XXXXXX";
+    ASSERT_TRUE(mkdtemp(name) != NULL);
+    dir = name;
+  }
+
+  virtual void TearDown() {
+    std::string output;
+    run_command("rm -rf " + dir, output);
+  }
+
+  /* a run with the cache */
+  int cached(const std::string &times, std::string &output) {
+    return run_command(std::string(cache_run) + times + " --cache=" + dir, output);
+  }
+
+  /* the number of runs in the cache */
+  int entries(void) {
+    std::string output;
+    run_command("ls " + dir + " | wc -l", output);
+    return atoi(output.c_str());
+  }
+
+  std::string dir;
+};
+
+/* a run is the same whether it's simulated, or read back from the cache */
+TEST_F(RunCacheTest, HitMatchesUncachedRun) {
+  std::string plain, miss, hit;
+  ASSERT_EQ(run_command(std::string(cache_run) + "--times=30,60", plain), 0);
+  ASSERT_EQ(cached("--times=30,60", miss), 0);
+  EXPECT_EQ(entries(), 1);
+  ASSERT_EQ(cached("--times=30,60", hit), 0);
+  EXPECT_EQ(entries(), 1);
+  EXPECT_FALSE(after_params(plain).empty());
+  EXPECT_EQ(after_params(miss), after_params(plain));
+  EXPECT_EQ(after_params(hit), after_params(plain));
+}
+
+/* the second run is read back, not simulated again: a mark left in the
+ * cached output shows up in it */
+TEST_F(RunCacheTest, HitReadsCachedOutput) {
+  std::string output;
+  ASSERT_EQ(cached("--times=30,60", output), 0);
+  ASSERT_EQ(run_command("sed -i '1s/^./#/' " + dir + "/*/output", output), 0);
+  ASSERT_EQ(cached("--times=30,60", output), 0);
+  EXPECT_EQ(after_params(output).compare(0, 1, "#"), 0);
+}
+
+/* a run that goes on from a cached one gives what it would from scratch */
+TEST_F(RunCacheTest, ExtendedPrefixMatchesUncachedRun) {
+  std::string plain, prefix, extended;
+  ASSERT_EQ(run_command(std::string(cache_run) + "--times=30,100", plain), 0);
+  ASSERT_EQ(cached("--times=30,60", prefix), 0);
+  ASSERT_EQ(cached("--times=30,100", extended), 0);
+  EXPECT_EQ(entries(), 2);
+  EXPECT_EQ(after_params(extended), after_params(plain));
+}
+
+/* and it goes on from the cached run's main loop, rather than from scratch */
+TEST_F(RunCacheTest, ExtensionReadsCachedPrefix) {
+  std::string output;
+  ASSERT_EQ(cached("--times=30,60", output), 0);
+  ASSERT_EQ(run_command("sed -i '1s/^./#/' " + dir + "/*/output", output), 0);
+  ASSERT_EQ(cached("--times=30,100", output), 0);
+  EXPECT_EQ(after_params(output).compare(0, 1, "#"), 0);
+}
+
+/* a run that fails part way leaves nothing in the cache */
+TEST_F(RunCacheTest, FailedRunLeavesNoEntry) {
+  std::string output;
+  EXPECT_NE(run_command("./quant --model=infinite --loci=0 --popsize=5000 --mu=0.1 --effects=0.5 "
+    "--opts=1 --times=50 --burnin=0 --seed=5 --genotype-memory=0.001 "
+    "--genotype-dir=/nonexistent --cache=" + dir + " 2>/dev/null", output), 0);
+  EXPECT_EQ(entries(), 0);
+}
+
+/* END */
@@ -0,0 +1,48 @@
+#ifndef __TEST_RUN_QUANT_H__
+#define __TEST_RUN_QUANT_H__
+
+#include <stdio.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+/* Tests of whole runs use the programs built alongside the test runner,
+ * which is run from src. Runs a command, giving back its standard output,
+ * and returns its exit status */
+static inline int run_command(const std::string &command, std::string &output) {
+  output.clear();
+  FILE *p = popen(command.c_str(), "r");
+  if (p == NULL) return -1;
+  char buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), p)) > 0) output.append(buf, n);
+  int status = pclose(p);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/* quant's output, without the 'cmd:' line, which differs between runs that
+ * are otherwise the same */
+static inline std::string without_cmd(const std::string &output) {
+  if (output.compare(0, 5, "cmd: ") != 0) return output;
+  size_t eol = output.find('\n');
+  return eol == std::string::npos ? std::string() : output.substr(eol+1);
+}
+
+/* quant's output after the cmd: and params: lines, which name the options */
+static inline std::string after_params(const std::string &output) {
+  size_t eol = output.find('\n', output.find("params: "));
+  return eol == std::string::npos ? std::string() : output.substr(eol+1);
+}
+
+/* the lines of some output */
+static inline std::vector<std::string> output_lines(const std::string &output) {
+  std::vector<std::string> lines;
+  std::stringstream s(output);
+  std::string line;
+  while (getline(s, line)) lines.push_back(line);
+  return lines;
+}
+
+#endif /* __TEST_RUN_QUANT_H__ */
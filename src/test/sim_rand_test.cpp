@@ -0,0 +1,113 @@
+#include "gtest/gtest.h"
+#include "sim_rand.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+TEST(RandStreamTest, MatchesErand48) {
+  RandStream r(12, 3);
+  unsigned short xsubi[3];
+  xsubi[0] = (unsigned short)(r.x & 0xFFFF);
+  xsubi[1] = (unsigned short)((r.x >> 16) & 0xFFFF);
+  xsubi[2] = (unsigned short)((r.x >> 32) & 0xFFFF);
+  for (int i=0; i < 100; i++) {
+    EXPECT_EQ(r.uniform(), erand48(xsubi));
+  }
+}
+
+TEST(RandStreamTest, ReseedRepeatsStream) {
+  RandStream a(5, 1);
+  double first = a.uniform();
+  a.uniform();
+  a.reseed(5, 1);
+  EXPECT_EQ(a.uniform(), first);
+}
+
+TEST(RandStreamTest, StreamsDiffer) {
+  RandStream a(5, 0);
+  RandStream b(5, 1);
+  EXPECT_NE(a.uniform(), b.uniform());
+}
+
+TEST(RandStreamTest, UniformInRange) {
+  RandStream r(1, 0);
+  for (int i=0; i < 1000; i++) {
+    double u = r.uniform();
+    EXPECT_GE(u, 0.0);
+    EXPECT_LT(u, 1.0);
+  }
+}
+
+TEST(RandStreamTest, PoissonMean) {
+  RandStream r(2, 0);
+  double sum = 0;
+  for (int i=0; i < 20000; i++) sum += r.poisson(3.0);
+  EXPECT_NEAR(sum/20000, 3.0, 0.1);
+  sum = 0;
+  for (int i=0; i < 20000; i++) sum += r.poisson(50.0);
+  EXPECT_NEAR(sum/20000, 50.0, 0.5);
+}
+
+/* binomials drawn in batches have the binomial's mean and variance, by
+ * inversion (small means) and by rejection, on either side of 1/2 */
+TEST(RandStreamTest, BinomialMoments) {
+  RandStream r(3, 0);
+  const int draws = 40000;
+  int ns[] = { 40, 40, 1000, 10000, 200 };
+  double ps[] = { 0.01, 0.3, 0.7, 0.002, 0.5 };
+  std::vector<double> p(draws);
+  std::vector<int> k(draws);
+  for (int c=0; c < 5; c++) {
+    for (int i=0; i < draws; i++) p[i] = ps[c];
+    r.binomials(ns[c], &p[0], &k[0], draws);
+    double sum = 0, sumsq = 0;
+    for (int i=0; i < draws; i++) {
+      ASSERT_GE(k[i], 0);
+      ASSERT_LE(k[i], ns[c]);
+      sum += k[i];
+      sumsq += (double)k[i]*k[i];
+    }
+    double mean = ns[c]*ps[c], var = mean*(1.0 - ps[c]);
+    double m = sum/draws, v = sumsq/draws - m*m;
+    EXPECT_NEAR(m, mean, 5*sqrt(var/draws));
+    EXPECT_NEAR(v, var, 0.05*var);
+  }
+  EXPECT_EQ(r.binomial(50, 0.0), 0);
+  EXPECT_EQ(r.binomial(50, 1.0), 50);
+}
+
+/* and the whole distribution matches, for a mean that's drawn by rejection */
+TEST(RandStreamTest, BinomialDistribution) {
+  RandStream r(4, 0);
+  const int draws = 100000, n = 60;
+  const double q = 0.35;
+  std::vector<int> tally(n+1, 0);
+  for (int i=0; i < draws; i++) tally[r.binomial(n, q)]++;
+  for (int x=10; x <= 32; x++) {
+    double pmf = exp(lgamma(n+1.0) - lgamma(x+1.0) - lgamma(n-x+1.0) + x*log(q) + (n-x)*log(1-q));
+    EXPECT_NEAR(tally[x] / (double)draws, pmf, 5*sqrt(pmf/draws));
+  }
+}
+
+TEST(RoleStreamsTest, RolesAreDecoupled) {
+  use_role_streams(7);
+  double first = ran1(rand_mutation);
+  use_role_streams(7);
+  for (int i=0; i < 10; i++) ran1(rand_parent);
+  poidev(0.5, rand_segregation);
+  EXPECT_EQ(ran1(rand_mutation), first);
+  delete[] role_streams;
+  role_streams = NULL;
+}
+
+TEST(RoleStreamsTest, PoissonByInversion) {
+  use_role_streams(3);
+  double sum = 0;
+  for (int i=0; i < 20000; i++) sum += poidev(0.8, rand_mutation);
+  EXPECT_NEAR(sum/20000, 0.8, 0.03);
+  delete[] role_streams;
+  role_streams = NULL;
+}
+
+/* END */
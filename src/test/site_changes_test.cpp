@@ -0,0 +1,76 @@
+#include "gtest/gtest.h"
+#include "run_cache.h"
+#include "run_quant.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <sstream>
+
+static const char *changes_run = "./quant --model=infinite --loci=0 --popsize=60 --mu=0.2 "
+  "--s=0.5 --effects=0.5,1 --eprobs=0.5,0.5 --opts=1,0 --times=150,300 --burnin=50 --seed=21 "
+  "--enable-stat=visits --enable-stat=segsites ";
+
+/* The visits, segsites and frequencies statistics are kept from the sites
+ * that have changed. Their output is that of scanning every site every
+ * generation, as quant did before: this is the hash of that output */
+TEST(SiteChangesTest, MatchesFullScanOutput) {
+  std::string output;
+  ASSERT_EQ(run_command(changes_run, output), 0);
+  std::string after = after_params(output);
+  EXPECT_EQ(after.size(), 1371480u);
+  EXPECT_EQ(RunCache::hash(after.data(), after.size()), 0x943f0a5442f35f7cULL);
+}
+
+/* the visits are the counts of the sites in each generation's freqs line */
+TEST(SiteChangesTest, VisitsCountFrequencies) {
+  const int copies = 120;
+  std::string output;
+  ASSERT_EQ(run_command(changes_run, output), 0);
+  std::vector<long> visits(copies-1, 0);
+  std::string printed;
+  std::vector<std::string> lines = output_lines(output);
+  for (size_t i=0; i < lines.size(); i++) {
+    if (lines[i].compare(0, 8, "visits: ") == 0) printed = lines[i];
+    /* the final population's line isn't a generation's visit */
+    if (lines[i].compare(0, 5, "gen: ") != 0 || lines[i].compare(0, 9, "gen: 300 ") == 0) continue;
+    size_t at = lines[i].find(" freqs:");
+    if (at == std::string::npos) continue;
+    std::stringstream s(lines[i].substr(at + 7));
+    std::string site;
+    while (s >> site) {
+      int c = (int)round(atof(site.c_str() + site.find(':') + 1) * copies);
+      if (c > 0 && c < copies) visits[c-1]++;
+    }
+  }
+  std::stringstream expected;
+  expected << "visits:";
+  for (size_t c=0; c < visits.size(); c++) expected << " " << visits[c];
+  EXPECT_EQ(printed, expected.str());
+}
+
+/* Frequencies collected only every so many generations see all the changes
+ * in between */
+TEST(SiteChangesTest, FrequenciesAtCadence) {
+  std::string every, seventh;
+  ASSERT_EQ(run_command(std::string(changes_run) + "--disable-stat=visits", every), 0);
+  ASSERT_EQ(run_command(std::string(changes_run) + "--disable-stat=visits "
+    "--stat-every=frequencies:7", seventh), 0);
+  std::vector<std::string> all = output_lines(every), some;
+  std::vector<std::string> lines = output_lines(seventh);
+  for (size_t i=0; i < lines.size(); i++)
+    if (lines[i].find(" freqs:") != std::string::npos) some.push_back(lines[i]);
+  size_t k = 0;
+  for (size_t i=0; i < all.size(); i++) {
+    size_t at = all[i].find(" freqs:");
+    if (at == std::string::npos) continue;
+    int gen = atoi(all[i].c_str() + 5);
+    if (gen % 7 != 0 && gen != 300) continue;
+    ASSERT_LT(k, some.size());
+    EXPECT_EQ(some[k++], all[i]) << "gen " << gen;
+  }
+  EXPECT_EQ(k, some.size());
+}
+
+/* END */
@@ -0,0 +1,129 @@
+#include "gtest/gtest.h"
+#include "stationary.h"
+#include "error_handling.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <valarray>
+#include <vector>
+
+/* f.diploid of modeling/phenotypic_variance.r */
+static double f_diploid(double v, double U, double N, double s) {
+  return 8*N*U * ((v+s)/(2*N) - 1.0/(sqrt(1+v/s*v/(2*v+s))*(exp(2*N/(v+s)/sqrt(1+v/s*v/(2*v+s))) - 1))) - v;
+}
+
+/* with a single effect of 1 the variance is the root of f.diploid */
+TEST(StationaryTest, VarianceIsMeanFieldRoot) {
+  Stationary st(1000, diploid, 0.01, 10.0);
+  std::valarray<double> effects(1.0, 1), probs(1.0, 1);
+  double v = st.infinite_sites_variance(effects, probs);
+  EXPECT_GT(v, 0.0);
+  EXPECT_NEAR(f_diploid(v, 0.01, 1000, 10.0), 0.0, 1e-6);
+}
+
+/* without selection to speak of, the spectrum is theta/c */
+TEST(StationaryTest, NeutralSpectrum) {
+  Stationary st(500, diploid, 0.001, 1.0);
+  std::vector<double> e;
+  st.site_spectrum(1e-6, 0.001, 0.0, e);
+  ASSERT_EQ(e.size(), 1001u);
+  EXPECT_EQ(e[0], 0.0);
+  EXPECT_EQ(e[1000], 0.0);
+  double theta = 4 * 500 * 0.001;
+  for (int c=1; c < 1000; c += 111) EXPECT_NEAR(e[c], theta / c, 1e-6 * theta / c);
+
+  /* and selection takes sites out of high frequencies most */
+  std::vector<double> s;
+  st.site_spectrum(1.0, 0.001, 0.0, s);
+  EXPECT_LT(s[10], e[10]);
+  EXPECT_LT(s[500] / e[500], s[10] / e[10]);
+}
+
+/* the spectrum, computed in blocks, follows the density of the random field */
+TEST(StationaryTest, SpectrumMatchesDensity) {
+  int N = 50000;
+  Stationary st(N, diploid, 0.001, 10.0);
+  std::vector<double> e;
+  st.site_spectrum(0.05, 0.001, 1.0, e);
+  double x = 2.0*N*0.05*0.05 / ((1.0 + 10.0) * sqrt(1.0 + 1.0/(10.0*12.0)));
+  for (int c=1; c < 2*N; c += 997) {
+    double q = (double)c / (2*N);
+    double f = 4*N*0.001 * exp(-x*q) * expm1(-x*(1-q)) / expm1(-x) / (q*(1-q)) / (2*N);
+    EXPECT_NEAR(e[c], f, 1e-9 * f);
+  }
+}
+
+/* new mutations fix at 1/2N without selection, and less often the larger
+ * their effect */
+TEST(StationaryTest, FixationProbability) {
+  Stationary st(500, diploid, 0.001, 1.0);
+  EXPECT_NEAR(st.fixation_probability(1e-6, 0.0), 1.0/1000, 1e-12);
+  double weak = st.fixation_probability(0.01, 0.0), strong = st.fixation_probability(0.1, 0.0);
+  EXPECT_LT(weak, 1.0/1000);
+  EXPECT_LT(strong, weak);
+  EXPECT_GT(strong, 0.0);
+  EXPECT_EQ(st.fixation_probability(10.0, 0.0), 0.0);
+}
+
+/* a finite sites locus is as likely at q as at 1-q, and more so at the ends
+ * the stronger it's selected */
+TEST(StationaryTest, LocusDistribution) {
+  Stationary st(200, diploid, 0.01, 2.0);
+  std::vector<double> weak, strong;
+  st.locus_distribution(0.05, 0.001, 0.5, weak);
+  st.locus_distribution(0.5, 0.001, 0.5, strong);
+  ASSERT_EQ(weak.size(), 401u);
+  double sum = 0.0;
+  for (int c=0; c <= 400; c++) {
+    sum += weak[c];
+    EXPECT_NEAR(weak[c], weak[400-c], 1e-12);
+  }
+  EXPECT_NEAR(sum, 1.0, 1e-9);
+  EXPECT_GT(strong[0], weak[0]);
+  EXPECT_LT(strong[200], weak[200]);
+}
+
+/* sampled sites number about the expected and have the effects given */
+TEST(StationaryTest, SampleSites) {
+  srand48(11);
+  Stationary st(1000, diploid, 0.01, 10.0);
+  std::valarray<double> effects(2), probs(1.0, 2);
+  effects[0] = 0.5;
+  effects[1] = 1.0;
+  std::vector<double> site_effects;
+  std::vector<int> counts;
+  double v;
+  st.sample_sites(effects, probs, site_effects, counts, v);
+  EXPECT_EQ(v, st.infinite_sites_variance(effects, probs));
+
+  double expected = 0.0;
+  std::vector<double> e;
+  for (int k=0; k < 2; k++) {
+    st.site_spectrum(effects[k], 0.005, v, e);
+    for (size_t c=0; c < e.size(); c++) expected += e[c];
+  }
+  ASSERT_EQ(site_effects.size(), counts.size());
+  EXPECT_NEAR((double)counts.size(), expected, 5*sqrt(expected));
+  for (size_t i=0; i < counts.size(); i++) {
+    EXPECT_GT(counts[i], 0);
+    EXPECT_LT(counts[i], 2000);
+    EXPECT_TRUE(fabs(site_effects[i]) == 0.5 || fabs(site_effects[i]) == 1.0);
+  }
+}
+
+/* counts are split into genotypes that add up, and fit in the population */
+TEST(StationaryTest, HardyWeinberg) {
+  int hets, homs;
+  for (int c=0; c <= 20; c++) {
+    Stationary::hardy_weinberg(c, 10, diploid, hets, homs);
+    EXPECT_EQ(hets + 2*homs, c);
+    EXPECT_GE(hets, 0);
+    EXPECT_LE(hets + homs, 10);
+  }
+  Stationary::hardy_weinberg(10, 10, diploid, hets, homs);
+  EXPECT_EQ(homs, 3);
+  Stationary::hardy_weinberg(7, 10, haploid, hets, homs);
+  EXPECT_EQ(hets, 7);
+  EXPECT_EQ(homs, 0);
+  EXPECT_THROW(Stationary::hardy_weinberg(11, 10, haploid, hets, homs), SimError);
+}
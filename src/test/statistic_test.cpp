@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+#include "statistic.h"
+#include "error_handling.h"
+#include "quant_api.h"
+#include "run_quant.h"
+
+#include <vector>
+
+TEST(StatisticTest, HandlesAndNames) {
+  Statistic::initialize_defaults();
+  EXPECT_EQ(Statistic::handle("frequencies"), STAT_FREQUENCIES);
+  EXPECT_EQ(Statistic::handle("fst"), STAT_FST);
+  EXPECT_EQ(Statistic::count(), NUM_BUILTIN_STATS);
+  EXPECT_EQ(Statistic::name(STAT_PMOMENTS), "pmoments");
+  EXPECT_TRUE(Statistic::is_activated(STAT_PHENOTYPE));
+  EXPECT_FALSE(Statistic::is_activated(STAT_SEGSITES));
+
+  Statistic::activate("segsites");
+  EXPECT_TRUE(Statistic::is_activated(STAT_SEGSITES));
+  Statistic::deactivate_all();
+  EXPECT_FALSE(Statistic::is_activated("phenotype"));
+  EXPECT_THROW(Statistic::activate("bogus"), SimError);
+  EXPECT_THROW(Statistic::set_every("phenotype", 0), SimError);
+  EXPECT_THROW(Statistic::add("segsites", true), SimError);
+}
+
+/* a statistic that records the generations it was collected in */
+class GenerationRecorder : public StatCollector {
+public:
+  GenerationRecorder() : StatCollector(ON_GENERATION) { }
+  void on_generation(Population &) { gens.push_back(quant_generation(NULL)); }
+  std::vector<int> gens;
+};
+
+/* a statistic added from outside is collected without any change to the
+ * simulation, at its own cadence */
+TEST(StatisticTest, CollectorsAtCadence) {
+  quant_params p;
+  quant_default_params(&p);
+  double effects[1] = { 1.0 };
+  int loci[1] = { 10 };
+  p.popsize = 50;
+  p.burnin = 5;
+  p.model = QUANT_FINITE_SITES;
+  p.neffects = 1;
+  p.effects = effects;
+  p.loci = loci;
+  quant_sim *sim = quant_create(&p);
+  ASSERT_TRUE(sim != NULL) << quant_last_error();
+
+  GenerationRecorder every7, off;
+  int h = Statistic::add("every-seventh", true);
+  Statistic::add_collector(h, &every7);
+  Statistic::set_every("every-seventh", 7);
+  Statistic::add_collector(Statistic::add("never", false), &off);
+  ASSERT_EQ(quant_step(sim, 5 + 30), 0);
+  quant_destroy(sim);
+
+  ASSERT_EQ(every7.gens.size(), 5u);
+  for (int i=0; i < 5; i++) EXPECT_EQ(every7.gens[i], 7*i);
+  EXPECT_TRUE(off.gens.empty());
+}
+
+/* the final population's lines keep quant's own order rather than the
+ * per-generation one: phenotype, segregating sites, then the visits */
+TEST(StatisticTest, FinalOrder) {
+  std::string output;
+  ASSERT_EQ(run_command("./quant --model=finite --popsize=30 --loci=5 --effects=0.5 --mu=0.05 "
+    "--opts=1 --times=5 --burnin=0 --freqs=even --seed=2 --enable-stat=visits "
+    "--enable-stat=segsites --enable-stat=phenotype-var-mean", output), 0);
+  size_t final = output.rfind("gen: 5 freqs:");
+  ASSERT_NE(final, std::string::npos);
+  size_t pheno = output.find("gen: 5 pheno:", final);
+  size_t segsites = output.find("gen: 5 segsites:", final);
+  size_t visits = output.find("visits:", final);
+  size_t var_mean = output.find("phenotype_var_mean:", final);
+  size_t mutations = output.find("mutations:", final);
+  EXPECT_LT(pheno, segsites);
+  EXPECT_LT(segsites, visits);
+  EXPECT_LT(visits, var_mean);
+  EXPECT_LT(var_mean, mutations);
+  EXPECT_NE(mutations, std::string::npos);
+}
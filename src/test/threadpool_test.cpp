@@ -0,0 +1,110 @@
+#include "gtest/gtest.h"
+#include "threadpool.h"
+#include "error_handling.h"
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+using std::vector;
+
+/* counts how many times it was run */
+class CountingTask : public PoolTask {
+public:
+  CountingTask() : runs(0) { }
+  void run(int worker) { runs++; }
+  std::atomic<int> runs;
+};
+
+/* always fails */
+class FailingTask : public PoolTask {
+public:
+  void run(int worker) { throw SimError("task failed"); }
+};
+
+/* one of two long tasks, which waits (for a while) until both are running */
+class LongTask : public PoolTask {
+public:
+  LongTask(std::atomic<int> &r) : running(r), overlapped(false) { }
+  void run(int worker) {
+    running++;
+    for (int i=0; i < 100 && running < 2; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    overlapped = running >= 2;
+  }
+  std::atomic<int> &running;
+  bool overlapped;
+};
+
+/* a task queued behind the long ones, which takes a while */
+class LaterTask : public PoolTask {
+public:
+  void run(int worker) { std::this_thread::sleep_for(std::chrono::milliseconds(300)); }
+};
+
+TEST(WorkStealingPoolTest, UsesRequestedThreads) {
+  WorkStealingPool pool(3);
+  EXPECT_EQ(pool.size(), 3);
+}
+
+TEST(WorkStealingPoolTest, DefaultsToHardwareThreads) {
+  WorkStealingPool pool;
+  EXPECT_EQ(pool.size(), WorkStealingPool::hardware_threads());
+}
+
+TEST(WorkStealingPoolTest, RunsEveryTaskOnce) {
+  WorkStealingPool pool(4);
+  vector<CountingTask*> tasks;
+  for (int i=0; i < 101; i++) {
+    tasks.push_back(new CountingTask);
+    pool.add(tasks.back());
+  }
+  pool.run();
+  for (int i=0; i < 101; i++) {
+    EXPECT_EQ(tasks[i]->runs, 1);
+    delete tasks[i];
+  }
+}
+
+TEST(WorkStealingPoolTest, CollectsErrors) {
+  WorkStealingPool pool(2);
+  FailingTask bad;
+  CountingTask good;
+  pool.add(&bad);
+  pool.add(&good);
+  pool.run();
+  EXPECT_EQ(good.runs, 1);
+  ASSERT_EQ(pool.errors().size(), 1u);
+  EXPECT_EQ(pool.errors()[0], "task failed");
+}
+
+/* Tasks added longest-first and dealt round-robin can leave one worker with
+ * two long tasks. The other worker steals the second of them as soon as it
+ * runs dry, rather than the shorter tasks queued behind it */
+TEST(WorkStealingPoolTest, StealsLongestWaitingTask) {
+  WorkStealingPool pool(2);
+  std::atomic<int> running(0);
+  LongTask first(running), second(running);
+  CountingTask quick[6];
+  LaterTask later[4];
+  pool.add(&first);
+  pool.add(&quick[0]);
+  pool.add(&second);
+  pool.add(&quick[1]);
+  for (int i=0; i < 4; i++) {
+    pool.add(&later[i]);
+    pool.add(&quick[i+2]);
+  }
+  pool.run();
+  EXPECT_TRUE(first.overlapped);
+  EXPECT_TRUE(second.overlapped);
+  EXPECT_GE(pool.steals(), 1);
+}
+
+TEST(WorkStealingPoolTest, NullTaskThrowsException) {
+  WorkStealingPool pool(1);
+  EXPECT_THROW(pool.add(NULL), SimError);
+}
+
+/* END */
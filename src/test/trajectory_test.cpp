@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+#include "trajectory.h"
+#include "error_handling.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+
+class TrajectoryTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    char name[] = "/tmp/trajectory_test_XXXXXX";
+    int fd = mkstemp(name);
+    close(fd);
+    path = name;
+  }
+  virtual void TearDown() {
+    unlink(path.c_str());
+  }
+  std::string path;
+};
+
+/* write more generations than fit in one chunk, with a varying number of
+ * sites, and check they all come back */
+TEST_F(TrajectoryTest, RoundTrip) {
+  TrajectoryWriter w(path, 50, 2, 4);
+  for (int gen=0; gen < 10; gen++) {
+    w.begin_generation(gen, gen*0.5, gen*0.25);
+    for (int s=0; s < gen % 3; s++)
+      w.add_site(100+s, gen+s, s % 2 ? 1.0 : -1.0);
+    w.end_generation();
+  }
+  w.close();
+
+  TrajectoryReader r(path);
+  EXPECT_EQ(r.popsize, 50);
+  EXPECT_EQ(r.ploidy, 2);
+  EXPECT_DOUBLE_EQ(r.frequency(25), 0.25);
+  TrajectoryGeneration g;
+  for (int gen=0; gen < 10; gen++) {
+    ASSERT_TRUE(r.next(g));
+    EXPECT_EQ(g.generation, gen);
+    EXPECT_DOUBLE_EQ(g.phenotype_mean, gen*0.5);
+    EXPECT_DOUBLE_EQ(g.phenotype_variance, gen*0.25);
+    ASSERT_EQ(g.nsites, gen % 3);
+    for (int s=0; s < g.nsites; s++) {
+      EXPECT_EQ(g.ids[s], (uint32_t)(100+s));
+      EXPECT_EQ(g.counts[s], gen+s);
+      EXPECT_DOUBLE_EQ(g.effects[s], s % 2 ? 1.0 : -1.0);
+    }
+  }
+  EXPECT_FALSE(r.next(g));
+}
+
+TEST_F(TrajectoryTest, RejectsOtherFiles) {
+  FILE *f = fopen(path.c_str(), "w");
+  fputs("gen: 0 freqs: 1:0.5\n", f);
+  fclose(f);
+  EXPECT_THROW(TrajectoryReader r(path), SimError);
+}
+
+/* END */
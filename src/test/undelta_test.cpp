@@ -0,0 +1,23 @@
+#include "gtest/gtest.h"
+#include "run_quant.h"
+
+#include <string>
+
+static const char *delta_run = "./quant --model=infinite --loci=0 --popsize=30 --mu=0.1 "
+  "--effects=0.5 --opts=1 --times=60 --burnin=10 --seed=9 ";
+
+/* undelta rebuilds exactly the frequencies statistic's output, from plain or
+ * compressed output, with keyframes more often than the run is long */
+TEST(UndeltaTest, RoundTrip) {
+  std::string freqs, plain, compressed;
+  ASSERT_EQ(run_command(delta_run, freqs), 0);
+  ASSERT_EQ(run_command(std::string(delta_run) + "--disable-stat=frequencies "
+    "--enable-stat=frequency-deltas --keyframe-every=7 | ./undelta", plain), 0);
+  ASSERT_EQ(run_command(std::string(delta_run) + "--disable-stat=frequencies "
+    "--enable-stat=frequency-deltas --keyframe-every=7 --gzip-output | ./undelta", compressed), 0);
+  EXPECT_NE(after_params(freqs).find("gen: 60 freqs: "), std::string::npos);
+  EXPECT_EQ(after_params(plain), after_params(freqs));
+  EXPECT_EQ(after_params(compressed), after_params(freqs));
+}
+
+/* END */
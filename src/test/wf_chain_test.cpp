@@ -0,0 +1,95 @@
+#include "gtest/gtest.h"
+#include "wf_chain.h"
+
+#include <math.h>
+#include <vector>
+
+/* a small tridiagonal system, solved both ways */
+TEST(WrightFisherChainTest, BandSolve) {
+  BandMatrix A(3, 1, 1);
+  A(0,0) = 4; A(0,1) = 1;
+  A(1,0) = 2; A(1,1) = 5; A(1,2) = 1;
+  A(2,1) = 1; A(2,2) = 3;
+  A.factor();
+  /* A (1,2,3) = (6,15,11) and A' (1,2,3) = (8,14,11) */
+  std::vector<double> b(3), c(3);
+  b[0] = 6; b[1] = 15; b[2] = 11;
+  c[0] = 8; c[1] = 14; c[2] = 11;
+  A.solve(b);
+  A.solve_transpose(c);
+  for (int i=0; i < 3; i++) {
+    EXPECT_NEAR(b[i], i + 1.0, 1e-12);
+    EXPECT_NEAR(c[i], i + 1.0, 1e-12);
+  }
+}
+
+/* without selection a new site fixes with probability 1/2N, and the visits
+ * are near the diffusion's 2/c away from fixation */
+TEST(WrightFisherChainTest, Neutral) {
+  WrightFisherChain chain(20, diploid, infinite_sites, 1e-9, 1e-9, 0.0);
+  int n = chain.copies();
+  ASSERT_EQ(n, 40);
+  std::vector<double> h, y;
+  chain.fixation(h);
+  chain.visits(y);
+  EXPECT_NEAR(h[1], 1.0 / n, 1e-9);
+  for (int x=2; x <= n/2; x += 6) {
+    EXPECT_NEAR(h[x], (double)x / n, 1e-9);
+    EXPECT_NEAR(y[x], 2.0 / x, 0.05 * 2.0 / x);
+  }
+}
+
+/* the visits are those of the chain: y = e1 + y Q over the counts 1 to 2N-1 */
+TEST(WrightFisherChainTest, VisitsSolveChain) {
+  WrightFisherChain chain(10, diploid, infinite_sites, 1.0, 0.5, 0.0, 0.0, 0.2);
+  int n = chain.copies();
+  std::vector<double> y, row, next(n+1, 0.0);
+  chain.visits(y);
+  next[1] = 1.0;
+  for (int x=1; x < n; x++) {
+    int first = chain.transition_row(x, row);
+    for (int k=0; k < (int)row.size(); k++) next[first + k] += y[x] * row[k];
+  }
+  for (int x=1; x < n; x++) EXPECT_NEAR(next[x], y[x], 1e-10 * y[1]);
+}
+
+/* the sojourn distribution accounts for every site, and the fixed ones in
+ * proportion to the fixation probability */
+TEST(WrightFisherChainTest, SojournDistribution) {
+  WrightFisherChain chain(10, diploid, infinite_sites, 0.5, 0.1, 0.0, 0.2, 0.1);
+  std::vector<double> h, loss, fixed;
+  chain.fixation(h);
+  chain.sojourn(100000, 1e-12, loss, fixed);
+  double lost = 0.0, fix = 0.0;
+  for (int t=0; t < (int)loss.size(); t++) {
+    lost += loss[t];
+    fix += fixed[t];
+  }
+  EXPECT_NEAR(lost + fix, 1.0, 1e-10);
+  EXPECT_NEAR(fix, h[1], 1e-10);
+  EXPECT_LT(h[1], 1.0 / 20);
+}
+
+/* the finite sites chain's stationary distribution, symmetric when the
+ * optimum is between the homozygotes */
+TEST(WrightFisherChainTest, Stationary) {
+  WrightFisherChain chain(15, diploid, finite_sites, 1.0, 0.5, 0.0, 0.0, 0.0, 0.01);
+  std::vector<double> pi, row;
+  chain.stationary(pi);
+  int n = chain.copies();
+  ASSERT_EQ((int)pi.size(), n + 1);
+  double total = 0.0;
+  for (int x=0; x <= n; x++) {
+    total += pi[x];
+    EXPECT_NEAR(pi[x], pi[n-x], 1e-10);
+  }
+  EXPECT_NEAR(total, 1.0, 1e-12);
+
+  /* and it is stationary: pi P = pi */
+  std::vector<double> next(n+1, 0.0);
+  for (int x=0; x <= n; x++) {
+    int first = chain.transition_row(x, row);
+    for (int k=0; k < (int)row.size(); k++) next[first + k] += pi[x] * row[k];
+  }
+  for (int x=0; x <= n; x++) EXPECT_NEAR(next[x], pi[x], 1e-10);
+}
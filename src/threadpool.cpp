@@ -0,0 +1,126 @@
+#include <thread>
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+
+#include "threadpool.h"
+#include "error_handling.h"
+
+using std::vector;
+using std::deque;
+using std::string;
+using std::mutex;
+using std::lock_guard;
+using std::thread;
+
+/* Create a pool with nthreads workers. If nthreads is not positive, use one
+ * worker per hardware thread */
+WorkStealingPool::WorkStealingPool(int n) : steal_count(0) {
+  nthreads = n > 0 ? n : hardware_threads();
+  next_queue = 0;
+  for (int i=0; i < nthreads; i++)
+    queues.push_back(new WorkerQueue);
+}
+
+/* The pool doesn't own the tasks, only the queues */
+WorkStealingPool::~WorkStealingPool() {
+  for (int i=0; i < nthreads; i++)
+    delete queues[i];
+}
+
+/* number of threads the machine offers, with a fallback of one */
+int WorkStealingPool::hardware_threads(void) {
+  int n = (int)thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
+
+/* deal a task out to the next worker's queue */
+void WorkStealingPool::add(PoolTask *t) {
+  if (t == NULL) throw SimError("cannot add a null task to the pool");
+  queues[next_queue]->tasks.push_back(t);
+  next_queue = (next_queue+1) % nthreads;
+}
+
+/* Run all the tasks that have been added, returning once they've all
+ * completed */
+void WorkStealingPool::run(void) {
+  vector<thread> workers;
+  for (int i=0; i < nthreads; i++)
+    workers.push_back(thread(&WorkStealingPool::work, this, i));
+  for (int i=0; i < nthreads; i++)
+    workers[i].join();
+}
+
+/* main loop of each worker thread */
+void WorkStealingPool::work(int worker) {
+  PoolTask *t;
+  while ((t = next_task(worker)) != NULL) {
+    try {
+      t->run(worker);
+    } catch (SimError &e) {
+      lock_guard<mutex> guard(error_lock);
+      error_list.push_back(e.detail);
+    }
+  }
+}
+
+/* take the next task from the front of our own queue, or steal one */
+PoolTask* WorkStealingPool::next_task(int worker) {
+  {
+    lock_guard<mutex> guard(queues[worker]->lock);
+    if (!queues[worker]->tasks.empty()) {
+      PoolTask *t = queues[worker]->tasks.front();
+      queues[worker]->tasks.pop_front();
+      return t;
+    }
+  }
+  return steal_task(worker);
+}
+
+/* Steal from the front of the fullest other queue, its longest task if they
+ * were added longest-first. Tasks are never added once the pool is running,
+ * so if every queue is empty we're done. */
+PoolTask* WorkStealingPool::steal_task(int thief) {
+  while (1) {
+    int victim = -1;
+    size_t most = 0;
+    for (int i=0; i < nthreads; i++) {
+      if (i == thief) continue;
+      lock_guard<mutex> guard(queues[i]->lock);
+      if (queues[i]->tasks.size() > most) {
+        most = queues[i]->tasks.size();
+        victim = i;
+      }
+    }
+    if (victim < 0) return NULL;
+
+    /* the victim may have drained its queue since we looked, in which case
+     * we go around again */
+    lock_guard<mutex> guard(queues[victim]->lock);
+    if (!queues[victim]->tasks.empty()) {
+      PoolTask *t = queues[victim]->tasks.front();
+      queues[victim]->tasks.pop_front();
+      steal_count++;
+      return t;
+    }
+  }
+}
+
+/* number of worker threads */
+int WorkStealingPool::size(void) const {
+  return nthreads;
+}
+
+/* number of tasks that were run by a worker other than the one they were
+ * dealt to */
+int WorkStealingPool::steals(void) const {
+  return steal_count;
+}
+
+/* messages from tasks that threw an exception */
+const vector<string>& WorkStealingPool::errors(void) const {
+  return error_list;
+}
+
+/* END */
@@ -0,0 +1,60 @@
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+
+/* A unit of work for the WorkStealingPool. Subclasses implement run(), which
+ * is given the index of the worker thread that is running it */
+class PoolTask {
+public:
+  PoolTask() { }
+  virtual ~PoolTask() { }
+  virtual void run(int worker) = 0;
+};
+
+/* The WorkStealingPool runs a fixed batch of tasks on a set of worker threads.
+ * Each worker has its own deque of tasks. Tasks are dealt out round-robin in
+ * the order they are added, so if they are added longest-first, every worker
+ * starts with its own longest-first queue. A worker takes tasks from the front
+ * of its own deque and, once it runs dry, steals from the front of the fullest
+ * other deque, which is that worker's longest task still waiting. Long tasks
+ * so start as early as they can, which keeps all the threads busy until the
+ * very end of the batch even when task lengths vary by orders of magnitude. */
+class WorkStealingPool {
+public:
+  WorkStealingPool(int nthreads = 0);
+  ~WorkStealingPool();
+  void add(PoolTask *t);
+  void run(void);
+  int size(void) const;
+  int steals(void) const;
+  const std::vector<std::string>& errors(void) const;
+
+  static int hardware_threads(void);
+
+private:
+  struct WorkerQueue {
+    std::mutex lock;
+    std::deque<PoolTask*> tasks;
+  };
+
+  void work(int worker);
+  PoolTask* next_task(int worker);
+  PoolTask* steal_task(int thief);
+
+  int nthreads;
+  int next_queue;                    /* round-robin position used by add() */
+  std::vector<WorkerQueue*> queues;  /* one deque per worker */
+  std::atomic<int> steal_count;
+
+  /* errors thrown by tasks are caught and recorded here, so one failure
+   * doesn't take down the rest of the batch */
+  std::mutex error_lock;
+  std::vector<std::string> error_list;
+};
+
+#endif /* __THREADPOOL_H__ */
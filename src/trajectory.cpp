@@ -0,0 +1,169 @@
+#include <string.h>
+#include <zlib.h>
+
+#include "trajectory.h"
+#include "error_handling.h"
+
+using std::string;
+using std::vector;
+
+/* append n bytes to a buffer */
+static void append(vector<unsigned char> &buf, const void *p, size_t n) {
+  const unsigned char *c = (const unsigned char *)p;
+  buf.insert(buf.end(), c, c+n);
+}
+
+template<class T> static void append_column(vector<unsigned char> &buf, const vector<T> &col) {
+  if (!col.empty()) append(buf, &col[0], col.size()*sizeof(T));
+}
+
+/* open the file and write the header */
+TrajectoryWriter::TrajectoryWriter(const string &p, int popsize, int ploidy, int chunk)
+    : path(p), chunk_generations(chunk) {
+  if (chunk_generations < 1) throw SimError("trajectory chunks must hold at least one generation");
+  out = fopen(path.c_str(), "wb");
+  if (out == NULL) throw SimError(0, "failed to open trajectory file %s", path.c_str());
+  uint32_t header[4] = { TRAJECTORY_VERSION, (uint32_t)popsize, (uint32_t)ploidy, (uint32_t)chunk_generations };
+  if (fwrite("QTRJ", 1, 4, out) != 4 || fwrite(header, sizeof(header), 1, out) != 1)
+    throw SimError(0, "failed to write to trajectory file %s", path.c_str());
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+  /* errors can't be thrown from here, so close() should be called explicitly */
+  if (out != NULL) {
+    try { close(); } catch (SimError &e) { }
+  }
+}
+
+/* start a new generation, whose sites are then given by add_site() */
+void
+TrajectoryWriter::begin_generation(int generation, double mean, double variance) {
+  generations.push_back(generation);
+  means.push_back(mean);
+  variances.push_back(variance);
+  nsites.push_back(0);
+}
+
+void
+TrajectoryWriter::end_generation(void) {
+  if ((int)generations.size() >= chunk_generations) write_chunk();
+}
+
+/* write any partial chunk and close the file */
+void
+TrajectoryWriter::close(void) {
+  if (out == NULL) return;
+  if (!generations.empty()) write_chunk();
+  FILE *f = out;
+  out = NULL;
+  if (fclose(f) != 0) throw SimError(0, "failed to close trajectory file %s", path.c_str());
+}
+
+/* lay out the columns, compress them, and write the chunk */
+void
+TrajectoryWriter::write_chunk(void) {
+  raw.clear();
+  append_column(raw, generations);
+  append_column(raw, nsites);
+  append_column(raw, means);
+  append_column(raw, variances);
+  append_column(raw, effects);
+  append_column(raw, ids);
+  append_column(raw, counts);
+
+  uLongf clen = compressBound(raw.size());
+  compressed.resize(clen);
+  if (compress2(&compressed[0], &clen, raw.empty() ? NULL : &raw[0], raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+    throw SimError("failed to compress trajectory chunk");
+
+  uint32_t header[4] = { (uint32_t)generations.size(), (uint32_t)ids.size(),
+    (uint32_t)raw.size(), (uint32_t)clen };
+  if (fwrite("QTCK", 1, 4, out) != 4 || fwrite(header, sizeof(header), 1, out) != 1 ||
+      fwrite(&compressed[0], 1, clen, out) != clen)
+    throw SimError(0, "failed to write to trajectory file %s", path.c_str());
+
+  generations.clear();
+  nsites.clear();
+  means.clear();
+  variances.clear();
+  ids.clear();
+  counts.clear();
+  effects.clear();
+}
+
+/* open the file and check its header */
+TrajectoryReader::TrajectoryReader(const string &p) : path(p) {
+  ngens = nrecords = gen_index = record_index = 0;
+  in = fopen(path.c_str(), "rb");
+  if (in == NULL) throw SimError(0, "failed to open trajectory file %s", path.c_str());
+  char magic[4];
+  uint32_t header[4];
+  if (fread(magic, 1, 4, in) != 4 || memcmp(magic, "QTRJ", 4) != 0 ||
+      fread(header, sizeof(header), 1, in) != 1)
+    throw SimError(0, "%s is not a trajectory file", path.c_str());
+  if (header[0] != TRAJECTORY_VERSION)
+    throw SimError(0, "unsupported trajectory file version %u", header[0]);
+  popsize = header[1];
+  ploidy = header[2];
+}
+
+TrajectoryReader::~TrajectoryReader() {
+  if (in != NULL) fclose(in);
+}
+
+/* read and inflate the next chunk. Returns false at the end of the file */
+bool
+TrajectoryReader::read_chunk(void) {
+  char magic[4];
+  uint32_t header[4];
+  size_t n = fread(magic, 1, 4, in);
+  if (n == 0 && feof(in)) return false;
+  if (n != 4 || memcmp(magic, "QTCK", 4) != 0 || fread(header, sizeof(header), 1, in) != 1)
+    throw SimError(0, "corrupt chunk in trajectory file %s", path.c_str());
+  ngens = header[0];
+  nrecords = header[1];
+  uLongf rlen = header[2];
+  compressed.resize(header[3]);
+  if (header[3] > 0 && fread(&compressed[0], 1, header[3], in) != header[3])
+    throw SimError(0, "truncated trajectory file %s", path.c_str());
+  size_t expected = ngens*(2*sizeof(uint32_t) + 2*sizeof(double)) +
+    nrecords*(sizeof(double) + 2*sizeof(uint32_t));
+  if (rlen != expected)
+    throw SimError(0, "corrupt chunk in trajectory file %s", path.c_str());
+  raw.resize(rlen > 0 ? rlen : 1);
+  if (uncompress(&raw[0], &rlen, &compressed[0], compressed.size()) != Z_OK || rlen != expected)
+    throw SimError(0, "failed to inflate chunk in trajectory file %s", path.c_str());
+
+  const unsigned char *p = &raw[0];
+  generations = (const int32_t *)p;   p += ngens*sizeof(int32_t);
+  nsites = (const uint32_t *)p;       p += ngens*sizeof(uint32_t);
+  means = (const double *)p;          p += ngens*sizeof(double);
+  variances = (const double *)p;      p += ngens*sizeof(double);
+  effects = (const double *)p;        p += nrecords*sizeof(double);
+  ids = (const uint32_t *)p;          p += nrecords*sizeof(uint32_t);
+  counts = (const int32_t *)p;
+  gen_index = record_index = 0;
+  return true;
+}
+
+/* get the next generation, returning false when there are no more */
+bool
+TrajectoryReader::next(TrajectoryGeneration &g) {
+  while (gen_index >= ngens) {
+    if (!read_chunk()) return false;
+  }
+  g.generation = generations[gen_index];
+  g.phenotype_mean = means[gen_index];
+  g.phenotype_variance = variances[gen_index];
+  g.nsites = nsites[gen_index];
+  if (record_index + g.nsites > nrecords)
+    throw SimError(0, "corrupt chunk in trajectory file %s", path.c_str());
+  g.ids = ids + record_index;
+  g.counts = counts + record_index;
+  g.effects = effects + record_index;
+  record_index += g.nsites;
+  gen_index++;
+  return true;
+}
+
+/* END */
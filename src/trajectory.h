@@ -0,0 +1,111 @@
+#ifndef __TRAJECTORY_H__
+#define __TRAJECTORY_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* Binary trajectory files hold the same information as the 'frequencies' and
+ * 'phenotype' statistics, the derived allele count of every segregating
+ * site and the phenotype mean and variance in each generation, without any
+ * text formatting or parsing.
+ *
+ * A file is a header followed by chunks. Each chunk holds a run of
+ * consecutive generations, stored by column and compressed with zlib:
+ *
+ *   header:  "QTRJ", uint32 version, popsize, ploidy, chunk_generations
+ *   chunk:   "QTCK", uint32 ngens, nrecords, raw_bytes, compressed_bytes,
+ *            followed by compressed_bytes of zlib data which inflate to
+ *
+ *              int32  generation[ngens]
+ *              uint32 nsites[ngens]          (records in each generation)
+ *              double phenotype_mean[ngens]
+ *              double phenotype_variance[ngens]
+ *              double effect[nrecords]       (records are generation by generation)
+ *              uint32 id[nrecords]           (site ids)
+ *              int32  count[nrecords]        (derived allele counts)
+ *
+ * The columns are ordered so that each one is aligned for its type.
+ * Integers and doubles are in the byte order of the machine that wrote the
+ * file. The frequency of a site is count / (ploidy * popsize). */
+
+#define TRAJECTORY_VERSION 1
+
+/* one generation, as returned by TrajectoryReader. The arrays point into
+ * the reader's current chunk, and are valid until the next call to next() */
+struct TrajectoryGeneration {
+  int generation;
+  double phenotype_mean;
+  double phenotype_variance;
+  int nsites;
+  const uint32_t *ids;
+  const int32_t *counts;
+  const double *effects;
+};
+
+/* Accumulates generations and writes them out a chunk at a time */
+class TrajectoryWriter {
+public:
+  TrajectoryWriter(const std::string &path, int popsize, int ploidy, int chunk_generations = 256);
+  ~TrajectoryWriter();
+  void begin_generation(int generation, double mean, double variance);
+  inline void add_site(uint32_t id, int32_t count, double effect) {
+    ids.push_back(id);
+    counts.push_back(count);
+    effects.push_back(effect);
+    nsites.back()++;
+  }
+  void end_generation(void);
+  void close(void);
+
+private:
+  void write_chunk(void);
+
+  FILE *out;
+  std::string path;
+  int chunk_generations;
+
+  /* columns of the chunk being accumulated */
+  std::vector<int32_t> generations;
+  std::vector<uint32_t> nsites;
+  std::vector<double> means, variances;
+  std::vector<uint32_t> ids;
+  std::vector<int32_t> counts;
+  std::vector<double> effects;
+
+  std::vector<unsigned char> raw, compressed;
+};
+
+/* Reads a trajectory file one generation at a time */
+class TrajectoryReader {
+public:
+  TrajectoryReader(const std::string &path);
+  ~TrajectoryReader();
+  bool next(TrajectoryGeneration &g);
+  double frequency(int32_t count) const { return count / (double)(ploidy * popsize); }
+
+  int popsize;
+  int ploidy;
+
+private:
+  bool read_chunk(void);
+
+  FILE *in;
+  std::string path;
+
+  /* the current chunk, inflated, and pointers to its columns */
+  std::vector<unsigned char> raw, compressed;
+  uint32_t ngens, nrecords;
+  const int32_t *generations;
+  const uint32_t *nsites;
+  const double *means, *variances;
+  const uint32_t *ids;
+  const int32_t *counts;
+  const double *effects;
+
+  /* position within the current chunk */
+  uint32_t gen_index, record_index;
+};
+
+#endif /* __TRAJECTORY_H__ */
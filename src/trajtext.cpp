@@ -0,0 +1,89 @@
+/*
+ *  trajtext.cpp
+ *
+ *  Convert a binary trajectory file written by quant --trajectory back to
+ *  the text printed by the 'frequencies' and 'phenotype' statistics, so
+ *  existing scripts (e.g. parse.trajectories.from.frequency.data in
+ *  r/evolveq.R) can read it:
+ *
+ *    gen: <g> freqs: <id>:<freq> ...
+ *    gen: <g> pheno: <mean> <variance>
+ */
+
+#include <getopt.h>
+#include <iostream>
+
+#include "error_handling.h"
+#include "trajectory.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+void usage(void);
+
+int
+main(int argc, char **argv) { try {
+  bool freqs = false, pheno = false, effects = false;
+
+  while (1) {
+    static struct option long_options[] = {
+      {"freqs", no_argument, 0, 'f'},
+      {"pheno", no_argument, 0, 'p'},
+      {"effects", no_argument, 0, 'e'},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    int c = getopt_long(argc, argv, "fpe", long_options, &option_index);
+    if (c == -1) break;
+    switch (c) {
+      case 'f': freqs = true; break;
+      case 'p': pheno = true; break;
+      case 'e': effects = true; break;
+      default:
+        throw SimUsageError("unrecognized option");
+    }
+  }
+  if (optind != argc-1) throw SimUsageError("must give exactly one trajectory file");
+  if (!freqs && !pheno) freqs = pheno = true;
+
+  TrajectoryReader reader(argv[optind]);
+  TrajectoryGeneration g;
+  while (reader.next(g)) {
+    if (freqs) {
+      cout << "gen: " << g.generation << " freqs:";
+      for (int i=0; i < g.nsites; i++) {
+        cout << " " << g.ids[i] << ":" << reader.frequency(g.counts[i]);
+        if (effects) cout << ":" << g.effects[i];
+      }
+      cout << "\n";
+    }
+    if (pheno)
+      cout << "gen: " << g.generation << " pheno: " << g.phenotype_mean
+        << " " << g.phenotype_variance << "\n";
+  }
+  cout.flush();
+
+/* catch any errors that were thrown anywhere inside this block */
+} catch (SimUsageError e) {
+   cerr << endl << "detected usage error: " << e.detail << endl << endl;
+   usage();
+   return 1;
+} catch(SimError &e) {
+   cerr << "uncaught exception: " << e.detail << endl;
+   return 1;
+} return 0; }
+
+/* print a help message */
+void
+usage(void) {
+  cerr << "usage: trajtext [options] <trajectory file>\n"
+    << "  -f/--freqs            print the site frequencies\n"
+    << "  -p/--pheno            print the phenotype mean and variance\n"
+    << "                        (by default both are printed)\n"
+    << "  -e/--effects          append each site's effect size, as id:freq:effect\n"
+    << "\n";
+  return;
+}
+
+/* END */
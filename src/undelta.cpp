@@ -0,0 +1,147 @@
+/*
+ *  undelta.cpp
+ *
+ *  Rebuild the output of the 'frequencies' statistic from that of the
+ *  'frequency-deltas' statistic. Each keyframe or delta line is replaced by
+ *  the 'gen: <g> freqs: <id>:<freq> ...' line quant would have printed, and
+ *  every other line is passed through unchanged. Input may be gzip
+ *  compressed, and is read from standard input if no file is given.
+ *
+ *  The population size and ploidy, needed to turn counts into frequencies,
+ *  are read from the 'params:' line.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "error_handling.h"
+#include "output.h"
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+void usage(void);
+
+/* the state of one position in the sites vector */
+struct DeltaSite {
+  DeltaSite() : present(false), id(0), count(0) { }
+  bool present;
+  unsigned long id;
+  long count;
+};
+
+/* find the value of key=<value> in the params line */
+string param(const string &line, const char *key) {
+  string k = string(" ") + key + "=";
+  size_t pos = line.find(k);
+  if (pos == string::npos) return string("");
+  pos += k.size();
+  return line.substr(pos, line.find(' ', pos) - pos);
+}
+
+/* apply one token of a keyframe or delta line */
+void apply(vector<DeltaSite> &sites, const char *tok, bool keyframe) {
+  char *end;
+  char op = keyframe ? '+' : tok[0];
+  if (op == '+' || op == '-') tok += keyframe ? 0 : 1;
+  else op = ' ';
+
+  long loc = strtol(tok, &end, 10);
+  if (end == tok || loc < 0) throw SimError(0, "bad site position in %s", tok);
+  if ((size_t)loc >= sites.size()) sites.resize(loc+1);
+  DeltaSite &s = sites[loc];
+
+  if (op == '-') {
+    s.present = false;
+  } else if (op == '+') {
+    /* <loc>:<id>:<count>:<effect> */
+    if (*end != ':') throw SimError(0, "bad new site %s", tok);
+    s.id = strtoul(end+1, &end, 10);
+    if (*end != ':') throw SimError(0, "bad new site %s", tok);
+    s.count = strtol(end+1, &end, 10);
+    s.present = true;
+  } else {
+    /* <loc>:<change> */
+    if (*end != ':' || !s.present) throw SimError(0, "bad count change %s", tok);
+    s.count += strtol(end+1, &end, 10);
+  }
+}
+
+int
+main(int argc, char **argv) { try {
+  if (argc > 2 || (argc == 2 && argv[1][0] == '-'))
+    throw SimUsageError("give at most one input file");
+
+  gzFile in = argc == 2 ? gzopen(argv[1], "rb") : gzdopen(dup(STDIN_FILENO), "rb");
+  if (in == NULL) throw SimError(0, "cannot open %s", argc == 2 ? argv[1] : "stdin");
+
+  double alleles = 0;
+  vector<DeltaSite> sites;
+  string line;
+  while (read_line(in, line)) {
+    size_t colon = line.find(" keyframe:");
+    bool keyframe = colon != string::npos;
+    if (!keyframe) colon = line.find(" delta:");
+    if (line.compare(0, 5, "gen: ") != 0 || colon == string::npos) {
+      if (line.compare(0, 7, "params:") == 0) {
+        double popsize = atof(param(line, "popsize").c_str());
+        alleles = (param(line, "ploidy") == "haploid" ? 1 : 2) * popsize;
+      }
+      out << line << '\n';
+      continue;
+    }
+    if (alleles <= 0) throw SimError("no params line before the first frequency deltas");
+
+    /* apply the keyframe or delta */
+    if (keyframe) {
+      for (size_t i=0; i < sites.size(); i++) sites[i].present = false;
+    }
+    size_t start = line.find(':', colon+1) + 1;
+    char *p = &line[start];
+    char *tok;
+    while ((tok = strtok(p, " ")) != NULL) {
+      p = NULL;
+      apply(sites, tok, keyframe);
+    }
+
+    /* print the frequencies line */
+    out << line.substr(0, colon) << " freqs:";
+    for (size_t i=0; i < sites.size(); i++) {
+      if (sites[i].present)
+        out << " " << sites[i].id << ":" << sites[i].count / alleles;
+    }
+    out << '\n';
+    out.end_generation();
+  }
+  gzclose(in);
+  out.finish();
+
+/* catch any errors that were thrown anywhere inside this block */
+} catch (SimUsageError e) {
+   cerr << endl << "detected usage error: " << e.detail << endl << endl;
+   usage();
+   return 1;
+} catch(SimError &e) {
+   cerr << "uncaught exception: " << e.detail << endl;
+   return 1;
+} return 0; }
+
+/* print a help message */
+void
+usage(void) {
+  cerr << "usage: undelta [<quant output>]\n"
+    << "  Rebuilds the 'frequencies' statistic from 'frequency-deltas' output. The\n"
+    << "  input may be gzip compressed, and is read from stdin if no file is given.\n"
+    << "\n";
+  return;
+}
+
+/* END */
@@ -0,0 +1,323 @@
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "wf_chain.h"
+#include "error_handling.h"
+
+using std::vector;
+
+/* binomial probabilities below this are left out of the transition matrix */
+#define TRUNCATION 1e-17
+
+BandMatrix::BandMatrix(int size, int kl, int ku) : m(size), kl(kl), ku(ku),
+    width(kl + ku + 1), data((size_t)size * (kl + ku + 1), 0.0) {
+  if (size <= 0 || kl < 0 || ku < 0) throw SimError("invalid band matrix");
+}
+
+/* LU decomposition in place, L below the diagonal (with a unit diagonal
+ * left out) and U on and above it */
+void
+BandMatrix::factor(void) {
+  for (int k=0; k < m; k++) {
+    double pivot = (*this)(k, k);
+    if (pivot == 0.0) throw SimError(0, "singular band matrix at row %d", k);
+    int last_row = std::min(m-1, k + kl), last_col = std::min(m-1, k + ku);
+    for (int i=k+1; i <= last_row; i++) {
+      double l = (*this)(i, k) / pivot;
+      (*this)(i, k) = l;
+      if (l == 0.0) continue;
+      for (int j=k+1; j <= last_col; j++) (*this)(i, j) -= l * (*this)(k, j);
+    }
+  }
+}
+
+/* solve A x = b, once factored, overwriting b with x */
+void
+BandMatrix::solve(vector<double> &b) const {
+  for (int i=0; i < m; i++) {
+    double sum = b[i];
+    for (int j=std::max(0, i - kl); j < i; j++) sum -= (*this)(i, j) * b[j];
+    b[i] = sum;
+  }
+  for (int i=m-1; i >= 0; i--) {
+    double sum = b[i];
+    for (int j=i+1; j <= std::min(m-1, i + ku); j++) sum -= (*this)(i, j) * b[j];
+    b[i] = sum / (*this)(i, i);
+  }
+}
+
+/* solve A' x = b (A' = U' L'), once factored, overwriting b with x */
+void
+BandMatrix::solve_transpose(vector<double> &b) const {
+  for (int i=0; i < m; i++) {
+    double sum = b[i];
+    for (int j=std::max(0, i - ku); j < i; j++) sum -= (*this)(j, i) * b[j];
+    b[i] = sum / (*this)(i, i);
+  }
+  for (int i=m-1; i >= 0; i--) {
+    double sum = b[i];
+    for (int j=i+1; j <= std::min(m-1, i + kl); j++) sum -= (*this)(j, i) * b[j];
+    b[i] = sum;
+  }
+}
+
+WrightFisherChain::WrightFisherChain(int N, enum ploidy p, Model model, double a, double s,
+    double opt, double env, double v, double u) : n((int)p * N), ploidy_level(p),
+    model(model), u(u) {
+  if (N <= 0) throw SimError("the chain needs a positive population size");
+  if (!(s > 0)) throw SimError("the chain needs s > 0");
+  if (env < 0 || v < 0) throw SimError("negative variance");
+  if (model == finite_sites && !(u > 0 && u < 0.5))
+    throw SimError("finite sites chain needs a mutation probability between 0 and 0.5");
+
+  /* the genotypes' phenotypes, from Genome::baseline up */
+  double baseline = model == finite_sites ? -a : 0.0;
+  double sig = 2.0/s + 2.0*v;
+  for (int g=0; g <= (int)p; g++) {
+    double z = baseline + g*a - opt;
+    if (env > 0) {
+      /* the fitness averaged over the noise, uniform on [0, env) */
+      double r = sqrt(sig);
+      w[g] = sqrt(M_PI) * r / (2.0*env) * (erf((z + env)/r) - erf(z/r));
+    } else {
+      w[g] = exp(-z*z/sig);
+    }
+  }
+  if (p == haploid) w[2] = 0.0;
+  if (*std::max_element(w, w + (int)p + 1) <= 0)
+    throw SimError("every genotype's fitness is zero");
+}
+
+/* The chances of each number of derived homozygotes, h, among the N
+ * diploids, when x derived copies are placed at random among their 2N,
+ * as independent gametes are. They're returned from the h returned */
+int
+WrightFisherChain::homozygotes(int x, vector<double> &chance) const {
+  int N = n / 2, lo = std::max(0, x - N), hi = x / 2;
+  chance.clear();
+  double total = lgamma(n + 1.0) - lgamma(x + 1.0) - lgamma(n - x + 1.0);
+  for (int h=lo; h <= hi; h++) {
+    int het = x - 2*h;
+    chance.push_back(exp(lgamma(N + 1.0) - lgamma(h + 1.0) - lgamma(het + 1.0)
+      - lgamma(N - h - het + 1.0) + het*M_LN2 - total));
+  }
+  return lo;
+}
+
+/* the chance a gamete carries the derived allele, when the parents, chosen
+ * by fitness, have het heterozygotes and hom derived homozygotes (or, for
+ * haploids, het derived individuals), after mutation */
+double
+WrightFisherChain::gamete_frequency(int het, int hom) const {
+  double f;
+  if (ploidy_level == diploid) {
+    int anc = n/2 - het - hom;
+    double total = anc*w[0] + het*w[1] + hom*w[2];
+    f = total > 0 ? (0.5*het*w[1] + hom*w[2]) / total : (0.5*het + hom) / (n/2);
+  } else {
+    double total = (n - het)*w[0] + het*w[1];
+    f = total > 0 ? het*w[1] / total : (double)het / n;
+  }
+  if (model == finite_sites) f = f*(1.0 - u) + (1.0 - f)*u;
+  return f;
+}
+
+/* the expected frequency of the next generation, from count x */
+double
+WrightFisherChain::next_frequency(int x) const {
+  if (ploidy_level == haploid) return gamete_frequency(x, 0);
+  vector<double> chance;
+  int lo = homozygotes(x, chance);
+  double f = 0.0;
+  for (int k=0; k < (int)chance.size(); k++) f += chance[k] * gamete_frequency(x - 2*(lo+k), lo+k);
+  return f;
+}
+
+/* The binomial probabilities of each count of n gametes derived with
+ * probability p, weighted by weight and added to row, which starts from
+ * count first. Those below TRUNCATION are left out. They're worked out from
+ * the mode outwards */
+void
+WrightFisherChain::add_binomial(double p, double weight, vector<double> &row, int &first) const {
+  int lo, hi;
+  vector<double> terms;
+  if (p <= 0.0 || p >= 1.0) {
+    lo = hi = p <= 0.0 ? 0 : n;
+    terms.push_back(weight);
+  } else {
+    double odds = p / (1.0 - p);
+    int mode = std::min(n, (int)floor((n+1) * p));
+    double at_mode = weight * exp(lgamma(n + 1.0) - lgamma(mode + 1.0) - lgamma(n - mode + 1.0)
+      + mode*log(p) + (n - mode)*log1p(-p));
+    vector<double> below;
+    double f = at_mode;
+    for (int k=mode; k > 0; k--) {
+      f *= k / (n - k + 1.0) / odds;
+      if (f < TRUNCATION) break;
+      below.push_back(f);
+    }
+    terms.assign(below.rbegin(), below.rend());
+    lo = mode - (int)below.size();
+    terms.push_back(at_mode);
+    f = at_mode;
+    for (int k=mode; k < n; k++) {
+      f *= (n - k) / (k + 1.0) * odds;
+      if (f < TRUNCATION) break;
+      terms.push_back(f);
+    }
+    hi = lo + (int)terms.size() - 1;
+  }
+  if (row.empty()) {
+    first = lo;
+    row.assign(terms.begin(), terms.end());
+    return;
+  }
+  /* widen the row to take these in */
+  if (lo < first) {
+    row.insert(row.begin(), first - lo, 0.0);
+    first = lo;
+  }
+  if (hi > first + (int)row.size() - 1) row.resize(hi - first + 1, 0.0);
+  for (int k=0; k < (int)terms.size(); k++) row[lo - first + k] += terms[k];
+}
+
+/* The probabilities of the next count from count x, starting from the count
+ * returned. The gametes are independent given the parents' genotypes, so
+ * the next count is binomial given the number of derived homozygotes, and a
+ * mixture of binomials over that */
+int
+WrightFisherChain::transition_row(int x, vector<double> &row) const {
+  row.clear();
+  int first = 0;
+  if (ploidy_level == haploid) {
+    add_binomial(gamete_frequency(x, 0), 1.0, row, first);
+    return first;
+  }
+  vector<double> chance;
+  int lo = homozygotes(x, chance);
+  for (int k=0; k < (int)chance.size(); k++) {
+    if (chance[k] < TRUNCATION) continue;
+    add_binomial(gamete_frequency(x - 2*(lo+k), lo+k), chance[k], row, first);
+  }
+  return first;
+}
+
+/* I - Q for the counts first to last, with Q the transitions among them */
+void
+WrightFisherChain::transient_matrix(int first, int last, BandMatrix *&A) const {
+  int m = last - first + 1, kl = 0, ku = 0;
+  vector< vector<double> > rows(m);
+  vector<int> starts(m);
+  for (int i=0; i < m; i++) {
+    starts[i] = transition_row(first + i, rows[i]) - first;
+    int lo = std::max(starts[i], 0), hi = std::min(starts[i] + (int)rows[i].size() - 1, m-1);
+    if (lo <= hi) {
+      kl = std::max(kl, i - lo);
+      ku = std::max(ku, hi - i);
+    }
+  }
+  A = new BandMatrix(m, kl, ku);
+  for (int i=0; i < m; i++) {
+    (*A)(i, i) = 1.0;
+    for (int k=0; k < (int)rows[i].size(); k++) {
+      int j = starts[i] + k;
+      if (j >= 0 && j < m) (*A)(i, j) -= rows[i][k];
+    }
+  }
+}
+
+/* The expected generations a new site spends at each count, 0 to 2N (0 at
+ * either end), born at count 1: the first row of the fundamental matrix
+ * (I - Q)^-1. Their sum is the expected sojourn */
+void
+WrightFisherChain::visits(vector<double> &y) const {
+  if (model != infinite_sites) throw SimError("visits of a new site are for infinite sites");
+  y.assign(n+1, 0.0);
+  if (n < 2) return;
+  BandMatrix *A;
+  transient_matrix(1, n-1, A);
+  A->factor();
+  vector<double> b(n-1, 0.0);
+  b[0] = 1.0;
+  A->solve_transpose(b);
+  delete A;
+  std::copy(b.begin(), b.end(), y.begin() + 1);
+}
+
+/* the probability a site at each count, 0 to 2N, is eventually fixed */
+void
+WrightFisherChain::fixation(vector<double> &h) const {
+  if (model != infinite_sites) throw SimError("fixation is for infinite sites");
+  h.assign(n+1, 0.0);
+  h[n] = 1.0;
+  if (n < 2) return;
+  vector<double> b(n-1, 0.0), row;
+  for (int x=1; x < n; x++) {
+    int first = transition_row(x, row);
+    if (first + (int)row.size() - 1 == n) b[x-1] = row.back();
+  }
+  BandMatrix *A;
+  transient_matrix(1, n-1, A);
+  A->factor();
+  A->solve(b);
+  delete A;
+  std::copy(b.begin(), b.end(), h.begin() + 1);
+}
+
+/* The distribution of a new site's sojourn, by its fate: loss[t] and
+ * fixed[t] are the probabilities it's lost or fixed after t generations.
+ * They're followed until less than tail of the probability is left, or
+ * for max_t generations */
+void
+WrightFisherChain::sojourn(int max_t, double tail, vector<double> &loss, vector<double> &fixed) const {
+  if (model != infinite_sites) throw SimError("sojourns are for infinite sites");
+  loss.assign(1, 0.0);
+  fixed.assign(1, 0.0);
+  vector< vector<double> > rows(n+1);
+  vector<int> starts(n+1);
+  for (int x=1; x < n; x++) starts[x] = transition_row(x, rows[x]);
+
+  vector<double> now(n+1, 0.0), next(n+1, 0.0);
+  now[1] = 1.0;
+  double left = 1.0;
+  for (int t=1; t <= max_t && left > tail; t++) {
+    std::fill(next.begin(), next.end(), 0.0);
+    for (int x=1; x < n; x++) {
+      if (now[x] == 0.0) continue;
+      const vector<double> &r = rows[x];
+      double *to = &next[starts[x]];
+      for (int k=0; k < (int)r.size(); k++) to[k] += now[x] * r[k];
+    }
+    loss.push_back(next[0]);
+    fixed.push_back(next[n]);
+    left -= next[0] + next[n];
+    next[0] = next[n] = 0.0;
+    now.swap(next);
+  }
+}
+
+/* The stationary distribution of the finite sites chain, over 0 to 2N. The
+ * expected visits to each count between returns to 0 are proportional to
+ * it, and those are a first row of a fundamental matrix, as for visits() */
+void
+WrightFisherChain::stationary(vector<double> &pi) const {
+  if (model != finite_sites) throw SimError("the stationary distribution is for finite sites");
+  vector<double> row;
+  int first = transition_row(0, row);
+  vector<double> b(n, 0.0);
+  for (int k=0; k < (int)row.size(); k++) if (first + k > 0) b[first + k - 1] = row[k];
+  BandMatrix *A;
+  transient_matrix(1, n, A);
+  A->factor();
+  A->solve_transpose(b);
+  delete A;
+  pi.assign(n+1, 1.0);
+  std::copy(b.begin(), b.end(), pi.begin() + 1);
+  double sum = 0.0;
+  for (int x=0; x <= n; x++) sum += pi[x];
+  for (int x=0; x <= n; x++) pi[x] /= sum;
+}
+
+/* END */
@@ -0,0 +1,83 @@
+#ifndef __WF_CHAIN_H__
+#define __WF_CHAIN_H__
+
+#include <vector>
+
+#include "common.h"
+
+/* A square band matrix, with kl diagonals below the main one and ku above,
+ * kept row by row. factor() does LU decomposition in place, without
+ * pivoting, which is stable for the diagonally dominant matrices it's used
+ * on (I - Q, for the transient part Q of a Markov chain) and keeps the LU
+ * factors within the band. */
+class BandMatrix {
+public:
+  BandMatrix(int size, int kl, int ku);
+
+  int size(void) const { return m; }
+  double& operator()(int i, int j) { return data[(size_t)i*width + j - i + kl]; }
+  double operator()(int i, int j) const { return data[(size_t)i*width + j - i + kl]; }
+
+  void factor(void);
+  void solve(std::vector<double> &b) const;
+  void solve_transpose(std::vector<double> &b) const;
+
+  int m, kl, ku, width;
+  std::vector<double> data;
+};
+
+/* The Wright-Fisher chain of a single site's derived allele count, 0 to 2N
+ * (N haploid), under quant's model. Each generation every offspring's
+ * parents are chosen by the fitness exp(-(z-opt)^2/sig) of their phenotype,
+ * sig 2/s, and each passes on a gamete. A genotype's phenotype is
+ * Genome::baseline plus the site's effect for each derived allele: the
+ * baseline is -a in the finite sites model, so the genotypes are -a, 0, a,
+ * and 0 in the infinite sites model. Every individual's phenotype also has
+ * the uniform environmental noise quant adds, on [0, env), and a Gaussian
+ * background of variance v, standing for the rest of the sites, which are
+ * averaged over.
+ *
+ * The gametes are independent, so given the count the derived copies are
+ * spread over the individuals at random, and the next count is binomial
+ * given how many of them are paired up in homozygotes. The count alone is
+ * then a Markov chain, with no assumption of Hardy-Weinberg proportions.
+ *
+ * In the infinite sites model a site is born at count 1, and is lost at 0 or
+ * fixed at 2N. In the finite sites model each copy mutates to the other
+ * allele with probability u a generation (mu over the number of loci), so
+ * the chain has a stationary distribution instead.
+ *
+ * Binomial probabilities below TRUNCATION are dropped, so each count moves
+ * only within a band, and the chain's transition matrix is a band matrix.
+ * Expected visits, fixation probabilities and the stationary distribution
+ * come from a banded LU solve, and the distribution of the sojourn time from
+ * repeated products with the band. */
+class WrightFisherChain {
+public:
+  WrightFisherChain(int N, enum ploidy p, Model model, double a, double s, double opt,
+    double env = 0.0, double v = 0.0, double u = 0.0);
+
+  int copies(void) const { return n; }
+  double fitness(int g) const { return w[g]; }
+  double next_frequency(int x) const;
+  int transition_row(int x, std::vector<double> &row) const;
+
+  void visits(std::vector<double> &y) const;
+  void fixation(std::vector<double> &h) const;
+  void sojourn(int max_t, double tail, std::vector<double> &loss, std::vector<double> &fixed) const;
+  void stationary(std::vector<double> &pi) const;
+
+private:
+  int homozygotes(int x, std::vector<double> &chance) const;
+  double gamete_frequency(int het, int hom) const;
+  void add_binomial(double p, double weight, std::vector<double> &row, int &first) const;
+  void transient_matrix(int first, int last, BandMatrix *&A) const;
+
+  int n;                        /* copies of the site */
+  enum ploidy ploidy_level;
+  Model model;
+  double u;                     /* mutation probability per copy (finite sites) */
+  double w[3];                  /* fitness of each genotype */
+};
+
+#endif /* __WF_CHAIN_H__ */